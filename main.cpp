@@ -34,6 +34,10 @@
 #include <errno.h>
 #include <limits.h>
 #include <ctype.h>
+#include <sched.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 
 #include "intel_fpga_platform_api.h"
@@ -47,20 +51,49 @@ static void show_help(const char *program)
 {
     printf(
         "Usage:\n"
-        " %s [--uio-driver-path=<path>] [--start-address=<address>] [--h2t-t2h-mem-size=<size>] [--port=<port>] [--ip=<ip address>]\n"
+        " %s [--uio-driver-path=<path>] [--uio-maps=<index>] [--start-address=<address>] [--wc-map-path=<path>] [--h2t-t2h-mem-size=<size>] [--port=<port>] [--unix-socket=<path>] [--handshake-timeout=<ms>] [--cold-reconnect] [--ip=<ip address>] [--event-loop=<select|epoll>] [--interrupt-mode] [--mmio-burst=<kernel>] [--threaded]\n"
+        "    [--busy-poll[=<usecs>]] [--cpu=<cpu>] [--engine-cpu=<cpu>] [--interrupt-cpu=<cpu>] [--sched-fifo=<priority>]\n"
         " %s --version\n"
         " %s --help\n\n"
         "Optional arguments:\n"
-        " --uio-driver-path=<path>, -u <path>       UIO driver path (default: /dev/uio0)\n"
-        " --start-address=<address>, -s <address>   JTAG-Over-Protocol interface starting address within this UIO driver (default: 0)\n"
+        " --uio-driver-path=<path>, -u <path>       UIO driver path, or a comma separated list of them (default: /dev/uio0)\n"
+        " --uio-maps=<index>                        UIO map index, or a comma separated list of them, mapped on every UIO driver (default: 0)\n"
+        " --start-address=<address>, -s <address>   JTAG-Over-Protocol interface starting address within each UIO map, or a comma\n"
+        "                                           separated list of them, one interface each (default: 0)\n"
+        " --wc-map-path=<path>                      write-combining mapping of the same span for the H2T/MGMT payload memory,\n"
+        "                                           e.g. /sys/class/uio/uio0/device/resource0_wc (default: none, payloads are written uncached)\n"
+        "                                           a comma separated list gives one per UIO driver and map, in that order\n"
         " --h2t-t2h-mem-size=<size>, -m <size>      JTAG-Over-Protocol H2T/T2H Memory Size in bytes (default: 4096)\n"
         " --port=<port>, -p <port>                  listening port (default: 0)\n"
+        " --unix-socket=<path>                      also listen on a Unix domain socket, for clients on this host; a leading '@'\n"
+        "                                           names one in the abstract namespace (default: none)\n"
+        " --handshake-timeout=<ms>                  time a client has to connect all of its sockets, and each socket to identify\n"
+        "                                           itself, before it is dropped (default: 10000)\n"
+        " --cold-reconnect                          reset the IP for every client, not only after a client that did not\n"
+        "                                           disconnect cleanly or that asked for it with FULL_RESET (default: off)\n"
+        " --event-loop=<select|epoll>, -e <backend> server event loop backend (default: epoll)\n"
+        " --interrupt-mode, -I                      wait for the IP interrupt instead of polling the hardware (default: off)\n"
+        " --mmio-burst=<kernel>, -b <kernel>        H2T/T2H payload copy kernel: auto, 64, sse2, avx2 or neon (default: auto)\n"
+        "                                           use 64 if the bus to the IP does not accept accesses wider than 64 bits\n"
+        " --threaded, -T                            serve the network and the hardware from separate threads (default: off)\n"
+        " --busy-poll[=<usecs>]                     never sleep: poll the sockets and the hardware in a tight loop, with the data sockets\n"
+        "                                           busy polling the device queue for <usecs> (default: off, 50 when given without a value)\n"
+        " --cpu=<cpu>                               pin the server thread to <cpu>, or a comma separated list of them, one per interface\n"
+        "                                           (default: none)\n"
+        " --engine-cpu=<cpu>                        same for the hardware thread of --threaded (default: none, it shares the server CPU)\n"
+        " --interrupt-cpu=<cpu>                     pin the UIO interrupt thread to <cpu> (default: none)\n"
+        " --sched-fifo=<priority>                   run the pinned threads SCHED_FIFO at <priority> (default: off)\n"
         " --version, -v                             print version and exit\n"
         " --help, -h                                print the usage description\n"
         "\n"
         "Note:\n"
         " In the device tree, the address span of the whole JTAG over protocol interface should be bound into the specified UIO driver.\n"
-        " Typically, the base address starts at 0x0.\n\n",
+        " Typically, the base address starts at 0x0.\n"
+        " Every JTAG-Over-Protocol interface found by the platform is served on its own thread; interface <n> listens on\n"
+        " <port> + <n>, or on an ephemeral port when <port> is 0.  Interfaces are numbered by UIO driver, then map,\n"
+        " then start address, e.g. --uio-driver-path=/dev/uio0,/dev/uio1 --start-address=0x0,0x4000 gives 4 interfaces.\n"
+        " With --unix-socket, interface <n> > 0 listens on <path>.<n> as well.\n"
+        " For the lowest latency, combine --busy-poll with --cpu (and --engine-cpu) naming isolated cores.\n\n",
         program, program, program);
 }
 
@@ -69,12 +102,14 @@ static void show_version()
      printf("%s-%s\n", APP_VERSION_BASE,GIT_VERSION);
 }
 
-static IRemoteDebug *s_etherlink_server = nullptr;
+// One per IP instance, see run_etherlink()
+static std::vector<IRemoteDebug *> s_etherlink_servers;
 
 // Streaming debug command line struct
 enum
 {
-    IP_MAX_STR_LEN = 15
+    IP_MAX_STR_LEN = 15,
+    DEFAULT_BUSY_POLL_US = 50
 };
 
 struct  EtherlinkCommandLine
@@ -82,42 +117,86 @@ struct  EtherlinkCommandLine
     size_t  h2t_t2h_mem_size;
     int     port;
     char    ip[IP_MAX_STR_LEN+1];
+    EVENT_LOOP_BACKEND event_loop_backend;
+    bool    interrupt_mode;
+    FPGA_MMIO_BURST_KERNEL mmio_burst;
+    bool    threaded;
+    int     busy_poll_us;
+    std::vector<int> cpus;          // Indexed by interface
+    std::vector<int> engine_cpus;
+    int     sched_fifo_priority;
+    std::string local_path;         // Empty for none
+    unsigned long handshake_timeout_ms; // 0 for the server default
+    bool    cold_reconnect;
 };
 
 static int parse_cmd_args(EtherlinkCommandLine *etherlink_cmdline, int argc, char *argv[]);
 static long parse_integer_arg(const char *name);
+static bool parse_cpu_list(const char *name, std::vector<int> *cpus);
+static std::string cpu_list_str(const std::vector<int> &cpus);
 static int run_etherlink(const struct EtherlinkCommandLine *etherlink_cmdline);
 static void install_sigint_handler();
 
 class StreamingDebug : public IRemoteDebug
 {
 public:
-    StreamingDebug(){}
+    StreamingDebug(const EtherlinkCommandLine &cmdline, unsigned int fpga_index) : m_server_context(), m_cmdline(cmdline), m_fpga_index(fpga_index)
+    {
+        init_driver_context(&m_server_context.driver_cxt);
+    }
     virtual ~StreamingDebug()
     {
         terminate();
     }
     int run(size_t h2t_t2h_mem_size, const char * /*unused*/, int port) override
     {
-        const int fpga_index = 0; // Only 1 IP instance is supported.
-        FPGA_MMIO_INTERFACE_HANDLE handle = fpga_open(fpga_index);
+        FPGA_MMIO_INTERFACE_HANDLE handle = fpga_open(m_fpga_index);
         init_st_dbg_transport_server_over_tcpip(&m_server_context, handle, h2t_t2h_mem_size, port);
+        m_server_context.instance = m_fpga_index;
+        m_server_context.event_loop_backend = m_cmdline.event_loop_backend;
+        m_server_context.threaded = m_cmdline.threaded ? 1 : 0;
+        m_server_context.busy_poll_us = m_cmdline.busy_poll_us;
+        m_server_context.cpu = (m_fpga_index < m_cmdline.cpus.size()) ? m_cmdline.cpus[m_fpga_index] : -1;
+        m_server_context.engine_cpu = (m_fpga_index < m_cmdline.engine_cpus.size()) ? m_cmdline.engine_cpus[m_fpga_index] : -1;
+        m_server_context.sched_fifo_priority = m_cmdline.sched_fifo_priority;
+        m_server_context.local_path = m_cmdline.local_path.empty() ? NULL : m_cmdline.local_path.c_str();
+        if (m_cmdline.handshake_timeout_ms > 0)
+        {
+            m_server_context.handshake_timeout_ms = m_cmdline.handshake_timeout_ms;
+        }
+        m_server_context.warm_reconnect = m_cmdline.cold_reconnect ? 0 : 1;
+        if (m_cmdline.interrupt_mode)
+        {
+            m_server_context.driver_cxt.interrupt_handle = fpga_interrupt_open(m_fpga_index);
+            if (m_server_context.driver_cxt.interrupt_handle == FPGA_INTERRUPT_INVALID_HANDLE)
+            {
+                printf("WARNING: Failed to open the interrupt, falling back to polling the hardware.\n");
+            }
+        }
         return start_st_dbg_transport_server_over_tcpip(&m_server_context);
     }
     
     void terminate() override
     {
+        if (m_server_context.driver_cxt.interrupt_handle != FPGA_INTERRUPT_INVALID_HANDLE)
+        {
+            disable_irq_wakeup(&m_server_context.driver_cxt);
+            fpga_interrupt_close(m_server_context.driver_cxt.interrupt_handle);
+            m_server_context.driver_cxt.interrupt_handle = FPGA_INTERRUPT_INVALID_HANDLE;
+        }
         fpga_close(m_server_context.driver_cxt.mmio_handle);
-        terminate_st_dbg_transport_server_over_tcpip();
+        terminate_st_dbg_transport_server_over_tcpip(&m_server_context);
     }
 
 private:
     intel_remote_debug_server_context m_server_context;
+    EtherlinkCommandLine m_cmdline;
+    unsigned int m_fpga_index;
 };
 
 int main( int argc, char** argv )
 {
-    EtherlinkCommandLine etherlink_cmdline = {4096, 0, {0,}};
+    EtherlinkCommandLine etherlink_cmdline = {4096, 0, {0,}, EVENT_LOOP_BACKEND_DEFAULT, false, FPGA_MMIO_BURST_AUTO, false, 0, {}, {}, 0, "", 0, false};
     int rc = parse_cmd_args(&etherlink_cmdline, argc, argv);
     if ( rc ) {
 
@@ -148,7 +227,30 @@ int main( int argc, char** argv )
     printf("INFO: Etherlink Server Configuration:\n");
     printf("INFO:    H2T/T2H Memory Size  : %ld\n", etherlink_cmdline.h2t_t2h_mem_size);
     printf("INFO:    Listening Port       : %d\n", etherlink_cmdline.port);
+    printf("INFO:    Unix Socket          : %s\n", etherlink_cmdline.local_path.empty() ? "none" : etherlink_cmdline.local_path.c_str());
+    if (etherlink_cmdline.handshake_timeout_ms > 0) {
+        printf("INFO:    Handshake Timeout    : %lu ms\n", etherlink_cmdline.handshake_timeout_ms);
+    } else {
+        printf("INFO:    Handshake Timeout    : default\n");
+    }
+    printf("INFO:    Warm Reconnect       : %s\n", etherlink_cmdline.cold_reconnect ? "off" : "on");
     printf("INFO:    IP Address           : %s\n", etherlink_cmdline.ip);
+    printf("INFO:    Event Loop           : %s\n", event_loop_backend_name(etherlink_cmdline.event_loop_backend));
+    printf("INFO:    Interrupt Mode       : %s\n", etherlink_cmdline.interrupt_mode ? "on" : "off");
+    printf("INFO:    MMIO Burst           : %s\n", fpga_mmio_burst_name(fpga_mmio_burst_selected()));
+    printf("INFO:    Threaded             : %s\n", etherlink_cmdline.threaded ? "on" : "off");
+    if (etherlink_cmdline.busy_poll_us > 0) {
+        printf("INFO:    Busy Poll            : on (%d us)\n", etherlink_cmdline.busy_poll_us);
+    } else {
+        printf("INFO:    Busy Poll            : off\n");
+    }
+    printf("INFO:    Server CPUs          : %s\n", cpu_list_str(etherlink_cmdline.cpus).c_str());
+    printf("INFO:    Engine CPUs          : %s\n", cpu_list_str(etherlink_cmdline.engine_cpus).c_str());
+    if (etherlink_cmdline.sched_fifo_priority > 0) {
+        printf("INFO:    SCHED_FIFO Priority  : %d\n", etherlink_cmdline.sched_fifo_priority);
+    } else {
+        printf("INFO:    SCHED_FIFO Priority  : off\n");
+    }
 
     if(fpga_platform_init(argc, (const char **)argv) == false)
     {
@@ -172,16 +274,39 @@ out_exit:
     return rc;
 }
 
+// Serves every IP instance the platform found, each on its own thread and port
 int run_etherlink(const struct EtherlinkCommandLine *etherlink_cmdline )
 {
-    int res = 0;
+    const unsigned int num_instances = fpga_get_num_of_interfaces();
+    if (num_instances == 0) {
+        printf("ERROR: No JTAG-Over-Protocol interface found.\n");
+        return -1;
+    }
+    printf("INFO:    IP Instances         : %u\n", num_instances);
+
+    std::vector<int> results(num_instances, 0);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < num_instances; ++i) {
+        s_etherlink_servers.push_back(new StreamingDebug(*etherlink_cmdline, i));
+    }
+    for (unsigned int i = 0; i < num_instances; ++i) {
+        const int port = (etherlink_cmdline->port != 0) ? etherlink_cmdline->port + (int)i : 0;
+        threads.emplace_back([&results, etherlink_cmdline, i, port]() {
+            results[i] = s_etherlink_servers[i]->run(etherlink_cmdline->h2t_t2h_mem_size, etherlink_cmdline->ip, port);
+        });
+    }
 
-    s_etherlink_server = new StreamingDebug();
-    if (s_etherlink_server) {
-        res = s_etherlink_server->run(etherlink_cmdline->h2t_t2h_mem_size, etherlink_cmdline->ip, etherlink_cmdline->port);
-        delete s_etherlink_server;
-        s_etherlink_server = nullptr;
+    int res = 0;
+    for (unsigned int i = 0; i < num_instances; ++i) {
+        threads[i].join();
+        if (results[i] != 0) {
+            res = results[i];
+        }
+    }
+    for (IRemoteDebug *server : s_etherlink_servers) {
+        delete server;
     }
+    s_etherlink_servers.clear();
 
     return res;
 }
@@ -192,7 +317,7 @@ int parse_cmd_args(EtherlinkCommandLine *etherlink_cmdline, int argc, char *argv
     int option_index = 0;
     int c;
 
-    const char *GETOPT_STRING = "hp:i:v";
+    const char *GETOPT_STRING = "hp:i:ve:Ib:T";
 
     struct option longopts[] = {
         {"help", no_argument, NULL, 'h'},
@@ -200,6 +325,17 @@ int parse_cmd_args(EtherlinkCommandLine *etherlink_cmdline, int argc, char *argv
         {"h2t-t2h-mem-size", required_argument, NULL, 'm'},
         {"port", required_argument, NULL, 'p'},
         {"ip", required_argument, NULL, 'i'},
+        {"event-loop", required_argument, NULL, 'e'},
+        {"interrupt-mode", no_argument, NULL, 'I'},
+        {"mmio-burst", required_argument, NULL, 'b'},
+        {"threaded", no_argument, NULL, 'T'},
+        {"busy-poll", optional_argument, NULL, 'B'},
+        {"cpu", required_argument, NULL, 'C'},
+        {"engine-cpu", required_argument, NULL, 'E'},
+        {"sched-fifo", required_argument, NULL, 'F'},
+        {"unix-socket", required_argument, NULL, 'U'},
+        {"handshake-timeout", required_argument, NULL, 'H'},
+        {"cold-reconnect", no_argument, NULL, 'R'},
         {0, 0, 0, 0}};
 
     opterr = 0; // Suppress stderr output from getopt_long upon unrecognized options
@@ -243,9 +379,98 @@ int parse_cmd_args(EtherlinkCommandLine *etherlink_cmdline, int argc, char *argv
                 strncpy(etherlink_cmdline->ip, optarg, 15);
                 etherlink_cmdline->ip[15] = '\0';
                 break;
+
+            case 'e':
+                // Server event loop backend
+                if (parse_event_loop_backend(optarg, &etherlink_cmdline->event_loop_backend) < 0) {
+                    printf("ERROR: Unsupported event loop backend: %s\n", optarg);
+                    return -3;
+                }
+                break;
+
+            case 'I':
+                // Interrupt driven hardware wakeups
+                etherlink_cmdline->interrupt_mode = true;
+                break;
+
+            case 'b':
+                // Payload copy kernel
+                if (!fpga_mmio_burst_parse(optarg, &etherlink_cmdline->mmio_burst) || !fpga_mmio_burst_select(etherlink_cmdline->mmio_burst)) {
+                    printf("ERROR: Unsupported MMIO burst kernel: %s\n", optarg);
+                    return -3;
+                }
+                break;
+
+            case 'T':
+                // Network I/O and hardware access on separate threads
+                etherlink_cmdline->threaded = true;
+                break;
+
+            case 'B':
+                // Run to completion, polling sockets and hardware without ever sleeping
+                etherlink_cmdline->busy_poll_us = (optarg != NULL) ? (int)parse_integer_arg("busy-poll") : DEFAULT_BUSY_POLL_US;
+                if (etherlink_cmdline->busy_poll_us <= 0) {
+                    return -3;
+                }
+                break;
+
+            case 'C':
+                // Server thread CPU, per interface
+                if (!parse_cpu_list("cpu", &etherlink_cmdline->cpus)) {
+                    return -3;
+                }
+                break;
+
+            case 'E':
+                // MMIO engine thread CPU, per interface
+                if (!parse_cpu_list("engine-cpu", &etherlink_cmdline->engine_cpus)) {
+                    return -3;
+                }
+                break;
+
+            case 'F':
+                // Real-time priority of the pinned threads
+                etherlink_cmdline->sched_fifo_priority = (int)parse_integer_arg("sched-fifo");
+                if (etherlink_cmdline->sched_fifo_priority < sched_get_priority_min(SCHED_FIFO) ||
+                    etherlink_cmdline->sched_fifo_priority > sched_get_priority_max(SCHED_FIFO)) {
+                    printf("ERROR: sched-fifo priority must be within %d and %d\n", sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+                    return -3;
+                }
+                break;
+
+            case 'U':
+                // Local listener
+                etherlink_cmdline->local_path = optarg;
+                if (etherlink_cmdline->local_path.empty()) {
+                    printf("ERROR: unix-socket path must not be empty\n");
+                    return -3;
+                }
+                break;
+
+            case 'H': {
+                // Session setup deadline
+                const long handshake_timeout_ms = parse_integer_arg("handshake-timeout");
+                if (handshake_timeout_ms <= 0) {
+                    return -3;
+                }
+                etherlink_cmdline->handshake_timeout_ms = (unsigned long)handshake_timeout_ms;
+                break;
+            }
+
+            case 'R':
+                // Full IP reset for every client
+                etherlink_cmdline->cold_reconnect = true;
+                break;
         }
     }
 
+    // The MMIO engine inherits the CPU of its server thread, where a SCHED_FIFO busy loop would never let either yield
+    if (etherlink_cmdline->threaded && etherlink_cmdline->sched_fifo_priority > 0 && etherlink_cmdline->cpus.size() > etherlink_cmdline->engine_cpus.size())
+    {
+        printf("ERROR: --threaded with --sched-fifo needs an --engine-cpu for every --cpu\n");
+        return -3;
+    }
+
     if (etherlink_cmdline->ip[0] == '\0')
     {
         strncpy(etherlink_cmdline->ip, "0.0.0.0", sizeof(etherlink_cmdline->ip));
@@ -326,17 +551,55 @@ long parse_integer_arg(const char *name)
     return ret;
 }
 
+// Parses a comma separated list of CPU numbers
+bool parse_cpu_list(const char *name, std::vector<int> *cpus)
+{
+    const char *p = optarg;
+
+    cpus->clear();
+    while (1)
+    {
+        char *end;
+        errno = 0;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || errno != 0 || cpu < 0 || cpu > INT_MAX || (*end != ',' && *end != '\0'))
+        {
+            printf("ERROR: Invalid %s value is provided. A comma separated list of CPU numbers is expected. %s is provided.\n", name, optarg);
+            return false;
+        }
+        cpus->push_back((int)cpu);
+        if (*end == '\0')
+        {
+            break;
+        }
+        p = end + 1;
+    }
+
+    return true;
+}
+
+std::string cpu_list_str(const std::vector<int> &cpus)
+{
+    std::string str;
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        str += (i == 0 ? "" : ",") + std::to_string(cpus[i]);
+    }
+    return str.empty() ? "none" : str;
+}
+
 void etherlink_sig_handler(int signo)
 {
     if (signo == SIGINT)
     {
         printf("\nINFO: Signal, SIGINT, was triggered; the program is terminating.\n");
-        fpga_platform_cleanup();
-        if (s_etherlink_server != nullptr)
+        // The instance threads are still running, so only close their sockets
+        // and interrupts here; the objects are released with the process.
+        for (IRemoteDebug *server : s_etherlink_servers)
         {
-            delete s_etherlink_server;
-            s_etherlink_server = nullptr;
+            server->terminate();
         }
+        fpga_platform_cleanup();
         exit(0);
     }
     else
@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include "intel_fpga_platform_uio.h"
 #include "intel_fpga_api_cmn_inf.h"
 
@@ -42,6 +43,64 @@ static inline void *fpga_uio_get_base_address(FPGA_MMIO_INTERFACE_HANDLE handle)
     return common_fpga_interface_info_vec_at(handle)->base_address;
 }
 
+// Write-combining mapping of the interface, NULL unless the platform was started with --wc-map-path
+static inline void *fpga_uio_get_wc_base_address(FPGA_MMIO_INTERFACE_HANDLE handle)
+{
+    return common_fpga_interface_info_vec_at(handle)->wc_base_address;
+}
+
+// An interface resolved once by fpga_mmio_resolve().  The handle based accessors look the base address up
+// in the interface vector on every access, and as the vector may be reallocated, the compiler cannot hoist
+// that load out of a loop.  Hot paths keep one of these instead.  Valid until fpga_platform_cleanup().
+typedef struct
+{
+    volatile uint8_t             *base_address;
+    volatile uint8_t             *wc_base_address;  //!< NULL if there is no write-combining mapping
+} FPGA_MMIO_INTERFACE;
+
+static inline FPGA_MMIO_INTERFACE fpga_mmio_resolve(FPGA_MMIO_INTERFACE_HANDLE handle)
+{
+    FPGA_MMIO_INTERFACE mmio;
+    mmio.base_address = (volatile uint8_t *)fpga_uio_get_base_address(handle);
+    mmio.wc_base_address = (volatile uint8_t *)fpga_uio_get_wc_base_address(handle);
+    return mmio;
+}
+
+static inline uint32_t fpga_mmio_read_32(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset)
+{
+    return *((volatile uint32_t *)(mmio->base_address + offset));
+}
+
+static inline void fpga_mmio_write_32(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, uint32_t value)
+{
+    *((volatile uint32_t *)(mmio->base_address + offset)) = value;
+}
+
+static inline uint64_t fpga_mmio_read_64(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset)
+{
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    return *((volatile uint64_t *)(mmio->base_address + offset));
+#else
+    // This emulation is needed when Intel FPGA PCIe Memory Mapped Bridge IP is used to implement the PCIe function.
+    // Little-endian system is assumed.
+    uint64_t data = fpga_mmio_read_32(mmio, offset);
+    data |= (uint64_t)fpga_mmio_read_32(mmio, offset + 4) << 32;
+
+    return data;
+#endif
+}
+
+static inline void fpga_mmio_write_64(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, uint64_t value)
+{
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    *((volatile uint64_t *)(mmio->base_address + offset)) = value;
+#else
+    // See fpga_mmio_read_64()
+    fpga_mmio_write_32(mmio, offset, (uint32_t)value);
+    fpga_mmio_write_32(mmio, offset + 4, (uint32_t)(value >> 32));
+#endif
+}
+
 static inline uint8_t fpga_read_8(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset)
 {
     return *((volatile uint8_t *)fpga_uio_get_base_address(handle) + offset);
@@ -74,28 +133,14 @@ static inline void fpga_write_32(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t off
 
 static inline uint64_t fpga_read_64(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset)
 {
-#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
-    return *((volatile uint64_t *)((volatile uint8_t *)fpga_uio_get_base_address(handle) + offset));
-#else
-    // This emulation is needed when Intel FPGA PCIe Memory Mapped Bridge IP is used to implement the PCIe function.
-    // Little-endian system is assumed.
-    uint64_t data = fpga_read_32(handle, offset);
-    data |= (uint64_t)fpga_read_32(handle, offset + 4) << 32;
-
-    return data;
-#endif
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(handle);
+    return fpga_mmio_read_64(&mmio, offset);
 }
 
 static inline void fpga_write_64(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, uint64_t value)
 {
-#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
-    *((volatile uint64_t *)((volatile uint8_t *)fpga_uio_get_base_address(handle) + offset)) = value;
-#else
-    // This emulation is needed when Intel FPGA PCIe Memory Mapped Bridge IP is used to implement the PCIe function.
-    // Little-endian system is assumed.
-    fpga_write_32(handle, offset, (uint32_t)value);
-    fpga_write_32(handle, offset + 4, (uint32_t)(value >> 32));
-#endif
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(handle);
+    fpga_mmio_write_64(&mmio, offset, value);
 }
 
 static inline void fpga_read_512(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, uint8_t *value)
@@ -120,6 +165,44 @@ static inline void fpga_write_512(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t of
     }
 }
 
+// Burst copy kernels used by fpga_read_burst() / fpga_write_burst()
+typedef enum
+{
+    FPGA_MMIO_BURST_AUTO,         //!< Widest kernel supported by the CPU
+    FPGA_MMIO_BURST_64,           //!< One 64-bit access per word, the safe fallback available everywhere
+    FPGA_MMIO_BURST_SSE2,         //!< 128-bit accesses, x86
+    FPGA_MMIO_BURST_AVX2,         //!< 256-bit accesses, x86
+    FPGA_MMIO_BURST_NEON          //!< 128-bit accesses, aarch64
+} FPGA_MMIO_BURST_KERNEL;
+
+// Copies between the MMIO space and host memory in whole 64-bit words, i.e. up to 7 bytes past 'len'
+// are transferred.  'host_buff' need not be aligned.  Wide kernels only issue accesses naturally aligned
+// to their width, a misaligned 'offset' is copied with the 64-bit kernel.
+void fpga_read_burst(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, void *host_buff, size_t len);
+void fpga_write_burst(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, const void *host_buff, size_t len);
+
+// Same as fpga_write_burst() but through the write-combining mapping, if there is one.  The stores may be
+// buffered, merged and reordered until fpga_wc_flush(), so this is only meant for payload memory, never CSRs.
+void fpga_write_burst_wc(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, const void *host_buff, size_t len);
+
+// Store fence: every write-combined store issued so far reaches the device before any later store, e.g.
+// the descriptor write that hands the payload over to the IP.  No-op without a write-combining mapping.
+void fpga_wc_flush(FPGA_MMIO_INTERFACE_HANDLE handle);
+
+// Same as the above on a resolved interface
+void fpga_mmio_read_burst(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, void *host_buff, size_t len);
+void fpga_mmio_write_burst(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, const void *host_buff, size_t len);
+void fpga_mmio_write_burst_wc(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, const void *host_buff, size_t len);
+void fpga_mmio_wc_flush(const FPGA_MMIO_INTERFACE *mmio);
+
+// The kernel is resolved by fpga_platform_init(), a different one should only be selected while no copy is in flight.
+// Only the 64-bit kernel is available when 64-bit MMIO is emulated, see fpga_read_64().
+// Returns false, leaving the selection unchanged, if 'kernel' is not supported.
+bool fpga_mmio_burst_select(FPGA_MMIO_BURST_KERNEL kernel);
+FPGA_MMIO_BURST_KERNEL fpga_mmio_burst_selected();
+const char *fpga_mmio_burst_name(FPGA_MMIO_BURST_KERNEL kernel);
+bool fpga_mmio_burst_parse(const char *name, FPGA_MMIO_BURST_KERNEL *kernel);
+
 void *fpga_malloc(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t size);
 void fpga_free(FPGA_MMIO_INTERFACE_HANDLE handle, void *address);
 FPGA_PLATFORM_PHYSICAL_MEM_ADDR_TYPE fpga_get_physical_address(void *address);
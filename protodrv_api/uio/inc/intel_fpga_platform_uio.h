@@ -67,7 +67,8 @@ typedef struct
     uint16_t                     group_id;      //!< Define a group of interfaces that support a high-level function.  One ProtoDriver may be developed using such group of interfaces.
     uint8_t                      subsystem_id;  //!< Define the subsystem scope of the group_id and instance field.
     void                         *base_address;  //!< Define the base address to be used by MMIO functions
-    uint16_t                     interrupt;      //!< interrupt assignment
+    void                         *wc_base_address;  //!< Write-combining mapping of the same address span, NULL if not mapped
+    uint16_t                     interrupt;      //!< interrupt assignment, i.e. the index of the UIO device the interface sits on
     bool                         is_mmio_opened; 
     bool                         is_interrupt_opened;
     bool                         interrupt_enable;
@@ -80,6 +81,13 @@ typedef void * FPGA_PLATFORM_PHYSICAL_MEM_ADDR_TYPE;
 // Platform specific internal API
 extern sem_t g_intSem;
 
+#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
+// The software model holds stores made through wc_base_address in a separate buffer until
+// they are flushed, so that a missing fence shows up as stale data at base_address.
+void uio_sw_model_wc_post(const volatile void *wc_address, size_t len);
+void uio_sw_model_wc_flush();
+#endif
+
 #ifdef __cplusplus
 }
 #endif
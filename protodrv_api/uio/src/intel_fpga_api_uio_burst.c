@@ -0,0 +1,384 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FPGA_MMIO_BURST_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FPGA_MMIO_BURST_AARCH64
+#endif
+
+#include "intel_fpga_api_uio.h"
+
+typedef void (*MMIO_READ_BURST)(volatile uint8_t *mmio, uint8_t *host, size_t words);
+typedef void (*MMIO_WRITE_BURST)(volatile uint8_t *mmio, const uint8_t *host, size_t words);
+
+static inline uint64_t mmio_read_word(volatile uint8_t *mmio)
+{
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    return *((volatile uint64_t *)mmio);
+#else
+    // See fpga_read_64()
+    uint64_t data = *((volatile uint32_t *)mmio);
+    data |= (uint64_t)*((volatile uint32_t *)(mmio + 4)) << 32;
+    return data;
+#endif
+}
+
+static inline void mmio_write_word(volatile uint8_t *mmio, uint64_t value)
+{
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    *((volatile uint64_t *)mmio) = value;
+#else
+    // See fpga_write_64()
+    *((volatile uint32_t *)mmio) = (uint32_t)value;
+    *((volatile uint32_t *)(mmio + 4)) = (uint32_t)(value >> 32);
+#endif
+}
+
+static void read_burst_64(volatile uint8_t *mmio, uint8_t *host, size_t words)
+{
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t word = mmio_read_word(mmio);
+        memcpy(host, &word, sizeof(word));
+        mmio += 8;
+        host += 8;
+    }
+}
+
+static void write_burst_64(volatile uint8_t *mmio, const uint8_t *host, size_t words)
+{
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t word;
+        memcpy(&word, host, sizeof(word));
+        mmio_write_word(mmio, word);
+        mmio += 8;
+        host += 8;
+    }
+}
+
+// Words to move one at a time before 'mmio' is aligned to 'width' bytes, at most 'words'
+static inline size_t words_to_alignment(volatile uint8_t *mmio, size_t width, size_t words)
+{
+    size_t head = ((width - ((uintptr_t)mmio & (width - 1))) & (width - 1)) / 8;
+    return (head < words) ? head : words;
+}
+
+#ifdef FPGA_MMIO_BURST_X86
+
+__attribute__((target("sse2")))
+static void read_burst_sse2(volatile uint8_t *mmio, uint8_t *host, size_t words)
+{
+    size_t head = words_to_alignment(mmio, 16, words);
+    read_burst_64(mmio, host, head);
+    mmio += head * 8;
+    host += head * 8;
+    words -= head;
+    for (; words >= 2; words -= 2)
+    {
+        _mm_storeu_si128((__m128i *)host, _mm_load_si128((const __m128i *)mmio));
+        mmio += 16;
+        host += 16;
+    }
+    read_burst_64(mmio, host, words);
+}
+
+__attribute__((target("sse2")))
+static void write_burst_sse2(volatile uint8_t *mmio, const uint8_t *host, size_t words)
+{
+    size_t head = words_to_alignment(mmio, 16, words);
+    write_burst_64(mmio, host, head);
+    mmio += head * 8;
+    host += head * 8;
+    words -= head;
+    for (; words >= 2; words -= 2)
+    {
+        _mm_store_si128((__m128i *)mmio, _mm_loadu_si128((const __m128i *)host));
+        mmio += 16;
+        host += 16;
+    }
+    write_burst_64(mmio, host, words);
+}
+
+__attribute__((target("avx2")))
+static void read_burst_avx2(volatile uint8_t *mmio, uint8_t *host, size_t words)
+{
+    size_t head = words_to_alignment(mmio, 32, words);
+    read_burst_64(mmio, host, head);
+    mmio += head * 8;
+    host += head * 8;
+    words -= head;
+    for (; words >= 4; words -= 4)
+    {
+        _mm256_storeu_si256((__m256i *)host, _mm256_load_si256((const __m256i *)mmio));
+        mmio += 32;
+        host += 32;
+    }
+    read_burst_64(mmio, host, words);
+}
+
+__attribute__((target("avx2")))
+static void write_burst_avx2(volatile uint8_t *mmio, const uint8_t *host, size_t words)
+{
+    size_t head = words_to_alignment(mmio, 32, words);
+    write_burst_64(mmio, host, head);
+    mmio += head * 8;
+    host += head * 8;
+    words -= head;
+    for (; words >= 4; words -= 4)
+    {
+        _mm256_store_si256((__m256i *)mmio, _mm256_loadu_si256((const __m256i *)host));
+        mmio += 32;
+        host += 32;
+    }
+    // No AVX to SSE transition penalty for whatever runs next
+    _mm256_zeroupper();
+    write_burst_64(mmio, host, words);
+}
+
+#endif
+
+#ifdef FPGA_MMIO_BURST_AARCH64
+
+static void read_burst_neon(volatile uint8_t *mmio, uint8_t *host, size_t words)
+{
+    size_t head = words_to_alignment(mmio, 16, words);
+    read_burst_64(mmio, host, head);
+    mmio += head * 8;
+    host += head * 8;
+    words -= head;
+    for (; words >= 2; words -= 2)
+    {
+        vst1q_u8(host, vld1q_u8((const uint8_t *)mmio));
+        mmio += 16;
+        host += 16;
+    }
+    read_burst_64(mmio, host, words);
+}
+
+static void write_burst_neon(volatile uint8_t *mmio, const uint8_t *host, size_t words)
+{
+    size_t head = words_to_alignment(mmio, 16, words);
+    write_burst_64(mmio, host, head);
+    mmio += head * 8;
+    host += head * 8;
+    words -= head;
+    for (; words >= 2; words -= 2)
+    {
+        vst1q_u8((uint8_t *)mmio, vld1q_u8(host));
+        mmio += 16;
+        host += 16;
+    }
+    write_burst_64(mmio, host, words);
+}
+
+#endif
+
+static bool s_is_supported(FPGA_MMIO_BURST_KERNEL kernel)
+{
+#ifdef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    return kernel == FPGA_MMIO_BURST_64;
+#else
+    switch (kernel)
+    {
+        case FPGA_MMIO_BURST_64:
+            return true;
+#ifdef FPGA_MMIO_BURST_X86
+        case FPGA_MMIO_BURST_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case FPGA_MMIO_BURST_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef FPGA_MMIO_BURST_AARCH64
+        case FPGA_MMIO_BURST_NEON:
+            return true; // Mandatory on aarch64
+#endif
+        default:
+            return false;
+    }
+#endif
+}
+
+static FPGA_MMIO_BURST_KERNEL s_resolve(FPGA_MMIO_BURST_KERNEL kernel)
+{
+    if (kernel != FPGA_MMIO_BURST_AUTO)
+    {
+        return kernel;
+    }
+    const FPGA_MMIO_BURST_KERNEL preferred[] = { FPGA_MMIO_BURST_AVX2, FPGA_MMIO_BURST_SSE2, FPGA_MMIO_BURST_NEON };
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); ++i)
+    {
+        if (s_is_supported(preferred[i]))
+        {
+            return preferred[i];
+        }
+    }
+    return FPGA_MMIO_BURST_64;
+}
+
+// Resolved by fpga_platform_init(), before any MMIO thread starts, unless selected before.  Until then
+// the 64-bit kernel is used, the copies never select a kernel themselves.
+static FPGA_MMIO_BURST_KERNEL s_selected_kernel = FPGA_MMIO_BURST_AUTO;
+static MMIO_READ_BURST s_read_burst = read_burst_64;
+static MMIO_WRITE_BURST s_write_burst = write_burst_64;
+
+bool fpga_mmio_burst_select(FPGA_MMIO_BURST_KERNEL kernel)
+{
+    kernel = s_resolve(kernel);
+    if (!s_is_supported(kernel))
+    {
+        return false;
+    }
+    switch (kernel)
+    {
+#ifdef FPGA_MMIO_BURST_X86
+        case FPGA_MMIO_BURST_SSE2:
+            s_read_burst = read_burst_sse2;
+            s_write_burst = write_burst_sse2;
+            break;
+        case FPGA_MMIO_BURST_AVX2:
+            s_read_burst = read_burst_avx2;
+            s_write_burst = write_burst_avx2;
+            break;
+#endif
+#ifdef FPGA_MMIO_BURST_AARCH64
+        case FPGA_MMIO_BURST_NEON:
+            s_read_burst = read_burst_neon;
+            s_write_burst = write_burst_neon;
+            break;
+#endif
+        default:
+            s_read_burst = read_burst_64;
+            s_write_burst = write_burst_64;
+            break;
+    }
+    s_selected_kernel = kernel;
+    return true;
+}
+
+FPGA_MMIO_BURST_KERNEL fpga_mmio_burst_selected()
+{
+    return s_resolve(s_selected_kernel);
+}
+
+static const char *s_kernel_names[] = { "auto", "64", "sse2", "avx2", "neon" };
+
+const char *fpga_mmio_burst_name(FPGA_MMIO_BURST_KERNEL kernel)
+{
+    return ((size_t)kernel < sizeof(s_kernel_names) / sizeof(s_kernel_names[0])) ? s_kernel_names[kernel] : "unknown";
+}
+
+bool fpga_mmio_burst_parse(const char *name, FPGA_MMIO_BURST_KERNEL *kernel)
+{
+    for (size_t i = 0; i < sizeof(s_kernel_names) / sizeof(s_kernel_names[0]); ++i)
+    {
+        if (strcmp(name, s_kernel_names[i]) == 0)
+        {
+            *kernel = (FPGA_MMIO_BURST_KERNEL)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void fpga_mmio_read_burst(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, void *host_buff, size_t len)
+{
+    volatile uint8_t *src = mmio->base_address + offset;
+    // The wide kernels cannot reach their alignment from a misaligned word
+    MMIO_READ_BURST read_burst = (((uintptr_t)src & 0x7) == 0) ? s_read_burst : read_burst_64;
+    read_burst(src, (uint8_t *)host_buff, (len + 7) / 8);
+}
+
+void fpga_mmio_write_burst(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, const void *host_buff, size_t len)
+{
+    volatile uint8_t *dst = mmio->base_address + offset;
+    MMIO_WRITE_BURST write_burst = (((uintptr_t)dst & 0x7) == 0) ? s_write_burst : write_burst_64;
+    write_burst(dst, (const uint8_t *)host_buff, (len + 7) / 8);
+}
+
+void fpga_mmio_write_burst_wc(const FPGA_MMIO_INTERFACE *mmio, uint32_t offset, const void *host_buff, size_t len)
+{
+    if (mmio->wc_base_address == NULL)
+    {
+        fpga_mmio_write_burst(mmio, offset, host_buff, len);
+        return;
+    }
+    volatile uint8_t *dst = mmio->wc_base_address + offset;
+    MMIO_WRITE_BURST write_burst = (((uintptr_t)dst & 0x7) == 0) ? s_write_burst : write_burst_64;
+    write_burst(dst, (const uint8_t *)host_buff, (len + 7) / 8);
+#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
+    uio_sw_model_wc_post(dst, (len + 7) & ~(size_t)0x7);
+#endif
+}
+
+void fpga_mmio_wc_flush(const FPGA_MMIO_INTERFACE *mmio)
+{
+    if (mmio->wc_base_address == NULL)
+    {
+        return;
+    }
+#if defined(FPGA_MMIO_BURST_X86)
+    _mm_sfence();
+#elif defined(FPGA_MMIO_BURST_AARCH64)
+    __asm__ __volatile__("dmb oshst" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
+    uio_sw_model_wc_flush();
+#endif
+}
+
+void fpga_read_burst(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, void *host_buff, size_t len)
+{
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(handle);
+    fpga_mmio_read_burst(&mmio, offset, host_buff, len);
+}
+
+void fpga_write_burst(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, const void *host_buff, size_t len)
+{
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(handle);
+    fpga_mmio_write_burst(&mmio, offset, host_buff, len);
+}
+
+void fpga_write_burst_wc(FPGA_MMIO_INTERFACE_HANDLE handle, uint32_t offset, const void *host_buff, size_t len)
+{
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(handle);
+    fpga_mmio_write_burst_wc(&mmio, offset, host_buff, len);
+}
+
+void fpga_wc_flush(FPGA_MMIO_INTERFACE_HANDLE handle)
+{
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(handle);
+    fpga_mmio_wc_flush(&mmio);
+}
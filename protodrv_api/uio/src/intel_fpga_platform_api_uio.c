@@ -24,6 +24,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // pthread_setaffinity_np()
+#endif
 #include <errno.h>
 #include <getopt.h>
 #include <stddef.h>
@@ -40,6 +43,7 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <pthread.h>
+#include <sched.h>
 #include <poll.h>
 #include <semaphore.h>
 
@@ -51,30 +55,82 @@
 
 sem_t g_intSem;
 
+enum
+{
+    UIO_MAX_DEVICES = 8,
+    UIO_MAX_MAPS = 5,               // MAX_UIO_MAPS of the kernel UIO framework
+    UIO_MAX_START_ADDRS = 16,
+    UIO_MAX_REGIONS = UIO_MAX_DEVICES * UIO_MAX_MAPS,
+    UIO_MAX_LIST_ENTRIES = UIO_MAX_REGIONS,
+    UIO_LIST_SIZE = 1024
+};
+
+// A UIO device, one per --uio-driver-path entry.  All its interfaces share its interrupt.
+typedef struct
+{
+    const char  *path;
+    int         handle;
+} UIO_DEVICE;
+
+// One map of a UIO device, e.g. a PCIe BAR, with the interfaces at the --start-address offsets in it
+typedef struct
+{
+    unsigned int    device;
+    unsigned int    map;
+    size_t          span;
+    void            *mmap_ptr;
+    const char      *wc_map_path;   //!< NULL if the region has no write-combining mapping
+    int             wc_map_handle;
+    void            *wc_mmap_ptr;
+#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
+    size_t          wc_pending_begin;
+    size_t          wc_pending_end;
+#endif
+} UIO_REGION;
+
 static char *s_uio_drv_path = "/dev/uio0";
 static size_t s_uio_addr_span = 0;
 static int s_uio_single_component_mode = 1;
-static size_t s_uio_start_addr = 0;
+static size_t s_uio_start_addrs[UIO_MAX_START_ADDRS] = { 0 };
+static unsigned int s_uio_num_start_addrs = 1;
+static size_t s_uio_maps[UIO_MAX_MAPS] = { 0 };
+static unsigned int s_uio_num_maps = 1;
 static size_t s_uio_inThread_timeout = 0;
+static char *s_uio_wc_map_path = NULL;
+static bool s_uio_list_error = false;
+static long s_uio_int_cpu = -1;             // Interrupt thread left to the scheduler unless set
+static long s_uio_int_sched_fifo_priority = 0;
+
+static char s_uio_drv_path_buff[UIO_LIST_SIZE];
+static char s_uio_wc_map_path_buff[UIO_LIST_SIZE];
+static UIO_DEVICE s_uio_devices[UIO_MAX_DEVICES];
+static unsigned int s_uio_num_devices = 0;
+static UIO_REGION s_uio_regions[UIO_MAX_REGIONS];
+static unsigned int s_uio_num_regions = 0;
 
-static int  s_uio_drv_handle = -1;
-static void *s_uio_mmap_ptr = NULL;
 static pthread_t s_intThread_id = 0;
 static pthread_rwlock_t s_intLock;
 static int s_intFlags = 0;
 
 static void uio_parse_args(unsigned int argc, const char *argv[]);
-static long uio_parse_integer_arg(const char *name);
+static long uio_parse_integer_arg(const char *name, const char *arg);
+static void uio_parse_integer_list(const char *name, const char *list, size_t values[], unsigned int max_values, unsigned int *num_values);
+static int uio_split_list(const char *list, char *buff, size_t buff_size, const char *entries[], unsigned int max_entries);
+static void uio_build_regions();
 static void uio_update_based_on_sysfs();
-static void uio_get_sysfs_map_path(char *path, int path_buf_size);
+static void uio_get_sysfs_map_path(const char *drv_path, unsigned int map, char *path, int path_buf_size);
 static uint64_t uio_get_sysfs_map_file_to_uint64(const char *path);
 static bool uio_validate_args();
 static void uio_print_configuration();
 static bool uio_open_driver();
 static bool uio_map_mmio();
+static bool uio_map_wc_mmio();
 static bool uio_scan_interfaces();
+static void uio_release_interfaces();
 static bool uio_create_interrupt_thread();
+static void uio_pin_interrupt_thread();
 static bool uio_create_unit_test_sw_model();
+static bool uio_demux_interrupts();
 
 static void *uio_interrupt_thread();
 
@@ -100,70 +156,17 @@ void *uio_interrupt_thread()
 
         if(!(flags & FPGA_PLATFORM_INT_THREAD_EXIT))
         {
-            // Loop for uio with interrupt enabled
-            // Current implementaion support 1 vector
-            if (common_fpga_interface_info_vec_at(0)->interrupt_enable)
+            if (!uio_demux_interrupts())
             {
-                int fd = 0;
-
-                fd = open(s_uio_drv_path, O_RDWR);
-                if(fd < 0)
-                {
-                    fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "InterruptThread failed to open UIO device" );
-                    break;
-                }
-
-                struct pollfd fds = {
-                   .fd = fd,
-                   .events = POLLIN,
-                   };
-
-                uint32_t info = 1;
-                int ret =write(fd, &info, sizeof(info));
-                if(ret < 0)
-                {
-                   fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "InterruptThread failed to re-Arm UIO interrupt" );
-                   close(fd);
-                   break;
-                }
-
-                // Polling with timeout to check thread exit flag
-                // s_uio_inThread_timeout init in uio_parse_args()
-                ret = poll(&fds, 1, s_uio_inThread_timeout);
-
-                if(ret > 0){
-                    if (common_fpga_interface_info_vec_at(0)->isr_callback != NULL)
-                    {
-                        common_fpga_interface_info_vec_at(0)->isr_callback(common_fpga_interface_info_vec_at(0)->isr_context);
-                    }
-                    else
-                    {
-                        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "InterruptThread ISR is NULL ptr" );
-                        close(fd);
-                        break;
-                    }
-                }
-
-                if(fd > 0){
-                    close(fd);
-                }
-            } else {
-
-                // Interrupt Thread blocked until sem_post
-                rc = sem_wait(&g_intSem);
-                if (rc != 0)
-                {
-                    fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "InterruptThread failed to acquire OS lock to handle interrupt.");
-                    break;
-                }
-           }
-       }
-       else
-       {
+                break;
+            }
+        }
+        else
+        {
             // Interrupt Thread exit
             fpga_msg_printf( FPGA_MSG_PRINTF_DEBUG, "InterruptThread exit" );
             pthread_exit(NULL);
-       }
+        }
     }
 
     // Interrupt Thread exit for break condition
@@ -171,61 +174,127 @@ void *uio_interrupt_thread()
     pthread_exit(NULL);
 }
 
-bool fpga_platform_init(unsigned int argc, const char *argv[])
+// Waits for the interrupt of every UIO device with at least one interface enabled and calls the ISR of
+// each enabled interface of a device that fired.  A device cannot tell which of its interfaces raised
+// the interrupt, so every ISR has to check its own IP.  Blocks on g_intSem while nothing is enabled.
+// Returns false upon an error.
+bool uio_demux_interrupts()
 {
-    bool        is_args_valid;
-    bool        ret = false;
-
-    uio_parse_args(argc, argv);
-    uio_update_based_on_sysfs();
-    is_args_valid = uio_validate_args();
+    struct pollfd fds[UIO_MAX_DEVICES];
+    unsigned int num_polled = 0;
+    unsigned int i;
+    int ret;
 
-    // Interrupt Timeout is configured to 100ms
-    s_uio_inThread_timeout = 100;
-
-    if (is_args_valid)
+    for (i = 0; i < s_uio_num_devices; ++i)
     {
-        uio_print_configuration();
-#ifndef UIO_UNIT_TEST_SW_MODEL_MODE
-        if(uio_open_driver() == false)
-            goto err_open;
+        fds[i].fd = -1;     // poll() skips negative descriptors
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    for (i = 0; i < common_fpga_interface_info_vec_size(); ++i)
+    {
+        FPGA_INTERFACE_INFO *info = common_fpga_interface_info_vec_at(i);
+        if (info->interrupt_enable && fds[info->interrupt].fd < 0 && s_uio_devices[info->interrupt].handle >= 0)
+        {
+            fds[info->interrupt].fd = s_uio_devices[info->interrupt].handle;
+            ++num_polled;
+        }
+    }
 
-        if(uio_map_mmio() == false)
-            goto err_map;
+    if (num_polled == 0)
+    {
+        // Interrupt Thread blocked until sem_post
+        if (sem_wait(&g_intSem) != 0)
+        {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "InterruptThread failed to acquire OS lock to handle interrupt.");
+            return false;
+        }
+        return true;
+    }
 
-        if(uio_scan_interfaces() == false)
-            goto err_scan;
-#else
-        if(uio_create_unit_test_sw_model() == false)
-            goto err_open;
-#endif
-        ret = true;
+    for (i = 0; i < s_uio_num_devices; ++i)
+    {
+        uint32_t info = 1;
+        if (fds[i].fd >= 0 && write(fds[i].fd, &info, sizeof(info)) < 0)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "InterruptThread failed to re-Arm UIO interrupt" );
+            return false;
+        }
     }
-    else
+
+    // Polling with timeout to check thread exit flag
+    // s_uio_inThread_timeout init in fpga_platform_init()
+    ret = poll(fds, s_uio_num_devices, s_uio_inThread_timeout);
+    if (ret <= 0)
     {
-        goto err_open;
+        return true;
     }
 
-    if(s_uio_single_component_mode)
+    for (i = 0; i < s_uio_num_devices; ++i)
     {
-        // Interrupt Thread creation and sync init
-        if(uio_create_interrupt_thread() == false)
+        uint32_t count;
+        unsigned int j;
+
+        if (!(fds[i].revents & POLLIN))
+        {
+            continue;
+        }
+        // Consume the event count, the descriptor stays readable otherwise
+        if (read(fds[i].fd, &count, sizeof(count)) != sizeof(count))
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "InterruptThread failed to read UIO interrupt count" );
+            return false;
+        }
+        for (j = 0; j < common_fpga_interface_info_vec_size(); ++j)
         {
-            goto err_open;
+            FPGA_INTERFACE_INFO *info = common_fpga_interface_info_vec_at(j);
+            if (info->interrupt != i || !info->interrupt_enable)
+            {
+                continue;
+            }
+            if (info->isr_callback == NULL)
+            {
+                fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "InterruptThread ISR is NULL ptr" );
+                return false;
+            }
+            info->isr_callback(info->isr_context);
         }
     }
 
-    return ret;
+    return true;
+}
 
-#ifndef UIO_UNIT_TEST_SW_MODEL_MODE
-err_scan:
-    munmap(s_uio_mmap_ptr,s_uio_addr_span);
+bool fpga_platform_init(unsigned int argc, const char *argv[])
+{
+    bool        ret;
+
+    uio_parse_args(argc, argv);
+    uio_build_regions();
+    uio_update_based_on_sysfs();
+    if (!uio_validate_args())
+    {
+        return false;
+    }
+
+    // Interrupt Timeout is configured to 100ms
+    s_uio_inThread_timeout = 100;
+
+    // Burst kernel resolved once, here, rather than by whichever thread copies first
+    fpga_mmio_burst_select(fpga_mmio_burst_selected());
 
-err_map:
-    close(s_uio_drv_handle);
+    uio_print_configuration();
+#ifndef UIO_UNIT_TEST_SW_MODEL_MODE
+    ret = uio_open_driver() && uio_map_mmio() && uio_map_wc_mmio();
+#else
+    ret = uio_create_unit_test_sw_model();
 #endif
+    // Interrupt Thread creation and sync init
+    ret = ret && uio_scan_interfaces() && uio_create_interrupt_thread();
+    if (!ret)
+    {
+        uio_release_interfaces();
+    }
 
-err_open:
     return ret;
 }
 
@@ -258,35 +327,30 @@ void fpga_platform_cleanup()
         if(pthread_join(s_intThread_id, &ret) != 0)
         {
             fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Interrupt Thread join failed" );
-        } else 
+        } else
         {
             fpga_msg_printf( FPGA_MSG_PRINTF_DEBUG, "Interrupt Thread join successfully" );
         }
-
+        s_intThread_id = 0;
     }
 
-    if (s_uio_drv_handle>=0)
-    {
-        close(s_uio_drv_handle);
-    }
-    
+    uio_release_interfaces();
+
     // Re-initialize local variables.
     s_uio_drv_path = NULL;
-    s_uio_start_addr = 0;
+    s_uio_start_addrs[0] = 0;
+    s_uio_num_start_addrs = 1;
+    s_uio_maps[0] = 0;
+    s_uio_num_maps = 1;
     s_uio_addr_span = 0;
     s_uio_single_component_mode = 0;
-    
-    s_uio_drv_handle = -1;
-    s_uio_mmap_ptr = NULL;
+    s_uio_wc_map_path = NULL;
+    s_uio_list_error = false;
+    s_uio_int_cpu = -1;
+    s_uio_int_sched_fifo_priority = 0;
+    s_uio_num_devices = 0;
+    s_uio_num_regions = 0;
 
-    if (common_fpga_interface_info_vec_size() > 0)
-    {
-#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
-        free(common_fpga_interface_info_vec_at(0)->base_address);
-#endif 
-        common_fpga_interface_info_vec_resize(0);
-    }
-    
     errno = -1;  //  -1 is a valid return on success.  Some function, such as strtol(), doesn't set errno upon successful return.
 
     fpga_msg_printf( FPGA_MSG_PRINTF_DEBUG, "Completed fpga_platform_cleanup" );
@@ -297,10 +361,14 @@ void uio_parse_args(unsigned int argc, const char *argv[])
     static struct option long_options[] =
         {
             {"uio-driver-path", required_argument, 0, 'p'},
+            {"uio-maps", required_argument, 0, 'm'},
             {"start-address", required_argument, 0, 'a'},
             {"address-span", required_argument, 0, 's'},
             {"show-dbg-msg", no_argument, &g_common_show_dbg_msg, 'd'},
             {"single-component-mode", no_argument, &s_uio_single_component_mode, 'c'},
+            {"wc-map-path", required_argument, 0, 'w'},
+            {"interrupt-cpu", required_argument, 0, 'i'},
+            {"sched-fifo", required_argument, 0, 'f'},
             {0, 0, 0, 0}};
 
     int option_index = 0;
@@ -308,52 +376,129 @@ void uio_parse_args(unsigned int argc, const char *argv[])
 
     opterr = 0; // Suppress stderr output from getopt_long upon unrecognized options
     optind = 0;     // Reset getopt_long position.
-    
+
     while(1)
     {
         c = getopt_long(argc, (char * const*)argv, "p:a:s:dc", long_options, &option_index);
-      
+
         if (c == -1)
         {
             break;
         }
-        
+
         switch(c)
         {
             case 'p':
                 s_uio_drv_path = optarg;
                 break;
-                
+
+            case 'm':
+                uio_parse_integer_list("Map index", optarg, s_uio_maps, UIO_MAX_MAPS, &s_uio_num_maps);
+                break;
+
             case 's':
-                s_uio_addr_span = uio_parse_integer_arg("Address span");
+                s_uio_addr_span = uio_parse_integer_arg("Address span", optarg);
                 break;
-                
+
             case 'a':
-                s_uio_start_addr = uio_parse_integer_arg("Start address");
+                uio_parse_integer_list("Start address", optarg, s_uio_start_addrs, UIO_MAX_START_ADDRS, &s_uio_num_start_addrs);
                 break;
+
+            case 'w':
+                s_uio_wc_map_path = optarg;
+                break;
+
+            case 'i':
+                s_uio_int_cpu = uio_parse_integer_arg("Interrupt CPU", optarg);
+                if (s_uio_int_cpu < 0 || s_uio_int_cpu >= CPU_SETSIZE)
+                {
+                    fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Interrupt CPU %ld is out of range; maximum accepted is %d", s_uio_int_cpu, CPU_SETSIZE - 1 );
+                    s_uio_list_error = true;
+                }
+                break;
+
+            case 'f':
+                // Shared with etherlink, which validates it, applies to the interrupt thread once pinned
+                s_uio_int_sched_fifo_priority = uio_parse_integer_arg("SCHED_FIFO priority", optarg);
+                break;
+        }
+    }
+}
+
+// Splits a comma separated list into 'entries', which point into 'buff'.  Empty entries are kept.
+// Returns the number of entries, or -1 if the list doesn't fit.
+int uio_split_list(const char *list, char *buff, size_t buff_size, const char *entries[], unsigned int max_entries)
+{
+    unsigned int num_entries = 0;
+    char *p;
+
+    if (strlen(list) >= buff_size)
+    {
+        return -1;
+    }
+    strcpy(buff, list);
+
+    for (p = buff; ; )
+    {
+        char *sep = strchr(p, ',');
+
+        if (num_entries == max_entries)
+        {
+            return -1;
+        }
+        entries[num_entries++] = p;
+        if (sep == NULL)
+        {
+            break;
         }
-    }        
+        *sep = '\0';
+        p = sep + 1;
+    }
+
+    return (int)num_entries;
 }
 
-long uio_parse_integer_arg( const char *name )
+void uio_parse_integer_list(const char *name, const char *list, size_t values[], unsigned int max_values, unsigned int *num_values)
+{
+    char buff[UIO_LIST_SIZE];
+    const char *entries[UIO_MAX_LIST_ENTRIES];
+    int num_entries;
+    int i;
+
+    num_entries = uio_split_list(list, buff, sizeof(buff), entries, max_values);
+    if (num_entries < 0)
+    {
+        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Too many %s values are provided. %s is provided; maximum accepted is %u values", name, list, max_values );
+        s_uio_list_error = true;
+        return;
+    }
+
+    for (i = 0; i < num_entries; ++i)
+    {
+        values[i] = uio_parse_integer_arg(name, entries[i]);
+    }
+    *num_values = (unsigned int)num_entries;
+}
+
+long uio_parse_integer_arg( const char *name, const char *arg )
 {
     long ret = 0;
     
     bool is_all_digit = true;
-    char *p;
+    const char *p;
     typedef int (*DIGIT_TEST_FN) ( int c );
     DIGIT_TEST_FN is_acceptabl_digit;
-    if(optarg[0] == '0' && (optarg[1] == 'x' || optarg[1] == 'X'))
+    if(arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X'))
     {
         is_acceptabl_digit = isxdigit;
-        optarg += 2;    // trim the "0x" portion
+        arg += 2;    // trim the "0x" portion
     }
     else
     {
         is_acceptabl_digit = isdigit;
     }
     
-    for(p = optarg; (*p) != '\0'; ++p)
+    for(p = arg; (*p) != '\0'; ++p)
     {
         if(!is_acceptabl_digit(*p))
         {
@@ -364,28 +509,28 @@ long uio_parse_integer_arg( const char *name )
     
     if ( is_acceptabl_digit == isxdigit )
     {
-        optarg -= 2;  // restore the "0x" portion
+        arg -= 2;  // restore the "0x" portion
     }
     
     if (is_all_digit)
     {
         if (sizeof(size_t) <= sizeof(long))
         {
-            ret = (size_t)strtol(optarg, NULL, 0);
+            ret = (size_t)strtol(arg, NULL, 0);
             if (errno == ERANGE)
             {
                 ret = 0;
-                fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "%s value is too big. %s is provided; maximum accepted is %ld", name, optarg, LONG_MAX );
+                fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "%s value is too big. %s is provided; maximum accepted is %ld", name, arg, LONG_MAX );
             }
         }
         else
         {
             long span, span_c;
-            span = strtol(optarg, NULL, 0);
+            span = strtol(arg, NULL, 0);
             if (errno == ERANGE)
             {
                 ret = 0;
-                fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "%s value is too big. %s is provided; maximum accepted is %ld", name, optarg, LONG_MAX );
+                fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "%s value is too big. %s is provided; maximum accepted is %ld", name, arg, LONG_MAX );
             }
             else
             {
@@ -393,7 +538,7 @@ long uio_parse_integer_arg( const char *name )
                 span_c = ret;
                 if (span != span_c)
                 {
-                    fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "%s value is too big. %s is provided; maximum accepted is %ld", name, optarg, (size_t)-1 );
+                    fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "%s value is too big. %s is provided; maximum accepted is %ld", name, arg, (size_t)-1 );
                     ret = 0;
                 }
             }
@@ -401,17 +546,80 @@ long uio_parse_integer_arg( const char *name )
     }
     else
     {
-        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Invalid argument value type is provided. A integer value is expected. %s is provided.", optarg );
+        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Invalid argument value type is provided. A integer value is expected. %s is provided.", arg );
     }
     
     return ret;
 }
 
+// Splits the driver and write-combining path lists and pairs every device with every --uio-maps index.
+// The regions are ordered device first, then map; the write-combining paths follow the same order, an
+// empty entry leaves that region without a write-combining mapping.
+void uio_build_regions()
+{
+    const char *entries[UIO_MAX_LIST_ENTRIES];
+    int num_entries = 0;
+    int num_wc_entries = 0;
+    unsigned int i, j;
+
+    s_uio_num_devices = 0;
+    s_uio_num_regions = 0;
+
+    if (s_uio_drv_path != NULL)
+    {
+        num_entries = uio_split_list(s_uio_drv_path, s_uio_drv_path_buff, sizeof(s_uio_drv_path_buff), entries, UIO_MAX_DEVICES);
+        if (num_entries < 0)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Too many UIO driver paths are provided; maximum accepted is %d", UIO_MAX_DEVICES );
+            s_uio_list_error = true;
+            return;
+        }
+        for (i = 0; i < (unsigned int)num_entries; ++i)
+        {
+            s_uio_devices[i].path = entries[i];
+            s_uio_devices[i].handle = -1;
+        }
+        s_uio_num_devices = num_entries;
+    }
+
+    for (i = 0; i < s_uio_num_devices; ++i)
+    {
+        for (j = 0; j < s_uio_num_maps; ++j)
+        {
+            UIO_REGION *region = &s_uio_regions[s_uio_num_regions++];
+
+            memset(region, 0, sizeof(*region));
+            region->device = i;
+            region->map = s_uio_maps[j];
+            region->span = s_uio_addr_span;
+            region->wc_map_handle = -1;
+        }
+    }
+
+    if (s_uio_wc_map_path != NULL)
+    {
+        num_wc_entries = uio_split_list(s_uio_wc_map_path, s_uio_wc_map_path_buff, sizeof(s_uio_wc_map_path_buff), entries, UIO_MAX_LIST_ENTRIES);
+        if (num_wc_entries < 0 || (unsigned int)num_wc_entries > s_uio_num_regions)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "More write-combining map paths than mapped regions are provided. %s is provided.", s_uio_wc_map_path );
+            s_uio_list_error = true;
+            return;
+        }
+        for (i = 0; i < (unsigned int)num_wc_entries; ++i)
+        {
+            s_uio_regions[i].wc_map_path = (entries[i][0] != '\0') ? entries[i] : NULL;
+        }
+    }
+}
+
 void uio_update_based_on_sysfs()
 {
 #ifndef UIO_UNIT_TEST_SW_MODEL_MODE
-    if (s_uio_addr_span == 0)
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
     {
+        UIO_REGION *region = &s_uio_regions[i];
         enum
         {
             UIO_MAP_PATH_SIZE = 1024
@@ -419,10 +627,15 @@ void uio_update_based_on_sysfs()
 
         char map_path[UIO_MAP_PATH_SIZE + 1];
 
-        uio_get_sysfs_map_path(map_path, UIO_MAP_PATH_SIZE);
+        if (region->span != 0)
+        {
+            continue;
+        }
+
+        uio_get_sysfs_map_path(s_uio_devices[region->device].path, region->map, map_path, UIO_MAP_PATH_SIZE);
 
         strncat(map_path, "size", UIO_MAP_PATH_SIZE);
-        s_uio_addr_span = uio_get_sysfs_map_file_to_uint64(map_path);
+        region->span = uio_get_sysfs_map_file_to_uint64(map_path);
     }
 #endif
 }
@@ -430,7 +643,7 @@ void uio_update_based_on_sysfs()
 uint64_t uio_get_sysfs_map_file_to_uint64(const char *path)
 {
     uint64_t ret = 0;
-    
+
     FILE *fp;
 
     fp = fopen(path, "r");
@@ -445,15 +658,15 @@ uint64_t uio_get_sysfs_map_file_to_uint64(const char *path)
 
     return ret;
 }
-void uio_get_sysfs_map_path(char *path, int path_buf_size)
+void uio_get_sysfs_map_path(const char *drv_path, unsigned int map, char *path, int path_buf_size)
 {
     uint32_t index = 0;
-    char *p;
+    const char *p;
     char *endptr;
 
     path[0] = '\0';
     // The region index is encoded in the file name component.
-    p = strrchr(s_uio_drv_path, '/');
+    p = strrchr(drv_path, '/');
     if (!p)
     {
         return;
@@ -471,8 +684,7 @@ void uio_get_sysfs_map_path(char *path, int path_buf_size)
     }
 
     // Example map path: /sys/class/uio/uio0/maps/map0
-    // Only use map0!
-    if (snprintf(path, path_buf_size, "/sys/class/uio/uio%d/maps/map0/", index) < 0)
+    if (snprintf(path, path_buf_size, "/sys/class/uio/uio%d/maps/map%u/", index, map) < 0)
     {
         path[0] = '\0';
         return;
@@ -481,12 +693,45 @@ void uio_get_sysfs_map_path(char *path, int path_buf_size)
 
 bool uio_validate_args()
 {
-    bool ret = s_uio_addr_span > 0 &&
+    bool is_span_valid = s_uio_num_regions > 0 || s_uio_addr_span > 0;
+    bool is_start_addr_valid = true;
+    unsigned int i, j;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
+    {
+        is_span_valid = is_span_valid && s_uio_regions[i].span > 0;
+    }
+
+    for (i = 0; i < s_uio_num_maps; ++i)
+    {
+        if (s_uio_maps[i] >= UIO_MAX_MAPS)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Map index %ld is out of range; maximum accepted is %d", s_uio_maps[i], UIO_MAX_MAPS - 1 );
+            is_start_addr_valid = false;
+        }
+    }
+
+    for (i = 0; is_span_valid && i < s_uio_num_regions; ++i)
+    {
+        for (j = 0; j < s_uio_num_start_addrs; ++j)
+        {
+            if (s_uio_start_addrs[j] >= s_uio_regions[i].span)
+            {
+                fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Start address 0x%lX is outside of the address span of map%u of %s.",
+                                 s_uio_start_addrs[j], s_uio_regions[i].map, s_uio_devices[s_uio_regions[i].device].path );
+                is_start_addr_valid = false;
+            }
+        }
+    }
+
+    bool ret = is_span_valid &&
+               is_start_addr_valid &&
+               !s_uio_list_error &&
                s_uio_drv_path != NULL;
-               
+
     if (!ret)
     {
-        if ( s_uio_addr_span == 0 )
+        if ( !is_span_valid )
         {
             fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "No valid address span value is provided using the argument, --address-span." );
         }
@@ -500,72 +745,225 @@ bool uio_validate_args()
 
 void uio_print_configuration()
 {
+    char start_addrs[UIO_LIST_SIZE];
+    size_t len = 0;
+    bool is_span_uniform = true;
+    unsigned int i;
+
     fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "UIO Platform Configuration:" );
     fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Driver Path: %s", s_uio_drv_path );
-    fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Address Span: %ld", s_uio_addr_span );
-    fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Start Address: 0x%lX", s_uio_start_addr );
+    if (s_uio_num_maps > 1 || s_uio_maps[0] != 0)
+    {
+        char maps[UIO_LIST_SIZE];
+        size_t maps_len = 0;
+        for (i = 0; i < s_uio_num_maps; ++i)
+        {
+            maps_len += snprintf(maps + maps_len, sizeof(maps) - maps_len, i == 0 ? "map%ld" : ", map%ld", s_uio_maps[i]);
+        }
+        fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Maps: %s", maps );
+    }
+
+    for (i = 1; i < s_uio_num_regions; ++i)
+    {
+        is_span_uniform = is_span_uniform && s_uio_regions[i].span == s_uio_regions[0].span;
+    }
+    if (is_span_uniform)
+    {
+        fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Address Span: %ld", s_uio_regions[0].span );
+    }
+    else
+    {
+        for (i = 0; i < s_uio_num_regions; ++i)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Address Span: %ld (map%u of %s)", s_uio_regions[i].span,
+                             s_uio_regions[i].map, s_uio_devices[s_uio_regions[i].device].path );
+        }
+    }
+
+    for (i = 0; i < s_uio_num_start_addrs; ++i)
+    {
+        len += snprintf(start_addrs + len, sizeof(start_addrs) - len, i == 0 ? "0x%lX" : ", 0x%lX", s_uio_start_addrs[i]);
+    }
+    fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Start Address: %s", start_addrs );
+    if (s_uio_wc_map_path != NULL)
+    {
+        fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Write-Combining Map Path: %s", s_uio_wc_map_path );
+    }
+    if (s_uio_int_cpu >= 0)
+    {
+        fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Interrupt CPU: %ld", s_uio_int_cpu );
+    }
     // TODO: no way to disable "Single Component Operation Model" for now.  Don't print this info.
     // fpga_msg_printf( FPGA_MSG_PRINTF_INFO, "   Single Component Operation Model: %s", s_uio_single_component_mode ? "Yes" : "No" );
 }
 
 bool uio_open_driver()
 {
-    bool ret = true;
-    
-    s_uio_drv_handle = open(s_uio_drv_path, O_RDWR);
-    if (s_uio_drv_handle == -1)
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_devices; ++i)
     {
+        s_uio_devices[i].handle = open(s_uio_devices[i].path, O_RDWR);
+        if (s_uio_devices[i].handle == -1)
+        {
 
 #ifdef _BSD_SOURCE
-        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to open %s. (Error code %d: %s)", s_uio_drv_path, sys_nerr, sys_errlist[sys_nerr] );
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to open %s. (Error code %d: %s)", s_uio_devices[i].path, sys_nerr, sys_errlist[sys_nerr] );
 #else
-        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to open %s. (Error code %d)", s_uio_drv_path, errno );
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to open %s. (Error code %d)", s_uio_devices[i].path, errno );
 #endif
 
-        ret = false;
+            return false;
+        }
     }
-    
-    return ret;
+
+    return true;
 }
 
+// UIO exposes map N of a device at offset N pages of its device file
 bool uio_map_mmio()
 {
-    bool ret = true;
-    
-    s_uio_mmap_ptr = mmap(0, s_uio_addr_span, PROT_READ | PROT_WRITE, MAP_SHARED, s_uio_drv_handle, 0);
-    if (s_uio_mmap_ptr == MAP_FAILED)
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
     {
+        UIO_REGION *region = &s_uio_regions[i];
+
+        region->mmap_ptr = mmap(0, region->span, PROT_READ | PROT_WRITE, MAP_SHARED, s_uio_devices[region->device].handle,
+                                (off_t)region->map * getpagesize());
+        if (region->mmap_ptr == MAP_FAILED)
+        {
+            region->mmap_ptr = NULL;
 #ifdef _BSD_SOURCE
-        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to map the mmio inteface to the UIO driver provided.  (Error code %d: %s)", sys_nerr, sys_errlist[sys_nerr] );
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to map the mmio inteface to the UIO driver provided.  (Error code %d: %s)", sys_nerr, sys_errlist[sys_nerr] );
 #else
-        fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to map the mmio inteface to the UIO driver provided.  (Error code %d)", errno );
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to map the mmio inteface to the UIO driver provided.  (Error code %d)", errno );
 #ifdef INTEL_FPGA_MSG_PRINTF_ENABLE_DEBUG
-        perror("MMAP error");
+            perror("MMAP error");
+#endif
 #endif
-#endif    
-        ret = false;
+            return false;
+        }
     }
-    
-    return ret;
+
+    return true;
 }
 
+// The write-combining mapping covers the same address span as the UIO map, e.g. the resource0_wc file of
+// the PCIe function behind the UIO device.  It is only used for payload memory; the CSRs are always
+// accessed through the uncached UIO mapping.
+bool uio_map_wc_mmio()
+{
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
+    {
+        UIO_REGION *region = &s_uio_regions[i];
+
+        if (region->wc_map_path == NULL)
+        {
+            continue;
+        }
+
+        region->wc_map_handle = open(region->wc_map_path, O_RDWR);
+        if (region->wc_map_handle == -1)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to open %s. (Error code %d)", region->wc_map_path, errno );
+            return false;
+        }
+
+        region->wc_mmap_ptr = mmap(0, region->span, PROT_READ | PROT_WRITE, MAP_SHARED, region->wc_map_handle, 0);
+        if (region->wc_mmap_ptr == MAP_FAILED)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_ERROR, "Failed to map the write-combining window %s.  (Error code %d)", region->wc_map_path, errno );
+            region->wc_mmap_ptr = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// One interface per region and start address, in that order, so that fpga_open(index) follows the command line.
+// The interrupt field is the index of the UIO device, which the interrupt thread demultiplexes on.
 bool uio_scan_interfaces()
 {
-    bool ret = true;
-    
-    if(s_uio_single_component_mode)
+    unsigned int i, j;
+    size_t index = 0;
+
+    common_fpga_interface_info_vec_resize(s_uio_num_regions * s_uio_num_start_addrs);
+    if (common_fpga_interface_info_vec_size() > 0 && common_fpga_interface_info_vec_at(0) == NULL)
+    {
+        return false;
+    }
+
+    for (i = 0; i < s_uio_num_regions; ++i)
     {
-        common_fpga_interface_info_vec_resize(1);
+        const UIO_REGION *region = &s_uio_regions[i];
 
-        common_fpga_interface_info_vec_at(0)->base_address = (void *)((char *)s_uio_mmap_ptr + s_uio_start_addr);
-        common_fpga_interface_info_vec_at(0)->is_mmio_opened = false;
-        common_fpga_interface_info_vec_at(0)->is_interrupt_opened = false;
+        for (j = 0; j < s_uio_num_start_addrs; ++j, ++index)
+        {
+            FPGA_INTERFACE_INFO *info = common_fpga_interface_info_vec_at(index);
+
+            info->instance = (uint16_t)index;
+            info->base_address = (void *)((char *)region->mmap_ptr + s_uio_start_addrs[j]);
+            info->wc_base_address = (region->wc_mmap_ptr != NULL) ? (void *)((char *)region->wc_mmap_ptr + s_uio_start_addrs[j]) : NULL;
+            info->interrupt = (uint16_t)region->device;
+            info->is_mmio_opened = false;
+            info->is_interrupt_opened = false;
+        }
     }
 
-    return ret;
+    return true;
 }
 
-bool uio_create_interrupt_thread() 
+// Unmaps every region and closes every device, whatever got opened
+void uio_release_interfaces()
+{
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
+    {
+        UIO_REGION *region = &s_uio_regions[i];
+
+#ifndef UIO_UNIT_TEST_SW_MODEL_MODE
+        if (region->wc_mmap_ptr != NULL)
+        {
+            munmap(region->wc_mmap_ptr, region->span);
+        }
+        if (region->wc_map_handle >= 0)
+        {
+            close(region->wc_map_handle);
+        }
+        if (region->mmap_ptr != NULL)
+        {
+            munmap(region->mmap_ptr, region->span);
+        }
+#else
+        free(region->wc_mmap_ptr);
+        free(region->mmap_ptr);
+#endif
+        region->wc_mmap_ptr = NULL;
+        region->wc_map_handle = -1;
+        region->mmap_ptr = NULL;
+    }
+
+    for (i = 0; i < s_uio_num_devices; ++i)
+    {
+        if (s_uio_devices[i].handle >= 0)
+        {
+            close(s_uio_devices[i].handle);
+            s_uio_devices[i].handle = -1;
+        }
+    }
+
+    if (common_fpga_interface_info_vec_size() > 0)
+    {
+        common_fpga_interface_info_vec_resize(0);
+    }
+}
+
+bool uio_create_interrupt_thread()
 {
     bool ret;
     int rc;
@@ -590,19 +988,125 @@ bool uio_create_interrupt_thread()
     }
 
     ret = rc == 0;
+    if (ret && s_uio_int_cpu >= 0)
+    {
+        uio_pin_interrupt_thread();
+    }
 
     return ret;
 }
 
+// Pins the interrupt thread to --interrupt-cpu, SCHED_FIFO at --sched-fifo if given.  Only warns upon
+// failure, e.g. without the privileges for SCHED_FIFO, interrupts are still served wherever the thread runs.
+void uio_pin_interrupt_thread()
+{
+    cpu_set_t cpus;
+    int rc;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(s_uio_int_cpu, &cpus);
+    rc = pthread_setaffinity_np(s_intThread_id, sizeof(cpus), &cpus);
+    if (rc != 0)
+    {
+        fpga_msg_printf( FPGA_MSG_PRINTF_WARNING, "Failed to pin the interrupt thread to CPU %ld: %s", s_uio_int_cpu, strerror(rc) );
+    }
+
+    if (s_uio_int_sched_fifo_priority > 0)
+    {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = (int)s_uio_int_sched_fifo_priority;
+        rc = pthread_setschedparam(s_intThread_id, SCHED_FIFO, &param);
+        if (rc != 0)
+        {
+            fpga_msg_printf( FPGA_MSG_PRINTF_WARNING, "Failed to run the interrupt thread SCHED_FIFO at priority %ld: %s", s_uio_int_sched_fifo_priority, strerror(rc) );
+        }
+    }
+}
+
 bool uio_create_unit_test_sw_model()
 {
-    bool  ret = true;
+    unsigned int i;
 
-    common_fpga_interface_info_vec_resize(1);
+    for (i = 0; i < s_uio_num_regions; ++i)
+    {
+        UIO_REGION *region = &s_uio_regions[i];
 
-    common_fpga_interface_info_vec_at(0)->base_address = malloc(s_uio_addr_span);
-    // Preset mem with all 1s
-    memset(common_fpga_interface_info_vec_at(0)->base_address, 0xFF, s_uio_addr_span);
+        region->mmap_ptr = malloc(region->span);
+        if (region->mmap_ptr == NULL)
+        {
+            return false;
+        }
+        // Preset mem with all 1s
+        memset(region->mmap_ptr, 0xFF, region->span);
 
-    return ret;
+        // No file is opened for the write-combining window, it is modelled by a second buffer
+        if (region->wc_map_path != NULL)
+        {
+            region->wc_mmap_ptr = malloc(region->span);
+            if (region->wc_mmap_ptr == NULL)
+            {
+                return false;
+            }
+            memset(region->wc_mmap_ptr, 0xFF, region->span);
+        }
+#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
+        region->wc_pending_begin = region->wc_pending_end = 0;
+#endif
+    }
+
+    return true;
 }
+
+#ifdef UIO_UNIT_TEST_SW_MODEL_MODE
+void uio_sw_model_wc_post(const volatile void *wc_address, size_t len)
+{
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
+    {
+        UIO_REGION *region = &s_uio_regions[i];
+        const char *wc_begin = (const char *)region->wc_mmap_ptr;
+        size_t offset;
+
+        if (wc_begin == NULL || (const char *)wc_address < wc_begin || (const char *)wc_address >= wc_begin + region->span)
+        {
+            continue;
+        }
+
+        offset = (const char *)wc_address - wc_begin;
+        if (region->wc_pending_begin == region->wc_pending_end)
+        {
+            region->wc_pending_begin = offset;
+            region->wc_pending_end = offset + len;
+        }
+        else
+        {
+            region->wc_pending_begin = (offset < region->wc_pending_begin) ? offset : region->wc_pending_begin;
+            region->wc_pending_end = (offset + len > region->wc_pending_end) ? offset + len : region->wc_pending_end;
+        }
+        return;
+    }
+}
+
+void uio_sw_model_wc_flush()
+{
+    unsigned int i;
+
+    for (i = 0; i < s_uio_num_regions; ++i)
+    {
+        UIO_REGION *region = &s_uio_regions[i];
+
+        if (region->wc_pending_end > region->span)
+        {
+            region->wc_pending_end = region->span;
+        }
+        if (region->wc_mmap_ptr != NULL && region->wc_pending_begin < region->wc_pending_end)
+        {
+            memcpy((char *)region->mmap_ptr + region->wc_pending_begin, (char *)region->wc_mmap_ptr + region->wc_pending_begin,
+                   region->wc_pending_end - region->wc_pending_begin);
+        }
+        region->wc_pending_begin = region->wc_pending_end = 0;
+    }
+}
+#endif
@@ -369,3 +369,261 @@ TEST_F(MMIO, should_deal_with_mmio_512)
     }
     
 }
+
+
+static void s_check_mmio_burst(FPGA_MMIO_INTERFACE_HANDLE handle, FPGA_MMIO_BURST_KERNEL kernel)
+{
+    const uint32_t  START_OFFSET = 2048;
+    const size_t    MAX_LEN = 200;
+    const size_t    GUARD = 16;
+    uint8_t         wdata[MAX_LEN + 8 + 8];
+    uint8_t         rdata[MAX_LEN + 8 + 8 + GUARD];
+    
+    ASSERT_TRUE(fpga_mmio_burst_select(kernel));
+    EXPECT_EQ(kernel, fpga_mmio_burst_selected());
+    
+    for(size_t len = 1; len <= MAX_LEN; len += 13)
+    {
+        for(uint32_t offset = START_OFFSET; offset < START_OFFSET + 32; offset += 8)
+        {
+            for(size_t misalign = 0; misalign < 8; misalign += 3)
+            {
+                const size_t words = (len + 7) / 8;
+                s_msg_buffer[0] = '\0';
+                ::snprintf( s_msg_buffer, MSG_BUFFER_SIZE, "%s burst, length: %zu, offset: %u, host misalignment: %zu", fpga_mmio_burst_name(kernel), len, offset, misalign );
+                SCOPED_TRACE(s_msg_buffer);
+                
+                // Write: whole words land in the MMIO space, the neighbouring words are left alone
+                for(uint32_t addr = START_OFFSET - 8; addr < START_OFFSET + 32 + MAX_LEN + 16; addr += 8)
+                {
+                    fpga_write_64(handle, addr, 0xffffffffffffffff);
+                }
+                for(size_t i = 0; i < words * 8; ++i)
+                {
+                    wdata[misalign + i] = (uint8_t)(i + len);
+                }
+                fpga_write_burst(handle, offset, wdata + misalign, len);
+                EXPECT_EQ(0xffffffffffffffff, fpga_read_64(handle, offset - 8));
+                EXPECT_EQ(0xffffffffffffffff, fpga_read_64(handle, offset + words * 8));
+                for(size_t i = 0; i < words; ++i)
+                {
+                    uint64_t expected;
+                    memcpy(&expected, wdata + misalign + i * 8, sizeof(expected));
+                    EXPECT_EQ(expected, fpga_read_64(handle, offset + i * 8));
+                }
+                
+                // Read: whole words land in host memory, the bytes past them are left alone
+                memset(rdata, 0xa5, sizeof(rdata));
+                fpga_read_burst(handle, offset, rdata + misalign, len);
+                EXPECT_EQ(0, memcmp(rdata + misalign, wdata + misalign, words * 8));
+                for(size_t i = misalign + words * 8; i < sizeof(rdata); ++i)
+                {
+                    EXPECT_EQ(0xa5, rdata[i]);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(MMIO, should_deal_with_mmio_burst_64)
+{
+    if (!fpga_mmio_burst_select(FPGA_MMIO_BURST_64))
+    {
+        GTEST_SKIP() << "Not supported by this CPU";
+    }
+    s_check_mmio_burst(m_handle, FPGA_MMIO_BURST_64);
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AUTO));
+}
+
+TEST_F(MMIO, should_deal_with_mmio_burst_sse2)
+{
+    if (!fpga_mmio_burst_select(FPGA_MMIO_BURST_SSE2))
+    {
+        GTEST_SKIP() << "Not supported by this CPU";
+    }
+    s_check_mmio_burst(m_handle, FPGA_MMIO_BURST_SSE2);
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AUTO));
+}
+
+TEST_F(MMIO, should_deal_with_mmio_burst_avx2)
+{
+    if (!fpga_mmio_burst_select(FPGA_MMIO_BURST_AVX2))
+    {
+        GTEST_SKIP() << "Not supported by this CPU";
+    }
+    s_check_mmio_burst(m_handle, FPGA_MMIO_BURST_AVX2);
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AUTO));
+}
+
+TEST_F(MMIO, should_deal_with_mmio_burst_neon)
+{
+    if (!fpga_mmio_burst_select(FPGA_MMIO_BURST_NEON))
+    {
+        GTEST_SKIP() << "Not supported by this CPU";
+    }
+    s_check_mmio_burst(m_handle, FPGA_MMIO_BURST_NEON);
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AUTO));
+}
+
+TEST_F(MMIO, should_deal_with_misaligned_mmio_burst)
+{
+    uint8_t wdata[24];
+    uint8_t rdata[24];
+    
+    for(int i = 0; i < (int)sizeof(wdata); ++i)
+    {
+        wdata[i] = i;
+    }
+    fpga_write_burst(m_handle, 3076, wdata, sizeof(wdata));
+    fpga_read_burst(m_handle, 3076, rdata, sizeof(rdata));
+    EXPECT_EQ(0, memcmp(wdata, rdata, sizeof(wdata)));
+    EXPECT_EQ(0xff, fpga_read_8(m_handle, 3075));
+    EXPECT_EQ(0xff, fpga_read_8(m_handle, 3100));
+}
+
+TEST_F(MMIO, should_deal_with_mmio_burst_selection)
+{
+    FPGA_MMIO_BURST_KERNEL kernel;
+    
+    EXPECT_TRUE(fpga_mmio_burst_parse("64", &kernel));
+    EXPECT_EQ(FPGA_MMIO_BURST_64, kernel);
+    EXPECT_TRUE(fpga_mmio_burst_parse("auto", &kernel));
+    EXPECT_EQ(FPGA_MMIO_BURST_AUTO, kernel);
+    EXPECT_FALSE(fpga_mmio_burst_parse("avx512", &kernel));
+    EXPECT_STREQ("avx2", fpga_mmio_burst_name(FPGA_MMIO_BURST_AVX2));
+    
+    // Auto never settles on the unresolved kernel
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AUTO));
+    EXPECT_NE(FPGA_MMIO_BURST_AUTO, fpga_mmio_burst_selected());
+    
+    // An unsupported kernel leaves the selection alone
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_64));
+#if defined(__x86_64__) || defined(__i386__)
+    EXPECT_FALSE(fpga_mmio_burst_select(FPGA_MMIO_BURST_NEON));
+#else
+    EXPECT_FALSE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AVX2));
+#endif
+    EXPECT_EQ(FPGA_MMIO_BURST_64, fpga_mmio_burst_selected());
+    EXPECT_TRUE(fpga_mmio_burst_select(FPGA_MMIO_BURST_AUTO));
+}
+
+TEST_F(MMIO, should_deal_with_resolved_mmio)
+{
+    FPGA_MMIO_INTERFACE mmio = fpga_mmio_resolve(m_handle);
+    uint8_t wdata[32];
+    uint8_t rdata[32];
+    
+    EXPECT_TRUE(mmio.base_address == fpga_uio_get_base_address(m_handle));
+    EXPECT_TRUE(mmio.wc_base_address == NULL);
+    
+    fpga_mmio_write_32(&mmio, 16, 0x12345678);
+    EXPECT_EQ(0x12345678U, fpga_read_32(m_handle, 16));
+    fpga_write_64(m_handle, 24, 0x0123456789abcdefULL);
+    EXPECT_EQ(0x0123456789abcdefULL, fpga_mmio_read_64(&mmio, 24));
+    EXPECT_EQ(0x89abcdefU, fpga_mmio_read_32(&mmio, 24));
+    fpga_mmio_write_64(&mmio, 24, 0xfedcba9876543210ULL);
+    EXPECT_EQ(0xfedcba9876543210ULL, fpga_read_64(m_handle, 24));
+    
+    for(int i = 0; i < (int)sizeof(wdata); ++i)
+    {
+        wdata[i] = 0xA0 + i;
+    }
+    fpga_mmio_write_burst(&mmio, 512, wdata, sizeof(wdata));
+    fpga_read_burst(m_handle, 512, rdata, sizeof(rdata));
+    EXPECT_EQ(0, memcmp(wdata, rdata, sizeof(wdata)));
+    memset(rdata, 0, sizeof(rdata));
+    fpga_mmio_read_burst(&mmio, 512, rdata, sizeof(rdata));
+    EXPECT_EQ(0, memcmp(wdata, rdata, sizeof(wdata)));
+}
+
+TEST_F(MMIO, should_write_through_without_wc_window)
+{
+    uint8_t wdata[16];
+    
+    for(int i = 0; i < (int)sizeof(wdata); ++i)
+    {
+        wdata[i] = i;
+    }
+    EXPECT_TRUE(fpga_uio_get_wc_base_address(m_handle) == NULL);
+    fpga_write_burst_wc(m_handle, 1024, wdata, sizeof(wdata));
+    EXPECT_EQ(0x0706050403020100ULL, fpga_read_64(m_handle, 1024));
+    EXPECT_EQ(0x0f0e0d0c0b0a0908ULL, fpga_read_64(m_handle, 1032));
+    fpga_wc_flush(m_handle);
+}
+
+class MMIO_WC : public ::testing::Test  
+{
+public:
+    void SetUp()
+    {
+        optind = 0;     // Reset getopt_long position.
+        s_uio_msg_oss = &m_uio_msg_oss;
+        fpga_platform_register_printf(s_uio_utst_printf);
+        fpga_platform_register_runtime_exception_handler(s_uio_utst_exception_handler); 
+        const char *argv_valid[] =
+        {
+            "program",
+            "--single-component-mode",        
+            "--uio-driver-path=/dev/uio0",        
+            "--address-span=4096",
+            "--wc-map-path=/sys/class/uio/uio0/device/resource0_wc"
+        };
+        
+        bool rc = fpga_platform_init(5, argv_valid);
+        EXPECT_TRUE(rc);
+        
+        EXPECT_STREQ( 
+            "INFO: UIO Platform Configuration:"
+            "INFO:    Driver Path: /dev/uio0"
+            "INFO:    Address Span: 4096"
+            "INFO:    Start Address: 0x0"
+            "INFO:    Write-Combining Map Path: /sys/class/uio/uio0/device/resource0_wc",
+            m_uio_msg_oss.str().c_str() );
+        
+        m_handle = fpga_open(0);
+        EXPECT_TRUE(m_handle != FPGA_MMIO_INTERFACE_INVALID_HANDLE);
+    }
+
+    void TearDown()
+    {
+        fpga_close(0);
+        
+        fpga_platform_cleanup();
+    }
+
+protected:
+
+    FPGA_MMIO_INTERFACE_HANDLE  m_handle;
+    ostringstream               m_uio_msg_oss;
+};
+
+// Payload through the write-combining window, then a descriptor through the uncached CSR window: the
+// payload is only guaranteed to be visible to the IP once fpga_wc_flush() has been called.
+TEST_F(MMIO_WC, should_order_payload_before_descriptor_with_flush)
+{
+    uint8_t wdata[40];
+    
+    for(int i = 0; i < (int)sizeof(wdata); ++i)
+    {
+        wdata[i] = i + 1;
+    }
+    EXPECT_TRUE(fpga_uio_get_wc_base_address(m_handle) != NULL);
+    EXPECT_TRUE(fpga_uio_get_wc_base_address(m_handle) != fpga_uio_get_base_address(m_handle));
+    
+    fpga_write_burst_wc(m_handle, 2048, wdata, sizeof(wdata));
+    EXPECT_EQ(0xffffffffffffffffULL, fpga_read_64(m_handle, 2048));
+    
+    fpga_wc_flush(m_handle);
+    fpga_write_64(m_handle, 0x10, 0x1234);
+    EXPECT_EQ(0x1234ULL, fpga_read_64(m_handle, 0x10));
+    
+    uint8_t rdata[40];
+    fpga_read_burst(m_handle, 2048, rdata, sizeof(rdata));
+    EXPECT_EQ(0, memcmp(wdata, rdata, sizeof(wdata)));
+    EXPECT_EQ(0xff, fpga_read_8(m_handle, 2047));
+    EXPECT_EQ(0xff, fpga_read_8(m_handle, 2088));
+    
+    // A flush with nothing pending leaves the CSRs alone
+    fpga_wc_flush(m_handle);
+    EXPECT_EQ(0x1234ULL, fpga_read_64(m_handle, 0x10));
+}
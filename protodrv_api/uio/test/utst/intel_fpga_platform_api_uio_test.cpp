@@ -33,6 +33,7 @@ using namespace std;
 #include "gtest/gtest.h"
 
 #include "intel_fpga_platform_api_uio.h"
+#include "intel_fpga_api_uio.h"
 #include "intel_fpga_api_cmn_msg.h"
 
 extern int optind;
@@ -363,3 +364,138 @@ TEST_F(Argument, should_deal_with_valid_argument_with_optional_start_addr)
 
     fpga_platform_cleanup();
 }
+
+TEST_F(Argument, should_deal_with_multiple_devices_maps_and_start_addrs)
+{
+    const char *argv_valid[] =
+    {
+        "program",
+        "--uio-driver-path=/dev/uio0,/dev/uio1",
+        "--uio-maps=0,2",
+        "--start-address=0x0,0x800",
+        "--address-span=4096"
+    };
+    
+    bool rc = fpga_platform_init(5, argv_valid);
+    EXPECT_TRUE(rc);
+    
+    EXPECT_STREQ( 
+        "INFO: UIO Platform Configuration:"
+        "INFO:    Driver Path: /dev/uio0,/dev/uio1"
+        "INFO:    Maps: map0, map2"
+        "INFO:    Address Span: 4096"
+        "INFO:    Start Address: 0x0, 0x800",
+        m_uio_msg_oss.str().c_str() );
+
+    // Device first, then map, then start address
+    ASSERT_EQ(8u, fpga_get_num_of_interfaces());
+    FPGA_INTERFACE_INFO info[8];
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        EXPECT_TRUE(fpga_get_interface_at(i, &info[i]));
+        EXPECT_EQ(i, info[i].instance);
+        EXPECT_EQ(i / 4, info[i].interrupt);
+    }
+    EXPECT_EQ((char *)info[0].base_address + 0x800, (char *)info[1].base_address);
+    EXPECT_NE(info[0].base_address, info[2].base_address);
+    EXPECT_NE(info[2].base_address, info[4].base_address);
+
+    // Instances in the same map share it
+    FPGA_MMIO_INTERFACE_HANDLE first = fpga_open(4);
+    FPGA_MMIO_INTERFACE_HANDLE second = fpga_open(5);
+    EXPECT_EQ(4, first);
+    EXPECT_EQ(5, second);
+    fpga_write_32(second, 0x10, 0x12345678);
+    EXPECT_EQ(0x12345678u, fpga_read_32(first, 0x810));
+    EXPECT_EQ(0xffffffffu, fpga_read_32(fpga_open(6), 0x10));
+    fpga_close(4);
+    fpga_close(5);
+    fpga_close(6);
+
+    fpga_platform_cleanup();
+}
+
+TEST_F(Argument, should_deal_with_start_address_outside_of_span)
+{
+    const char *argv_invalid[] =
+    {
+        "program",
+        "--uio-driver-path=/dev/uio0",
+        "--start-address=0x0,0x1000",
+        "--address-span=4096"
+    };
+    
+    bool rc = fpga_platform_init(4, argv_invalid);
+    EXPECT_FALSE(rc);
+    
+    EXPECT_STREQ( 
+        "ERROR: Start address 0x1000 is outside of the address span of map0 of /dev/uio0.",
+        m_uio_msg_oss.str().c_str() );
+    EXPECT_EQ(0u, fpga_get_num_of_interfaces());
+
+    fpga_platform_cleanup();
+}
+
+TEST_F(Argument, should_deal_with_invalid_map_index)
+{
+    const char *argv_invalid[] =
+    {
+        "program",
+        "--uio-driver-path=/dev/uio0",
+        "--uio-maps=5",
+        "--address-span=4096"
+    };
+    
+    bool rc = fpga_platform_init(4, argv_invalid);
+    EXPECT_FALSE(rc);
+    
+    EXPECT_STREQ( 
+        "ERROR: Map index 5 is out of range; maximum accepted is 4",
+        m_uio_msg_oss.str().c_str() );
+
+    fpga_platform_cleanup();
+}
+
+TEST_F(Argument, should_deal_with_interrupt_cpu)
+{
+    const char *argv_valid[] =
+    {
+        "program",
+        "--uio-driver-path=/dev/uio0",
+        "--address-span=4096",
+        "--interrupt-cpu=0"
+    };
+    
+    bool rc = fpga_platform_init(4, argv_valid);
+    EXPECT_TRUE(rc);
+    
+    EXPECT_STREQ( 
+        "INFO: UIO Platform Configuration:"
+        "INFO:    Driver Path: /dev/uio0"
+        "INFO:    Address Span: 4096"
+        "INFO:    Start Address: 0x0"
+        "INFO:    Interrupt CPU: 0",
+        m_uio_msg_oss.str().c_str() );
+
+    fpga_platform_cleanup();
+}
+
+TEST_F(Argument, should_deal_with_invalid_interrupt_cpu)
+{
+    const char *argv_invalid[] =
+    {
+        "program",
+        "--uio-driver-path=/dev/uio0",
+        "--address-span=4096",
+        "--interrupt-cpu=100000"
+    };
+    
+    bool rc = fpga_platform_init(4, argv_invalid);
+    EXPECT_FALSE(rc);
+    
+    EXPECT_STREQ( 
+        "ERROR: Interrupt CPU 100000 is out of range; maximum accepted is 1023",
+        m_uio_msg_oss.str().c_str() );
+
+    fpga_platform_cleanup();
+}
@@ -38,6 +38,8 @@ typedef enum {
 
 #define HW_LOOPBACK_PARAM "#HW_LOOPBACK"
 #define HW_LOOPBACK_PARAM_LEN 13
+#define DONE_BATCH_PARAM "#DONE_BATCH"
+#define DONE_BATCH_PARAM_LEN 12
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +39,8 @@ extern const char *MANAGEMENT_SOCK_NAME;
 extern const char *MANAGEMENT_RSP_SOCK_NAME;
 extern const char *H2T_SOCK_NAME;
 extern const char *T2H_SOCK_NAME;
+// Acks the CTRL handle instead of CONTROL_SOCK_NAME where the welcome message offers MUX_SUPPORT, see MUX_STREAM
+extern const char *MUX_SOCK_NAME;
 
 // Server control messages
 extern const char *READY_MSG;
@@ -62,6 +64,8 @@ extern const char *SET_DRIVER_PARAM_CMD;
 extern const size_t SET_DRIVER_PARAM_CMD_LEN;
 extern const char *GET_DRIVER_PARAM_CMD;
 extern const size_t GET_DRIVER_PARAM_CMD_LEN;
+extern const char *SHM_ATTACH_CMD;
+extern const size_t SHM_ATTACH_CMD_LEN;
 
 // Control command responses
 extern const char *UNRECOGNIZED_CMD_RSP;
@@ -76,6 +80,10 @@ extern const char *GET_PARAM_CMD_FAIL_RSP;
 extern const size_t GET_PARAM_CMD_FAIL_RSP_LEN;
 extern const char *DISCONNECT_CMD_RSP;
 extern const size_t DISCONNECT_CMD_RSP_LEN;
+extern const char *SHM_ATTACH_CMD_RSP;
+extern const size_t SHM_ATTACH_CMD_RSP_LEN;
+extern const char *SHM_ATTACH_CMD_FAIL_RSP;
+extern const size_t SHM_ATTACH_CMD_FAIL_RSP_LEN;
 
 // Server control params
 extern const size_t MAX_SERVER_PARAM_VALUE_LEN;
@@ -91,8 +99,38 @@ extern const char *T2H_NAGLE_PARAM;
 extern const size_t T2H_NAGLE_PARAM_LEN;
 extern const char *MGMT_RSP_NAGLE_PARAM;
 extern const size_t MGMT_RSP_NAGLE_PARAM_LEN;
+extern const char *T2H_HIGH_WATER_MARK_PARAM;
+extern const size_t T2H_HIGH_WATER_MARK_PARAM_LEN;
+extern const char *MGMT_RSP_HIGH_WATER_MARK_PARAM;
+extern const size_t MGMT_RSP_HIGH_WATER_MARK_PARAM_LEN;
+extern const char *T2H_BATCH_SIZE_PARAM;
+extern const size_t T2H_BATCH_SIZE_PARAM_LEN;
+extern const char *POLL_SPIN_US_PARAM;
+extern const size_t POLL_SPIN_US_PARAM_LEN;
+extern const char *POLL_SLEEP_US_PARAM;
+extern const size_t POLL_SLEEP_US_PARAM_LEN;
+extern const char *POLL_MAX_WAIT_MS_PARAM;
+extern const size_t POLL_MAX_WAIT_MS_PARAM_LEN;
+extern const char *POLL_STATE_TIME_US_PARAM;
+extern const size_t POLL_STATE_TIME_US_PARAM_LEN;
+extern const char *HW_WRITES_SAVED_PER_SEC_PARAM;
+extern const size_t HW_WRITES_SAVED_PER_SEC_PARAM_LEN;
+extern const char *SESSION_SETUP_US_PARAM;
+extern const size_t SESSION_SETUP_US_PARAM_LEN;
+extern const char *HANDSHAKES_ABANDONED_PARAM;
+extern const size_t HANDSHAKES_ABANDONED_PARAM_LEN;
+extern const char *WARM_START_PARAM;
+extern const size_t WARM_START_PARAM_LEN;
+extern const char *FULL_RESET_PARAM;
+extern const size_t FULL_RESET_PARAM_LEN;
+extern const char *CONNS_REJECTED_PARAM;
+extern const size_t CONNS_REJECTED_PARAM_LEN;
+extern const char *REJECTS_RATE_LIMITED_PARAM;
+extern const size_t REJECTS_RATE_LIMITED_PARAM_LEN;
 extern const char *MGMT_SUPPORT_PARAM;
 extern const size_t MGMT_SUPPORT_PARAM_LEN;
+extern const char *MUX_SUPPORT_PARAM;
+extern const size_t MUX_SUPPORT_PARAM_LEN;
 
 // Global ST Host params
 #define HOSTNAMES_PARAM "hostnames"
@@ -0,0 +1,103 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "intel_st_debug_if_common.h"
+#include "intel_st_debug_if_platform.h"
+#include "intel_st_debug_if_sockets.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interest / readiness flags
+#define EVENT_LOOP_READ 0x1
+#define EVENT_LOOP_WRITE 0x2
+#define EVENT_LOOP_EXCEPT 0x4
+
+// Interest-only flag, requests that readiness is reported on transitions rather than levels.
+// The consumer must then drain the source until it would block before waiting again.
+// Only honored by the epoll backend, the select backend is always level-triggered.
+#define EVENT_LOOP_EDGE_TRIGGERED 0x8
+
+#define EVENT_LOOP_MAX_SOURCES 16
+#define EVENT_LOOP_INFINITE_TIMEOUT -1
+
+// Enumerations
+typedef enum {
+    EVENT_LOOP_BACKEND_SELECT,
+    EVENT_LOOP_BACKEND_EPOLL
+} EVENT_LOOP_BACKEND;
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#define EVENT_LOOP_BACKEND_DEFAULT EVENT_LOOP_BACKEND_EPOLL
+#else
+#define EVENT_LOOP_BACKEND_DEFAULT EVENT_LOOP_BACKEND_SELECT
+#endif
+
+// Structure Definitions
+typedef struct {
+    SOCKET fd;
+    unsigned int interest; // EVENT_LOOP_READ | EVENT_LOOP_WRITE | EVENT_LOOP_EDGE_TRIGGERED
+    int tag;               // Caller defined identifier reported back with each event
+} EVENT_LOOP_SOURCE;
+
+typedef struct {
+    int tag;
+    unsigned int ready;    // EVENT_LOOP_READ | EVENT_LOOP_WRITE | EVENT_LOOP_EXCEPT
+} EVENT_LOOP_EVENT;
+
+typedef struct {
+    EVENT_LOOP_BACKEND backend;
+    int epoll_fd;
+    EVENT_LOOP_SOURCE sources[EVENT_LOOP_MAX_SOURCES];
+    int num_sources;
+
+    // Statistics
+    size_t waits;          // Number of calls into the backend
+    size_t idle_waits;     // Number of calls that returned without any event
+} EVENT_LOOP;
+
+extern const EVENT_LOOP EVENT_LOOP_default;
+
+RETURN_CODE event_loop_init(EVENT_LOOP *loop, EVENT_LOOP_BACKEND backend);
+void event_loop_close(EVENT_LOOP *loop);
+RETURN_CODE event_loop_add(EVENT_LOOP *loop, SOCKET fd, unsigned int interest, int tag);
+RETURN_CODE event_loop_modify(EVENT_LOOP *loop, SOCKET fd, unsigned int interest);
+RETURN_CODE event_loop_remove(EVENT_LOOP *loop, SOCKET fd);
+unsigned int event_loop_get_interest(EVENT_LOOP *loop, SOCKET fd);
+
+// Waits up to 'timeout_ms' (EVENT_LOOP_INFINITE_TIMEOUT to block) for any of the registered sources to become ready.
+// Returns the number of entries filled in 'events', or < 0 on error.
+int event_loop_wait(EVENT_LOOP *loop, EVENT_LOOP_EVENT *events, int max_events, int timeout_ms);
+
+const char *event_loop_backend_name(EVENT_LOOP_BACKEND backend);
+int parse_event_loop_backend(const char *name, EVENT_LOOP_BACKEND *backend); // A return value of < 0 indicates an unknown name
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+
+#include "intel_st_debug_if_common.h"
+#include "intel_st_debug_if_sockets.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Consumers may read up to this many bytes past the received data, see memcpy64_host2fpga()
+#define INPUT_QUEUE_SLACK 8
+
+// Bytes received from a socket but not parsed yet.  The socket is read in chunks as large as
+// the room left in the queue, so any number of packets (and the start of the next one) are
+// taken in at once.  Consumed bytes are reclaimed by moving the remainder to the front.
+typedef struct {
+    char *buff;
+    size_t buff_sz;
+    size_t head;            // Offset of the next byte to be parsed
+    size_t tail;            // Offset one past the last received byte
+    size_t recv_calls;      // Since the last reset, for statistics
+} INPUT_QUEUE;
+
+extern const INPUT_QUEUE INPUT_QUEUE_default;
+
+RETURN_CODE input_queue_alloc(INPUT_QUEUE *queue, size_t sz);
+void input_queue_free(INPUT_QUEUE *queue);
+void input_queue_reset(INPUT_QUEUE *queue);
+
+size_t input_queue_len(const INPUT_QUEUE *queue);
+char input_queue_is_full(const INPUT_QUEUE *queue);
+const char *input_queue_peek(const INPUT_QUEUE *queue);
+void input_queue_consume(INPUT_QUEUE *queue, size_t len);
+
+// A single recv() of whatever the socket has ready, up to 'max_len' bytes or the room left in the queue.  Only
+// socket errors other than "would block", and the peer closing the connection, are reported as a FAILURE.
+RETURN_CODE input_queue_fill(INPUT_QUEUE *queue, SOCKET fd, size_t max_len, int flags, ssize_t *bytes_recvd);
+
+// Same as input_queue_fill() for bytes taken in by other means than recv(), e.g. from a shared-memory ring.
+// Returns room for up to 'max_len' bytes, its size in 'room'.  Nothing is added until input_queue_commit() is called.
+char *input_queue_reserve(INPUT_QUEUE *queue, size_t max_len, size_t *room);
+void input_queue_commit(INPUT_QUEUE *queue, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
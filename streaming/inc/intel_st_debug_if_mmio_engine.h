@@ -0,0 +1,83 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "intel_st_debug_if_platform.h"
+#include "intel_st_debug_if_spsc_ring.h"
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct SERVER_CONN;
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+
+// The thread owning the hardware while a client is served in threaded mode, see SERVER_CONN.threaded.
+// The network thread receives H2T / MGMT data straight into the inbound rings, the engine pushes complete
+// packets to the IP and lays T2H / MGMT RSP packets out in the outbound rings, ready to be sent as is.
+typedef struct MMIO_ENGINE {
+    struct SERVER_CONN *server_conn;
+
+    SPSC_RING h2t_ring;         // Network thread -> engine
+    SPSC_RING mgmt_ring;        // Network thread -> engine
+    SPSC_RING t2h_ring;         // Engine -> network thread, sized after the T2H high-water mark
+    SPSC_RING mgmt_rsp_ring;    // Engine -> network thread, sized after the MGMT RSP high-water mark
+    SPSC_DOORBELL engine_bell;  // Rung by the network thread
+    SPSC_DOORBELL network_bell; // Rung by the engine
+
+    char *bounce_buff;          // One payload, for those wrapping around the end of the H2T ring
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int park_requested;         // Under 'lock', see mmio_engine_park()
+    int parked;                 // Under 'lock'
+    int stop;
+    int exited;                 // Set under 'lock', the engine stopped on its own in case of an error
+} MMIO_ENGINE;
+
+RETURN_CODE mmio_engine_start(MMIO_ENGINE *engine, struct SERVER_CONN *server_conn);
+void mmio_engine_stop(MMIO_ENGINE *engine);
+char mmio_engine_has_exited(MMIO_ENGINE *engine);
+
+// Holds the engine between two passes, e.g. while a control message changes what it works with
+void mmio_engine_park(MMIO_ENGINE *engine);
+void mmio_engine_unpark(MMIO_ENGINE *engine);
+
+// Grows the outbound rings after a high-water mark change, only while the engine is parked
+RETURN_CODE mmio_engine_fit_rings(MMIO_ENGINE *engine);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
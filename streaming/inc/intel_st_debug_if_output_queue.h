@@ -0,0 +1,83 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+
+#include "intel_st_debug_if_common.h"
+#include "intel_st_debug_if_sockets.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Producers may overrun a reservation by up to this many bytes, see memcpy64_fpga2host()
+#define OUTPUT_QUEUE_SLACK 8
+
+#define OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK 0x10000
+
+// Bytes waiting to be sent out on a non-blocking socket.  Producers are expected to stop
+// adding packets once the high-water mark is reached, the queue always has room for one more
+// packet of up to 'max_packet_sz' bytes past that point.
+typedef struct {
+    char *buff;
+    size_t buff_sz;
+    size_t head;            // Offset of the next byte to be sent
+    size_t tail;            // Offset one past the last queued byte
+    size_t high_water_mark;
+    size_t max_packet_sz;
+    size_t send_calls;      // Since the last reset, for statistics
+} OUTPUT_QUEUE;
+
+extern const OUTPUT_QUEUE OUTPUT_QUEUE_default;
+
+RETURN_CODE output_queue_alloc(OUTPUT_QUEUE *queue, size_t max_packet_sz);
+void output_queue_free(OUTPUT_QUEUE *queue);
+void output_queue_reset(OUTPUT_QUEUE *queue);
+RETURN_CODE output_queue_set_high_water_mark(OUTPUT_QUEUE *queue, size_t high_water_mark);
+
+size_t output_queue_len(const OUTPUT_QUEUE *queue);
+char output_queue_is_empty(const OUTPUT_QUEUE *queue);
+char output_queue_is_full(const OUTPUT_QUEUE *queue); // At or above the high-water mark
+
+// Returns room for 'len' bytes (plus OUTPUT_QUEUE_SLACK) at the end of the queue, NULL if unavailable.
+// Nothing is queued until output_queue_commit() is called.
+char *output_queue_reserve(OUTPUT_QUEUE *queue, size_t len);
+void output_queue_commit(OUTPUT_QUEUE *queue, size_t len);
+RETURN_CODE output_queue_push(OUTPUT_QUEUE *queue, const char *data, size_t len);
+
+// Sends as much as the socket accepts without blocking.  Only socket errors other than
+// "would block" are reported as a FAILURE.
+RETURN_CODE output_queue_flush(OUTPUT_QUEUE *queue, SOCKET fd, int flags, ssize_t *bytes_sent);
+
+// Same as output_queue_flush() for bytes sent out by other means than send(), e.g. into a shared-memory ring
+const char *output_queue_peek(const OUTPUT_QUEUE *queue);
+void output_queue_consume(OUTPUT_QUEUE *queue, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
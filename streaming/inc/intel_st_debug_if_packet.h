@@ -46,6 +46,9 @@
 #define MGMT_PACKET_HEADER_MASK_DATA_LEN_BYTES 0xFFFF
 #define MGMT_PACKET_MAX_PAYLOAD_BYTES MGMT_PACKET_HEADER_MASK_DATA_LEN_BYTES
 
+#define SIZEOF_MUX_FRAME_HEADER ((unsigned char)sizeof(MUX_FRAME_HEADER))
+#define MUX_FRAME_MAX_PAYLOAD_BYTES 0xFFFF
+
 //#define DEBUG 1
 
 #ifdef __cplusplus
@@ -68,6 +71,24 @@ typedef struct {
     unsigned short DATA_LEN_BYTES;
 } MGMT_PACKET_HEADER;
 
+// Streams of a multiplexed connection.  Once the CTRL handle is acked with MUX_SOCK_NAME, no other socket is
+// connected and every stream travels over the CTRL one as frames, READY being the last unframed message.
+typedef enum {
+    MUX_STREAM_CONTROL = 1,
+    MUX_STREAM_MGMT,
+    MUX_STREAM_MGMT_RSP,
+    MUX_STREAM_H2T,
+    MUX_STREAM_T2H
+} MUX_STREAM;
+
+// Each frame carries the next DATA_LEN_BYTES bytes of one stream, exactly as they would have gone over the
+// socket of that stream: frames need not line up with the packets or messages they carry.
+typedef struct {
+    unsigned char STREAM;
+    unsigned char RESERVED;
+    unsigned short DATA_LEN_BYTES;
+} MUX_FRAME_HEADER;
+
 void populate_guardband(unsigned char *bytes);
 
 // H2T / T2H
@@ -125,6 +146,10 @@ void populate_mgmt_packet_bytes
     unsigned short data_len_bytes
 );
 
+// Multiplexed connections
+void populate_mux_frame_header_bytes(unsigned char *bytes, unsigned char stream, unsigned short data_len_bytes);
+void parse_mux_frame_header_bytes(const unsigned char *bytes, MUX_FRAME_HEADER *header);
+
 // Debug stuff
 #ifdef STI_DEBUG
 void dump_h2t_packet_header(H2T_PACKET_HEADER *packet);
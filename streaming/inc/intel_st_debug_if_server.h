@@ -27,11 +27,17 @@
 #pragma once
 
 
+#include <time.h>
+
 #include "intel_st_debug_if_sockets.h"
 #include "intel_st_debug_if_packet.h"
 #include "intel_st_debug_if_platform.h"
 #include "intel_st_debug_if_st_dbg_ip_driver.h"
 #include "intel_st_debug_if_stream_dbg.h"
+#include "intel_st_debug_if_event_loop.h"
+#include "intel_st_debug_if_input_queue.h"
+#include "intel_st_debug_if_output_queue.h"
+#include "intel_st_debug_if_shm_transport.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,12 +49,54 @@ typedef const char * const printf_format_arg;
 typedef const char * printf_format_arg;
 #endif
 
+// Number of T2H descriptors drained into the T2H queue before it is flushed
+#define DEFAULT_T2H_BATCH_SIZE 16
+
+// Backoff of the hardware polling once nothing happens, see IDLE_POLL.  Short sleeps double from 1 us up to
+// IDLE_POLL_MAX_SLEEP_US, blocking waits from 1 ms up to 'max_wait_ms'.
+#define DEFAULT_POLL_SPIN_US 1000
+#define DEFAULT_POLL_SLEEP_US 50000
+#define DEFAULT_POLL_MAX_WAIT_MS 10
+#define IDLE_POLL_MAX_SLEEP_US 1000
+
+// Time a connection has to identify itself, and a session to get all of its sockets connected, see PENDING_CONN
+#define DEFAULT_HANDSHAKE_TIMEOUT_MS 10000
+#define MAX_PENDING_CONNS 8
+#define MAX_HANDSHAKE_MSG 64
+
+// Time a client that sent DISCONNECT_CMD has to close its connection before the server does, see DRAINING_CONN
+#define DISCONNECT_DRAIN_TIMEOUT_MS 10000
+#define MAX_DRAINING_CONNS 4
+
+// Connections refused from one address within REJECT_WINDOW_MS past the first REJECT_BURST ones are reset
+// without the rejection message, see REJECT_OFFENDER
+#define REJECT_BURST 4
+#define REJECT_WINDOW_MS 1000
+#define MAX_REJECT_OFFENDERS 16
+
 // Enumerations
 typedef enum {
     SINGLE_CLIENT,    // Server will only ever service one client (useful for unit test)
     MULTIPLE_CLIENTS  // Server will serve an unlimited number of clients, one at a time
 } SERVER_LIFESPAN;
 
+// Identifies the sources registered with the event loop while a client is served
+typedef enum {
+    SERVER_SOCK_TAG,
+    CONTROL_SOCK_TAG,
+    MANAGEMENT_SOCK_TAG,
+    MANAGEMENT_RSP_SOCK_TAG,
+    H2T_SOCK_TAG,
+    T2H_SOCK_TAG,
+    NUM_SOCK_TAGS,
+    HW_WAKEUP_TAG = NUM_SOCK_TAGS, // Not a socket, see SERVER_HW_CALLBACKS.get_wakeup_fd
+    ENGINE_WAKEUP_TAG,             // Not a socket, the other thread made progress in threaded mode
+    LOCAL_SERVER_SOCK_TAG,         // Only registered with a local listener, see SERVER_CONN.local_fd
+    SHM_WAKEUP_TAG,                // Not a socket, the client rang, see SERVER_CONN.shm
+    DRAINING_SOCK_TAG,             // Plus the index of the slot, see SERVER_CONN.draining_conns
+    NUM_EVENT_TAGS = DRAINING_SOCK_TAG + MAX_DRAINING_CONNS
+} SERVER_SOCK_TAGS;
+
 // Structure Definitions
 typedef struct {
     char *ctrl_rx_buff;
@@ -80,59 +128,157 @@ typedef struct {
 } SERVER_BUFFERS;
 
 typedef struct {
-    // Optional driver initialization, invoked by the server for each new client connection.
+    // The hardware instance served, handed to every callback below.  Each server serves its own instance.
+    intel_stream_debug_if_driver_context *context;
+
+    // Optional driver initialization, invoked by the server for each new client connection unless resume_driver is.
     // This is the first callback to be invoked by the server. A return value of < 0 indicates an error condition.
     int (*init_driver)(intel_stream_debug_if_driver_context *context, FPGA_MMIO_INTERFACE_HANDLE mmio_handle);
 
+    // Optional, invoked instead of init_driver when the previous client left the hardware in a state the next one
+    // may take over, see SERVER_CONN.warm_reconnect.  A non-zero return value has init_driver invoked after all.
+    int (*resume_driver)(intel_stream_debug_if_driver_context *context);
+
     // Will return NULL if a buffer of size 'sz' is unavailable
-    uint32_t (*get_h2t_buffer)(size_t sz);
+    uint32_t (*get_h2t_buffer)(intel_stream_debug_if_driver_context *context, size_t sz);
 
     // A return value of < 0 indicates an error condition
-    int (*h2t_data_received)(H2T_PACKET_HEADER *header, uint32_t payload);
+    int (*h2t_data_received)(intel_stream_debug_if_driver_context *context, H2T_PACKET_HEADER *header, uint32_t payload);
 
     // Will return NULL if a buffer of size 'sz' is unavailable
-    uint32_t (*get_mgmt_buffer)(size_t sz);
+    uint32_t (*get_mgmt_buffer)(intel_stream_debug_if_driver_context *context, size_t sz);
 
     // A return value of < 0 indicates an error condition
-    int (*mgmt_data_received)(MGMT_PACKET_HEADER *header, uint32_t payload);
+    int (*mgmt_data_received)(intel_stream_debug_if_driver_context *context, MGMT_PACKET_HEADER *header, uint32_t payload);
 
     // 'payload' & 'header' are outputs to be filled -- a header->DATA_LEN_BYTES equal to 0 implies no data.
     // A return value of < 0 indicates an error condition
-    int (*acquire_t2h_data)(H2T_PACKET_HEADER *header, uint32_t *payload);
+    int (*acquire_t2h_data)(intel_stream_debug_if_driver_context *context, H2T_PACKET_HEADER *header, uint32_t *payload);
 
     // Used to indicate the most recently acquired T2H data has been fully processed and is ready to have
     // any associated resources (e.g. payload / header memory) freed
-    void(*t2h_data_complete)();
+    void(*t2h_data_complete)(intel_stream_debug_if_driver_context *context);
 
     // 'payload' & 'header' are outputs to be filled -- a header->DATA_LEN_BYTES equal to 0 implies no data.
     // A return value of < 0 indicates an error condition
-    int (*acquire_mgmt_rsp_data)(MGMT_PACKET_HEADER *header, uint32_t *payload);
+    int (*acquire_mgmt_rsp_data)(intel_stream_debug_if_driver_context *context, MGMT_PACKET_HEADER *header, uint32_t *payload);
 
     // Used to indicate the most recently acquired MGMT RSP data has been fully processed and is ready to have
     // any associated resources (e.g. payload / header memory) freed
-    void(*mgmt_rsp_data_complete)();
+    void(*mgmt_rsp_data_complete)(intel_stream_debug_if_driver_context *context);
+
+    // Optional callback for drivers which acknowledge completed T2H / MGMT RSP data in batches.  Invoked at the
+    // end of every pass over the hardware, any completion still held back must be handed to the hardware here.
+    // Returns the number of hardware writes saved by batching since the previous call.
+    size_t (*flush_data_complete)(intel_stream_debug_if_driver_context *context);
 
     // Optional callback, if left NULL it implies no MGMT support.
     // Used to declare whether or not the driver has support for MGMT + MGMT RSP channels.
     // A return value of '1' indicates MGMT support, anything else indicates no MGMT support.
-    int (*has_mgmt_support)();
+    int (*has_mgmt_support)(intel_stream_debug_if_driver_context *context);
 
     // Optional callback to set a driver parameter.  A return value of < 0 indicates an error condition.
-    int (*set_param)(const char *param, const char *val);
+    int (*set_param)(intel_stream_debug_if_driver_context *context, const char *param, const char *val);
 
     // Optional callback to get a driver parameter.  Returns NULL if param is undefined.
-    char *(*get_param)(const char *param);
+    char *(*get_param)(intel_stream_debug_if_driver_context *context, const char *param);
+
+    // Optional callback, if left NULL (or if it returns < 0) the server polls the hardware for outbound data.
+    // Returns a descriptor which becomes readable once the hardware raised an interrupt, i.e. T2H / MGMT RSP
+    // data became available or H2T / MGMT descriptor slots were freed.  Queried after init_driver.
+    int (*get_wakeup_fd)(intel_stream_debug_if_driver_context *context);
+
+    // Consumes the pending wakeups, invoked before the hardware is serviced following a wakeup
+    void (*ack_wakeup)(intel_stream_debug_if_driver_context *context);
 
 } SERVER_HW_CALLBACKS;
 
+// Where the hardware polling stands, from the last activity on
+typedef enum {
+    IDLE_POLL_SPIN,     // Waits return right away
+    IDLE_POLL_SLEEP,    // Short sleeps between passes, sockets are only looked at in between
+    IDLE_POLL_WAIT,     // Waits block, with growing timeouts, until a socket is ready
+    NUM_IDLE_POLL_STATES
+} IDLE_POLL_STATE;
+
+// Adaptive polling of a hardware without wakeup: spin for 'spin_us' after any activity (socket events,
+// packets in either direction), then sleep for a little longer each pass until 'sleep_us' has gone by, and
+// finally block in the event loop for a little longer each pass.  Activity goes back to spinning.
+typedef struct {
+    unsigned long spin_us;
+    unsigned long sleep_us;
+    unsigned long max_wait_ms;
+
+    IDLE_POLL_STATE state;
+    char active;                    // Set by idle_poll_activity(), picked up by the next idle_poll_timeout()
+    char polling;                   // Cleared by idle_poll_pause(), time in between is not accounted
+    unsigned long backoff;          // Current sleep in us, or wait in ms
+    struct timespec last_activity;
+    struct timespec last_pass;
+    unsigned long long time_ns[NUM_IDLE_POLL_STATES]; // Since the client connected
+} IDLE_POLL;
+
 typedef struct {
     size_t h2t_cnt;
     size_t t2h_cnt;
     size_t mgmt_cnt;
     size_t mgmt_rsp_cnt;
+    size_t hw_writes_saved; // See SERVER_HW_CALLBACKS.flush_data_complete
+    struct timespec connect_time;
+    unsigned long long setup_us; // From accepting the CONTROL socket to the final READY
+    unsigned char warm_start; // The hardware was taken over from the previous client, see SERVER_CONN.warm_reconnect
 } SERVER_PKT_STATS;
 
 typedef struct {
+    SOCKET ctrl_fd;
+    SOCKET mgmt_fd;
+    SOCKET mgmt_rsp_fd;
+    SOCKET h2t_data_fd;
+    SOCKET t2h_data_fd;
+    char is_local; // Connected through SERVER_CONN.local_fd, none of the TCP options apply
+    char is_mux;   // Every stream travels as frames over 'ctrl_fd', the other sockets are unused, see MUX_SOCK_NAME
+    char draining; // Sent DISCONNECT_CMD, see DRAINING_CONN
+} CLIENT_CONN;
+
+// The sockets of a client that sent DISCONNECT_CMD.  The client is left to close first, so that resetting the
+// connections cannot discard the response before it was read, but nothing waits for it: they are closed once the
+// client's FIN comes in, or DISCONNECT_DRAIN_TIMEOUT_MS after the response, while the next sessions are set up
+// and served.  Frames a multiplexed client had not taken in yet are sent meanwhile, without blocking.
+// A slot is free unless its 'conn.draining' is set.
+typedef struct {
+    CLIENT_CONN conn;
+    struct timespec since;
+    OUTPUT_QUEUE tx_queue; // The SERVER_CONN.mux_tx_queue of the session, the slot's own buffer went to the next one
+} DRAINING_CONN;
+
+// A connection accepted by connect_client() that is not part of a session yet.  The first one that has not sent
+// anything is welcomed as the CONTROL socket of the next session, the others name the session they belong to with
+// the HANDLE= token of their ack, in whatever order they come in.  Connections left over by a session that failed
+// to set up are kept for the next call, those left over once a session is set up are rejected.
+typedef enum {
+    PENDING_CONN_FREE,      // Unused slot
+    PENDING_CONN_UNKNOWN,
+    PENDING_CONN_WELCOMED   // Candidate CONTROL socket, waiting for its ack
+} PENDING_CONN_STATE;
+
+typedef struct {
+    SOCKET fd;
+    char is_local;
+    PENDING_CONN_STATE state;
+    struct timespec accepted;
+    size_t rx_len;
+    char rx_buff[MAX_HANDSHAKE_MSG];
+} PENDING_CONN;
+
+// Address that connected while a client was served, and how often it did since 'window_start'.  Local clients all
+// share address 0.  The least recently seen address makes room for a new one.
+typedef struct {
+    uint32_t addr; // IPv4, network byte order
+    struct timespec window_start;
+    size_t count;
+} REJECT_OFFENDER;
+
+typedef struct SERVER_CONN {
     // Buffers
     SERVER_BUFFERS *buff;
     char h2t_waiting;
@@ -142,24 +288,92 @@ typedef struct {
     SERVER_HW_CALLBACKS hw_callbacks;
     char loopback_mode; // 1 enabled, 0 disabled (default)
 
+    // H2T data received but not yet pushed to the hardware, including the start of the next packet
+    INPUT_QUEUE h2t_rx_queue;
+
     // Connection info
     SOCKET server_fd;
     struct sockaddr_in server_addr;
     char t2h_nagle;
     char mgmt_rsp_nagle;
 
+    // Opt-in, Linux only: AF_UNIX listener next to the TCP one, for clients on the same host.  A client is served
+    // on the listener its CONTROL socket came in on.  A leading '@' names a socket in the abstract namespace,
+    // anything else is a path, the socket file is created by initialize_server() and removed again on exit.
+    const char *local_path;
+    SOCKET local_fd;
+
+    // Connections that have not identified themselves within 'handshake_timeout_ms', and sessions that have not
+    // connected all of their sockets within that long after the welcome message, are given up, see PENDING_CONN.
+    unsigned long handshake_timeout_ms;
+    PENDING_CONN pending_conns[MAX_PENDING_CONNS];
+    size_t handshakes_abandoned;
+    DRAINING_CONN draining_conns[MAX_DRAINING_CONNS];
+
+    // Connections coming in while a client is served are refused, by a low priority thread of their own on Linux
+    // unless 'background_reject' is 0, by the thread serving the client otherwise.  Repeat offenders are rate
+    // limited, see REJECT_BURST.
+    char background_reject;
+    struct ACCEPTOR *acceptor; // Only set while a client is served with the acceptor thread running, taken atomically to stop it
+    REJECT_OFFENDER reject_offenders[MAX_REJECT_OFFENDERS];
+    size_t conns_rejected;          // Counted by the acceptor thread, only accessed atomically
+    size_t rejects_rate_limited;    // Same
+
+    // Warm reconnect: a client that follows one that sent DISCONNECT_CMD gets the hardware as that one left it,
+    // through SERVER_HW_CALLBACKS.resume_driver.  Any other end of a session, a FULL_RESET_PARAM request or
+    // 'warm_reconnect' 0 have the next client start from init_driver, i.e. a reset IP.
+    char warm_reconnect;
+    char hw_clean; // No client used the hardware since it was set up, or the last one sent DISCONNECT_CMD between two packets
+    char full_reset_requested;
+
+    // Set by server_terminate(), server_main() serves no further client
+    volatile char stopping;
+
+    // Linux only: H2T / T2H data of a local client goes through shared memory once it sent SHM_ATTACH_CMD, its
+    // H2T / T2H sockets then only tell when it hung up.  CTRL, MGMT and MGMT RSP stay on their sockets.
+    SHM_TRANSPORT shm;
+
+    // Multiplexed clients, see MUX_SOCK_NAME: frames received but not demultiplexed yet, with the stream and the
+    // bytes left of the frame being demultiplexed.  CTRL and MGMT bytes wait in queues of their own until their
+    // message or packet is complete, H2T bytes go to 'h2t_rx_queue'.  Outbound streams are framed into 'mux_tx_queue'.
+    INPUT_QUEUE mux_rx_queue;
+    unsigned char mux_rx_stream;
+    size_t mux_rx_remaining;
+    INPUT_QUEUE ctrl_rx_queue;
+    INPUT_QUEUE mgmt_rx_queue;
+    OUTPUT_QUEUE mux_tx_queue;
+
+    // Outbound data not yet accepted by the non-blocking T2H / MGMT RSP sockets.  Hardware
+    // data is left in the IP while a queue is at its high-water mark.
+    OUTPUT_QUEUE t2h_queue;
+    OUTPUT_QUEUE mgmt_rsp_queue;
+    size_t t2h_batch_size;
+
+    // Event loop
+    EVENT_LOOP_BACKEND event_loop_backend;
+
+    // Opt-in, Linux only: network I/O and hardware access on threads of their own, so that receiving the
+    // next H2T packet overlaps with copying the current one to the IP.  Otherwise a single thread does both.
+    char threaded;
+    struct MMIO_ENGINE *engine; // Only set while a client is served in threaded mode
+
+    // Opt-in run to completion mode for a dedicated core: the event loops never sleep, the hardware is polled on
+    // every pass and the data sockets busy poll the device queue for 'busy_poll_us' microseconds.  0 is off.
+    int busy_poll_us;
+
+    // CPUs the server thread and the MMIO engine thread are pinned to, -1 leaves them to the scheduler.
+    // Pinned threads run SCHED_FIFO at 'sched_fifo_priority', unless it is 0.
+    int cpu;
+    int engine_cpu;
+    int sched_fifo_priority;
+
+    // Hardware polling backoff, used by the thread that owns the hardware
+    IDLE_POLL idle_poll;
+
     // Misc
     SERVER_PKT_STATS pkt_stats;
 } SERVER_CONN;
 
-typedef struct {
-    SOCKET ctrl_fd;
-    SOCKET mgmt_fd;
-    SOCKET mgmt_rsp_fd;
-    SOCKET h2t_data_fd;
-    SOCKET t2h_data_fd;
-} CLIENT_CONN;
-
 extern const SERVER_BUFFERS SERVER_BUFFERS_default;
 extern const SERVER_CONN SERVER_CONN_default;
 extern const SERVER_HW_CALLBACKS SERVER_HW_CALLBACKS_default;
@@ -168,13 +382,20 @@ extern const CLIENT_CONN CLIENT_CONN_default;
 
 // Server code
 RETURN_CODE initialize_server(unsigned short port, SERVER_CONN *server_conn, const char *port_filename);
-int server_main(intel_remote_debug_server_context *context, SERVER_LIFESPAN lifespan, SERVER_CONN *server_conn);
-void server_terminate();
-void reject_client(SERVER_CONN *server_conn);
+int server_main(SERVER_LIFESPAN lifespan, SERVER_CONN *server_conn);
+void server_terminate(SERVER_CONN *server_conn);
+void reject_client(SERVER_CONN *server_conn, SOCKET listen_fd);
 void handle_client(SERVER_CONN *server_conn, CLIENT_CONN *client_conn);
 RETURN_CODE bind_server_socket(SERVER_CONN *server_conn);
-RETURN_CODE connect_client_socket(SERVER_CONN *server_conn, int handle_id, SOCKET *client_fd, const char *sock_name, char use_nagle);
+RETURN_CODE bind_local_server_socket(SERVER_CONN *server_conn);
 RETURN_CODE close_client_conn(CLIENT_CONN *client_conn, SERVER_CONN *server_conn);
+RETURN_CODE pin_current_thread(int cpu, int sched_fifo_priority, const char *thread_name);
+
+// Hardware polling backoff
+void idle_poll_reset(IDLE_POLL *poll);
+void idle_poll_activity(IDLE_POLL *poll);
+void idle_poll_pause(IDLE_POLL *poll);
+int idle_poll_timeout(IDLE_POLL *poll);
 
 // Message handling
 const char *get_parameter(char *cmd, SERVER_CONN *server_conn);
@@ -183,7 +404,9 @@ const char *get_driver_parameter(char *cmd, SERVER_CONN *server_conn);
 const char *set_driver_parameter(char *cmd, SERVER_CONN *server_conn);
 RETURN_CODE process_control_message(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, char *disconnect_client);
 unsigned long buff_len_to_wrap_boundary(uint64_t buff_sa, size_t buff_sz, uint64_t buff, size_t payload_sz);
-RETURN_CODE update_curr_h2t_header(CLIENT_CONN *client_conn, SERVER_CONN *server_conn);
+void copy_h2t_payload(SERVER_CONN *server_conn, uint64_t *payload, uint64_t h2t_buff, size_t payload_sz);
+void copy_t2h_payload(SERVER_CONN *server_conn, uint32_t payload, char *dst, size_t payload_sz);
+char update_curr_h2t_header(SERVER_CONN *server_conn);
 RETURN_CODE process_h2t_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn);
 RETURN_CODE update_curr_mgmt_header(CLIENT_CONN *client_conn, SERVER_CONN *server_conn);
 RETURN_CODE process_mgmt_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn);
@@ -192,7 +415,7 @@ RETURN_CODE process_mgmt_rsp_data(CLIENT_CONN *client_conn, SERVER_CONN *server_
 
 // Misc helper
 void reset_buffers(SERVER_CONN *server_conn);
-void generate_server_welcome_message(char *buff, size_t buff_size, int mgmt_support, SERVER_BUFFERS *serv_buff, int handle);
+void generate_server_welcome_message(char *buff, size_t buff_size, int mgmt_support, int mux_support, SERVER_BUFFERS *serv_buff, int handle);
 void print_last_socket_error(const char *context_msg);
 void print_last_socket_error_b(const char *context_msg, ssize_t bytes_transferred);
 
@@ -0,0 +1,144 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "intel_st_debug_if_common.h"
+#include "intel_st_debug_if_sockets.h"
+#include "intel_st_debug_if_spsc_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHM_TRANSPORT_MAGIC 0x53544d54 // "STMT"
+#define SHM_TRANSPORT_VERSION 1
+
+#define SHM_TRANSPORT_DEFAULT_RING_SZ 0x40000
+#define SHM_TRANSPORT_MAX_RING_SZ 0x4000000
+#define SHM_TRANSPORT_DEFAULT_SPIN_US 20
+
+// Descriptors handed to the client along with SHM_ATTACH_CMD_RSP, in this order
+enum {
+    SHM_TRANSPORT_MEM_FD,
+    SHM_TRANSPORT_SERVER_BELL_FD,   // Rung by the client
+    SHM_TRANSPORT_CLIENT_BELL_FD,   // Rung by the server
+    SHM_TRANSPORT_NUM_FDS
+};
+
+// What a side waits for while its doorbell is armed, so that the other side only rings when it matters
+enum {
+    SHM_TRANSPORT_WAIT_DATA = 1,    // Data in the ring it consumes
+    SHM_TRANSPORT_WAIT_ROOM = 2     // Room in the ring it produces into
+};
+
+// Indices of one ring, as seen by both processes.  They run freely and are masked into the ring, whose size
+// is a power of 2.  32 bits wide, so that 32-bit clients (e.g. on an HPS) share them with a 64-bit server.
+typedef struct {
+    uint32_t head __attribute__((aligned(SPSC_RING_CACHE_LINE_SZ)));  // Next byte to be consumed, published by the consumer
+    uint32_t tail __attribute__((aligned(SPSC_RING_CACHE_LINE_SZ)));  // One past the last byte published by the producer
+} SHM_RING_INDICES;
+
+// Start of the shared memory, followed by the H2T ring and then by the T2H ring, 'ring_sz' bytes each.
+// Both rings carry the packets exactly as the H2T / T2H sockets would, guardband and header included.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_sz;
+    int server_sleeping __attribute__((aligned(SPSC_RING_CACHE_LINE_SZ)));
+    int client_sleeping __attribute__((aligned(SPSC_RING_CACHE_LINE_SZ)));
+    SHM_RING_INDICES h2t;
+    SHM_RING_INDICES t2h;
+} SHM_TRANSPORT_LAYOUT;
+
+// One side of a ring in the shared memory, private to the process.  As for SPSC_RING, the index of the other
+// side is only looked up when the cached copy does not show the data (or the room) wanted.
+typedef struct {
+    SHM_RING_INDICES *indices;
+    char *buff;
+    size_t buff_sz;
+    uint32_t cached_head;   // Producer side
+    uint32_t cached_tail;   // Consumer side
+} SHM_RING;
+
+// H2T / T2H data exchanged with a client on the same host through shared memory rather than through sockets,
+// see SHM_ATTACH_CMD.  Neither side makes a system call for as long as the other one keeps up.  Each side has
+// an eventfd doorbell, rung by the other side only while it is about to sleep, with the same protocol as SPSC_DOORBELL.
+typedef struct {
+    SHM_TRANSPORT_LAYOUT *layout;   // NULL while not attached
+    size_t map_sz;
+    int mem_fd;                     // Server side only, kept for as long as the client may need it
+    SHM_RING h2t;                   // Client -> server
+    SHM_RING t2h;                   // Server -> client
+    int *own_sleeping;
+    int *peer_sleeping;
+    int own_bell_fd;                // Becomes readable once the other side rang
+    int peer_bell_fd;
+    unsigned long spin_us;          // Client side, how long shm_transport_send_all() / recv_all() spin before sleeping
+} SHM_TRANSPORT;
+
+extern const SHM_TRANSPORT SHM_TRANSPORT_default;
+
+// Server side, 'fds' receives the descriptors to hand to the client, which remain owned by the transport.
+// 'ring_sz' is rounded up to a power of 2.
+RETURN_CODE shm_transport_create(SHM_TRANSPORT *shm, size_t ring_sz, int *fds);
+// Client side, from the descriptors received with SHM_ATTACH_CMD_RSP, which the transport takes over
+RETURN_CODE shm_transport_attach(SHM_TRANSPORT *shm, const int *fds);
+void shm_transport_close(SHM_TRANSPORT *shm);
+
+// Producer side, returns the number of bytes written and published
+size_t shm_ring_room(SHM_RING *ring, size_t wanted);
+size_t shm_ring_write(SHM_RING *ring, const void *src, size_t len);
+
+// Consumer side, returns the number of bytes read and consumed
+size_t shm_ring_readable(SHM_RING *ring, size_t wanted);
+size_t shm_ring_read(SHM_RING *ring, void *dst, size_t max_len);
+
+// Either side rings the other once it published data (SHM_TRANSPORT_WAIT_DATA) or consumed some (SHM_TRANSPORT_WAIT_ROOM).
+// The side about to sleep arms its doorbell with what it waits for, checks its rings once more and only then waits
+// for its descriptor.  Disarming consumes pending rings and tells whether there was one.
+void shm_transport_ring_peer(SHM_TRANSPORT *shm, int event);
+void shm_transport_arm(SHM_TRANSPORT *shm, int wait_for);
+char shm_transport_disarm(SHM_TRANSPORT *shm);
+// Consumes a ring that came in while disarming, once the descriptor was found readable anyway
+void shm_transport_ack(SHM_TRANSPORT *shm);
+
+// SHM_ATTACH_CMD_RSP with the descriptors attached, over an AF_UNIX socket.  The receiving side gets the
+// NUL terminated message in 'buff' and 'num_fds' descriptors in 'fds', or -1 if none came along.
+RETURN_CODE shm_transport_send_fds(SOCKET sock_fd, const char *msg, size_t msg_len, const int *fds, int num_fds);
+RETURN_CODE shm_transport_recv_fds(SOCKET sock_fd, char *buff, size_t buff_sz, int *fds, int num_fds);
+
+// Reference client: blocking H2T sends and T2H receives, spinning for 'spin_us' before sleeping.
+// A FAILURE is returned once 'hangup_fd' (typically the T2H socket) reports the server gone.
+RETURN_CODE shm_transport_send_all(SHM_TRANSPORT *shm, const void *src, size_t len, SOCKET hangup_fd);
+RETURN_CODE shm_transport_recv_all(SHM_TRANSPORT *shm, void *dst, size_t len, SOCKET hangup_fd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -53,6 +53,7 @@
         #include <netinet/tcp.h>
         #include <arpa/inet.h>
         #include <poll.h>
+        #include <sys/ioctl.h> // FIONREAD
     #endif
     #include <fcntl.h>
     #include <unistd.h> // close
@@ -79,21 +80,22 @@ SOCKET max_of(SOCKET *array, int size);
 #define FALSE 0
 
 RETURN_CODE socket_send_all(SOCKET fd, const char * buff, const size_t len, int flags, ssize_t *bytes_sent);
-RETURN_CODE socket_send_all_t2h_data(SOCKET fd, uint64_t buff, const size_t len, int flags, ssize_t *bytes_sent);
 RETURN_CODE socket_recv_until_null_reached(SOCKET sock_fd, char *buff, const size_t max_len, int flags, ssize_t *bytes_recvd);
 RETURN_CODE socket_recv_accumulate(SOCKET sock_fd, char *buff, const size_t len, int flags, ssize_t *bytes_recvd);
-RETURN_CODE socket_recv_accumulate_h2t_data(SOCKET sock_fd, uint64_t buff, const size_t len, int flags, ssize_t *bytes_recvd);
 RETURN_CODE initialize_sockets_library();
 int set_boolean_socket_option(SOCKET socket_fd, int option, int option_val);
 int set_tcp_no_delay(SOCKET socket_fd, int no_delay);
 int set_linger_socket_option(SOCKET socket_fd, int l_onoff, int l_linger);
+int set_non_blocking_socket(SOCKET socket_fd, int non_blocking);
+int set_recv_low_water_mark(SOCKET socket_fd, int bytes);
+int set_busy_poll_socket_option(SOCKET socket_fd, int usecs);
+int get_socket_bytes_readable(SOCKET socket_fd);
 char is_last_socket_error_would_block();
+char is_last_socket_error_peer_gone();
 int close_socket_fd(SOCKET socket_fd);
 void wait_for_read_event(SOCKET socket_fd, long seconds, long useconds);
 int get_last_socket_error();
 const char *get_last_socket_error_msg(char *buff, size_t buff_sz);
-RETURN_CODE alloc_tcpip_recv_send_buffer(size_t sz);
-void free_tcpip_recv_send_buffer();
 
 #ifdef __cplusplus    
 }
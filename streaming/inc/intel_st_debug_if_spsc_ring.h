@@ -0,0 +1,107 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+
+#include "intel_st_debug_if_common.h"
+#include "intel_st_debug_if_sockets.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Producers may write, and consumers read, up to this many bytes past their data, see memcpy64_fpga2host()
+// and memcpy64_host2fpga()
+#define SPSC_RING_SLACK 8
+
+#define SPSC_RING_CACHE_LINE_SZ 64
+
+// A byte stream handed from exactly one producer thread to exactly one consumer thread, without locks.
+// Each side owns an index and keeps a copy of the other side's, on cache lines of their own, so that an
+// index only moves between cores when the cached copy no longer tells whether there is data (or room).
+// Indices run freely and are masked into the buffer, whose size is a power of 2.  What the producer
+// writes is only seen by the consumer once published.
+typedef struct {
+    char *buff;             // 'buff_sz' bytes followed by SPSC_RING_SLACK bytes of slack
+    size_t buff_sz;
+
+    // Consumer side
+    size_t head __attribute__((aligned(SPSC_RING_CACHE_LINE_SZ)));  // Next byte to be consumed, published
+    size_t cached_tail;
+
+    // Producer side
+    size_t tail __attribute__((aligned(SPSC_RING_CACHE_LINE_SZ)));  // One past the last published byte
+    size_t cached_head;
+    size_t pending_tail;    // One past the last written byte, not published yet
+} SPSC_RING;
+
+// Lets the thread owning it sleep in an event loop until the other side of its rings made progress.
+// Ringing only costs a system call while the owner is actually about to sleep.
+typedef struct {
+    int fd;                 // Becomes readable once rung, registered with the owner's event loop
+    int sleeping;
+} SPSC_DOORBELL;
+
+// Neither side may run while the ring is allocated, freed, reset or resized
+RETURN_CODE spsc_ring_alloc(SPSC_RING *ring, size_t min_sz);
+void spsc_ring_free(SPSC_RING *ring);
+void spsc_ring_reset(SPSC_RING *ring);
+RETURN_CODE spsc_ring_resize(SPSC_RING *ring, size_t min_sz); // Never shrinks, the queued bytes must all be published
+
+// Producer side
+// The other side's index is only looked up when the cached copy does not show 'wanted' bytes of room
+size_t spsc_ring_room(SPSC_RING *ring, size_t wanted);
+char spsc_ring_is_full(SPSC_RING *ring, size_t high_water_mark); // Written and not consumed yet, at or above the mark
+char *spsc_ring_write_ptr(SPSC_RING *ring, size_t *contiguous); // Room up to the end of the buffer
+void spsc_ring_advance(SPSC_RING *ring, size_t len);
+void spsc_ring_write(SPSC_RING *ring, const void *data, size_t len); // The caller checked the room
+void spsc_ring_publish(SPSC_RING *ring);
+
+// Consumer side
+size_t spsc_ring_readable(SPSC_RING *ring, size_t wanted); // Same as spsc_ring_room() for published data
+const char *spsc_ring_read_ptr(SPSC_RING *ring, size_t offset, size_t *contiguous); // Data up to the end of the buffer
+void spsc_ring_peek(SPSC_RING *ring, size_t offset, void *dst, size_t len); // The caller checked what is readable
+void spsc_ring_consume(SPSC_RING *ring, size_t len);
+
+// recv() / send() of whatever the socket and the ring allow without blocking.  Only socket errors other than
+// "would block", and the peer closing the connection, are reported as a FAILURE.  Filling publishes the data.
+RETURN_CODE spsc_ring_fill(SPSC_RING *ring, SOCKET fd, int flags, ssize_t *bytes_recvd, size_t *recv_calls);
+RETURN_CODE spsc_ring_flush(SPSC_RING *ring, SOCKET fd, int flags, ssize_t *bytes_sent, size_t *send_calls);
+
+RETURN_CODE spsc_doorbell_init(SPSC_DOORBELL *bell);
+void spsc_doorbell_close(SPSC_DOORBELL *bell);
+void spsc_doorbell_ring(SPSC_DOORBELL *bell);
+
+// The owner arms the doorbell, then checks its rings once more and sleeps only if they had nothing.  Anything
+// the other side publishes after that check rings the doorbell.  Disarming consumes pending rings.
+void spsc_doorbell_arm(SPSC_DOORBELL *bell);
+void spsc_doorbell_disarm(SPSC_DOORBELL *bell);
+
+#ifdef __cplusplus
+}
+#endif
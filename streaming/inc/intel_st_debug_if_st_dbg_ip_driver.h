@@ -30,6 +30,8 @@
 #include "intel_st_debug_if_packet.h"
 #include "intel_st_debug_if_platform.h"
 #include "intel_fpga_platform.h"
+#include "intel_fpga_api.h"
+#include "intel_st_debug_if_st_dbg_ip_allocator.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -63,12 +65,11 @@ JOP_MEM_SIZE_2K is used to match SW H2T/T2H memory base address with HW tcl defi
 #define H2T_MEM_BASE_2K 0x800
 //T2H_MEM_BASE_4K wiil be used if h2t-t2h-mem-size <= JOP_MEM_SIZE_2K
 #define T2H_MEM_BASE_4K 0x1000
+//Descriptor depths of the T2H / MGMT RSP queues, these bound how many completions may be acknowledged at once
+#define T2H_DESC_DEPTH_DEFAULT 128
+#define MGMT_RSP_DESC_DEPTH_DEFAULT 128
 
 
-typedef struct {
-  FPGA_MMIO_INTERFACE_HANDLE  mmio_handle ;
-}  intel_stream_debug_if_driver_context;
-
 typedef struct {
     uint32_t ST_DBG_IP_CSR_BASE_ADDR;
 
@@ -77,20 +78,80 @@ typedef struct {
 
     uint32_t T2H_MEM_BASE_ADDR;
     size_t T2H_MEM_SZ;
+    unsigned short T2H_DESC_DEPTH;
 
     uint32_t MGMT_MEM_BASE_ADDR;
     size_t MGMT_MEM_SZ;
 
     uint32_t MGMT_RSP_MEM_BASE_ADDR;
     size_t MGMT_RSP_MEM_SZ;
+    unsigned short MGMT_RSP_DESC_DEPTH;
 } ST_DBG_IP_DESIGN_INFO;
 
-extern ST_DBG_IP_DESIGN_INFO g_std_dbg_ip_info;
+// CSR accesses made by the driver since start up, counted in bus transactions: a 64-bit access counts
+// twice when 64-bit MMIO is emulated.  Payload copies are not included.
+typedef struct {
+    size_t reads;
+    size_t writes;
+    size_t writes_saved; // DESCRIPTORS_DONE writes avoided by acknowledging several descriptors at once
+} ST_DBG_IP_MMIO_STATS;
 
 // The ST Debug IP allows these to be queried dynamically, but since we are not using malloc,
 // I will reserve enough space for the upperlimit of how many descriptors the IP supports.
 #define MAX_H2T_DESCRIPTOR_DEPTH 128
 #define MAX_MGMT_DESCRIPTOR_DEPTH 128
+#define MAX_DESCRIPTOR_DEPTH ((MAX_H2T_DESCRIPTOR_DEPTH > MAX_MGMT_DESCRIPTOR_DEPTH) ? MAX_H2T_DESCRIPTOR_DEPTH : MAX_MGMT_DESCRIPTOR_DEPTH)
+
+// Descriptor tracking.  The AVAILABLE_SLOTS CSR is only read once the locally known credits, slots
+// or buffer space, cannot satisfy a request.  'chain_end' holds the running total of bytes allocated
+// after each descriptor, so any number of descriptors handed back by the IP is freed in one step.
+typedef struct {
+    uint32_t available_slots_csr;
+    unsigned short depth;
+    unsigned short slots_total; // AVAILABLE_SLOTS with every descriptor returned, as read by init_driver()
+    unsigned short slots_available;
+    unsigned short write_idx;
+    unsigned short read_idx;
+    size_t bytes_allocated;
+    size_t bytes_freed;
+    size_t chain_end[MAX_DESCRIPTOR_DEPTH];
+    CIRCLE_BUFF cbuff;
+} ST_DBG_IP_DESCRIPTOR_CREDITS;
+
+// Everything the driver knows about one ST Debug IP instance.  Every driver function takes the context
+// of the instance it works on, so a process may serve several IPs, each from its own thread.
+// Prepare it with init_driver_context(), only 'mmio_handle' and 'interrupt_handle' are for the caller to set.
+typedef struct {
+  FPGA_MMIO_INTERFACE_HANDLE  mmio_handle ;
+  FPGA_INTERRUPT_HANDLE  interrupt_handle ; // FPGA_INTERRUPT_INVALID_HANDLE keeps the driver in polling mode
+
+  ST_DBG_IP_DESIGN_INFO design_info;
+  char design_info_set;
+  char in_sync; // The IP is in the state the context below describes, set by init_driver(), see resume_driver()
+  FPGA_MMIO_INTERFACE mmio; // Resolved once per init_driver(), so that no MMIO access looks the handle up again
+  ST_DBG_IP_MMIO_STATS mmio_stats;
+
+  ST_DBG_IP_DESCRIPTOR_CREDITS h2t_credits;
+  ST_DBG_IP_DESCRIPTOR_CREDITS mgmt_credits;
+
+  // Completion tracking.  Up to 'done_batch' consumed descriptors are acknowledged with a single
+  // DESCRIPTORS_DONE write, the server flushes whatever is left at the end of each pass over the IP.
+  unsigned int done_batch;
+  unsigned int t2h_done_pending;
+  unsigned int mgmt_rsp_done_pending;
+
+  // SOP tracking
+  unsigned char t2h_sop;
+  unsigned char mgmt_rsp_sop;
+  unsigned char h2t_sop; // The next descriptor pushed starts a packet
+  unsigned char mgmt_sop;
+
+  // Interrupt tracking
+  FPGA_INTERRUPT_HANDLE irq_enabled_handle; // 'interrupt_handle' once its wakeups are routed to 'irq_wakeup_fd'
+  int irq_wakeup_fd;
+
+  char param_buff[16]; // Backs the values returned by get_driver_param()
+}  intel_stream_debug_if_driver_context;
 
 // This is used to keep addresses passed to the H2T / MGMT CSR aligned to the native word size
 // of the ST Debug IP's DMA masters.
@@ -129,6 +190,7 @@ extern ST_DBG_IP_DESIGN_INFO g_std_dbg_ip_info;
 #define ST_DBG_IP_T2H_WHERE 0x20C
 #define ST_DBG_IP_T2H_CONNECTION_ID 0x210
 #define ST_DBG_IP_T2H_CHANNEL_ID_ADVANCE 0x214
+// Written with the number of descriptors consumed since the last write, not just 1, see DONE_BATCH_PARAM
 #define ST_DBG_IP_T2H_DESCRIPTORS_DONE 0x218
 
 // MGMT CSR
@@ -141,6 +203,7 @@ extern ST_DBG_IP_DESIGN_INFO g_std_dbg_ip_info;
 #define ST_DBG_IP_MGMT_RSP_HOW_LONG 0x1208
 #define ST_DBG_IP_MGMT_RSP_WHERE 0x120C
 #define ST_DBG_IP_MGMT_RSP_CHANNEL_ID_ADVANCE 0x1214
+// Takes a count, as ST_DBG_IP_T2H_DESCRIPTORS_DONE
 #define ST_DBG_IP_MGMT_RSP_DESCRIPTORS_DONE 0x1218
 
 // Common masks
@@ -148,40 +211,53 @@ extern ST_DBG_IP_DESIGN_INFO g_std_dbg_ip_info;
 #define ST_DBG_IP_HOW_LONG_MASK 0x7FFFFFFF
 
 // Driver init
+void init_driver_context(intel_stream_debug_if_driver_context *context);
 int init_driver(intel_stream_debug_if_driver_context *context, FPGA_MMIO_INTERFACE_HANDLE mmio_handle);
-void set_design_info(ST_DBG_IP_DESIGN_INFO info);
+int resume_driver(intel_stream_debug_if_driver_context *context); // Non-zero if init_driver() is needed instead
+void set_design_info(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESIGN_INFO info);
 
 // H2T
-uint32_t get_h2t_buffer(size_t sz);
-int push_h2t_data(H2T_PACKET_HEADER *header, uint32_t payload);
+uint32_t get_h2t_buffer(intel_stream_debug_if_driver_context *context, size_t sz);
+int push_h2t_data(intel_stream_debug_if_driver_context *context, H2T_PACKET_HEADER *header, uint32_t payload);
 
 // MGMT
-uint32_t get_mgmt_buffer(size_t sz);
-int push_mgmt_data(MGMT_PACKET_HEADER *header, uint32_t payload);
+uint32_t get_mgmt_buffer(intel_stream_debug_if_driver_context *context, size_t sz);
+int push_mgmt_data(intel_stream_debug_if_driver_context *context, MGMT_PACKET_HEADER *header, uint32_t payload);
 
 // T2H
-int get_t2h_data(H2T_PACKET_HEADER *header, uint32_t *payload);
-void t2h_data_complete();
+int get_t2h_data(intel_stream_debug_if_driver_context *context, H2T_PACKET_HEADER *header, uint32_t *payload);
+void t2h_data_complete(intel_stream_debug_if_driver_context *context);
 
 // MGMT RSP
-int get_mgmt_rsp_data(MGMT_PACKET_HEADER *header, uint32_t *payload);
-void mgmt_rsp_data_complete();
+int get_mgmt_rsp_data(intel_stream_debug_if_driver_context *context, MGMT_PACKET_HEADER *header, uint32_t *payload);
+void mgmt_rsp_data_complete(intel_stream_debug_if_driver_context *context);
+
+// Acknowledges the T2H / MGMT RSP descriptors held back by DONE_BATCH_PARAM, returns the writes saved
+size_t flush_data_complete(intel_stream_debug_if_driver_context *context);
 
 // Config CSR
-void set_loopback_mode(int val);
-int get_loopback_mode();
-void enable_interrupts(int val);
-int get_mgmt_support();
-int check_version_and_type(); // A non-zero return value indicates the IP is incompatible
-void assert_h2t_t2h_reset();
+void set_loopback_mode(intel_stream_debug_if_driver_context *context, int val);
+int get_loopback_mode(intel_stream_debug_if_driver_context *context);
+void enable_interrupts(intel_stream_debug_if_driver_context *context, int val);
+int get_mgmt_support(intel_stream_debug_if_driver_context *context);
+int check_version_and_type(intel_stream_debug_if_driver_context *context); // A non-zero return value indicates the IP is incompatible
+void assert_h2t_t2h_reset(intel_stream_debug_if_driver_context *context);
+
+// Interrupt wakeups
+int get_irq_wakeup_fd(intel_stream_debug_if_driver_context *context); // < 0 when the driver is not interrupt driven
+void ack_irq_wakeup(intel_stream_debug_if_driver_context *context);
+void disable_irq_wakeup(intel_stream_debug_if_driver_context *context);
 
 // buffer data exchange
-void memcpy64_fpga2host(int32_t fpga_buff, uint64_t *host_buff, size_t len);
-void memcpy64_host2fpga(uint64_t *host_buff, int32_t fpga_buff, size_t len);
+void memcpy64_fpga2host(intel_stream_debug_if_driver_context *context, int32_t fpga_buff, uint64_t *host_buff, size_t len);
+void memcpy64_host2fpga(intel_stream_debug_if_driver_context *context, uint64_t *host_buff, int32_t fpga_buff, size_t len);
+
+// Stats
+void get_mmio_stats(intel_stream_debug_if_driver_context *context, ST_DBG_IP_MMIO_STATS *stats);
 
 // Misc settings
-int set_driver_param(const char *param, const char *val);
-char *get_driver_param(const char *param);
+int set_driver_param(intel_stream_debug_if_driver_context *context, const char *param, const char *val);
+char *get_driver_param(intel_stream_debug_if_driver_context *context, const char *param);
 
 #ifdef __cplusplus    
 }
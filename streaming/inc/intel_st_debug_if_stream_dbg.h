@@ -28,21 +28,36 @@
 
 #include <stddef.h>
 #include "intel_st_debug_if_st_dbg_ip_driver.h"
+#include "intel_st_debug_if_event_loop.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+struct SERVER_CONN;
+
+// One per ST Debug IP instance served, several servers may run side by side on their own threads
 typedef struct {
   intel_stream_debug_if_driver_context driver_cxt ;
   size_t h2t_t2h_mem_size ;
   int port ;
+  unsigned int instance ; // Tells the port files of servers running side by side apart, 0 by default
+  EVENT_LOOP_BACKEND event_loop_backend ;
+  char threaded ; // Network I/O and hardware access on threads of their own, see SERVER_CONN.threaded
+  int busy_poll_us ; // Run to completion on a dedicated core, see SERVER_CONN.busy_poll_us
+  int cpu ; // -1 unless the server thread is pinned, see SERVER_CONN.cpu
+  int engine_cpu ;
+  int sched_fifo_priority ;
+  const char *local_path ; // AF_UNIX listener next to the TCP one, NULL for none, see SERVER_CONN.local_path
+  unsigned long handshake_timeout_ms ; // See SERVER_CONN.handshake_timeout_ms
+  char warm_reconnect ; // See SERVER_CONN.warm_reconnect, 1 by default
+  struct SERVER_CONN *server_conn ; // Only set while start_st_dbg_transport_server_over_tcpip() runs
 } intel_remote_debug_server_context;
 
 int start_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *context);
 void init_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *context, FPGA_MMIO_INTERFACE_HANDLE mmio_handle, size_t size, int port);
-void terminate_st_dbg_transport_server_over_tcpip();
+void terminate_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *context);
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,7 @@ const char *MANAGEMENT_SOCK_NAME = "Management";
 const char *MANAGEMENT_RSP_SOCK_NAME = "Management Response";
 const char *H2T_SOCK_NAME = "H2T";
 const char *T2H_SOCK_NAME = "T2H";
+const char *MUX_SOCK_NAME = "Multiplexed";
 
 /**
     Note: all string lengths include the NULL terminator.
@@ -63,6 +64,8 @@ const char *SET_DRIVER_PARAM_CMD = "SET_DRIVER_PARAM";
 const size_t SET_DRIVER_PARAM_CMD_LEN = 17;
 const char *GET_DRIVER_PARAM_CMD = "GET_DRIVER_PARAM";
 const size_t GET_DRIVER_PARAM_CMD_LEN = 17;
+const char *SHM_ATTACH_CMD = "SHM_ATTACH";
+const size_t SHM_ATTACH_CMD_LEN = 11;
 
 // Control command responses
 const char *UNRECOGNIZED_CMD_RSP = "UNRECOGNIZED_COMMAND";
@@ -77,6 +80,10 @@ const char *GET_PARAM_CMD_FAIL_RSP = "GET_PARAM_FAILURE";
 const size_t GET_PARAM_CMD_FAIL_RSP_LEN = 18;
 const char *DISCONNECT_CMD_RSP = "DISCONNECT_ACK";
 const size_t DISCONNECT_CMD_RSP_LEN = 15;
+const char *SHM_ATTACH_CMD_RSP = "SHM_ATTACH_ACK";
+const size_t SHM_ATTACH_CMD_RSP_LEN = 15;
+const char *SHM_ATTACH_CMD_FAIL_RSP = "SHM_ATTACH_FAIL_ACK";
+const size_t SHM_ATTACH_CMD_FAIL_RSP_LEN = 20;
 
 // Server control params
 const size_t MAX_SERVER_PARAM_VALUE_LEN = 256;
@@ -92,5 +99,35 @@ const char *T2H_NAGLE_PARAM = "T2H_NAGLE";
 const size_t T2H_NAGLE_PARAM_LEN = 10;
 const char *MGMT_RSP_NAGLE_PARAM = "MGMT_RSP_NAGLE";
 const size_t MGMT_RSP_NAGLE_PARAM_LEN = 15;
+const char *T2H_HIGH_WATER_MARK_PARAM = "T2H_HIGH_WATER_MARK";
+const size_t T2H_HIGH_WATER_MARK_PARAM_LEN = 20;
+const char *MGMT_RSP_HIGH_WATER_MARK_PARAM = "MGMT_RSP_HIGH_WATER_MARK";
+const size_t MGMT_RSP_HIGH_WATER_MARK_PARAM_LEN = 25;
+const char *T2H_BATCH_SIZE_PARAM = "T2H_BATCH_SIZE";
+const size_t T2H_BATCH_SIZE_PARAM_LEN = 15;
+const char *POLL_SPIN_US_PARAM = "POLL_SPIN_US";
+const size_t POLL_SPIN_US_PARAM_LEN = 13;
+const char *POLL_SLEEP_US_PARAM = "POLL_SLEEP_US";
+const size_t POLL_SLEEP_US_PARAM_LEN = 14;
+const char *POLL_MAX_WAIT_MS_PARAM = "POLL_MAX_WAIT_MS";
+const size_t POLL_MAX_WAIT_MS_PARAM_LEN = 17;
+const char *POLL_STATE_TIME_US_PARAM = "POLL_STATE_TIME_US";
+const size_t POLL_STATE_TIME_US_PARAM_LEN = 19;
+const char *HW_WRITES_SAVED_PER_SEC_PARAM = "HW_WRITES_SAVED_PER_SEC";
+const size_t HW_WRITES_SAVED_PER_SEC_PARAM_LEN = 24;
+const char *SESSION_SETUP_US_PARAM = "SESSION_SETUP_US";
+const size_t SESSION_SETUP_US_PARAM_LEN = 17;
+const char *HANDSHAKES_ABANDONED_PARAM = "HANDSHAKES_ABANDONED";
+const size_t HANDSHAKES_ABANDONED_PARAM_LEN = 21;
+const char *WARM_START_PARAM = "WARM_START";
+const size_t WARM_START_PARAM_LEN = 11;
+const char *FULL_RESET_PARAM = "FULL_RESET";
+const size_t FULL_RESET_PARAM_LEN = 11;
+const char *CONNS_REJECTED_PARAM = "CONNS_REJECTED";
+const size_t CONNS_REJECTED_PARAM_LEN = 15;
+const char *REJECTS_RATE_LIMITED_PARAM = "REJECTS_RATE_LIMITED";
+const size_t REJECTS_RATE_LIMITED_PARAM_LEN = 21;
 const char *MGMT_SUPPORT_PARAM = "MGMT_SUPPORT";
 const size_t MGMT_SUPPORT_PARAM_LEN = 13;
+const char *MUX_SUPPORT_PARAM = "MUX_SUPPORT";
+const size_t MUX_SUPPORT_PARAM_LEN = 12;
@@ -0,0 +1,270 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "intel_fpga_api.h"
+
+#include "intel_st_debug_if_event_loop.h"
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#include <sys/epoll.h>
+#endif
+
+const EVENT_LOOP EVENT_LOOP_default = {
+    .backend = EVENT_LOOP_BACKEND_DEFAULT,
+    .epoll_fd = -1,
+    .sources = { { INVALID_SOCKET, 0, 0 } },
+    .num_sources = 0,
+    .waits = 0,
+    .idle_waits = 0
+};
+
+static EVENT_LOOP_SOURCE *find_source(EVENT_LOOP *loop, SOCKET fd) {
+    for (int i = 0; i < loop->num_sources; ++i) {
+        if (loop->sources[i].fd == fd) {
+            return &(loop->sources[i]);
+        }
+    }
+    return NULL;
+}
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+static int epoll_ctl_source(EVENT_LOOP *loop, int op, EVENT_LOOP_SOURCE *source) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    // Hang-up & error conditions are always reported by epoll, they do not need to be requested
+    ev.events = EPOLLPRI;
+    if (source->interest & EVENT_LOOP_READ) {
+        ev.events |= EPOLLIN;
+    } else {
+        // Without read interest the peer shutting down its side would go unnoticed until the full hang-up,
+        // it is reported as an exception instead.  Readers observe it as EOF from their next recv().
+        ev.events |= EPOLLRDHUP;
+    }
+    if (source->interest & EVENT_LOOP_WRITE) {
+        ev.events |= EPOLLOUT;
+    }
+    if (source->interest & EVENT_LOOP_EDGE_TRIGGERED) {
+        ev.events |= EPOLLET;
+    }
+    ev.data.u64 = (uint64_t)(uint32_t)source->fd | ((uint64_t)(uint32_t)source->tag << 32);
+    return epoll_ctl(loop->epoll_fd, op, source->fd, &ev);
+}
+
+static int epoll_wait_events(EVENT_LOOP *loop, EVENT_LOOP_EVENT *events, int max_events, int timeout_ms) {
+    struct epoll_event ep_events[EVENT_LOOP_MAX_SOURCES];
+    int n = epoll_wait(loop->epoll_fd, ep_events, MIN_MACRO(max_events, EVENT_LOOP_MAX_SOURCES), timeout_ms);
+    for (int i = 0; i < n; ++i) {
+        unsigned int ready = 0;
+        // A hang-up is reported as readable, the following recv() will observe the EOF exactly as with select()
+        if (ep_events[i].events & (EPOLLIN | EPOLLHUP)) {
+            ready |= EVENT_LOOP_READ;
+        }
+        if (ep_events[i].events & EPOLLOUT) {
+            ready |= EVENT_LOOP_WRITE;
+        }
+        if (ep_events[i].events & (EPOLLPRI | EPOLLERR | EPOLLRDHUP)) {
+            ready |= EVENT_LOOP_EXCEPT;
+        }
+        events[i].tag = (int)(uint32_t)(ep_events[i].data.u64 >> 32);
+        events[i].ready = ready;
+    }
+    return n;
+}
+#endif
+
+static int select_wait_events(EVENT_LOOP *loop, EVENT_LOOP_EVENT *events, int max_events, int timeout_ms) {
+    fd_set read_fds;
+    fd_set write_fds;
+    fd_set except_fds;
+    SOCKET max_fd = 0;
+
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    FD_ZERO(&except_fds);
+    for (int i = 0; i < loop->num_sources; ++i) {
+        const EVENT_LOOP_SOURCE *source = &(loop->sources[i]);
+        if (source->interest & EVENT_LOOP_READ) {
+            FD_SET(source->fd, &read_fds);
+        }
+        if (source->interest & EVENT_LOOP_WRITE) {
+            FD_SET(source->fd, &write_fds);
+        }
+        FD_SET(source->fd, &except_fds);
+        max_fd = MAX_MACRO(max_fd, source->fd);
+    }
+
+    struct timeval to;
+    struct timeval *to_ptr = NULL;
+    if (timeout_ms >= 0) {
+        to.tv_sec = timeout_ms / 1000;
+        to.tv_usec = (timeout_ms % 1000) * 1000;
+        to_ptr = &to;
+    }
+    int rc = select((int)(max_fd + 1), &read_fds, &write_fds, &except_fds, to_ptr);
+    if (rc <= 0) {
+        return rc;
+    }
+
+    int n = 0;
+    for (int i = 0; (i < loop->num_sources) && (n < max_events); ++i) {
+        const EVENT_LOOP_SOURCE *source = &(loop->sources[i]);
+        unsigned int ready = 0;
+        if (FD_ISSET(source->fd, &read_fds)) {
+            ready |= EVENT_LOOP_READ;
+        }
+        if (FD_ISSET(source->fd, &write_fds)) {
+            ready |= EVENT_LOOP_WRITE;
+        }
+        if (FD_ISSET(source->fd, &except_fds)) {
+            ready |= EVENT_LOOP_EXCEPT;
+        }
+        if (ready != 0) {
+            events[n].tag = source->tag;
+            events[n].ready = ready;
+            ++n;
+        }
+    }
+    return n;
+}
+
+RETURN_CODE event_loop_init(EVENT_LOOP *loop, EVENT_LOOP_BACKEND backend) {
+    *loop = EVENT_LOOP_default;
+    loop->backend = backend;
+    if (backend == EVENT_LOOP_BACKEND_EPOLL) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+        if ((loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            return FAILURE;
+        }
+#else
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "The epoll event loop backend is not available on this platform\n");
+        return FAILURE;
+#endif
+    }
+    return OK;
+}
+
+void event_loop_close(EVENT_LOOP *loop) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+#endif
+    loop->epoll_fd = -1;
+    loop->num_sources = 0;
+}
+
+RETURN_CODE event_loop_add(EVENT_LOOP *loop, SOCKET fd, unsigned int interest, int tag) {
+    if ((fd == INVALID_SOCKET) || (loop->num_sources >= EVENT_LOOP_MAX_SOURCES) || (find_source(loop, fd) != NULL)) {
+        return FAILURE;
+    }
+    EVENT_LOOP_SOURCE *source = &(loop->sources[loop->num_sources]);
+    source->fd = fd;
+    source->interest = interest;
+    source->tag = tag;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if ((loop->backend == EVENT_LOOP_BACKEND_EPOLL) && (epoll_ctl_source(loop, EPOLL_CTL_ADD, source) < 0)) {
+        return FAILURE;
+    }
+#endif
+    ++(loop->num_sources);
+    return OK;
+}
+
+RETURN_CODE event_loop_modify(EVENT_LOOP *loop, SOCKET fd, unsigned int interest) {
+    EVENT_LOOP_SOURCE *source = find_source(loop, fd);
+    if (source == NULL) {
+        return FAILURE;
+    }
+    if (source->interest == interest) {
+        return OK; // Nothing to do, spare the system call
+    }
+    source->interest = interest;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if ((loop->backend == EVENT_LOOP_BACKEND_EPOLL) && (epoll_ctl_source(loop, EPOLL_CTL_MOD, source) < 0)) {
+        return FAILURE;
+    }
+#endif
+    return OK;
+}
+
+RETURN_CODE event_loop_remove(EVENT_LOOP *loop, SOCKET fd) {
+    EVENT_LOOP_SOURCE *source = find_source(loop, fd);
+    if (source == NULL) {
+        return FAILURE;
+    }
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (loop->backend == EVENT_LOOP_BACKEND_EPOLL) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif
+    *source = loop->sources[--(loop->num_sources)];
+    return OK;
+}
+
+unsigned int event_loop_get_interest(EVENT_LOOP *loop, SOCKET fd) {
+    EVENT_LOOP_SOURCE *source = find_source(loop, fd);
+    return (source != NULL) ? source->interest : 0;
+}
+
+int event_loop_wait(EVENT_LOOP *loop, EVENT_LOOP_EVENT *events, int max_events, int timeout_ms) {
+    int n;
+    ++(loop->waits);
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (loop->backend == EVENT_LOOP_BACKEND_EPOLL) {
+        n = epoll_wait_events(loop, events, max_events, timeout_ms);
+    } else
+#endif
+    {
+        n = select_wait_events(loop, events, max_events, timeout_ms);
+    }
+    if (n == 0) {
+        ++(loop->idle_waits);
+    } else if ((n < 0) && (get_last_socket_error() == EINTR)) {
+        n = 0; // Interrupted by a signal, not an error condition
+    }
+    return n;
+}
+
+const char *event_loop_backend_name(EVENT_LOOP_BACKEND backend) {
+    return (backend == EVENT_LOOP_BACKEND_EPOLL) ? "epoll" : "select";
+}
+
+int parse_event_loop_backend(const char *name, EVENT_LOOP_BACKEND *backend) {
+    if (strcmp(name, "select") == 0) {
+        *backend = EVENT_LOOP_BACKEND_SELECT;
+        return 0;
+    } else if (strcmp(name, "epoll") == 0) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+        *backend = EVENT_LOOP_BACKEND_EPOLL;
+        return 0;
+#endif
+    }
+    return -1;
+}
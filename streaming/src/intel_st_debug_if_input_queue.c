@@ -0,0 +1,121 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_st_debug_if_input_queue.h"
+
+const INPUT_QUEUE INPUT_QUEUE_default = {
+    .buff = NULL,
+    .buff_sz = 0,
+    .head = 0,
+    .tail = 0,
+    .recv_calls = 0
+};
+
+RETURN_CODE input_queue_alloc(INPUT_QUEUE *queue, size_t sz) {
+    queue->buff_sz = sz + INPUT_QUEUE_SLACK;
+    queue->buff = (char *)malloc(queue->buff_sz);
+    input_queue_reset(queue);
+    return (queue->buff != NULL) ? OK : FAILURE;
+}
+
+void input_queue_free(INPUT_QUEUE *queue) {
+    if (queue->buff != NULL) {
+        free(queue->buff);
+        queue->buff = NULL;
+    }
+    queue->buff_sz = 0;
+    input_queue_reset(queue);
+}
+
+void input_queue_reset(INPUT_QUEUE *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->recv_calls = 0;
+}
+
+size_t input_queue_len(const INPUT_QUEUE *queue) {
+    return queue->tail - queue->head;
+}
+
+char input_queue_is_full(const INPUT_QUEUE *queue) {
+    return input_queue_len(queue) + INPUT_QUEUE_SLACK >= queue->buff_sz;
+}
+
+const char *input_queue_peek(const INPUT_QUEUE *queue) {
+    return queue->buff + queue->head;
+}
+
+void input_queue_consume(INPUT_QUEUE *queue, size_t len) {
+    queue->head += len;
+    if (queue->head == queue->tail) {
+        queue->head = queue->tail = 0;
+    }
+}
+
+RETURN_CODE input_queue_fill(INPUT_QUEUE *queue, SOCKET fd, size_t max_len, int flags, ssize_t *bytes_recvd) {
+    ssize_t curr_bytes_recvd = 0;
+    size_t room;
+    char *dst = input_queue_reserve(queue, max_len, &room);
+    if (room > 0) {
+        curr_bytes_recvd = recv(fd, dst, room, flags);
+        ++queue->recv_calls;
+        if (curr_bytes_recvd <= 0) {
+            if (curr_bytes_recvd < 0 && is_last_socket_error_would_block()) {
+                curr_bytes_recvd = 0;
+            } else {
+                if (bytes_recvd != NULL) {
+                    *bytes_recvd = curr_bytes_recvd; // Return the error
+                }
+                return FAILURE;
+            }
+        }
+        input_queue_commit(queue, curr_bytes_recvd);
+    }
+    if (bytes_recvd != NULL) {
+        *bytes_recvd = curr_bytes_recvd;
+    }
+    return OK;
+}
+
+char *input_queue_reserve(INPUT_QUEUE *queue, size_t max_len, size_t *room) {
+    // Move the unparsed bytes back to the start of the buffer once less than half of it is left,
+    // what is moved is at most a partial packet in the common case
+    const size_t received = input_queue_len(queue);
+    if (queue->head != 0 && queue->tail + INPUT_QUEUE_SLACK > queue->buff_sz / 2) {
+        memmove(queue->buff, queue->buff + queue->head, received);
+        queue->head = 0;
+        queue->tail = received;
+    }
+    *room = MIN_MACRO(max_len, queue->buff_sz - INPUT_QUEUE_SLACK - queue->tail);
+    return queue->buff + queue->tail;
+}
+
+void input_queue_commit(INPUT_QUEUE *queue, size_t len) {
+    queue->tail += len;
+}
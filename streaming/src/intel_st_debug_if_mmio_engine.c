@@ -0,0 +1,544 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_fpga_api.h"
+
+#include "intel_st_debug_if_mmio_engine.h"
+#include "intel_st_debug_if_server.h"
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+
+// Returns 1 once the whole of the H2T packet at the front of the ring is readable, its header is copied to h2t_header_buff
+static char peek_h2t_packet(SPSC_RING *ring, SERVER_BUFFERS *buff) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    if (spsc_ring_readable(ring, header_sz) < header_sz) {
+        return 0;
+    }
+    spsc_ring_peek(ring, 0, buff->h2t_header_buff, header_sz);
+    H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(buff->h2t_header_buff + SIZEOF_PACKET_GUARDBAND);
+    return spsc_ring_readable(ring, header_sz + header->DATA_LEN_BYTES) >= header_sz + header->DATA_LEN_BYTES;
+}
+
+// Same as above for MGMT, its header is copied to mgmt_header_buff
+static char peek_mgmt_packet(SPSC_RING *ring, SERVER_BUFFERS *buff) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER;
+    if (spsc_ring_readable(ring, header_sz) < header_sz) {
+        return 0;
+    }
+    spsc_ring_peek(ring, 0, buff->mgmt_header_buff, header_sz);
+    MGMT_PACKET_HEADER *header = (MGMT_PACKET_HEADER *)(buff->mgmt_header_buff + SIZEOF_PACKET_GUARDBAND);
+    return spsc_ring_readable(ring, header_sz + header->DATA_LEN_BYTES) >= header_sz + header->DATA_LEN_BYTES;
+}
+
+// Lays a T2H packet, header followed by the payload read out of the IP memory, out in the T2H ring
+static RETURN_CODE ring_t2h_packet(MMIO_ENGINE *engine, const char *header_buff, uint32_t payload, size_t payload_sz) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    SPSC_RING *ring = &(engine->t2h_ring);
+    if (spsc_ring_room(ring, header_sz + payload_sz + SPSC_RING_SLACK) < header_sz + payload_sz + SPSC_RING_SLACK) {
+        return FAILURE;
+    }
+    spsc_ring_write(ring, header_buff, header_sz);
+
+    // The payload is read straight into the ring unless it wraps around its end
+    size_t contiguous;
+    char *dst = spsc_ring_write_ptr(ring, &contiguous);
+    if (contiguous >= payload_sz) {
+        copy_t2h_payload(engine->server_conn, payload, dst, payload_sz);
+        spsc_ring_advance(ring, payload_sz);
+    } else {
+        copy_t2h_payload(engine->server_conn, payload, engine->bounce_buff, payload_sz);
+        spsc_ring_write(ring, engine->bounce_buff, payload_sz);
+    }
+    return OK;
+}
+
+// Same as above for MGMT RSP, whose payload is addressed directly
+static RETURN_CODE ring_mgmt_rsp_packet(MMIO_ENGINE *engine, const char *header_buff, const char *payload, size_t payload_sz) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER;
+    SERVER_BUFFERS *buff = engine->server_conn->buff;
+    SPSC_RING *ring = &(engine->mgmt_rsp_ring);
+    if (spsc_ring_room(ring, header_sz + payload_sz) < header_sz + payload_sz) {
+        return FAILURE;
+    }
+    spsc_ring_write(ring, header_buff, header_sz);
+
+/*TODO: clean up pointer vs int type mismatch*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    size_t first_len;
+    if (buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(buff->mgmt_rsp_tx_buff, buff->mgmt_rsp_tx_buff_sz, (uint64_t)payload, payload_sz)) != 0)) {
+        // Wrap, 2 copies necessary
+        spsc_ring_write(ring, payload, first_len);
+        spsc_ring_write(ring, (const char *)buff->mgmt_rsp_tx_buff, payload_sz - first_len);
+    } else {
+        spsc_ring_write(ring, payload, payload_sz);
+    }
+#pragma GCC diagnostic pop
+    return OK;
+}
+
+// Pushes every complete H2T packet of the ring to the hardware, or echoes it in loopback.
+// Returns the number of packets pushed, < 0 on failure.
+static int push_h2t_packets(MMIO_ENGINE *engine) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    SERVER_CONN *server_conn = engine->server_conn;
+    H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->h2t_header_buff + SIZEOF_PACKET_GUARDBAND);
+    int pushed = 0;
+
+    // In loopback the echo has to fit the T2H ring, leave the data in the H2T ring until the client catches up
+    while (!(server_conn->loopback_mode == 1 && spsc_ring_is_full(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark)) &&
+           peek_h2t_packet(&(engine->h2t_ring), server_conn->buff)) {
+        const size_t bytes_to_transfer = header->DATA_LEN_BYTES;
+
+        // Polls to see if there is room for the packet
+        uint64_t h2t_buff = ((server_conn->hw_callbacks.get_h2t_buffer != NULL) && (server_conn->loopback_mode == 0)) ? server_conn->hw_callbacks.get_h2t_buffer(server_conn->hw_callbacks.context, bytes_to_transfer) : server_conn->buff->h2t_rx_buff;
+        if (h2t_buff == 0) {
+            // Wait for buffer to be available!
+            server_conn->h2t_waiting = 1;
+            break;
+        }
+        server_conn->pkt_stats.h2t_cnt++;
+        server_conn->h2t_waiting = 0;
+
+        // A payload wrapping around the end of the ring is made contiguous first
+        size_t contiguous;
+        uint64_t *payload = (uint64_t *)spsc_ring_read_ptr(&(engine->h2t_ring), header_sz, &contiguous);
+        if (contiguous < bytes_to_transfer) {
+            spsc_ring_peek(&(engine->h2t_ring), header_sz, engine->bounce_buff, bytes_to_transfer);
+            payload = (uint64_t *)engine->bounce_buff;
+        }
+        copy_h2t_payload(server_conn, payload, h2t_buff, bytes_to_transfer);
+        spsc_ring_consume(&(engine->h2t_ring), header_sz + bytes_to_transfer);
+
+        if (server_conn->loopback_mode == 0) {
+            // Normal operation, push the transaction to HW
+            if (server_conn->hw_callbacks.h2t_data_received != NULL && server_conn->hw_callbacks.h2t_data_received(server_conn->hw_callbacks.context, header, h2t_buff) != 0) {
+                return -1;
+            }
+        } else if (ring_t2h_packet(engine, server_conn->buff->h2t_header_buff, h2t_buff, bytes_to_transfer) != OK) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue loopback T2H data\n");
+            return -1;
+        }
+        ++pushed;
+    }
+    return pushed;
+}
+
+// Same as above for MGMT
+static int push_mgmt_packets(MMIO_ENGINE *engine) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER;
+    SERVER_CONN *server_conn = engine->server_conn;
+    MGMT_PACKET_HEADER *header = (MGMT_PACKET_HEADER *)(server_conn->buff->mgmt_header_buff + SIZEOF_PACKET_GUARDBAND);
+    int pushed = 0;
+
+    while (!(server_conn->loopback_mode == 1 && spsc_ring_is_full(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark)) &&
+           peek_mgmt_packet(&(engine->mgmt_ring), server_conn->buff)) {
+        const size_t bytes_to_transfer = header->DATA_LEN_BYTES;
+
+        // Polls to see if there is room for the packet
+        uint64_t mgmt_buff = ((server_conn->hw_callbacks.get_mgmt_buffer != NULL) && (server_conn->loopback_mode == 0)) ? server_conn->hw_callbacks.get_mgmt_buffer(server_conn->hw_callbacks.context, bytes_to_transfer) : server_conn->buff->mgmt_rx_buff;
+        if (mgmt_buff == 0) {
+            // Wait for buffer to be available!
+            server_conn->mgmt_waiting = 1;
+            break;
+        }
+        server_conn->pkt_stats.mgmt_cnt++;
+        server_conn->mgmt_waiting = 0;
+
+/*TODO: clean up pointer vs int type mismatch*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+        size_t first_len;
+        if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->mgmt_rx_buff, server_conn->buff->mgmt_rx_buff_sz, mgmt_buff, bytes_to_transfer)) != 0)) {
+            // Wrap, 2 copies necessary
+            spsc_ring_peek(&(engine->mgmt_ring), header_sz, (char *)mgmt_buff, first_len);
+            spsc_ring_peek(&(engine->mgmt_ring), header_sz + first_len, (char *)server_conn->buff->mgmt_rx_buff, bytes_to_transfer - first_len);
+        } else {
+            spsc_ring_peek(&(engine->mgmt_ring), header_sz, (char *)mgmt_buff, bytes_to_transfer);
+        }
+        spsc_ring_consume(&(engine->mgmt_ring), header_sz + bytes_to_transfer);
+
+        if (server_conn->loopback_mode == 0) {
+            // Normal operation, push the transaction to HW
+            if (server_conn->hw_callbacks.mgmt_data_received != NULL && server_conn->hw_callbacks.mgmt_data_received(server_conn->hw_callbacks.context, header, (uint32_t)mgmt_buff) != 0) {
+                return -1;
+            }
+        } else if (ring_mgmt_rsp_packet(engine, server_conn->buff->mgmt_header_buff, (const char *)mgmt_buff, bytes_to_transfer) != OK) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue loopback MGMT RSP data\n");
+            return -1;
+        }
+#pragma GCC diagnostic pop
+        ++pushed;
+    }
+    return pushed;
+}
+
+// Drains up to 't2h_batch_size' ready descriptors into the T2H ring
+static RETURN_CODE drain_t2h_data(MMIO_ENGINE *engine) {
+    SERVER_CONN *server_conn = engine->server_conn;
+    H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->t2h_header_buff + SIZEOF_PACKET_GUARDBAND);
+    uint32_t t2h_buff;
+    size_t batched = 0;
+
+    // Data is left in the IP whenever the ring is full, until the client catches up
+    while (batched < server_conn->t2h_batch_size && !spsc_ring_is_full(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark)) {
+        if (server_conn->hw_callbacks.acquire_t2h_data(server_conn->hw_callbacks.context, header, &t2h_buff) != 0) {
+            return FAILURE;
+        }
+        if (header->DATA_LEN_BYTES == 0) {
+            break;
+        }
+        server_conn->pkt_stats.t2h_cnt++;
+        if (ring_t2h_packet(engine, server_conn->buff->t2h_header_buff, t2h_buff, header->DATA_LEN_BYTES) != OK) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue T2H data\n");
+            return FAILURE;
+        }
+        // The data now lives in the ring, the IP can reuse its memory right away
+        if (server_conn->hw_callbacks.t2h_data_complete != NULL) {
+            server_conn->hw_callbacks.t2h_data_complete(server_conn->hw_callbacks.context);
+        }
+        ++batched;
+    }
+    return OK;
+}
+
+static RETURN_CODE drain_mgmt_rsp_data(MMIO_ENGINE *engine) {
+    SERVER_CONN *server_conn = engine->server_conn;
+    MGMT_PACKET_HEADER *header = (MGMT_PACKET_HEADER *)(server_conn->buff->mgmt_rsp_header_buff + SIZEOF_PACKET_GUARDBAND);
+    uint32_t mgmt_rsp_buff;
+
+    // Leave the data in the IP until the client catches up
+    if (spsc_ring_is_full(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark)) {
+        return OK;
+    }
+    if (server_conn->hw_callbacks.acquire_mgmt_rsp_data(server_conn->hw_callbacks.context, header, &mgmt_rsp_buff) != 0) {
+        return FAILURE;
+    }
+    if (header->DATA_LEN_BYTES == 0) {
+        return OK;
+    }
+    server_conn->pkt_stats.mgmt_rsp_cnt++;
+
+/*TODO: clean up pointer vs int type mismatch*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    if (ring_mgmt_rsp_packet(engine, server_conn->buff->mgmt_rsp_header_buff, (const char *)mgmt_rsp_buff, header->DATA_LEN_BYTES) != OK) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue MGMT RSP data\n");
+        return FAILURE;
+    }
+#pragma GCC diagnostic pop
+    // The data now lives in the ring, the IP can reuse its memory right away
+    if (server_conn->hw_callbacks.mgmt_rsp_data_complete != NULL) {
+        server_conn->hw_callbacks.mgmt_rsp_data_complete(server_conn->hw_callbacks.context);
+    }
+    return OK;
+}
+
+// Whether a pass over the rings could get anything done, checked once more before going to sleep
+static char has_inbound_work(MMIO_ENGINE *engine, char hw_pending) {
+    SERVER_CONN *server_conn = engine->server_conn;
+    const char h2t_open = !(server_conn->h2t_waiting && !hw_pending) &&
+                          !(server_conn->loopback_mode == 1 && spsc_ring_is_full(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark));
+    const char mgmt_open = !(server_conn->mgmt_waiting && !hw_pending) &&
+                           !(server_conn->loopback_mode == 1 && spsc_ring_is_full(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark));
+    return (h2t_open && peek_h2t_packet(&(engine->h2t_ring), server_conn->buff)) ||
+           (mgmt_open && peek_mgmt_packet(&(engine->mgmt_ring), server_conn->buff));
+}
+
+static void wait_while_parked(MMIO_ENGINE *engine) {
+    pthread_mutex_lock(&(engine->lock));
+    engine->parked = 1;
+    pthread_cond_broadcast(&(engine->cond));
+    while (engine->park_requested) {
+        pthread_cond_wait(&(engine->cond), &(engine->lock));
+    }
+    engine->parked = 0;
+    pthread_mutex_unlock(&(engine->lock));
+}
+
+// Lets the network thread know the engine is gone, whether it was parking it or not
+static void signal_exit(MMIO_ENGINE *engine) {
+    pthread_mutex_lock(&(engine->lock));
+    __atomic_store_n(&(engine->exited), 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&(engine->cond));
+    pthread_mutex_unlock(&(engine->lock));
+    spsc_doorbell_ring(&(engine->network_bell));
+}
+
+static void *mmio_engine_main(void *arg) {
+    enum { IDLE_WAIT_MS = 1000 };
+    MMIO_ENGINE *engine = (MMIO_ENGINE *)arg;
+    SERVER_CONN *server_conn = engine->server_conn;
+    const char busy_poll = server_conn->busy_poll_us > 0;
+    EVENT_LOOP loop;
+
+    // Otherwise the engine inherits the CPU and policy of the server thread
+    if (server_conn->engine_cpu >= 0) {
+        pin_current_thread(server_conn->engine_cpu, server_conn->sched_fifo_priority, "MMIO engine");
+    }
+
+    if (event_loop_init(&loop, server_conn->event_loop_backend) != OK ||
+        event_loop_add(&loop, engine->engine_bell.fd, EVENT_LOOP_READ, ENGINE_WAKEUP_TAG) != OK) {
+        print_last_socket_error("Failed to create the MMIO engine event loop");
+        event_loop_close(&loop);
+        signal_exit(engine);
+        return NULL;
+    }
+
+    // Same hardware servicing as in single-threaded mode, see handle_client()
+    const char has_t2h = server_conn->hw_callbacks.acquire_t2h_data != NULL;
+    const char has_mgmt_rsp = server_conn->hw_callbacks.acquire_mgmt_rsp_data != NULL;
+    int wakeup_fd = (server_conn->hw_callbacks.get_wakeup_fd != NULL) ? server_conn->hw_callbacks.get_wakeup_fd(server_conn->hw_callbacks.context) : -1;
+    if (wakeup_fd >= 0) {
+        if (event_loop_add(&loop, wakeup_fd, EVENT_LOOP_READ, HW_WAKEUP_TAG) != OK) {
+            print_last_socket_error("Failed to register hardware wakeup with event loop, polling the hardware instead");
+            wakeup_fd = -1;
+        }
+    }
+    char hw_pending = 1;
+    char timed_out = 0;
+
+    while (!__atomic_load_n(&(engine->stop), __ATOMIC_ACQUIRE)) {
+        if (__atomic_load_n(&(engine->park_requested), __ATOMIC_RELAXED)) {
+            idle_poll_pause(&(server_conn->idle_poll));
+            wait_while_parked(engine);
+            hw_pending = 1; // Whatever changed, take a fresh look at the hardware
+            continue;
+        }
+        if (busy_poll) {
+            hw_pending = 1; // As in handle_client(), the hardware is serviced on every pass
+        }
+
+        // Inbound packets waiting on buffer space are retried once the hardware signals freed slots, on
+        // every pass when polling it, or after an idle wait in case that wakeup went missing
+        const char retry_waiting = (wakeup_fd < 0) || hw_pending || timed_out;
+        int pushed = 0;
+        int rc;
+        if (!(server_conn->mgmt_waiting && !retry_waiting)) {
+            if ((rc = push_mgmt_packets(engine)) < 0) {
+                break;
+            }
+            pushed += rc;
+        }
+        if (!(server_conn->h2t_waiting && !retry_waiting)) {
+            if ((rc = push_h2t_packets(engine)) < 0) {
+                break;
+            }
+            pushed += rc;
+        }
+
+        size_t outbound_cnt = server_conn->pkt_stats.t2h_cnt + server_conn->pkt_stats.mgmt_rsp_cnt;
+        if (server_conn->loopback_mode == 0 && ((wakeup_fd < 0) || hw_pending)) {
+            if ((has_mgmt_rsp && drain_mgmt_rsp_data(engine) != OK) || (has_t2h && drain_t2h_data(engine) != OK)) {
+                break;
+            }
+            if (server_conn->hw_callbacks.flush_data_complete != NULL) {
+                server_conn->pkt_stats.hw_writes_saved += server_conn->hw_callbacks.flush_data_complete(server_conn->hw_callbacks.context);
+            }
+            hw_pending = (server_conn->pkt_stats.t2h_cnt + server_conn->pkt_stats.mgmt_rsp_cnt) != outbound_cnt ||
+                         (has_t2h && spsc_ring_is_full(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark)) ||
+                         (has_mgmt_rsp && spsc_ring_is_full(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark));
+        }
+        outbound_cnt = (server_conn->pkt_stats.t2h_cnt + server_conn->pkt_stats.mgmt_rsp_cnt) - outbound_cnt;
+
+        // Hand whatever was laid out to the network thread in one go, consumed inbound data frees up room for it too
+        if (pushed > 0 || outbound_cnt > 0) {
+            spsc_ring_publish(&(engine->t2h_ring));
+            spsc_ring_publish(&(engine->mgmt_rsp_ring));
+            spsc_doorbell_ring(&(engine->network_bell));
+            idle_poll_activity(&(server_conn->idle_poll));
+            timed_out = 0;
+            continue;
+        }
+
+        // Without a hardware wakeup the hardware is polled, as long as there is room for what it may have.  Packets
+        // held up on buffer space keep it spinning, otherwise it backs off once nothing happened for a while.
+        const char t2h_open = has_t2h && !spsc_ring_is_full(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark);
+        const char mgmt_rsp_open = has_mgmt_rsp && !spsc_ring_is_full(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark);
+        const char hw_polling = (server_conn->loopback_mode == 0) && (t2h_open || mgmt_rsp_open) && ((wakeup_fd < 0) || hw_pending);
+        const char hw_waiting = (wakeup_fd < 0) && (server_conn->h2t_waiting || server_conn->mgmt_waiting);
+        int idle_wait_ms = IDLE_WAIT_MS;
+        if (busy_poll || hw_waiting || (hw_polling && wakeup_fd >= 0)) {
+            if (hw_waiting) {
+                idle_poll_activity(&(server_conn->idle_poll));
+            }
+            continue;
+        }
+        if (hw_polling) {
+            if ((idle_wait_ms = idle_poll_timeout(&(server_conn->idle_poll))) == 0) {
+                continue;
+            }
+        } else {
+            idle_poll_pause(&(server_conn->idle_poll));
+        }
+
+        // Nothing left to do, sleep unless the network thread published something since the passes above.
+        // Busy polling only looks for a hardware wakeup to acknowledge.
+        EVENT_LOOP_EVENT events[NUM_EVENT_TAGS];
+        if (!busy_poll) {
+            spsc_doorbell_arm(&(engine->engine_bell));
+        }
+        const char has_work = busy_poll || __atomic_load_n(&(engine->stop), __ATOMIC_RELAXED) || __atomic_load_n(&(engine->park_requested), __ATOMIC_RELAXED) ||
+                              has_inbound_work(engine, hw_pending);
+        const int timeout = has_work ? 0 : idle_wait_ms;
+        int num_events = event_loop_wait(&loop, events, NUM_EVENT_TAGS, timeout);
+        if (!busy_poll) {
+            spsc_doorbell_disarm(&(engine->engine_bell));
+        }
+        if (num_events < 0) {
+            print_last_socket_error("MMIO engine event loop wait failure");
+            break;
+        }
+        timed_out = (num_events == 0 && timeout != 0);
+        if (num_events > 0) {
+            idle_poll_activity(&(server_conn->idle_poll));
+        }
+        for (int i = 0; i < num_events; ++i) {
+            // Consume the wakeup before touching the hardware, anything raised from here on wakes us up again
+            if (events[i].tag == HW_WAKEUP_TAG && (events[i].ready & EVENT_LOOP_READ)) {
+                if (server_conn->hw_callbacks.ack_wakeup != NULL) {
+                    server_conn->hw_callbacks.ack_wakeup(server_conn->hw_callbacks.context);
+                }
+                hw_pending = 1;
+            }
+        }
+    }
+
+    // Completions held back by the driver are handed back to the hardware whatever the reason for stopping
+    if (server_conn->hw_callbacks.flush_data_complete != NULL) {
+        server_conn->pkt_stats.hw_writes_saved += server_conn->hw_callbacks.flush_data_complete(server_conn->hw_callbacks.context);
+    }
+    event_loop_close(&loop);
+
+    signal_exit(engine);
+    return NULL;
+}
+
+static void free_engine_resources(MMIO_ENGINE *engine) {
+    spsc_ring_free(&(engine->h2t_ring));
+    spsc_ring_free(&(engine->mgmt_ring));
+    spsc_ring_free(&(engine->t2h_ring));
+    spsc_ring_free(&(engine->mgmt_rsp_ring));
+    spsc_doorbell_close(&(engine->engine_bell));
+    spsc_doorbell_close(&(engine->network_bell));
+    free(engine->bounce_buff);
+    engine->bounce_buff = NULL;
+}
+
+RETURN_CODE mmio_engine_start(MMIO_ENGINE *engine, SERVER_CONN *server_conn) {
+    // Room for a maximum sized packet on top of a partially received one, as for the H2T receive queue
+    const size_t h2t_ring_sz = 2 * (SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + USHRT_MAX);
+    const size_t mgmt_ring_sz = 2 * (SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER + USHRT_MAX);
+
+    engine->server_conn = server_conn;
+    engine->h2t_ring.buff = engine->mgmt_ring.buff = engine->t2h_ring.buff = engine->mgmt_rsp_ring.buff = NULL;
+    engine->engine_bell.fd = engine->network_bell.fd = -1;
+    engine->bounce_buff = NULL;
+    engine->park_requested = engine->parked = engine->stop = engine->exited = 0;
+
+    RETURN_CODE rc = spsc_ring_alloc(&(engine->h2t_ring), h2t_ring_sz);
+    if (rc == OK) {
+        rc = spsc_ring_alloc(&(engine->mgmt_ring), mgmt_ring_sz);
+    }
+    if (rc == OK) {
+        rc = spsc_ring_alloc(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark + server_conn->t2h_queue.max_packet_sz + SPSC_RING_SLACK);
+    }
+    if (rc == OK) {
+        rc = spsc_ring_alloc(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark + server_conn->mgmt_rsp_queue.max_packet_sz + SPSC_RING_SLACK);
+    }
+    if (rc == OK) {
+        rc = ((engine->bounce_buff = (char *)malloc(USHRT_MAX + SPSC_RING_SLACK)) != NULL) ? OK : FAILURE;
+    }
+    if (rc == OK) {
+        rc = spsc_doorbell_init(&(engine->engine_bell));
+    }
+    if (rc == OK) {
+        rc = spsc_doorbell_init(&(engine->network_bell));
+    }
+    if (rc != OK) {
+        free_engine_resources(engine);
+        return FAILURE;
+    }
+
+    pthread_mutex_init(&(engine->lock), NULL);
+    pthread_cond_init(&(engine->cond), NULL);
+    if (pthread_create(&(engine->thread), NULL, mmio_engine_main, engine) != 0) {
+        pthread_cond_destroy(&(engine->cond));
+        pthread_mutex_destroy(&(engine->lock));
+        free_engine_resources(engine);
+        return FAILURE;
+    }
+    server_conn->engine = engine;
+    return OK;
+}
+
+void mmio_engine_stop(MMIO_ENGINE *engine) {
+    __atomic_store_n(&(engine->stop), 1, __ATOMIC_RELEASE);
+    spsc_doorbell_ring(&(engine->engine_bell));
+    pthread_join(engine->thread, NULL);
+    engine->server_conn->engine = NULL;
+    pthread_cond_destroy(&(engine->cond));
+    pthread_mutex_destroy(&(engine->lock));
+    free_engine_resources(engine);
+}
+
+char mmio_engine_has_exited(MMIO_ENGINE *engine) {
+    return (char)__atomic_load_n(&(engine->exited), __ATOMIC_ACQUIRE);
+}
+
+// Returns once the engine is done with its current pass, or gone
+void mmio_engine_park(MMIO_ENGINE *engine) {
+    pthread_mutex_lock(&(engine->lock));
+    __atomic_store_n(&(engine->park_requested), 1, __ATOMIC_RELAXED);
+    spsc_doorbell_ring(&(engine->engine_bell));
+    while (!engine->parked && !engine->exited) {
+        pthread_cond_wait(&(engine->cond), &(engine->lock));
+    }
+    pthread_mutex_unlock(&(engine->lock));
+}
+
+void mmio_engine_unpark(MMIO_ENGINE *engine) {
+    pthread_mutex_lock(&(engine->lock));
+    __atomic_store_n(&(engine->park_requested), 0, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&(engine->cond));
+    pthread_mutex_unlock(&(engine->lock));
+}
+
+RETURN_CODE mmio_engine_fit_rings(MMIO_ENGINE *engine) {
+    SERVER_CONN *server_conn = engine->server_conn;
+    if (spsc_ring_resize(&(engine->t2h_ring), server_conn->t2h_queue.high_water_mark + server_conn->t2h_queue.max_packet_sz + SPSC_RING_SLACK) != OK ||
+        spsc_ring_resize(&(engine->mgmt_rsp_ring), server_conn->mgmt_rsp_queue.high_water_mark + server_conn->mgmt_rsp_queue.max_packet_sz + SPSC_RING_SLACK) != OK) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Failed to grow the outbound rings\n");
+        return FAILURE;
+    }
+    return OK;
+}
+
+#endif
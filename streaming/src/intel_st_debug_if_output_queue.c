@@ -0,0 +1,162 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_st_debug_if_output_queue.h"
+
+const OUTPUT_QUEUE OUTPUT_QUEUE_default = {
+    .buff = NULL,
+    .buff_sz = 0,
+    .head = 0,
+    .tail = 0,
+    .high_water_mark = OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK,
+    .max_packet_sz = 0,
+    .send_calls = 0
+};
+
+static size_t required_buff_sz(size_t high_water_mark, size_t max_packet_sz) {
+    return high_water_mark + max_packet_sz + OUTPUT_QUEUE_SLACK;
+}
+
+RETURN_CODE output_queue_alloc(OUTPUT_QUEUE *queue, size_t max_packet_sz) {
+    queue->max_packet_sz = max_packet_sz;
+    queue->buff_sz = required_buff_sz(queue->high_water_mark, max_packet_sz);
+    queue->buff = (char *)malloc(queue->buff_sz);
+    output_queue_reset(queue);
+    return (queue->buff != NULL) ? OK : FAILURE;
+}
+
+void output_queue_free(OUTPUT_QUEUE *queue) {
+    if (queue->buff != NULL) {
+        free(queue->buff);
+        queue->buff = NULL;
+    }
+    queue->buff_sz = 0;
+    output_queue_reset(queue);
+}
+
+void output_queue_reset(OUTPUT_QUEUE *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->send_calls = 0;
+}
+
+RETURN_CODE output_queue_set_high_water_mark(OUTPUT_QUEUE *queue, size_t high_water_mark) {
+    if (high_water_mark == 0) {
+        return FAILURE;
+    }
+    const size_t buff_sz = required_buff_sz(high_water_mark, queue->max_packet_sz);
+    if (buff_sz > queue->buff_sz) {
+        // Whatever is queued moves along with the buffer, offsets stay valid
+        char *buff = (char *)realloc(queue->buff, buff_sz);
+        if (buff == NULL) {
+            return FAILURE;
+        }
+        queue->buff = buff;
+        queue->buff_sz = buff_sz;
+    }
+    queue->high_water_mark = high_water_mark;
+    return OK;
+}
+
+size_t output_queue_len(const OUTPUT_QUEUE *queue) {
+    return queue->tail - queue->head;
+}
+
+char output_queue_is_empty(const OUTPUT_QUEUE *queue) {
+    return queue->tail == queue->head;
+}
+
+char output_queue_is_full(const OUTPUT_QUEUE *queue) {
+    return output_queue_len(queue) >= queue->high_water_mark;
+}
+
+char *output_queue_reserve(OUTPUT_QUEUE *queue, size_t len) {
+    if (queue->tail + len + OUTPUT_QUEUE_SLACK > queue->buff_sz) {
+        // Move the unsent bytes back to the start of the buffer
+        const size_t queued = output_queue_len(queue);
+        if (queued + len + OUTPUT_QUEUE_SLACK > queue->buff_sz) {
+            return NULL;
+        }
+        memmove(queue->buff, queue->buff + queue->head, queued);
+        queue->head = 0;
+        queue->tail = queued;
+    }
+    return queue->buff + queue->tail;
+}
+
+void output_queue_commit(OUTPUT_QUEUE *queue, size_t len) {
+    queue->tail += len;
+}
+
+RETURN_CODE output_queue_push(OUTPUT_QUEUE *queue, const char *data, size_t len) {
+    char *dst = output_queue_reserve(queue, len);
+    if (dst == NULL) {
+        return FAILURE;
+    }
+    memcpy(dst, data, len);
+    output_queue_commit(queue, len);
+    return OK;
+}
+
+RETURN_CODE output_queue_flush(OUTPUT_QUEUE *queue, SOCKET fd, int flags, ssize_t *bytes_sent) {
+    ssize_t total_bytes_sent = 0;
+    while (!output_queue_is_empty(queue)) {
+        ssize_t curr_bytes_sent = send(fd, queue->buff + queue->head, output_queue_len(queue), flags);
+        ++queue->send_calls;
+        if (curr_bytes_sent <= 0) {
+            if (curr_bytes_sent < 0 && is_last_socket_error_would_block()) {
+                break; // Resumed once the socket is writable again
+            }
+            if (bytes_sent != NULL) {
+                *bytes_sent = curr_bytes_sent;
+            }
+            return FAILURE;
+        }
+        queue->head += curr_bytes_sent;
+        total_bytes_sent += curr_bytes_sent;
+    }
+    if (output_queue_is_empty(queue)) {
+        queue->head = queue->tail = 0;
+    }
+    if (bytes_sent != NULL) {
+        *bytes_sent = total_bytes_sent;
+    }
+    return OK;
+}
+
+const char *output_queue_peek(const OUTPUT_QUEUE *queue) {
+    return queue->buff + queue->head;
+}
+
+void output_queue_consume(OUTPUT_QUEUE *queue, size_t len) {
+    queue->head += len;
+    if (output_queue_is_empty(queue)) {
+        queue->head = queue->tail = 0;
+    }
+}
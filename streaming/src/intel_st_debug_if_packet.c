@@ -122,6 +122,19 @@ void populate_mgmt_packet_bytes
     populate_mgmt_packet_header_bytes(bytes + SIZEOF_PACKET_GUARDBAND, sop, eop, channel, data_len_bytes);
 }
 
+void populate_mux_frame_header_bytes(unsigned char *bytes, unsigned char stream, unsigned short data_len_bytes) {
+    bytes[0] = stream;
+    bytes[1] = 0;
+    bytes[2] = (unsigned char)data_len_bytes;
+    bytes[3] = (data_len_bytes & 0xFF00) >> 8;
+}
+
+void parse_mux_frame_header_bytes(const unsigned char *bytes, MUX_FRAME_HEADER *header) {
+    header->STREAM = bytes[0];
+    header->RESERVED = bytes[1];
+    header->DATA_LEN_BYTES = (unsigned short)(bytes[2] | (bytes[3] << 8));
+}
+
 #ifdef STI_DEBUG
 void dump_mgmt_packet_header(MGMT_PACKET_HEADER *packet) {
     printf("MGMT Packet header (size = %d): \n", SIZEOF_MGMT_PACKET_HEADER);
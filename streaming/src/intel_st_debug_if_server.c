@@ -24,6 +24,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pthread_setaffinity_np()
+#endif
 #include <sys/types.h>
 #include <limits.h>
 #include <stdio.h>
@@ -37,6 +40,14 @@
 #include "intel_st_debug_if_server.h"
 #include "intel_st_debug_if_packet.h"
 #include "intel_st_debug_if_constants.h"
+#include "intel_st_debug_if_mmio_engine.h"
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
 
 const SERVER_BUFFERS SERVER_BUFFERS_default = {
     .ctrl_rx_buff = NULL,
@@ -68,7 +79,9 @@ const SERVER_CONN SERVER_CONN_default = {
     .h2t_waiting = 0,
     .mgmt_waiting = 0,
     .hw_callbacks = {
+        .context = NULL,
         .init_driver = NULL,
+        .resume_driver = NULL,
         .get_h2t_buffer = NULL,
         .h2t_data_received = NULL,
         .get_mgmt_buffer = NULL,
@@ -77,18 +90,62 @@ const SERVER_CONN SERVER_CONN_default = {
         .t2h_data_complete = NULL,
         .acquire_mgmt_rsp_data = NULL,
         .mgmt_rsp_data_complete = NULL,
+        .flush_data_complete = NULL,
         .has_mgmt_support = NULL,
         .set_param = NULL,
-        .get_param = NULL
+        .get_param = NULL,
+        .get_wakeup_fd = NULL,
+        .ack_wakeup = NULL
     },
     .loopback_mode = 0,
+    .h2t_rx_queue = { NULL, 0, 0, 0, 0 },
     .server_fd = INVALID_SOCKET,
+    .local_path = NULL,
+    .local_fd = INVALID_SOCKET,
+    .handshake_timeout_ms = DEFAULT_HANDSHAKE_TIMEOUT_MS,
+    .pending_conns = { { INVALID_SOCKET, 0, PENDING_CONN_FREE, { 0, 0 }, 0, { 0 } } }, // All slots free
+    .handshakes_abandoned = 0,
+    .draining_conns = { // All slots free
+        { { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, 0, 0, 0 }, { 0, 0 }, { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 } },
+        { { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, 0, 0, 0 }, { 0, 0 }, { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 } },
+        { { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, 0, 0, 0 }, { 0, 0 }, { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 } },
+        { { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, 0, 0, 0 }, { 0, 0 }, { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 } }
+    },
+    .background_reject = 1,
+    .acceptor = NULL,
+    .reject_offenders = { { 0, { 0, 0 }, 0 } },
+    .conns_rejected = 0,
+    .rejects_rate_limited = 0,
+    .warm_reconnect = 1,
+    .hw_clean = 0,
+    .full_reset_requested = 0,
+    .stopping = 0,
+    .shm = { NULL, 0, -1, { NULL, NULL, 0, 0, 0 }, { NULL, NULL, 0, 0, 0 }, NULL, NULL, -1, -1, SHM_TRANSPORT_DEFAULT_SPIN_US },
     .t2h_nagle = 0,
     .mgmt_rsp_nagle = 0,
-    .pkt_stats = { 0, 0, 0, 0 }
+    .mux_rx_queue = { NULL, 0, 0, 0, 0 },
+    .mux_rx_stream = 0,
+    .mux_rx_remaining = 0,
+    .ctrl_rx_queue = { NULL, 0, 0, 0, 0 },
+    .mgmt_rx_queue = { NULL, 0, 0, 0, 0 },
+    .mux_tx_queue = { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 },
+    .t2h_queue = { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 },
+    .mgmt_rsp_queue = { NULL, 0, 0, 0, OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK, 0, 0 },
+    .t2h_batch_size = DEFAULT_T2H_BATCH_SIZE,
+    .event_loop_backend = EVENT_LOOP_BACKEND_DEFAULT,
+    .threaded = 0,
+    .engine = NULL,
+    .busy_poll_us = 0,
+    .cpu = -1,
+    .engine_cpu = -1,
+    .sched_fifo_priority = 0,
+    .idle_poll = { DEFAULT_POLL_SPIN_US, DEFAULT_POLL_SLEEP_US, DEFAULT_POLL_MAX_WAIT_MS, IDLE_POLL_SPIN, 0, 0, 0, { 0, 0 }, { 0, 0 }, { 0, 0, 0 } },
+    .pkt_stats = { 0, 0, 0, 0, 0, { 0, 0 }, 0, 0 }
 };
 const SERVER_HW_CALLBACKS SERVER_HW_CALLBACKS_default = {
+    .context = NULL,
     .init_driver = NULL,
+    .resume_driver = NULL,
     .get_h2t_buffer = NULL,
     .h2t_data_received = NULL,
     .get_mgmt_buffer = NULL,
@@ -97,18 +154,21 @@ const SERVER_HW_CALLBACKS SERVER_HW_CALLBACKS_default = {
     .t2h_data_complete = NULL,
     .acquire_mgmt_rsp_data = NULL,
     .mgmt_rsp_data_complete = NULL,
+    .flush_data_complete = NULL,
     .has_mgmt_support = NULL,
     .set_param = NULL,
-    .get_param = NULL
+    .get_param = NULL,
+    .get_wakeup_fd = NULL,
+    .ack_wakeup = NULL
 };
-const SERVER_PKT_STATS SERVER_PKT_STATS_default = { 0, 0, 0, 0 };
-const CLIENT_CONN CLIENT_CONN_default = { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET };
+const SERVER_PKT_STATS SERVER_PKT_STATS_default = { 0, 0, 0, 0, 0, { 0, 0 }, 0, 0 };
+const CLIENT_CONN CLIENT_CONN_default = { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, 0, 0, 0 };
 
-// Global variables
+// Address length as taken by bind() / accept() / getsockname(), kept per call so that servers may run side by side
 #if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS || STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_NIOS_INICHE
-int sizeof_addr = -1;
+typedef int SOCKADDR_LEN;
 #else
-uint32_t sizeof_addr = 0;
+typedef uint32_t SOCKADDR_LEN;
 #endif
 
 void reset_buffers(SERVER_CONN *conn) {
@@ -135,10 +195,12 @@ void print_last_socket_error_b(const char *context_msg, ssize_t bytes_transferre
     }
 }
 
-void generate_server_welcome_message(char *buff, size_t buff_size, int mgmt_support, SERVER_BUFFERS *serv_buff, int handle) {
-    snprintf(buff, buff_size, "Welcome to INTEL_ST_HOST_EP_SERVER: %s=%d %s=%ld %s=%ld %s=%ld HANDLE=%d",
+void generate_server_welcome_message(char *buff, size_t buff_size, int mgmt_support, int mux_support, SERVER_BUFFERS *serv_buff, int handle) {
+    snprintf(buff, buff_size, "Welcome to INTEL_ST_HOST_EP_SERVER: %s=%d %s=%d %s=%ld %s=%ld %s=%ld HANDLE=%d",
         MGMT_SUPPORT_PARAM,
         mgmt_support,
+        MUX_SUPPORT_PARAM,
+        mux_support,
         H2T_RX_BUFFER_SIZE_PARAM,
         serv_buff->h2t_rx_buff_sz,
         MGMT_RX_BUFFER_SIZE_PARAM,
@@ -168,7 +230,7 @@ RETURN_CODE bind_server_socket(SERVER_CONN *server_conn) {
 #endif
 
     // Bind it to PORT + Protocol
-    if ((errors == 0) && (bind(server_conn->server_fd, (const struct sockaddr *)(&(server_conn->server_addr)), sizeof_addr) < 0)) {
+    if ((errors == 0) && (bind(server_conn->server_fd, (const struct sockaddr *)(&(server_conn->server_addr)), sizeof(server_conn->server_addr)) < 0)) {
         print_last_socket_error("Failed to bind socket");
         ++errors;
     }
@@ -190,114 +252,710 @@ RETURN_CODE bind_server_socket(SERVER_CONN *server_conn) {
     }
 }
 
-RETURN_CODE connect_client_socket(SERVER_CONN *server_conn, int handle_id, SOCKET *client_fd, const char *sock_name, char use_nagle) {
-    enum { FAIL_MSG_SIZE = 80, MAX_HANDLE_RSP = 64 };
-    char socket_fail_msg[FAIL_MSG_SIZE];
-    if((*client_fd = accept(server_conn->server_fd, (struct sockaddr *)(&(server_conn->server_addr)), &sizeof_addr)) == INVALID_SOCKET) {
-        snprintf(socket_fail_msg, FAIL_MSG_SIZE, "Failed to accept %s socket", sock_name);
-        print_last_socket_error(socket_fail_msg);
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+// Fills in the address of SERVER_CONN.local_path, abstract ones start with a NUL instead of the '@'
+static RETURN_CODE get_local_server_addr(const char *path, struct sockaddr_un *addr, SOCKADDR_LEN *addr_len) {
+    const size_t path_len = strlen(path);
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path_len == 0 || path_len >= sizeof(addr->sun_path)) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Local socket path must be 1 to %d characters long: %s\n", (int)sizeof(addr->sun_path) - 1, path);
+        return FAILURE;
+    }
+    memcpy(addr->sun_path, path, path_len);
+    if (path[0] == '@') {
+        addr->sun_path[0] = '\0';
+        *addr_len = (SOCKADDR_LEN)(offsetof(struct sockaddr_un, sun_path) + path_len);
     } else {
-        if (set_tcp_no_delay(*client_fd, (use_nagle == 0) ? 1 : 0) == 0) {
-            ssize_t bytes_transferred;
-            if (socket_recv_until_null_reached(*client_fd, server_conn->buff->ctrl_rx_buff, MAX_HANDLE_RSP, 0, &bytes_transferred) == OK) {
-                // Client needs to send a null terminated handle ack message
-                generate_expected_handle_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, sock_name, handle_id);
-                if (strncmp(server_conn->buff->ctrl_rx_buff, server_conn->buff->ctrl_tx_buff, MAX_HANDLE_RSP) == 0) {
-                    RETURN_CODE result;
-                    if ((result = socket_send_all(*client_fd, READY_MSG, READY_MSG_LEN, 0, &bytes_transferred)) != OK) {
-                        snprintf(socket_fail_msg, FAIL_MSG_SIZE, "Failed to send handle ready message for %s socket", sock_name);
-                        print_last_socket_error_b(socket_fail_msg, bytes_transferred);
-                    }
-                    return result;
-                } else {
-                    socket_send_all(*client_fd, NOT_READY_MSG, NOT_READY_MSG_LEN, 0, NULL);
-                    fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Got unexpected handle ack message: %s\n\tExpected: %s\n", server_conn->buff->ctrl_rx_buff, server_conn->buff->ctrl_tx_buff);
-                }
-            } else {
-                snprintf(socket_fail_msg, FAIL_MSG_SIZE, "Failed to recv handle ack message for %s socket", sock_name);
-                print_last_socket_error_b(socket_fail_msg, bytes_transferred);
+        *addr_len = (SOCKADDR_LEN)sizeof(*addr);
+    }
+    return OK;
+}
+#endif
+
+// Closes the local listener, if any, and removes its socket file
+static void close_local_server_socket(SERVER_CONN *server_conn) {
+    if (server_conn->local_fd == INVALID_SOCKET) {
+        return;
+    }
+    if (close_socket_fd(server_conn->local_fd)) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Error closing local server socket.\n");
+    }
+    server_conn->local_fd = INVALID_SOCKET;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (server_conn->local_path[0] != '@') {
+        unlink(server_conn->local_path);
+    }
+#endif
+}
+
+RETURN_CODE bind_local_server_socket(SERVER_CONN *server_conn) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    const int MAX_LISTEN = 8;
+    const char *path = server_conn->local_path;
+    struct sockaddr_un addr;
+    SOCKADDR_LEN addr_len;
+    struct stat path_stat;
+
+    if (get_local_server_addr(path, &addr, &addr_len) != OK) {
+        return FAILURE;
+    }
+
+    // A socket file left behind by a previous run would fail the bind, anything else at that path is kept
+    if (path[0] != '@' && lstat(path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+        unlink(path);
+    }
+
+    if ((server_conn->local_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == INVALID_SOCKET) {
+        print_last_socket_error("Failed to create local socket");
+        return FAILURE;
+    }
+    if (bind(server_conn->local_fd, (const struct sockaddr *)&addr, addr_len) < 0) {
+        print_last_socket_error("Failed to bind local socket");
+        close_socket_fd(server_conn->local_fd);
+        server_conn->local_fd = INVALID_SOCKET;
+        return FAILURE;
+    }
+    if (listen(server_conn->local_fd, MAX_LISTEN) < 0) {
+        print_last_socket_error("Failed to listen on local socket");
+        close_local_server_socket(server_conn);
+        return FAILURE;
+    }
+    return OK;
+#else
+    fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Local sockets are not supported on this platform\n");
+    return FAILURE;
+#endif
+}
+
+// Accepts the next connection on 'listen_fd', either SERVER_CONN.server_fd or SERVER_CONN.local_fd
+static SOCKET accept_on(SERVER_CONN *server_conn, SOCKET listen_fd) {
+    if (listen_fd != server_conn->server_fd) {
+        return accept(listen_fd, NULL, NULL);
+    }
+    SOCKADDR_LEN sizeof_addr = sizeof(server_conn->server_addr);
+    return accept(server_conn->server_fd, (struct sockaddr *)(&(server_conn->server_addr)), &sizeof_addr);
+}
+
+// Tells a connection that a client is served already, and closes it
+static void reject_connection(SOCKET sock_fd) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
+    int flags = 0;
+#else
+    int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#endif
+    size_t reject_msg_len = 12;
+    // A client that hung up already is not told, nor is that an error of the server
+    if (send(sock_fd, REJECT_MSG, reject_msg_len, flags) < 0 && !is_last_socket_error_peer_gone()) {
+        print_last_socket_error("Failed to send rejection message to additional client");
+    }
+
+    fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Rejected one connection request because only one connection has already been established.");
+
+    // Prevent TIME_WAIT
+    set_linger_socket_option(sock_fd, 1, 0);
+    close_socket_fd(sock_fd);
+}
+
+static long long elapsed_ns(const struct timespec *from, const struct timespec *to) {
+    return (long long)(to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+}
+
+// Counts a connection from 'addr', true once the address connected more than REJECT_BURST times in the current window
+static char is_repeat_offender(SERVER_CONN *server_conn, uint32_t addr, const struct timespec *now) {
+    REJECT_OFFENDER *offender = NULL;
+    REJECT_OFFENDER *least_recent = &(server_conn->reject_offenders[0]);
+    for (size_t i = 0; i < MAX_REJECT_OFFENDERS; ++i) {
+        REJECT_OFFENDER *entry = &(server_conn->reject_offenders[i]);
+        if (entry->count > 0 && entry->addr == addr) {
+            offender = entry;
+            break;
+        }
+        if (elapsed_ns(&(entry->window_start), &(least_recent->window_start)) > 0) {
+            least_recent = entry;
+        }
+    }
+    if (offender == NULL || elapsed_ns(&(offender->window_start), now) >= REJECT_WINDOW_MS * 1000000LL) {
+        if (offender == NULL) {
+            offender = least_recent;
+        }
+        offender->addr = addr;
+        offender->window_start = *now;
+        offender->count = 0;
+    }
+    return ++(offender->count) > REJECT_BURST;
+}
+
+void reject_client(SERVER_CONN *server_conn, SOCKET listen_fd) {
+    const char is_local = (listen_fd != server_conn->server_fd);
+    struct sockaddr_in peer_addr;
+    SOCKADDR_LEN sizeof_addr = sizeof(peer_addr);
+    memset(&peer_addr, 0, sizeof(peer_addr));
+    SOCKET sock_fd = accept(listen_fd, is_local ? NULL : (struct sockaddr *)(&peer_addr), is_local ? NULL : &sizeof_addr);
+    if (sock_fd == INVALID_SOCKET) {
+        print_last_socket_error("Failed to accept additional client");
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    __atomic_fetch_add(&(server_conn->conns_rejected), 1, __ATOMIC_RELAXED);
+    if (is_repeat_offender(server_conn, is_local ? 0 : peer_addr.sin_addr.s_addr, &now)) {
+        // Neither told nor logged, and no TIME_WAIT either
+        __atomic_fetch_add(&(server_conn->rejects_rate_limited), 1, __ATOMIC_RELAXED);
+        set_linger_socket_option(sock_fd, 1, 0);
+        close_socket_fd(sock_fd);
+    } else {
+        reject_connection(sock_fd);
+    }
+}
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+// Refuses the connections coming in while a client is served, see SERVER_CONN.background_reject.  It runs
+// SCHED_IDLE, so that it only gets CPU time the threads serving the client leave, connections meanwhile wait in
+// the listen backlog.  The listening sockets are those of the session: the thread is stopped either as the
+// session ends or by server_terminate() before it closes them, see acceptor_join().
+typedef struct ACCEPTOR {
+    SERVER_CONN *server_conn;
+    EVENT_LOOP loop;
+    SOCKET listen_fds[2];       // SERVER_CONN.server_fd and SERVER_CONN.local_fd, when the session started
+    SPSC_DOORBELL stop_bell;    // Rung by acceptor_join()
+    pthread_t thread;
+    char joined;                // Set by acceptor_join() once the thread is gone, only accessed atomically
+} ACCEPTOR;
+
+enum { ACCEPTOR_STOP_TAG = 2 };
+
+static void *acceptor_main(void *arg) {
+    ACCEPTOR *acceptor = (ACCEPTOR *)arg;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param); // Left as is if refused, it still works
+
+    while (1) {
+        EVENT_LOOP_EVENT events[3];
+        const int num_events = event_loop_wait(&(acceptor->loop), events, 3, EVENT_LOOP_INFINITE_TIMEOUT);
+        if (num_events < 0) {
+            print_last_socket_error("Acceptor event loop wait failure");
+            break;
+        }
+        char stop = 0;
+        for (int i = 0; i < num_events; ++i) {
+            const int tag = events[i].tag;
+            if (tag == ACCEPTOR_STOP_TAG) {
+                stop = 1;
+            } else if (events[i].ready & EVENT_LOOP_READ) {
+                reject_client(acceptor->server_conn, acceptor->listen_fds[tag]);
             }
         }
+        if (stop) {
+            break;
+        }
     }
-    return FAILURE;
+    return NULL;
+}
+
+static RETURN_CODE acceptor_start(ACCEPTOR *acceptor, SERVER_CONN *server_conn) {
+    acceptor->server_conn = server_conn;
+    acceptor->listen_fds[0] = server_conn->server_fd;
+    acceptor->listen_fds[1] = server_conn->local_fd;
+    acceptor->joined = 0;
+    if (spsc_doorbell_init(&(acceptor->stop_bell)) != OK) {
+        return FAILURE;
+    }
+    // Armed for good, the thread only ever sleeps
+    spsc_doorbell_arm(&(acceptor->stop_bell));
+    if (event_loop_init(&(acceptor->loop), server_conn->event_loop_backend) != OK) {
+        spsc_doorbell_close(&(acceptor->stop_bell));
+        return FAILURE;
+    }
+    char failed = (event_loop_add(&(acceptor->loop), acceptor->stop_bell.fd, EVENT_LOOP_READ, ACCEPTOR_STOP_TAG) != OK);
+    for (int i = 0; !failed && i < 2; ++i) {
+        failed = (acceptor->listen_fds[i] != INVALID_SOCKET && event_loop_add(&(acceptor->loop), acceptor->listen_fds[i], EVENT_LOOP_READ, i) != OK);
+    }
+    if (failed || pthread_create(&(acceptor->thread), NULL, acceptor_main, acceptor) != 0) {
+        event_loop_close(&(acceptor->loop));
+        spsc_doorbell_close(&(acceptor->stop_bell));
+        return FAILURE;
+    }
+    __atomic_store_n(&(server_conn->acceptor), acceptor, __ATOMIC_RELEASE);
+    return OK;
+}
+
+// Wakes the acceptor thread of 'server_conn', if any, through its stop doorbell and joins it.  Called by the session
+// and by server_terminate(), the one that takes SERVER_CONN.acceptor first does it.
+static void acceptor_join(SERVER_CONN *server_conn) {
+    ACCEPTOR *acceptor = __atomic_exchange_n(&(server_conn->acceptor), NULL, __ATOMIC_ACQ_REL);
+    if (acceptor != NULL) {
+        spsc_doorbell_ring(&(acceptor->stop_bell));
+        pthread_join(acceptor->thread, NULL);
+        __atomic_store_n(&(acceptor->joined), 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Ends the session's acceptor, waiting for server_terminate() if that got to join it, then releases it
+static void acceptor_stop(ACCEPTOR *acceptor) {
+    acceptor_join(acceptor->server_conn);
+    while (!__atomic_load_n(&(acceptor->joined), __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    event_loop_close(&(acceptor->loop));
+    spsc_doorbell_close(&(acceptor->stop_bell));
+}
+#endif
+
+// Milliseconds left of 'timeout_ms' since 'from', rounded up, 0 once it has gone by
+static int ms_left(const struct timespec *from, unsigned long timeout_ms, const struct timespec *now) {
+    const long long left_ns = (long long)timeout_ms * 1000000LL - elapsed_ns(from, now);
+    return (left_ns > 0) ? (int)MIN_MACRO((left_ns + 999999) / 1000000, (long long)INT_MAX) : 0;
+}
+
+// Time left for a connection to identify itself.  One that has not sent anything yet may be the CONTROL socket of a
+// client queued behind the session being set up ('in_setup'), it has no deadline until it could be welcomed.
+static int pending_conn_ms_left(const PENDING_CONN *conn, char in_setup, const struct timespec *welcome_possible, unsigned long timeout_ms, const struct timespec *now) {
+    if (conn->rx_len > 0) {
+        return ms_left(&(conn->accepted), timeout_ms, now);
+    } else if (in_setup) {
+        return EVENT_LOOP_INFINITE_TIMEOUT;
+    }
+    return ms_left((elapsed_ns(&(conn->accepted), welcome_possible) > 0) ? welcome_possible : &(conn->accepted), timeout_ms, now);
+}
+
+// Gives up a slot of SERVER_CONN.pending_conns, its socket is closed unless it was handed over to the session
+static void free_pending_conn(EVENT_LOOP *loop, PENDING_CONN *conn, char close_fd) {
+    event_loop_remove(loop, conn->fd);
+    if (close_fd) {
+        set_linger_socket_option(conn->fd, 1, 0);
+        close_socket_fd(conn->fd);
+    }
+    conn->fd = INVALID_SOCKET;
+    conn->state = PENDING_CONN_FREE;
+}
+
+// Connections that sent something other than an ack of the session being set up are told so and closed
+static void refuse_pending_conn(EVENT_LOOP *loop, PENDING_CONN *conn, const char *reason) {
+    fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "%s: %.*s\n", reason, (int)conn->rx_len, conn->rx_buff);
+    send(conn->fd, NOT_READY_MSG, NOT_READY_MSG_LEN, 0);
+    free_pending_conn(loop, conn, 1);
+}
+
+// Takes a new connection into a free slot of SERVER_CONN.pending_conns, tagged 'first_tag' plus its index
+static void accept_pending_conn(SERVER_CONN *server_conn, EVENT_LOOP *loop, SOCKET listen_fd, int first_tag, const struct timespec *now) {
+    SOCKET fd = accept_on(server_conn, listen_fd);
+    if (fd == INVALID_SOCKET) {
+        print_last_socket_error("Failed to accept client socket");
+        return;
+    }
+    for (int i = 0; i < MAX_PENDING_CONNS; ++i) {
+        PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+        if (conn->state != PENDING_CONN_FREE) {
+            continue;
+        }
+        // The handshake messages go out right away, Nagle's algorithm is set up per socket once it is known
+        const char is_local = (listen_fd == server_conn->local_fd);
+        if ((!is_local && set_tcp_no_delay(fd, 1) != 0) || event_loop_add(loop, fd, EVENT_LOOP_READ, first_tag + i) != OK) {
+            print_last_socket_error("Failed to set up client socket");
+            break;
+        }
+        conn->fd = fd;
+        conn->is_local = is_local;
+        conn->state = PENDING_CONN_UNKNOWN;
+        conn->accepted = *now;
+        conn->rx_len = 0;
+        return;
+    }
+    reject_connection(fd);
+}
+
+// Closes the sockets of a client that sent DISCONNECT_CMD and frees its slot of SERVER_CONN.draining_conns.
+// Frames still queued are dropped, the buffer is kept for the next client.
+static void finish_draining(SERVER_CONN *server_conn, EVENT_LOOP *loop, DRAINING_CONN *draining) {
+    if (loop != NULL) {
+        event_loop_remove(loop, draining->conn.ctrl_fd);
+    }
+    close_client_conn(&(draining->conn), server_conn);
+    draining->conn = CLIENT_CONN_default;
+    output_queue_reset(&(draining->tx_queue));
+}
+
+static unsigned int draining_interest(const DRAINING_CONN *draining) {
+    return EVENT_LOOP_READ | (output_queue_is_empty(&(draining->tx_queue)) ? 0 : EVENT_LOOP_WRITE);
+}
+
+// Registers the connections still draining with an event loop, the slot at index i as 'first_tag' + i
+static void watch_draining_conns(SERVER_CONN *server_conn, EVENT_LOOP *loop, int first_tag) {
+    for (int i = 0; i < MAX_DRAINING_CONNS; ++i) {
+        DRAINING_CONN *draining = &(server_conn->draining_conns[i]);
+        if (draining->conn.draining && event_loop_add(loop, draining->conn.ctrl_fd, draining_interest(draining), first_tag + i) != OK) {
+            finish_draining(server_conn, NULL, draining);
+        }
+    }
+}
+
+// Sends what the CTRL socket takes of the frames left, drops anything the client still sends, and closes the
+// connection once the client's FIN comes in or its time is up
+static void service_draining_conn(SERVER_CONN *server_conn, EVENT_LOOP *loop, DRAINING_CONN *draining, unsigned int ready, const struct timespec *now) {
+    char done = (ms_left(&(draining->since), DISCONNECT_DRAIN_TIMEOUT_MS, now) == 0);
+    if (!done && (ready & (EVENT_LOOP_READ | EVENT_LOOP_EXCEPT))) {
+        char discarded[64];
+        const ssize_t bytes_recvd = recv(draining->conn.ctrl_fd, discarded, sizeof(discarded), 0);
+        done = (bytes_recvd == 0 || (bytes_recvd < 0 && !is_last_socket_error_would_block()));
+    }
+    if (!done && (ready & EVENT_LOOP_WRITE)) {
+        done = (output_queue_flush(&(draining->tx_queue), draining->conn.ctrl_fd, 0, NULL) != OK);
+        if (!done && output_queue_is_empty(&(draining->tx_queue)) && event_loop_modify(loop, draining->conn.ctrl_fd, EVENT_LOOP_READ) != OK) {
+            done = 1;
+        }
+    }
+    if (done) {
+        finish_draining(server_conn, loop, draining);
+    }
+}
+
+// Same as service_draining_conn() for every slot, 'ready' is indexed by slot
+static void service_draining_conns(SERVER_CONN *server_conn, EVENT_LOOP *loop, const unsigned int *ready) {
+    struct timespec now = { 0, 0 };
+    char have_now = 0;
+    for (int i = 0; i < MAX_DRAINING_CONNS; ++i) {
+        DRAINING_CONN *draining = &(server_conn->draining_conns[i]);
+        if (draining->conn.draining) {
+            if (!have_now) {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                have_now = 1;
+            }
+            service_draining_conn(server_conn, loop, draining, ready[i], &now);
+        }
+    }
+}
+
+// Milliseconds until the next connection is closed whether the client hung up or not, 'wait_ms' if that is sooner
+static int draining_wait_ms(SERVER_CONN *server_conn, int wait_ms) {
+    struct timespec now;
+    char have_now = 0;
+    for (int i = 0; i < MAX_DRAINING_CONNS; ++i) {
+        const DRAINING_CONN *draining = &(server_conn->draining_conns[i]);
+        if (draining->conn.draining) {
+            if (!have_now) {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                have_now = 1;
+            }
+            const int left = ms_left(&(draining->since), DISCONNECT_DRAIN_TIMEOUT_MS, &now);
+            wait_ms = (wait_ms < 0) ? left : MIN_MACRO(wait_ms, left);
+        }
+    }
+    return wait_ms;
+}
+
+// Closes the sockets of the session being set up, the next client to come in is welcomed instead
+static void abandon_session(EVENT_LOOP *loop, CLIENT_CONN *client_conn, PENDING_CONN **welcomed) {
+    SOCKET *fds[] = { &(client_conn->ctrl_fd), &(client_conn->mgmt_fd), &(client_conn->mgmt_rsp_fd), &(client_conn->h2t_data_fd), &(client_conn->t2h_data_fd) };
+    if (*welcomed != NULL) {
+        free_pending_conn(loop, *welcomed, 1);
+        *welcomed = NULL;
+    }
+    if (client_conn->ctrl_fd != INVALID_SOCKET) {
+        event_loop_remove(loop, client_conn->ctrl_fd);
+    }
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+        if (*(fds[i]) != INVALID_SOCKET) {
+            set_linger_socket_option(*(fds[i]), 1, 0);
+            close_socket_fd(*(fds[i]));
+            *(fds[i]) = INVALID_SOCKET;
+        }
+    }
+}
+
+// The CONTROL socket acks the welcome message either as such or, where offered, as a multiplexed connection.
+// NOT_READY is left to the caller.
+static RETURN_CODE ack_control_socket(SERVER_CONN *server_conn, CLIENT_CONN *client_conn, int handle, const char *ack) {
+    ssize_t bytes_transferred;
+    generate_expected_handle_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, MUX_SOCK_NAME, handle);
+    client_conn->is_mux = !server_conn->threaded && strncmp(ack, server_conn->buff->ctrl_tx_buff, MAX_HANDSHAKE_MSG) == 0;
+    if (!client_conn->is_mux) {
+        generate_expected_handle_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, CONTROL_SOCK_NAME, handle);
+    }
+    if (strncmp(ack, server_conn->buff->ctrl_tx_buff, MAX_HANDSHAKE_MSG) != 0) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Got unexpected handle ack message: %s\n\tExpected: %s\n", ack, server_conn->buff->ctrl_tx_buff);
+        return FAILURE;
+    }
+    if (socket_send_all(client_conn->ctrl_fd, READY_MSG, READY_MSG_LEN, 0, &bytes_transferred) != OK) {
+        print_last_socket_error_b("Failed to send handle ready message for CTRL socket", bytes_transferred);
+        return FAILURE;
+    }
+    return OK;
 }
 
-RETURN_CODE connect_client(intel_stream_debug_if_driver_context *context, SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
-    enum { MAX_HANDLE_RSP = 64 };
+RETURN_CODE connect_client(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
+    enum { LISTENER_TAG, LOCAL_LISTENER_TAG, CONTROL_TAG, DRAINING_CONN_TAG, PENDING_CONN_TAG = DRAINING_CONN_TAG + MAX_DRAINING_CONNS, NUM_CHANNELS = 4 };
+    const char *channel_names[NUM_CHANNELS] = { MANAGEMENT_SOCK_NAME, MANAGEMENT_RSP_SOCK_NAME, H2T_SOCK_NAME, T2H_SOCK_NAME };
+    const char channel_nagle[NUM_CHANNELS] = { 0, server_conn->mgmt_rsp_nagle, 0, server_conn->t2h_nagle };
+    SOCKET *channel_fds[NUM_CHANNELS] = { &(client_conn->mgmt_fd), &(client_conn->mgmt_rsp_fd), &(client_conn->h2t_data_fd), &(client_conn->t2h_data_fd) };
     RETURN_CODE result = OK;
     int handle = get_random_id();
     ssize_t bytes_transferred;
 
     server_conn->pkt_stats = SERVER_PKT_STATS_default;
+    clock_gettime(CLOCK_MONOTONIC, &(server_conn->pkt_stats.connect_time));
+    idle_poll_reset(&(server_conn->idle_poll));
 
     // Initialize the driver if required.  Initialization occurs here since it is the first thing run per spec,
-    // and the welcome message requires querying the driver for MGMT support.
-    if (server_conn->hw_callbacks.init_driver != NULL) {
+    // and the welcome message requires querying the driver for MGMT support.  After a clean DISCONNECT the hardware
+    // is taken over as it was left instead, see SERVER_CONN.warm_reconnect.
+    server_conn->pkt_stats.warm_start = server_conn->warm_reconnect && server_conn->hw_clean && !server_conn->full_reset_requested &&
+        server_conn->hw_callbacks.resume_driver != NULL && server_conn->hw_callbacks.resume_driver(server_conn->hw_callbacks.context) == 0;
+    server_conn->hw_clean = 0;
+    server_conn->full_reset_requested = 0;
+    if (!server_conn->pkt_stats.warm_start && server_conn->hw_callbacks.init_driver != NULL) {
         int init_driver_rc;
-        if ((init_driver_rc = server_conn->hw_callbacks.init_driver(context, context->mmio_handle)) != 0) {
+        if ((init_driver_rc = server_conn->hw_callbacks.init_driver(server_conn->hw_callbacks.context, server_conn->hw_callbacks.context->mmio_handle)) != 0) {
             fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Failed to initialize driver: %d\n", init_driver_rc);
             return INIT_ERR; // Early return if driver fails to initialize, client is rejected.
         }
     }
-    
-    // Connect CTRL socket
-    if((client_conn->ctrl_fd = accept(server_conn->server_fd, (struct sockaddr *)(&(server_conn->server_addr)), &sizeof_addr)) == INVALID_SOCKET) {
-        print_last_socket_error("Failed to accept CTRL socket");
-        result = FAILURE;
-    } else {
-        // Send out the welcome message
-        int mgmt_support = server_conn->hw_callbacks.has_mgmt_support != NULL ? server_conn->hw_callbacks.has_mgmt_support() : 0;
-        generate_server_welcome_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, mgmt_support, server_conn->buff, handle);
-        if (socket_send_all(client_conn->ctrl_fd, server_conn->buff->ctrl_tx_buff, strnlen(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz) + 1, 0, &bytes_transferred) == FAILURE) {
-            print_last_socket_error_b("Failed to send welcome message to CTRL socket", bytes_transferred);
-            result = FAILURE;
+    server_conn->hw_clean = 1;
+    int mgmt_support = server_conn->hw_callbacks.has_mgmt_support != NULL ? server_conn->hw_callbacks.has_mgmt_support(server_conn->hw_callbacks.context) : 0;
+
+    // Nothing here blocks: the sockets of any number of clients come in side by side, and each one only has
+    // SERVER_CONN.handshake_timeout_ms to play its part, see PENDING_CONN.  A session that is not complete by
+    // then, or whose CONTROL socket hangs up, is dropped and the next client is welcomed.
+    EVENT_LOOP loop;
+    if (event_loop_init(&loop, server_conn->event_loop_backend) != OK || event_loop_add(&loop, server_conn->server_fd, EVENT_LOOP_READ, LISTENER_TAG) != OK ||
+        (server_conn->local_fd != INVALID_SOCKET && event_loop_add(&loop, server_conn->local_fd, EVENT_LOOP_READ, LOCAL_LISTENER_TAG) != OK)) {
+        print_last_socket_error("Failed to create handshake event loop");
+        event_loop_close(&loop);
+        return FAILURE;
+    }
+    for (int i = 0; i < MAX_PENDING_CONNS; ++i) {
+        PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+        if (conn->state != PENDING_CONN_FREE && event_loop_add(&loop, conn->fd, EVENT_LOOP_READ, PENDING_CONN_TAG + i) != OK) {
+            free_pending_conn(&loop, conn, 1);
         }
     }
-    
-    // Verify CTRL handle response
-    if (result == OK) {
-        if ((result = socket_recv_until_null_reached(client_conn->ctrl_fd, server_conn->buff->ctrl_rx_buff, MAX_HANDLE_RSP, 0, &bytes_transferred)) == OK) {
-            generate_expected_handle_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, CONTROL_SOCK_NAME, handle);
-            if (strncmp(server_conn->buff->ctrl_rx_buff, server_conn->buff->ctrl_tx_buff, MAX_HANDLE_RSP) != 0) {
-                socket_send_all(client_conn->ctrl_fd, NOT_READY_MSG, NOT_READY_MSG_LEN, 0, NULL);
-                fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Got unexpected handle ack message: %s\n\tExpected: %s\n", server_conn->buff->ctrl_rx_buff, server_conn->buff->ctrl_tx_buff);
+    watch_draining_conns(server_conn, &loop, DRAINING_CONN_TAG);
+
+    PENDING_CONN *welcomed = NULL;
+    struct timespec welcome_possible;
+    clock_gettime(CLOCK_MONOTONIC, &welcome_possible);
+    struct timespec ctrl_accepted = { 0, 0 };
+    struct timespec welcome_time = { 0, 0 };
+    int num_channels = 0;
+    char done = 0;
+    while (!done) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        // Give up on what took too long.  Unless it was welcomed, a connection only ever costs its own slot.
+        for (int i = 0; i < MAX_DRAINING_CONNS; ++i) {
+            DRAINING_CONN *draining = &(server_conn->draining_conns[i]);
+            if (draining->conn.draining) {
+                service_draining_conn(server_conn, &loop, draining, 0, &now);
+            }
+        }
+        const char in_setup = (welcomed != NULL || client_conn->ctrl_fd != INVALID_SOCKET);
+        for (int i = 0; i < MAX_PENDING_CONNS; ++i) {
+            PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+            if (conn->state == PENDING_CONN_UNKNOWN && pending_conn_ms_left(conn, in_setup, &welcome_possible, server_conn->handshake_timeout_ms, &now) == 0) {
+                fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Closed a client socket that did not send its handle ack within %lu ms\n", server_conn->handshake_timeout_ms);
+                ++server_conn->handshakes_abandoned;
+                free_pending_conn(&loop, conn, 1);
+            }
+        }
+        if (in_setup && ms_left(&welcome_time, server_conn->handshake_timeout_ms, &now) == 0) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Gave up on a client that did not connect all of its sockets within %lu ms\n", server_conn->handshake_timeout_ms);
+            ++server_conn->handshakes_abandoned;
+            abandon_session(&loop, client_conn, &welcomed);
+            handle = get_random_id();
+            num_channels = 0;
+            welcome_possible = now;
+        }
+
+        // Welcome the connection that came in first among those that have not sent anything, unless a session is
+        // being set up already.  Anything else it might be, it would have said so.
+        if (welcomed == NULL && client_conn->ctrl_fd == INVALID_SOCKET) {
+            for (int i = 0; i < MAX_PENDING_CONNS; ++i) {
+                PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+                if (conn->state == PENDING_CONN_UNKNOWN && conn->rx_len == 0 && (welcomed == NULL || elapsed_ns(&(conn->accepted), &(welcomed->accepted)) > 0)) {
+                    welcomed = conn;
+                }
+            }
+            if (welcomed != NULL) {
+                generate_server_welcome_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, mgmt_support, !server_conn->threaded, server_conn->buff, handle);
+                if (socket_send_all(welcomed->fd, server_conn->buff->ctrl_tx_buff, strnlen(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz) + 1, 0, &bytes_transferred) == FAILURE) {
+                    print_last_socket_error_b("Failed to send welcome message to CTRL socket", bytes_transferred);
+                    free_pending_conn(&loop, welcomed, 1);
+                    welcomed = NULL;
+                    continue;
+                }
+                welcomed->state = PENDING_CONN_WELCOMED;
+                ctrl_accepted = welcomed->accepted;
+                welcome_time = now;
+            }
+        }
+
+        // Wait until the next connection or message comes in, or the next deadline
+        int timeout_ms = EVENT_LOOP_INFINITE_TIMEOUT;
+        for (int i = 0; i < MAX_PENDING_CONNS; ++i) {
+            const PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+            const int left = (conn->state == PENDING_CONN_UNKNOWN) ?
+                pending_conn_ms_left(conn, welcomed != NULL || client_conn->ctrl_fd != INVALID_SOCKET, &welcome_possible, server_conn->handshake_timeout_ms, &now) :
+                EVENT_LOOP_INFINITE_TIMEOUT;
+            if (left >= 0) {
+                timeout_ms = (timeout_ms < 0) ? left : MIN_MACRO(timeout_ms, left);
+            }
+        }
+        if (welcomed != NULL || client_conn->ctrl_fd != INVALID_SOCKET) {
+            const int left = ms_left(&welcome_time, server_conn->handshake_timeout_ms, &now);
+            timeout_ms = (timeout_ms < 0) ? left : MIN_MACRO(timeout_ms, left);
+        }
+        timeout_ms = draining_wait_ms(server_conn, timeout_ms);
+        EVENT_LOOP_EVENT events[EVENT_LOOP_MAX_SOURCES];
+        const int num_events = event_loop_wait(&loop, events, EVENT_LOOP_MAX_SOURCES, timeout_ms);
+        if (num_events < 0) {
+            print_last_socket_error("Failed to wait for a client");
+            result = FAILURE;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        // New connections last, a slot freed meanwhile could otherwise be taken while an event for it is pending
+        for (int e = 0; e < num_events; ++e) {
+            if (events[e].tag == CONTROL_TAG) {
+                // Only ever reported once the client hung up, it has nothing to say until the last READY
+                fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Client hung up before connecting all of its sockets\n");
+                abandon_session(&loop, client_conn, &welcomed);
+                handle = get_random_id();
+                num_channels = 0;
+                welcome_possible = now;
+            } else if (events[e].tag >= DRAINING_CONN_TAG && events[e].tag < PENDING_CONN_TAG) {
+                DRAINING_CONN *draining = &(server_conn->draining_conns[events[e].tag - DRAINING_CONN_TAG]);
+                if (draining->conn.draining) {
+                    service_draining_conn(server_conn, &loop, draining, events[e].ready, &now);
+                }
+            } else if (events[e].tag >= PENDING_CONN_TAG) {
+                PENDING_CONN *conn = &(server_conn->pending_conns[events[e].tag - PENDING_CONN_TAG]);
+                if (conn->state == PENDING_CONN_FREE) {
+                    continue;
+                }
+                const ssize_t bytes_recvd = recv(conn->fd, conn->rx_buff + conn->rx_len, MAX_HANDSHAKE_MSG - conn->rx_len, 0);
+                if (bytes_recvd > 0) {
+                    conn->rx_len += (size_t)bytes_recvd;
+                } else if (conn == welcomed) {
+                    print_last_socket_error_b("Failed to recv handle ack message for CTRL socket", bytes_recvd);
+                    abandon_session(&loop, client_conn, &welcomed);
+                    handle = get_random_id();
+                    welcome_possible = now;
+                } else {
+                    free_pending_conn(&loop, conn, 1);
+                }
+            }
+        }
+        for (int e = 0; e < num_events; ++e) {
+            if (events[e].tag == LISTENER_TAG) {
+                accept_pending_conn(server_conn, &loop, server_conn->server_fd, PENDING_CONN_TAG, &now);
+            } else if (events[e].tag == LOCAL_LISTENER_TAG) {
+                accept_pending_conn(server_conn, &loop, server_conn->local_fd, PENDING_CONN_TAG, &now);
+            }
+        }
+
+        // The CONTROL socket is acked first, the others of its session may have come in before that
+        if (welcomed != NULL && (memchr(welcomed->rx_buff, '\0', welcomed->rx_len) != NULL || welcomed->rx_len == MAX_HANDSHAKE_MSG)) {
+            welcomed->rx_buff[MAX_HANDSHAKE_MSG - 1] = '\0';
+            client_conn->ctrl_fd = welcomed->fd;
+            client_conn->is_local = welcomed->is_local;
+            result = ack_control_socket(server_conn, client_conn, handle, welcomed->rx_buff);
+            free_pending_conn(&loop, welcomed, 0);
+            welcomed = NULL;
+            if (result != OK) {
+                break;
+            }
+            // A multiplexed connection carries every stream and is the only one to set up
+            if (client_conn->is_mux) {
+                done = 1;
+                break;
+            }
+            // From here on the CONTROL socket is only watched for a hang-up
+            if (event_loop_add(&loop, client_conn->ctrl_fd, 0, CONTROL_TAG) != OK) {
+                print_last_socket_error("Failed to register CTRL socket with handshake event loop");
                 result = FAILURE;
-            } else {
-                if ((result = socket_send_all(client_conn->ctrl_fd, READY_MSG, READY_MSG_LEN, 0, &bytes_transferred)) != OK) {
-                    print_last_socket_error_b("Failed to send handle ready message for CTRL socket", bytes_transferred);
+                break;
+            }
+        }
+
+        for (int i = 0; i < MAX_PENDING_CONNS && result == OK; ++i) {
+            PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+            if (conn->state != PENDING_CONN_UNKNOWN || conn->rx_len == 0) {
+                continue;
+            }
+            if (memchr(conn->rx_buff, '\0', conn->rx_len) == NULL) {
+                if (conn->rx_len == MAX_HANDSHAKE_MSG) {
+                    refuse_pending_conn(&loop, conn, "Got an overlong handle ack message");
                 }
+                continue;
+            }
+            if (parse_handle_id(conn->rx_buff) != handle || (welcomed == NULL && client_conn->ctrl_fd == INVALID_SOCKET)) {
+                refuse_pending_conn(&loop, conn, "Got a handle ack message for another session");
+                continue;
+            }
+            if (client_conn->ctrl_fd == INVALID_SOCKET) {
+                continue; // Picked up once the CONTROL socket has acked
+            }
+            int channel = 0;
+            for (; channel < NUM_CHANNELS; ++channel) {
+                generate_expected_handle_message(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, channel_names[channel], handle);
+                if (*(channel_fds[channel]) == INVALID_SOCKET && strncmp(conn->rx_buff, server_conn->buff->ctrl_tx_buff, MAX_HANDSHAKE_MSG) == 0) {
+                    break;
+                }
+            }
+            // The sockets of a client all come in on the listener of its CONTROL socket
+            if (channel == NUM_CHANNELS || conn->is_local != client_conn->is_local) {
+                refuse_pending_conn(&loop, conn, "Got unexpected handle ack message");
+                continue;
+            }
+            *(channel_fds[channel]) = conn->fd;
+            free_pending_conn(&loop, conn, 0);
+            ++num_channels;
+
+            // Nagle's algorithm is a TCP matter, local sockets send right away
+            if ((!client_conn->is_local && set_tcp_no_delay(*(channel_fds[channel]), channel_nagle[channel] ? 0 : 1) != 0) ||
+                socket_send_all(*(channel_fds[channel]), READY_MSG, READY_MSG_LEN, 0, &bytes_transferred) != OK) {
+                snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "Failed to set up %s socket", channel_names[channel]);
+                print_last_socket_error(server_conn->buff->ctrl_tx_buff);
+                result = FAILURE;
             }
-        } else {
-            print_last_socket_error_b("Failed to recv handle ack message for CTRL socket", bytes_transferred);
+        }
+        if (result == OK && num_channels == NUM_CHANNELS) {
+            if ((result = socket_send_all(client_conn->ctrl_fd, READY_MSG, READY_MSG_LEN, 0, &bytes_transferred)) != OK) {
+                print_last_socket_error_b("Failed to send ready message to CTRL socket", bytes_transferred);
+            }
+            done = 1;
         }
     }
 
-    if (result == OK) {
-        result = connect_client_socket(server_conn, handle, &(client_conn->mgmt_fd), MANAGEMENT_SOCK_NAME, 0);
-    }
-    if (result == OK) {
-        result = connect_client_socket(server_conn, handle, &(client_conn->mgmt_rsp_fd), MANAGEMENT_RSP_SOCK_NAME, server_conn->mgmt_rsp_nagle);
-    }
-    if (result == OK) {
-        result = connect_client_socket(server_conn, handle, &(client_conn->h2t_data_fd), H2T_SOCK_NAME, 0);
+    if (welcomed != NULL) {
+        // Left to close_client_conn(), as are the sockets of the session
+        client_conn->ctrl_fd = welcomed->fd;
+        free_pending_conn(&loop, welcomed, 0);
     }
     if (result == OK) {
-        result = connect_client_socket(server_conn, handle, &(client_conn->t2h_data_fd), T2H_SOCK_NAME, server_conn->t2h_nagle);
-    }
-    
-    if (result != OK) {
-        if (client_conn->ctrl_fd != INVALID_SOCKET) {
-            send(client_conn->ctrl_fd, NOT_READY_MSG, NOT_READY_MSG_LEN, 0);
-        }
-        return FAILURE;
-    } else {
-        if (socket_send_all(client_conn->ctrl_fd, READY_MSG, READY_MSG_LEN, 0, &bytes_transferred) == OK) {
-            return OK;
-        } else {
-            print_last_socket_error_b("Failed to send ready message to CTRL socket", bytes_transferred);
-            return FAILURE;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        server_conn->hw_clean = 0; // Until the client sends DISCONNECT_CMD
+        server_conn->pkt_stats.setup_us = (unsigned long long)MAX_MACRO(elapsed_ns(&ctrl_accepted, &now), 0) / 1000;
+
+        // Whoever else came in meanwhile is turned away, as they would be while the client is served
+        for (int i = 0; i < MAX_PENDING_CONNS; ++i) {
+            PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+            if (conn->state != PENDING_CONN_FREE) {
+                const SOCKET fd = conn->fd;
+                free_pending_conn(&loop, conn, 0);
+                reject_connection(fd);
+            }
         }
+    } else if (client_conn->ctrl_fd != INVALID_SOCKET) {
+        send(client_conn->ctrl_fd, NOT_READY_MSG, NOT_READY_MSG_LEN, 0);
     }
+    event_loop_close(&loop);
+    return result;
 }
 
 RETURN_CODE close_client_conn(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
@@ -346,6 +1004,48 @@ RETURN_CODE close_client_conn(CLIENT_CONN *client_conn, SERVER_CONN *server_conn
     }
 }
 
+// Hands the sockets of a client that sent DISCONNECT_CMD over to the event loops that follow, see DRAINING_CONN.
+// With all slots taken, the one that has been waiting longest is closed.  Mux frames not sent yet go along with the
+// sockets, the slot's own buffer becomes the next session's SERVER_CONN.mux_tx_queue.
+static void start_draining(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
+    DRAINING_CONN *slot = &(server_conn->draining_conns[0]);
+    for (int i = 0; i < MAX_DRAINING_CONNS; ++i) {
+        DRAINING_CONN *draining = &(server_conn->draining_conns[i]);
+        if (!draining->conn.draining) {
+            slot = draining;
+            break;
+        }
+        if (elapsed_ns(&(draining->since), &(slot->since)) > 0) {
+            slot = draining;
+        }
+    }
+    if (slot->conn.draining) {
+        finish_draining(server_conn, NULL, slot);
+    }
+    if (client_conn->is_mux && !output_queue_is_empty(&(server_conn->mux_tx_queue))) {
+        OUTPUT_QUEUE *mux_queue = &(server_conn->mux_tx_queue);
+        RETURN_CODE rc;
+        if (slot->tx_queue.buff == NULL) {
+            slot->tx_queue.high_water_mark = mux_queue->high_water_mark;
+            rc = output_queue_alloc(&(slot->tx_queue), mux_queue->max_packet_sz);
+        } else {
+            rc = output_queue_set_high_water_mark(&(slot->tx_queue), mux_queue->high_water_mark);
+        }
+        if (rc == OK) {
+            const OUTPUT_QUEUE unsent = *mux_queue;
+            *mux_queue = slot->tx_queue;
+            slot->tx_queue = unsent;
+            output_queue_reset(mux_queue);
+        } else {
+            fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Dropped %zu bytes queued for a disconnecting client.\n", output_queue_len(mux_queue));
+            output_queue_reset(mux_queue);
+        }
+    }
+    slot->conn = *client_conn;
+    clock_gettime(CLOCK_MONOTONIC, &(slot->since));
+    *client_conn = CLIENT_CONN_default;
+}
+
 const char *get_parameter(char *cmd, SERVER_CONN *server_conn) {
     const char *param_name = strstr(cmd, GET_PARAM_CMD) + GET_PARAM_CMD_LEN;
     if (strncmp(param_name, SERVER_LOOPBACK_MODE_PARAM, SERVER_LOOPBACK_MODE_PARAM_LEN) == 0) {
@@ -365,11 +1065,70 @@ const char *get_parameter(char *cmd, SERVER_CONN *server_conn) {
     } else if (strncmp(param_name, MGMT_RSP_NAGLE_PARAM, MGMT_RSP_NAGLE_PARAM_LEN) == 0) {
         snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%d", (int)(server_conn->mgmt_rsp_nagle));
         return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, T2H_HIGH_WATER_MARK_PARAM, T2H_HIGH_WATER_MARK_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%ld", server_conn->t2h_queue.high_water_mark);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, MGMT_RSP_HIGH_WATER_MARK_PARAM, MGMT_RSP_HIGH_WATER_MARK_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%ld", server_conn->mgmt_rsp_queue.high_water_mark);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, T2H_BATCH_SIZE_PARAM, T2H_BATCH_SIZE_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%ld", server_conn->t2h_batch_size);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, POLL_SPIN_US_PARAM, POLL_SPIN_US_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%lu", server_conn->idle_poll.spin_us);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, POLL_SLEEP_US_PARAM, POLL_SLEEP_US_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%lu", server_conn->idle_poll.sleep_us);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, POLL_MAX_WAIT_MS_PARAM, POLL_MAX_WAIT_MS_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%lu", server_conn->idle_poll.max_wait_ms);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, POLL_STATE_TIME_US_PARAM, POLL_STATE_TIME_US_PARAM_LEN) == 0) {
+        // Time spent spinning, sleeping and waiting while polling the hardware, since the client connected
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%llu %llu %llu", server_conn->idle_poll.time_ns[IDLE_POLL_SPIN] / 1000,
+                 server_conn->idle_poll.time_ns[IDLE_POLL_SLEEP] / 1000, server_conn->idle_poll.time_ns[IDLE_POLL_WAIT] / 1000);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, HW_WRITES_SAVED_PER_SEC_PARAM, HW_WRITES_SAVED_PER_SEC_PARAM_LEN) == 0) {
+        // Averaged over the time the client has been connected
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (double)(now.tv_sec - server_conn->pkt_stats.connect_time.tv_sec) +
+                         (now.tv_nsec - server_conn->pkt_stats.connect_time.tv_nsec) / 1e9;
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%.0f",
+                 (elapsed > 0) ? server_conn->pkt_stats.hw_writes_saved / elapsed : 0.0);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, SESSION_SETUP_US_PARAM, SESSION_SETUP_US_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%llu", server_conn->pkt_stats.setup_us);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, WARM_START_PARAM, WARM_START_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%d", server_conn->pkt_stats.warm_start);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, FULL_RESET_PARAM, FULL_RESET_PARAM_LEN) == 0) {
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%d", server_conn->full_reset_requested);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, HANDSHAKES_ABANDONED_PARAM, HANDSHAKES_ABANDONED_PARAM_LEN) == 0) {
+        // Since the server started
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%lu", (unsigned long)server_conn->handshakes_abandoned);
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, CONNS_REJECTED_PARAM, CONNS_REJECTED_PARAM_LEN) == 0) {
+        // Since the server started, while a client was served
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%lu", (unsigned long)__atomic_load_n(&(server_conn->conns_rejected), __ATOMIC_RELAXED));
+        return server_conn->buff->ctrl_tx_buff;
+    } else if (strncmp(param_name, REJECTS_RATE_LIMITED_PARAM, REJECTS_RATE_LIMITED_PARAM_LEN) == 0) {
+        // Part of CONNS_REJECTED, reset without the rejection message
+        snprintf(server_conn->buff->ctrl_tx_buff, server_conn->buff->ctrl_tx_buff_sz, "%lu", (unsigned long)__atomic_load_n(&(server_conn->rejects_rate_limited), __ATOMIC_RELAXED));
+        return server_conn->buff->ctrl_tx_buff;
     } else {
         return GET_PARAM_CMD_FAIL_RSP;
     }
 }
 
+// Nagle's algorithm is a TCP matter, a local client's sockets send right away whatever the value, see connect_client().
+// A multiplexed client's streams share the CTRL socket, which has to send right away for the commands.
+static int set_stream_nagle(CLIENT_CONN *client_conn, SOCKET fd, char nagle) {
+    return (client_conn->is_local || client_conn->is_mux) ? 0 : set_tcp_no_delay(fd, nagle ? 0 : 1);
+}
+
 const char *set_parameter(char *cmd, SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
     const char *param_name = strstr(cmd, SET_PARAM_CMD);
     const char *param_value;
@@ -383,11 +1142,18 @@ const char *set_parameter(char *cmd, SERVER_CONN *server_conn, CLIENT_CONN *clie
             server_conn->loopback_mode = (*param_value == '1' ? 1 : 0);
             return SET_PARAM_CMD_RSP;
         }
+    } else if (strstr(param_name, FULL_RESET_PARAM) == param_name) {
+        // Applies to the next client, this one keeps the hardware as it is
+        param_value = param_name + FULL_RESET_PARAM_LEN;
+        if (strnlen(param_value, 1) == 1) {
+            server_conn->full_reset_requested = (*param_value == '1' ? 1 : 0);
+            return SET_PARAM_CMD_RSP;
+        }
     } else if (strstr(param_name, T2H_NAGLE_PARAM) == param_name) {
         param_value = param_name + T2H_NAGLE_PARAM_LEN;
         if (strnlen(param_value, 1) == 1) {
             const char t2h_nagle = (*param_value == '1' ? 1 : 0);
-            if (set_tcp_no_delay(client_conn->t2h_data_fd, t2h_nagle ? 0 : 1) == 0) {
+            if (set_stream_nagle(client_conn, client_conn->t2h_data_fd, t2h_nagle) == 0) {
                 server_conn->t2h_nagle = t2h_nagle;
                 return SET_PARAM_CMD_RSP;
             }
@@ -396,19 +1162,65 @@ const char *set_parameter(char *cmd, SERVER_CONN *server_conn, CLIENT_CONN *clie
         param_value = param_name + MGMT_RSP_NAGLE_PARAM_LEN;
         if (strnlen(param_value, 1) == 1) {
             const char mgmt_rsp_nagle = (*param_value == '1' ? 1 : 0);
-            if (set_tcp_no_delay(client_conn->mgmt_rsp_fd, mgmt_rsp_nagle ? 0 : 1) == 0) {
+            if (set_stream_nagle(client_conn, client_conn->mgmt_rsp_fd, mgmt_rsp_nagle) == 0) {
                 server_conn->mgmt_rsp_nagle = mgmt_rsp_nagle;
                 return SET_PARAM_CMD_RSP;
             }
         }
-    }
-    return SET_PARAM_CMD_FAIL_RSP;
-}
-
-const char *get_driver_parameter(char *cmd, SERVER_CONN *server_conn) {
-    if (server_conn->hw_callbacks.get_param != NULL) {
+    } else if (strstr(param_name, T2H_HIGH_WATER_MARK_PARAM) == param_name) {
+        char *param_end;
+        param_value = param_name + T2H_HIGH_WATER_MARK_PARAM_LEN;
+        const unsigned long high_water_mark = strtoul(param_value, &param_end, 0);
+        if (param_end != param_value && output_queue_set_high_water_mark(&(server_conn->t2h_queue), high_water_mark) == OK) {
+            return SET_PARAM_CMD_RSP;
+        }
+    } else if (strstr(param_name, MGMT_RSP_HIGH_WATER_MARK_PARAM) == param_name) {
+        char *param_end;
+        param_value = param_name + MGMT_RSP_HIGH_WATER_MARK_PARAM_LEN;
+        const unsigned long high_water_mark = strtoul(param_value, &param_end, 0);
+        if (param_end != param_value && output_queue_set_high_water_mark(&(server_conn->mgmt_rsp_queue), high_water_mark) == OK) {
+            return SET_PARAM_CMD_RSP;
+        }
+    } else if (strstr(param_name, T2H_BATCH_SIZE_PARAM) == param_name) {
+        char *param_end;
+        param_value = param_name + T2H_BATCH_SIZE_PARAM_LEN;
+        const unsigned long batch_size = strtoul(param_value, &param_end, 0);
+        if (param_end != param_value && batch_size > 0) {
+            server_conn->t2h_batch_size = batch_size;
+            return SET_PARAM_CMD_RSP;
+        }
+    } else if (strstr(param_name, POLL_SPIN_US_PARAM) == param_name) {
+        char *param_end;
+        param_value = param_name + POLL_SPIN_US_PARAM_LEN;
+        const unsigned long spin_us = strtoul(param_value, &param_end, 0);
+        if (param_end != param_value) {
+            server_conn->idle_poll.spin_us = spin_us;
+            return SET_PARAM_CMD_RSP;
+        }
+    } else if (strstr(param_name, POLL_SLEEP_US_PARAM) == param_name) {
+        char *param_end;
+        param_value = param_name + POLL_SLEEP_US_PARAM_LEN;
+        const unsigned long sleep_us = strtoul(param_value, &param_end, 0);
+        if (param_end != param_value) {
+            server_conn->idle_poll.sleep_us = sleep_us;
+            return SET_PARAM_CMD_RSP;
+        }
+    } else if (strstr(param_name, POLL_MAX_WAIT_MS_PARAM) == param_name) {
+        char *param_end;
+        param_value = param_name + POLL_MAX_WAIT_MS_PARAM_LEN;
+        const unsigned long max_wait_ms = strtoul(param_value, &param_end, 0);
+        if (param_end != param_value && max_wait_ms <= INT_MAX) {
+            server_conn->idle_poll.max_wait_ms = max_wait_ms;
+            return SET_PARAM_CMD_RSP;
+        }
+    }
+    return SET_PARAM_CMD_FAIL_RSP;
+}
+
+const char *get_driver_parameter(char *cmd, SERVER_CONN *server_conn) {
+    if (server_conn->hw_callbacks.get_param != NULL) {
         const char *param_name = strstr(cmd, GET_DRIVER_PARAM_CMD) + GET_DRIVER_PARAM_CMD_LEN;
-        const char *result = server_conn->hw_callbacks.get_param(param_name);
+        const char *result = server_conn->hw_callbacks.get_param(server_conn->hw_callbacks.context, param_name);
         if (result != NULL) {
             return result;
         }
@@ -431,7 +1243,7 @@ const char *set_driver_parameter(char *cmd, SERVER_CONN *server_conn) {
         for (size_t i = 0; i < MIN_MACRO(param_name_len, MAX_DRIVER_PARAM_NAME_LEN); ++i) {
             param_name_buff[i] = param_name[i];
         }
-        if (server_conn->hw_callbacks.set_param(param_name_buff, param_value) >= 0) {
+        if (server_conn->hw_callbacks.set_param(server_conn->hw_callbacks.context, param_name_buff, param_value) >= 0) {
             return SET_PARAM_CMD_RSP;
         }
     }
@@ -439,31 +1251,190 @@ const char *set_driver_parameter(char *cmd, SERVER_CONN *server_conn) {
     return SET_PARAM_CMD_FAIL_RSP;
 }
 
+// Multiplexed clients, see MUX_SOCK_NAME.  Frames the bytes of 'queue' as 'stream' for as long as the multiplexed
+// output queue is below its high-water mark, and sends out as much as the socket accepts.
+static RETURN_CODE flush_mux_stream(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, unsigned char stream, OUTPUT_QUEUE *queue, ssize_t *bytes_sent) {
+    OUTPUT_QUEUE *mux_queue = &(server_conn->mux_tx_queue);
+    while (!output_queue_is_empty(queue) && !output_queue_is_full(mux_queue)) {
+        // Below the high-water mark there is always room for a frame of any size
+        const size_t len = MIN_MACRO(output_queue_len(queue), MUX_FRAME_MAX_PAYLOAD_BYTES);
+        char *frame = output_queue_reserve(mux_queue, SIZEOF_MUX_FRAME_HEADER + len);
+        populate_mux_frame_header_bytes((unsigned char *)frame, stream, (unsigned short)len);
+        memcpy(frame + SIZEOF_MUX_FRAME_HEADER, output_queue_peek(queue), len);
+        output_queue_commit(mux_queue, SIZEOF_MUX_FRAME_HEADER + len);
+        output_queue_consume(queue, len);
+    }
+    return output_queue_flush(mux_queue, client_conn->ctrl_fd, 0, bytes_sent);
+}
+
+// Moves the frames received from a multiplexed client to the queues of their streams, for as long as these have
+// room.  A stream that is held up holds up the frames behind it, as it would on any single connection.
+static RETURN_CODE demux_frames(SERVER_CONN *server_conn) {
+    INPUT_QUEUE *queue = &(server_conn->mux_rx_queue);
+    while (input_queue_len(queue) > 0) {
+        if (server_conn->mux_rx_remaining == 0) {
+            MUX_FRAME_HEADER header;
+            if (input_queue_len(queue) < SIZEOF_MUX_FRAME_HEADER) {
+                break;
+            }
+            parse_mux_frame_header_bytes((const unsigned char *)input_queue_peek(queue), &header);
+            input_queue_consume(queue, SIZEOF_MUX_FRAME_HEADER);
+            if (header.STREAM != MUX_STREAM_CONTROL && header.STREAM != MUX_STREAM_MGMT && header.STREAM != MUX_STREAM_H2T) {
+                fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Unexpected stream in multiplexed frame: %d\n", header.STREAM);
+                return FAILURE;
+            }
+            server_conn->mux_rx_stream = header.STREAM;
+            server_conn->mux_rx_remaining = header.DATA_LEN_BYTES;
+            continue;
+        }
+
+        INPUT_QUEUE *dst = (server_conn->mux_rx_stream == MUX_STREAM_CONTROL) ? &(server_conn->ctrl_rx_queue) :
+                           (server_conn->mux_rx_stream == MUX_STREAM_MGMT) ? &(server_conn->mgmt_rx_queue) : &(server_conn->h2t_rx_queue);
+        size_t room;
+        char *buff = input_queue_reserve(dst, MIN_MACRO(server_conn->mux_rx_remaining, input_queue_len(queue)), &room);
+        if (room == 0) {
+            break;
+        }
+        memcpy(buff, input_queue_peek(queue), room);
+        input_queue_commit(dst, room);
+        input_queue_consume(queue, room);
+        server_conn->mux_rx_remaining -= room;
+    }
+    return OK;
+}
+
+// A whole CTRL message has been demultiplexed, or more than a message may hold
+static char has_mux_control_message(SERVER_CONN *server_conn) {
+    const INPUT_QUEUE *queue = &(server_conn->ctrl_rx_queue);
+    return memchr(input_queue_peek(queue), '\0', input_queue_len(queue)) != NULL || input_queue_len(queue) >= server_conn->buff->ctrl_rx_buff_sz;
+}
+
+// A whole MGMT packet has been demultiplexed, or the payload of the one waiting on buffer space
+static char has_mux_mgmt_packet(SERVER_CONN *server_conn) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER;
+    const size_t received = input_queue_len(&(server_conn->mgmt_rx_queue));
+    if (server_conn->mgmt_waiting) {
+        return 1;
+    }
+    if (received < header_sz) {
+        return 0;
+    }
+    // Copied out, the header need not be aligned in the queue
+    MGMT_PACKET_HEADER header;
+    memcpy(&header, (const char *)input_queue_peek(&(server_conn->mgmt_rx_queue)) + SIZEOF_PACKET_GUARDBAND, sizeof(header));
+    return received >= header_sz + (size_t)(header.DATA_LEN_BYTES & MGMT_PACKET_HEADER_MASK_DATA_LEN_BYTES);
+}
+
+static RETURN_CODE recv_control_message(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, ssize_t *bytes_recvd) {
+    if (!client_conn->is_mux) {
+        return socket_recv_until_null_reached(client_conn->ctrl_fd, server_conn->buff->ctrl_rx_buff, server_conn->buff->ctrl_rx_buff_sz, 0, bytes_recvd);
+    }
+    INPUT_QUEUE *queue = &(server_conn->ctrl_rx_queue);
+    const char *end = (const char *)memchr(input_queue_peek(queue), '\0', MIN_MACRO(input_queue_len(queue), server_conn->buff->ctrl_rx_buff_sz));
+    if (end == NULL) {
+        *bytes_recvd = 0;
+        return FAILURE;
+    }
+    const size_t len = end - input_queue_peek(queue) + 1;
+    memcpy(server_conn->buff->ctrl_rx_buff, input_queue_peek(queue), len);
+    input_queue_consume(queue, len);
+    *bytes_recvd = (ssize_t)len;
+    return OK;
+}
+
+static RETURN_CODE send_control_response(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, const char *rsp, size_t len, ssize_t *bytes_sent) {
+    if (!client_conn->is_mux) {
+        return socket_send_all(client_conn->ctrl_fd, rsp, len, 0, bytes_sent);
+    }
+    // CTRL messages are only taken in below the high-water mark, so there is room for the response
+    char *frame = output_queue_reserve(&(server_conn->mux_tx_queue), SIZEOF_MUX_FRAME_HEADER + len);
+    if (frame == NULL) {
+        if (bytes_sent != NULL) {
+            *bytes_sent = 0;
+        }
+        return FAILURE;
+    }
+    populate_mux_frame_header_bytes((unsigned char *)frame, MUX_STREAM_CONTROL, (unsigned short)len);
+    memcpy(frame + SIZEOF_MUX_FRAME_HEADER, rsp, len);
+    output_queue_commit(&(server_conn->mux_tx_queue), SIZEOF_MUX_FRAME_HEADER + len);
+    return output_queue_flush(&(server_conn->mux_tx_queue), client_conn->ctrl_fd, 0, bytes_sent);
+}
+
+// SHM_ATTACH_CMD, optionally followed by the size of each ring.  Only a local client may attach, and only while
+// nothing is in flight on its H2T / T2H sockets: anything it sends on them afterwards is taken for a hang-up.
+static RETURN_CODE attach_shm_transport(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
+    const char *arg = server_conn->buff->ctrl_rx_buff + SHM_ATTACH_CMD_LEN - 1;
+    const size_t ring_sz = (*arg == ' ') ? strtoul(arg + 1, NULL, 0) : SHM_TRANSPORT_DEFAULT_RING_SZ;
+    int fds[SHM_TRANSPORT_NUM_FDS];
+    if (!client_conn->is_local || client_conn->is_mux || server_conn->threaded || server_conn->shm.layout != NULL ||
+        input_queue_len(&(server_conn->h2t_rx_queue)) != 0 ||
+        !output_queue_is_empty(&(server_conn->t2h_queue)) || shm_transport_create(&(server_conn->shm), ring_sz, fds) != OK) {
+        return send_control_response(client_conn, server_conn, SHM_ATTACH_CMD_FAIL_RSP, SHM_ATTACH_CMD_FAIL_RSP_LEN, NULL);
+    }
+    if (shm_transport_send_fds(client_conn->ctrl_fd, SHM_ATTACH_CMD_RSP, SHM_ATTACH_CMD_RSP_LEN, fds, SHM_TRANSPORT_NUM_FDS) != OK) {
+        shm_transport_close(&(server_conn->shm));
+        return FAILURE;
+    }
+    return OK;
+}
+
+// Nothing is left half way between the client and the hardware: no inbound packet partly received or waiting for
+// room in the IP, no outbound data queued.  Only then may the next client take the hardware over, see hw_clean.
+static char is_between_packets(SERVER_CONN *server_conn) {
+    if (server_conn->h2t_waiting || server_conn->mgmt_waiting || server_conn->mux_rx_remaining > 0 ||
+        input_queue_len(&(server_conn->h2t_rx_queue)) != 0 || input_queue_len(&(server_conn->mgmt_rx_queue)) != 0 ||
+        !output_queue_is_empty(&(server_conn->t2h_queue)) || !output_queue_is_empty(&(server_conn->mgmt_rsp_queue)) ||
+        !output_queue_is_empty(&(server_conn->mux_tx_queue))) {
+        return 0;
+    }
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    // The engine only consumes whole packets from its rings, see mmio_engine_main()
+    MMIO_ENGINE *engine = server_conn->engine;
+    if (engine != NULL && (spsc_ring_readable(&(engine->h2t_ring), 1) > 0 || spsc_ring_readable(&(engine->mgmt_ring), 1) > 0 ||
+                           spsc_ring_readable(&(engine->t2h_ring), 1) > 0 || spsc_ring_readable(&(engine->mgmt_rsp_ring), 1) > 0)) {
+        return 0;
+    }
+#endif
+    return 1;
+}
+
 RETURN_CODE process_control_message(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, char *disconnect_client) {
     ssize_t bytes_transferred;
     RETURN_CODE result;
-    if (socket_recv_until_null_reached(client_conn->ctrl_fd, server_conn->buff->ctrl_rx_buff, server_conn->buff->ctrl_rx_buff_sz, 0, &bytes_transferred) == OK) {
+    if (recv_control_message(client_conn, server_conn, &bytes_transferred) == OK) {
         if (strstr(server_conn->buff->ctrl_rx_buff, GET_PARAM_CMD) == server_conn->buff->ctrl_rx_buff) {
             const char *resp = get_parameter(server_conn->buff->ctrl_rx_buff, server_conn);
-            result = socket_send_all(client_conn->ctrl_fd, resp, strnlen(resp, MAX_SERVER_PARAM_VALUE_LEN) + 1, 0, &bytes_transferred);
+            result = send_control_response(client_conn, server_conn, resp, strnlen(resp, MAX_SERVER_PARAM_VALUE_LEN) + 1, &bytes_transferred);
         } else if (strncmp(server_conn->buff->ctrl_rx_buff, PING_CMD, PING_CMD_LEN) == 0) {
-            result = socket_send_all(client_conn->ctrl_fd, PING_CMD_RSP, PING_CMD_RSP_LEN, 0, &bytes_transferred);
+            result = send_control_response(client_conn, server_conn, PING_CMD_RSP, PING_CMD_RSP_LEN, &bytes_transferred);
         } else if (strncmp(server_conn->buff->ctrl_rx_buff, DISCONNECT_CMD, DISCONNECT_CMD_LEN) == 0) {
-            socket_send_all(client_conn->ctrl_fd, DISCONNECT_CMD_RSP, DISCONNECT_CMD_RSP_LEN, 0, NULL);
-            wait_for_read_event(client_conn->ctrl_fd, 10, 0); // Wait 10 seconds at most for the client to close first
+            // Checked before the response is queued, a packet cut short has the next client start from a reset IP
+            const char between_packets = is_between_packets(server_conn);
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+            // Whoever connects once the client got the response is the next client
+            acceptor_join(server_conn);
+#endif
+            send_control_response(client_conn, server_conn, DISCONNECT_CMD_RSP, DISCONNECT_CMD_RSP_LEN, NULL);
+            // The client closes first, the next session is set up meanwhile, see DRAINING_CONN.  Mux frames still
+            // queued go out from there, within the same deadline.
+            client_conn->draining = 1;
+            server_conn->hw_clean = between_packets;
             *disconnect_client = 1;
             result = OK;
         } else if (strstr(server_conn->buff->ctrl_rx_buff, SET_PARAM_CMD) == server_conn->buff->ctrl_rx_buff) {
             const char *resp = set_parameter(server_conn->buff->ctrl_rx_buff, server_conn, client_conn);
-            result = socket_send_all(client_conn->ctrl_fd, resp, strnlen(resp, 128) + 1, 0, &bytes_transferred);
+            result = send_control_response(client_conn, server_conn, resp, strnlen(resp, 128) + 1, &bytes_transferred);
         } else if (strstr(server_conn->buff->ctrl_rx_buff, SET_DRIVER_PARAM_CMD) == server_conn->buff->ctrl_rx_buff) {
             const char *resp = set_driver_parameter(server_conn->buff->ctrl_rx_buff, server_conn);
-            result = socket_send_all(client_conn->ctrl_fd, resp, strnlen(resp, 256) + 1, 0, &bytes_transferred);
+            result = send_control_response(client_conn, server_conn, resp, strnlen(resp, 256) + 1, &bytes_transferred);
         } else if (strstr(server_conn->buff->ctrl_rx_buff, GET_DRIVER_PARAM_CMD) == server_conn->buff->ctrl_rx_buff) {
             const char *resp = get_driver_parameter(server_conn->buff->ctrl_rx_buff, server_conn);
-            result = socket_send_all(client_conn->ctrl_fd, resp, strnlen(resp, MAX_SERVER_PARAM_VALUE_LEN) + 1, 0, &bytes_transferred);
+            result = send_control_response(client_conn, server_conn, resp, strnlen(resp, MAX_SERVER_PARAM_VALUE_LEN) + 1, &bytes_transferred);
+        } else if (strstr(server_conn->buff->ctrl_rx_buff, SHM_ATTACH_CMD) == server_conn->buff->ctrl_rx_buff) {
+            bytes_transferred = 0;
+            result = attach_shm_transport(client_conn, server_conn);
         } else {
-            result = socket_send_all(client_conn->ctrl_fd, UNRECOGNIZED_CMD_RSP, UNRECOGNIZED_CMD_RSP_LEN, 0, &bytes_transferred);
+            result = send_control_response(client_conn, server_conn, UNRECOGNIZED_CMD_RSP, UNRECOGNIZED_CMD_RSP_LEN, &bytes_transferred);
         }
         if (result != OK) {
             print_last_socket_error_b("Failed to send CTRL message response", bytes_transferred);
@@ -486,78 +1457,210 @@ unsigned long buff_len_to_wrap_boundary(uint64_t buff_sa, size_t buff_sz, uint64
     }
 }
 
-RETURN_CODE update_curr_h2t_header(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
-    if (server_conn->h2t_waiting == 0) {
-        ssize_t bytes_recvd;
-        RETURN_CODE result = socket_recv_accumulate(client_conn->h2t_data_fd, server_conn->buff->h2t_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER, 0, &bytes_recvd);
-        if (result != OK) {
-            print_last_socket_error_b("Failed to recv H2T header", bytes_recvd);
+// Reads a T2H payload out of the IP memory, up to 7 bytes past 'payload_sz' are written to 'dst'
+void copy_t2h_payload(SERVER_CONN *server_conn, uint32_t payload, char *dst, size_t payload_sz) {
+    size_t first_len;
+    if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->t2h_tx_buff, server_conn->buff->t2h_tx_buff_sz, payload, payload_sz)) != 0)) {
+        // Wrap, 2 copies necessary
+        memcpy64_fpga2host(server_conn->hw_callbacks.context, payload, (uint64_t *)dst, first_len);
+        memcpy64_fpga2host(server_conn->hw_callbacks.context, server_conn->buff->t2h_tx_buff, (uint64_t *)(dst + first_len), payload_sz - first_len);
+    } else {
+        memcpy64_fpga2host(server_conn->hw_callbacks.context, payload, (uint64_t *)dst, payload_sz);
+    }
+}
+
+// Writes an H2T payload to the IP memory at 'h2t_buff', up to 7 bytes past 'payload_sz' are read from 'payload'
+void copy_h2t_payload(SERVER_CONN *server_conn, uint64_t *payload, uint64_t h2t_buff, size_t payload_sz) {
+    size_t first_len;
+    if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->h2t_rx_buff, server_conn->buff->h2t_rx_buff_sz, h2t_buff, payload_sz)) != 0)) {
+        // Wrap, 2 copies necessary
+        memcpy64_host2fpga(server_conn->hw_callbacks.context, payload, h2t_buff, first_len);
+        memcpy64_host2fpga(server_conn->hw_callbacks.context, (uint64_t *)((char *)payload + first_len), server_conn->buff->h2t_rx_buff, payload_sz - first_len);
+    } else {
+        memcpy64_host2fpga(server_conn->hw_callbacks.context, payload, h2t_buff, payload_sz);
+    }
+}
+
+// Copies a T2H packet, header followed by the payload read out of the IP memory, to the end of the T2H queue
+static RETURN_CODE queue_t2h_packet(SERVER_CONN *server_conn, const char *header_buff, uint32_t payload, size_t payload_sz) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    char *dst = output_queue_reserve(&(server_conn->t2h_queue), header_sz + payload_sz);
+    if (dst == NULL) {
+        return FAILURE;
+    }
+    memcpy(dst, header_buff, header_sz);
+    copy_t2h_payload(server_conn, payload, dst + header_sz, payload_sz);
+    output_queue_commit(&(server_conn->t2h_queue), header_sz + payload_sz);
+    return OK;
+}
+
+// Same as above for MGMT RSP, whose payload is addressed directly
+static RETURN_CODE queue_mgmt_rsp_packet(SERVER_CONN *server_conn, const char *header_buff, const char *payload, size_t payload_sz) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER;
+    char *dst = output_queue_reserve(&(server_conn->mgmt_rsp_queue), header_sz + payload_sz);
+    if (dst == NULL) {
+        return FAILURE;
+    }
+    memcpy(dst, header_buff, header_sz);
+    dst += header_sz;
+
+/*TODO: clean up pointer vs int type mismatch*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    size_t first_len;
+    if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->mgmt_rsp_tx_buff, server_conn->buff->mgmt_rsp_tx_buff_sz, (uint64_t)payload, payload_sz)) != 0)) {
+        // Wrap, 2 copies necessary
+        memcpy(dst, payload, first_len);
+        memcpy(dst + first_len, (const char *)server_conn->buff->mgmt_rsp_tx_buff, payload_sz - first_len);
+    } else {
+        memcpy(dst, payload, payload_sz);
+    }
+#pragma GCC diagnostic pop
+    output_queue_commit(&(server_conn->mgmt_rsp_queue), header_sz + payload_sz);
+    return OK;
+}
+
+// Returns 1 once the H2T receive queue holds the whole of the current packet.  Its header is copied
+// to h2t_header_buff, the packet itself is left in the queue.
+char update_curr_h2t_header(SERVER_CONN *server_conn) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    const INPUT_QUEUE *queue = &(server_conn->h2t_rx_queue);
+    if (input_queue_len(queue) < header_sz) {
+        return 0;
+    }
+    memcpy(server_conn->buff->h2t_header_buff, input_queue_peek(queue), header_sz);
+    H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->h2t_header_buff + SIZEOF_PACKET_GUARDBAND);
+    return (input_queue_len(queue) >= header_sz + header->DATA_LEN_BYTES) ? 1 : 0;
+}
+
+// Pushes the current H2T packet, whose payload is in the IP memory at 'h2t_buff', to the driver or loopback
+static RETURN_CODE push_h2t_packet(SERVER_CONN *server_conn, uint64_t h2t_buff, size_t *echoed) {
+    H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->h2t_header_buff + SIZEOF_PACKET_GUARDBAND);
+    RETURN_CODE has_error = OK;
+    if (server_conn->loopback_mode == 0) {
+        // Normal operation, push the transaction to HW
+        has_error = (server_conn->hw_callbacks.h2t_data_received != NULL) ? server_conn->hw_callbacks.h2t_data_received(server_conn->hw_callbacks.context, header, h2t_buff) : OK;
+    } else {
+        // Echo the packet back through the T2H queue
+        if ((has_error = queue_t2h_packet(server_conn, server_conn->buff->h2t_header_buff, h2t_buff, header->DATA_LEN_BYTES)) == OK) {
+            ++(*echoed);
+        } else {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue loopback T2H data\n");
         }
-        return result;
     }
+    return has_error;
+}
+
+// Same as input_queue_fill() on the H2T socket, from the shared memory instead once the client attached it.
+// Nothing to do for a multiplexed client, see demux_frames().
+static RETURN_CODE fill_h2t_queue(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, ssize_t *bytes_recvd) {
+    if (client_conn->is_mux) {
+        *bytes_recvd = 0; // Already demultiplexed into the queue
+        return OK;
+    }
+    if (server_conn->shm.layout == NULL) {
+        return input_queue_fill(&(server_conn->h2t_rx_queue), client_conn->h2t_data_fd, SIZE_MAX, 0, bytes_recvd);
+    }
+    size_t room;
+    char *dst = input_queue_reserve(&(server_conn->h2t_rx_queue), SIZE_MAX, &room);
+    const size_t len = shm_ring_read(&(server_conn->shm.h2t), dst, room);
+    if (len > 0) {
+        input_queue_commit(&(server_conn->h2t_rx_queue), len);
+        shm_transport_ring_peer(&(server_conn->shm), SHM_TRANSPORT_WAIT_ROOM);
+    }
+    *bytes_recvd = (ssize_t)len;
+    return OK;
+}
+
+// Same as output_queue_flush() on the T2H socket, into the shared memory instead once the client attached it,
+// or into T2H frames for a multiplexed client
+static RETURN_CODE flush_t2h_queue(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, ssize_t *bytes_sent) {
+    if (client_conn->is_mux) {
+        return flush_mux_stream(client_conn, server_conn, MUX_STREAM_T2H, &(server_conn->t2h_queue), bytes_sent);
+    }
+    if (server_conn->shm.layout == NULL) {
+        return output_queue_flush(&(server_conn->t2h_queue), client_conn->t2h_data_fd, 0, bytes_sent);
+    }
+    OUTPUT_QUEUE *queue = &(server_conn->t2h_queue);
+    const size_t len = shm_ring_write(&(server_conn->shm.t2h), output_queue_peek(queue), output_queue_len(queue));
+    if (len > 0) {
+        output_queue_consume(queue, len);
+        shm_transport_ring_peer(&(server_conn->shm), SHM_TRANSPORT_WAIT_DATA);
+    }
+    *bytes_sent = (ssize_t)len;
     return OK;
 }
 
+// Takes in as much H2T data as the socket (or the shared memory) has ready, then pushes every complete packet received so far
 RETURN_CODE process_h2t_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    INPUT_QUEUE *queue = &(server_conn->h2t_rx_queue);
     ssize_t bytes_recvd;
     RETURN_CODE has_error = OK;
+    size_t echoed = 0;
 
-    if ((has_error = update_curr_h2t_header(client_conn, server_conn)) == OK) {
+    if ((has_error = fill_h2t_queue(client_conn, server_conn, &bytes_recvd)) != OK) {
+        print_last_socket_error_b("Failed to recv H2T data", bytes_recvd);
+        return has_error;
+    }
+
+    // In loopback the echo has to fit the T2H queue, leave the data in the receive queue until the client catches up
+    while (!(server_conn->loopback_mode == 1 && output_queue_is_full(&(server_conn->t2h_queue))) && update_curr_h2t_header(server_conn)) {
         H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->h2t_header_buff + SIZEOF_PACKET_GUARDBAND);
         size_t bytes_to_transfer = header->DATA_LEN_BYTES;
 
         // Polls to see if there is room for the packet
-        uint64_t h2t_buff = ((server_conn->hw_callbacks.get_h2t_buffer != NULL) && (server_conn->loopback_mode == 0)) ? server_conn->hw_callbacks.get_h2t_buffer(bytes_to_transfer) : server_conn->buff->h2t_rx_buff;
-
-        // Recv H2T payload
-        if (h2t_buff != 0) {
-            server_conn->pkt_stats.h2t_cnt++;
-            server_conn->h2t_waiting = 0;
-            size_t first_len;
-            if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->h2t_rx_buff, server_conn->buff->h2t_rx_buff_sz, h2t_buff, header->DATA_LEN_BYTES)) != 0)) {
-                // Wrap, 2 recv necessary
-                size_t second_len = header->DATA_LEN_BYTES - first_len;
-                has_error = socket_recv_accumulate_h2t_data(client_conn->h2t_data_fd, h2t_buff, first_len, 0, &bytes_recvd);
-                if (has_error == OK) {
-                    has_error = socket_recv_accumulate_h2t_data(client_conn->h2t_data_fd, server_conn->buff->h2t_rx_buff, second_len, 0, &bytes_recvd);
-                }
-            } else {
-                // No wrap
-            	has_error = socket_recv_accumulate_h2t_data(client_conn->h2t_data_fd, h2t_buff, bytes_to_transfer, 0, &bytes_recvd);
-            }
-
-            // Push to driver or loopback
-            if (has_error == OK) {
-                if (server_conn->loopback_mode == 0) {
-                    // Normal operation, push the transaction to HW
-                    has_error = (server_conn->hw_callbacks.h2t_data_received != NULL) ? server_conn->hw_callbacks.h2t_data_received(header, h2t_buff) : OK;
-                } else {
-                    // Send the header
-                    if ((has_error = socket_send_all(client_conn->t2h_data_fd, server_conn->buff->h2t_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER, 0, &bytes_recvd)) == OK) {
-                        // Send the payload
-                        if ((has_error = socket_send_all_t2h_data(client_conn->t2h_data_fd, h2t_buff, bytes_to_transfer, 0, &bytes_recvd)) != OK) {
-                            print_last_socket_error_b("Failed to send loopback T2H data", bytes_recvd);
-                        }
-                    } else {
-                        print_last_socket_error_b("Failed to send loopback T2H header", bytes_recvd);
-                    }
-                }
-            } else {
-                print_last_socket_error_b("Failed to recv H2T data", bytes_recvd);
-            }
-        } else {
+        uint64_t h2t_buff = ((server_conn->hw_callbacks.get_h2t_buffer != NULL) && (server_conn->loopback_mode == 0)) ? server_conn->hw_callbacks.get_h2t_buffer(server_conn->hw_callbacks.context, bytes_to_transfer) : server_conn->buff->h2t_rx_buff;
+        if (h2t_buff == 0) {
             // Wait for buffer to be available!
             server_conn->h2t_waiting = 1;
+            break;
+        }
+        server_conn->pkt_stats.h2t_cnt++;
+        server_conn->h2t_waiting = 0;
+
+        // Copy the H2T payload
+        copy_h2t_payload(server_conn, (uint64_t *)(input_queue_peek(queue) + header_sz), h2t_buff, bytes_to_transfer);
+        input_queue_consume(queue, header_sz + bytes_to_transfer);
+
+        if ((has_error = push_h2t_packet(server_conn, h2t_buff, &echoed)) != OK) {
+            return has_error;
+        }
+    }
+
+    if (echoed > 0) {
+        if ((has_error = flush_t2h_queue(client_conn, server_conn, &bytes_recvd)) != OK) {
+            print_last_socket_error_b("Failed to send loopback T2H data", bytes_recvd);
         }
     }
 
     return has_error;
 }
 
+// Same as socket_recv_accumulate() on the MGMT socket.  A multiplexed client's packet is only processed once it
+// has been demultiplexed whole, see has_mux_mgmt_packet().
+static RETURN_CODE recv_mgmt_bytes(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, char *dst, size_t len, ssize_t *bytes_recvd) {
+    if (!client_conn->is_mux) {
+        return socket_recv_accumulate(client_conn->mgmt_fd, dst, len, 0, bytes_recvd);
+    }
+    memcpy(dst, input_queue_peek(&(server_conn->mgmt_rx_queue)), len);
+    input_queue_consume(&(server_conn->mgmt_rx_queue), len);
+    *bytes_recvd = (ssize_t)len;
+    return OK;
+}
+
+// Same as output_queue_flush() on the MGMT RSP socket, or into MGMT RSP frames for a multiplexed client
+static RETURN_CODE flush_mgmt_rsp_queue(CLIENT_CONN *client_conn, SERVER_CONN *server_conn, ssize_t *bytes_sent) {
+    if (client_conn->is_mux) {
+        return flush_mux_stream(client_conn, server_conn, MUX_STREAM_MGMT_RSP, &(server_conn->mgmt_rsp_queue), bytes_sent);
+    }
+    return output_queue_flush(&(server_conn->mgmt_rsp_queue), client_conn->mgmt_rsp_fd, 0, bytes_sent);
+}
+
 RETURN_CODE update_curr_mgmt_header(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
     if (server_conn->mgmt_waiting == 0) {
         ssize_t bytes_recvd;
-        RETURN_CODE result = socket_recv_accumulate(client_conn->mgmt_fd, server_conn->buff->mgmt_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER, 0, &bytes_recvd);
+        RETURN_CODE result = recv_mgmt_bytes(client_conn, server_conn, server_conn->buff->mgmt_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER, &bytes_recvd);
         if (result != OK) {
             print_last_socket_error_b("Failed to recv MGMT header", bytes_recvd);
         }
@@ -570,12 +1673,17 @@ RETURN_CODE process_mgmt_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn
     ssize_t bytes_recvd;
     RETURN_CODE has_error = OK;
 
+    // In loopback the echo has to fit the MGMT RSP queue, leave the data in the socket until the client catches up
+    if (server_conn->loopback_mode == 1 && output_queue_is_full(&(server_conn->mgmt_rsp_queue))) {
+        return OK;
+    }
+
     if ((has_error = update_curr_mgmt_header(client_conn, server_conn)) == OK) {
         MGMT_PACKET_HEADER *header = (MGMT_PACKET_HEADER *)(server_conn->buff->mgmt_header_buff + SIZEOF_PACKET_GUARDBAND);
         size_t bytes_to_transfer = header->DATA_LEN_BYTES;
 
         // Polls to see if there is room for the packet
-        uint64_t mgmt_buff = ((server_conn->hw_callbacks.get_mgmt_buffer != NULL) && (server_conn->loopback_mode == 0)) ? server_conn->hw_callbacks.get_mgmt_buffer(bytes_to_transfer) : server_conn->buff->mgmt_rx_buff;
+        uint64_t mgmt_buff = ((server_conn->hw_callbacks.get_mgmt_buffer != NULL) && (server_conn->loopback_mode == 0)) ? server_conn->hw_callbacks.get_mgmt_buffer(server_conn->hw_callbacks.context, bytes_to_transfer) : server_conn->buff->mgmt_rx_buff;
 
 /*TODO: clean up pointer vs int type mismatch*/
 #pragma GCC diagnostic push
@@ -589,30 +1697,28 @@ RETURN_CODE process_mgmt_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn
             if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->mgmt_rx_buff, server_conn->buff->mgmt_rx_buff_sz, mgmt_buff, header->DATA_LEN_BYTES)) != 0)) {
                 // Wrap, 2 recv necessary
                 size_t second_len = header->DATA_LEN_BYTES - first_len;
-                has_error = socket_recv_accumulate(client_conn->mgmt_fd, /*TODO: clean up pointer vs int type mismatch*/ (char *)mgmt_buff, first_len, 0, &bytes_recvd);
+                has_error = recv_mgmt_bytes(client_conn, server_conn, /*TODO: clean up pointer vs int type mismatch*/ (char *)mgmt_buff, first_len, &bytes_recvd);
                 if (has_error == OK) {
-                    has_error = socket_recv_accumulate(client_conn->mgmt_fd, /*TODO: clean up pointer vs int type mismatch*/ (char *)server_conn->buff->mgmt_rx_buff, second_len, 0, &bytes_recvd);
+                    has_error = recv_mgmt_bytes(client_conn, server_conn, /*TODO: clean up pointer vs int type mismatch*/ (char *)server_conn->buff->mgmt_rx_buff, second_len, &bytes_recvd);
                 }
             } else {
                 // No wrap
-                has_error = socket_recv_accumulate(client_conn->mgmt_fd, /*TODO: clean up pointer vs int type mismatch*/ (char *)mgmt_buff, bytes_to_transfer, 0, &bytes_recvd);
+                has_error = recv_mgmt_bytes(client_conn, server_conn, /*TODO: clean up pointer vs int type mismatch*/ (char *)mgmt_buff, bytes_to_transfer, &bytes_recvd);
             }
 
             // Push to driver or loopback
             if (has_error == OK) {
                 if (server_conn->loopback_mode == 0) {
                     // Normal operation, push the transaction to HW
-                    has_error = (server_conn->hw_callbacks.mgmt_data_received != NULL) ? server_conn->hw_callbacks.mgmt_data_received(header, /*TODO: clean up pointer vs int type mismatch*/ (uint32_t)mgmt_buff) : OK;
+                    has_error = (server_conn->hw_callbacks.mgmt_data_received != NULL) ? server_conn->hw_callbacks.mgmt_data_received(server_conn->hw_callbacks.context, header, /*TODO: clean up pointer vs int type mismatch*/ (uint32_t)mgmt_buff) : OK;
                 } else {
-                    // Send the header
-                    if ((has_error = socket_send_all(client_conn->mgmt_rsp_fd, server_conn->buff->mgmt_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER, 0, &bytes_recvd)) == OK) {
-                        // Send the payload
-                        if ((has_error = socket_send_all(client_conn->mgmt_rsp_fd, /*TODO: clean up pointer vs int type mismatch*/ (char *)mgmt_buff, bytes_to_transfer, 0, &bytes_recvd)) != OK)
-                        {
+                    // Echo the packet back through the MGMT RSP queue
+                    if ((has_error = queue_mgmt_rsp_packet(server_conn, server_conn->buff->mgmt_header_buff, /*TODO: clean up pointer vs int type mismatch*/ (const char *)mgmt_buff, bytes_to_transfer)) == OK) {
+                        if ((has_error = flush_mgmt_rsp_queue(client_conn, server_conn, &bytes_recvd)) != OK) {
                             print_last_socket_error_b("Failed to send loopback MGMT RSP data", bytes_recvd);
                         }
                     } else {
-                        print_last_socket_error_b("Failed to send loopback MGMT RSP header", bytes_recvd);
+                        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue loopback MGMT RSP data\n");
                     }
                 }
             } else {
@@ -628,37 +1734,38 @@ RETURN_CODE process_mgmt_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn
     return has_error;
 }
 
+// Drains up to 't2h_batch_size' ready descriptors into the T2H queue, then sends them out together
 RETURN_CODE process_t2h_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
-    ssize_t bytes_sent;
+    ssize_t bytes_sent = 0;
     RETURN_CODE has_error = OK;
+    size_t batched = 0;
 
     H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->t2h_header_buff + SIZEOF_PACKET_GUARDBAND);
     uint32_t t2h_buff;
-    if ((has_error = (server_conn->hw_callbacks.acquire_t2h_data(header, &t2h_buff) == 0) ? OK : FAILURE) == OK) {
+
+    // Data is left in the IP whenever the queue is full, until the client catches up
+    while (batched < server_conn->t2h_batch_size && !output_queue_is_full(&(server_conn->t2h_queue))) {
+        if ((has_error = (server_conn->hw_callbacks.acquire_t2h_data(server_conn->hw_callbacks.context, header, &t2h_buff) == 0) ? OK : FAILURE) != OK) {
+            return has_error;
+        }
         unsigned short curr_payload_bytes;
         if ((curr_payload_bytes = header->DATA_LEN_BYTES) == 0) {
-            return has_error;
+            break;
         }
         server_conn->pkt_stats.t2h_cnt++;
-        if ((has_error = socket_send_all(client_conn->t2h_data_fd, (const char *)server_conn->buff->t2h_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER, 0, &bytes_sent)) == OK) {
-            size_t first_len;
-            if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->t2h_tx_buff, server_conn->buff->t2h_tx_buff_sz, t2h_buff, header->DATA_LEN_BYTES)) != 0)) {
-                // Wrap, 2 sends necessary
-            	size_t second_len = header->DATA_LEN_BYTES - first_len;
-            	if ((has_error = socket_send_all_t2h_data(client_conn->t2h_data_fd, t2h_buff, first_len, 0, &bytes_sent)) == OK) {
-                    has_error = socket_send_all_t2h_data(client_conn->t2h_data_fd, server_conn->buff->t2h_tx_buff, second_len, 0, &bytes_sent);
-            	}
-            } else {
-                // No wrap
-                has_error = socket_send_all_t2h_data(client_conn->t2h_data_fd, t2h_buff, curr_payload_bytes, 0, &bytes_sent);
-            }
-            if (has_error == OK) {
-                if (server_conn->hw_callbacks.t2h_data_complete != NULL) {
-                    server_conn->hw_callbacks.t2h_data_complete();
-                }
-            }
+        if ((has_error = queue_t2h_packet(server_conn, server_conn->buff->t2h_header_buff, t2h_buff, curr_payload_bytes)) != OK) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "No room to queue T2H data\n");
+            return has_error;
         }
-        if (has_error != OK) {
+        // The data now lives in the queue, the IP can reuse its memory right away
+        if (server_conn->hw_callbacks.t2h_data_complete != NULL) {
+            server_conn->hw_callbacks.t2h_data_complete(server_conn->hw_callbacks.context);
+        }
+        ++batched;
+    }
+
+    if (batched > 0) {
+        if ((has_error = flush_t2h_queue(client_conn, server_conn, &bytes_sent)) != OK) {
             print_last_socket_error_b("An error occurred sending T2H data", bytes_sent);
         }
     }
@@ -667,39 +1774,32 @@ RETURN_CODE process_t2h_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn)
 }
 
 RETURN_CODE process_mgmt_rsp_data(CLIENT_CONN *client_conn, SERVER_CONN *server_conn) {
-    ssize_t bytes_sent;
+    ssize_t bytes_sent = 0;
     RETURN_CODE has_error = OK;
 
+    // Leave the data in the IP until the client catches up
+    if (output_queue_is_full(&(server_conn->mgmt_rsp_queue))) {
+        return OK;
+    }
+
 /*TODO: clean up pointer vs int type mismatch*/
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
 
     MGMT_PACKET_HEADER *header = (MGMT_PACKET_HEADER *)(server_conn->buff->mgmt_rsp_header_buff + SIZEOF_PACKET_GUARDBAND);
     uint32_t mgmt_rsp_buff;
-    if ((has_error = (server_conn->hw_callbacks.acquire_mgmt_rsp_data(header, &mgmt_rsp_buff) == 0) ? OK : FAILURE) == OK) {
+    if ((has_error = (server_conn->hw_callbacks.acquire_mgmt_rsp_data(server_conn->hw_callbacks.context, header, &mgmt_rsp_buff) == 0) ? OK : FAILURE) == OK) {
         unsigned short curr_payload_bytes;
         if ((curr_payload_bytes = header->DATA_LEN_BYTES) == 0) {
             return has_error;
         }
         server_conn->pkt_stats.mgmt_rsp_cnt++;
-        if ((has_error = socket_send_all(client_conn->mgmt_rsp_fd, (const char *)server_conn->buff->mgmt_rsp_header_buff, SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER, 0, &bytes_sent)) == OK) {
-            size_t first_len;
-            if (server_conn->buff->use_wrapping_data_buffers && ((first_len = buff_len_to_wrap_boundary(server_conn->buff->mgmt_rsp_tx_buff, server_conn->buff->mgmt_rsp_tx_buff_sz, mgmt_rsp_buff, header->DATA_LEN_BYTES)) != 0)) {
-                // Wrap, 2 sends necessary
-                size_t second_len = header->DATA_LEN_BYTES - first_len;
-                if ((has_error = socket_send_all(client_conn->mgmt_rsp_fd, /*TODO: clean up pointer vs int type mismatch*/ (const char *)mgmt_rsp_buff, first_len, 0, &bytes_sent)) == OK)
-                {
-                    has_error = socket_send_all(client_conn->mgmt_rsp_fd, /*TODO: clean up pointer vs int type mismatch*/ (const char *)server_conn->buff->mgmt_rsp_tx_buff, second_len, 0, &bytes_sent);
-                }
-            } else {
-                // No wrap
-                has_error = socket_send_all(client_conn->mgmt_rsp_fd, /*TODO: clean up pointer vs int type mismatch*/ (const char *)mgmt_rsp_buff, curr_payload_bytes, 0, &bytes_sent);
-            }
-            if (has_error == OK) {
-                if (server_conn->hw_callbacks.mgmt_rsp_data_complete != NULL) {
-                    server_conn->hw_callbacks.mgmt_rsp_data_complete();
-                }
+        if ((has_error = queue_mgmt_rsp_packet(server_conn, server_conn->buff->mgmt_rsp_header_buff, /*TODO: clean up pointer vs int type mismatch*/ (const char *)mgmt_rsp_buff, curr_payload_bytes)) == OK) {
+            // The data now lives in the queue, the IP can reuse its memory right away
+            if (server_conn->hw_callbacks.mgmt_rsp_data_complete != NULL) {
+                server_conn->hw_callbacks.mgmt_rsp_data_complete(server_conn->hw_callbacks.context);
             }
+            has_error = flush_mgmt_rsp_queue(client_conn, server_conn, &bytes_sent);
         }
         if (has_error != OK) {
             print_last_socket_error_b("An error occurred sending MGMT RSP data", bytes_sent);
@@ -711,88 +1811,329 @@ RETURN_CODE process_mgmt_rsp_data(CLIENT_CONN *client_conn, SERVER_CONN *server_
     return has_error;
 }
 
-void reject_client(SERVER_CONN *server_conn) {
-    SOCKET sock_fd = INVALID_SOCKET;
-    if((sock_fd = accept(server_conn->server_fd, (struct sockaddr *)(&(server_conn->server_addr)), &sizeof_addr)) == INVALID_SOCKET) {
-        print_last_socket_error("Failed to accept additional client");
-    } else {
-#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
-        int flags = 0;
-#else
-        int flags = MSG_DONTWAIT;
-#endif
-        size_t reject_msg_len = 12;
-        if (send(sock_fd, REJECT_MSG, reject_msg_len, flags) < 0) {
-            print_last_socket_error("Failed to send rejection message to additional client");
-        }
+// Bytes the H2T socket has to hold before it is reported readable: a whole packet header, so that
+// every wakeup has something to parse, unless fewer bytes are missing from the packet received last
+static int h2t_recv_low_water_mark(SERVER_CONN *server_conn) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    const size_t received = input_queue_len(&(server_conn->h2t_rx_queue));
+    size_t missing = header_sz;
+    if (received < header_sz) {
+        missing = header_sz - received;
+    } else if (!update_curr_h2t_header(server_conn)) {
+        H2T_PACKET_HEADER *header = (H2T_PACKET_HEADER *)(server_conn->buff->h2t_header_buff + SIZEOF_PACKET_GUARDBAND);
+        missing = header_sz + header->DATA_LEN_BYTES - received;
+    }
+    return (int)MIN_MACRO(missing, header_sz);
+}
 
-        fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Rejected one connection request because only one connection has already been established.");
+// Whether H2T data is left alone for now, see the end of handle_client()
+static char is_h2t_blocked(SERVER_CONN *server_conn, int wakeup_fd) {
+    return (server_conn->loopback_mode == 1 && output_queue_is_full(&(server_conn->t2h_queue))) ||
+           (wakeup_fd >= 0 && server_conn->h2t_waiting) || input_queue_is_full(&(server_conn->h2t_rx_queue));
+}
 
-        // Prevent TIME_WAIT
-        set_linger_socket_option(sock_fd, 1, 0);
-        close_socket_fd(sock_fd);
+// Whether the shared memory has H2T data to take in, or room for T2H data still queued
+static char has_shm_work(SERVER_CONN *server_conn, int wakeup_fd) {
+    return (!is_h2t_blocked(server_conn, wakeup_fd) && shm_ring_readable(&(server_conn->shm.h2t), 1) > 0) ||
+           (!output_queue_is_empty(&(server_conn->t2h_queue)) && shm_ring_room(&(server_conn->shm.t2h), 1) > 0);
+}
+
+// The streams of a multiplexed client are ready once enough of them has been demultiplexed, and as long as the
+// multiplexed output queue has room for what they send.  Returns whether any stream is ready.
+static char get_mux_ready(SERVER_CONN *server_conn, const unsigned int *all_interests, unsigned int *ready) {
+    const char tx_open = !output_queue_is_full(&(server_conn->mux_tx_queue));
+    char any = 0;
+    if (tx_open && has_mux_control_message(server_conn)) {
+        ready[CONTROL_SOCK_TAG] |= EVENT_LOOP_READ;
+        any = 1;
+    }
+    if ((all_interests[MANAGEMENT_SOCK_TAG] & EVENT_LOOP_READ) && has_mux_mgmt_packet(server_conn)) {
+        ready[MANAGEMENT_SOCK_TAG] |= EVENT_LOOP_READ;
+        any = 1;
+    }
+    if ((all_interests[H2T_SOCK_TAG] & EVENT_LOOP_READ) && !server_conn->h2t_waiting && update_curr_h2t_header(server_conn)) {
+        ready[H2T_SOCK_TAG] |= EVENT_LOOP_READ;
+        any = 1;
+    }
+    if (tx_open && !output_queue_is_empty(&(server_conn->t2h_queue))) {
+        ready[T2H_SOCK_TAG] |= EVENT_LOOP_WRITE;
+        any = 1;
+    }
+    if (tx_open && !output_queue_is_empty(&(server_conn->mgmt_rsp_queue))) {
+        ready[MANAGEMENT_RSP_SOCK_TAG] |= EVENT_LOOP_WRITE;
+        any = 1;
+    }
+    return any;
+}
+
+// Thresholds are kept, the client starts off spinning
+void idle_poll_reset(IDLE_POLL *poll) {
+    poll->state = IDLE_POLL_SPIN;
+    poll->active = 1;
+    poll->polling = 0;
+    poll->backoff = 0;
+    for (int i = 0; i < NUM_IDLE_POLL_STATES; ++i) {
+        poll->time_ns[i] = 0;
+    }
+}
+
+void idle_poll_activity(IDLE_POLL *poll) {
+    poll->active = 1;
+}
+
+// The hardware is not polled until the next idle_poll_timeout(), e.g. while its output queues are full
+void idle_poll_pause(IDLE_POLL *poll) {
+    poll->polling = 0;
+}
+
+// Returns the timeout of the next wait of a thread polling the hardware, having slept already in the
+// IDLE_POLL_SLEEP state.  A 'max_wait_ms' of 0 never gets past the sleeps.
+int idle_poll_timeout(IDLE_POLL *poll) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (poll->polling) {
+        poll->time_ns[poll->state] += (unsigned long long)MAX_MACRO(elapsed_ns(&(poll->last_pass), &now), 0);
+    }
+    poll->polling = 1;
+    poll->last_pass = now;
+    if (poll->active) {
+        poll->active = 0;
+        poll->last_activity = now;
+        poll->state = IDLE_POLL_SPIN;
+    }
+
+    const unsigned long long idle_us = (unsigned long long)MAX_MACRO(elapsed_ns(&(poll->last_activity), &now), 0) / 1000;
+    if (idle_us < poll->spin_us) {
+        return 0;
+    }
+    if (idle_us < poll->sleep_us || poll->max_wait_ms == 0) {
+        poll->backoff = (poll->state == IDLE_POLL_SLEEP) ? MIN_MACRO(2 * poll->backoff, IDLE_POLL_MAX_SLEEP_US) : 1;
+        poll->state = IDLE_POLL_SLEEP;
+        struct timespec sleep_time = { 0, (long)poll->backoff * 1000 };
+        nanosleep(&sleep_time, NULL);
+        return 0;
+    }
+    poll->backoff = (poll->state == IDLE_POLL_WAIT) ? MIN_MACRO(2 * poll->backoff, poll->max_wait_ms) : 1;
+    poll->state = IDLE_POLL_WAIT;
+    return (int)poll->backoff;
+}
+
+// Applies a change of interest, if any, keeping 'interest' in sync with the event loop
+static RETURN_CODE update_interest(EVENT_LOOP *loop, SOCKET fd, unsigned int *interest, unsigned int wanted, const char *sock_name) {
+    if (*interest == wanted) {
+        return OK;
+    }
+    *interest = wanted;
+    // The streams of a multiplexed client have no socket of their own, the interest only gates get_mux_ready()
+    if (fd != INVALID_SOCKET && event_loop_modify(loop, fd, wanted) != OK) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Failed to update %s socket interest\n", sock_name);
+        return FAILURE;
+    }
+    return OK;
+}
+
+// The listening socket is left to the acceptor thread, if any
+static void get_client_sockets(SERVER_CONN *server_conn, CLIENT_CONN *client_conn, SOCKET *all_fds, const char **all_fd_names) {
+    all_fds[SERVER_SOCK_TAG] = (server_conn->acceptor == NULL) ? server_conn->server_fd : INVALID_SOCKET;
+    all_fds[CONTROL_SOCK_TAG] = client_conn->ctrl_fd;
+    all_fds[MANAGEMENT_SOCK_TAG] = client_conn->mgmt_fd;
+    all_fds[MANAGEMENT_RSP_SOCK_TAG] = client_conn->mgmt_rsp_fd;
+    all_fds[H2T_SOCK_TAG] = client_conn->h2t_data_fd;
+    all_fds[T2H_SOCK_TAG] = client_conn->t2h_data_fd;
+    all_fd_names[SERVER_SOCK_TAG] = SERVER_SOCK_NAME;
+    all_fd_names[CONTROL_SOCK_TAG] = CONTROL_SOCK_NAME;
+    all_fd_names[MANAGEMENT_SOCK_TAG] = MANAGEMENT_SOCK_NAME;
+    all_fd_names[MANAGEMENT_RSP_SOCK_TAG] = MANAGEMENT_RSP_SOCK_NAME;
+    all_fd_names[H2T_SOCK_TAG] = H2T_SOCK_NAME;
+    all_fd_names[T2H_SOCK_TAG] = T2H_SOCK_NAME;
+}
+
+// Busy poll mode, see SERVER_CONN.busy_poll_us.  The loops poll whatever the socket option does, so failing to
+// set it, typically for lack of CAP_NET_ADMIN, only costs the device queue polling.
+static void set_busy_poll_sockets(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
+    if (server_conn->busy_poll_us <= 0 || client_conn->is_local) {
+        return;
+    }
+    if (client_conn->is_mux) {
+        if (set_busy_poll_socket_option(client_conn->ctrl_fd, server_conn->busy_poll_us) != 0) {
+            print_last_socket_error("Failed to enable busy polling on the multiplexed socket");
+        }
+        return;
+    }
+    if (set_busy_poll_socket_option(client_conn->h2t_data_fd, server_conn->busy_poll_us) != 0 ||
+        set_busy_poll_socket_option(client_conn->t2h_data_fd, server_conn->busy_poll_us) != 0 ||
+        set_busy_poll_socket_option(client_conn->mgmt_fd, server_conn->busy_poll_us) != 0 ||
+        set_busy_poll_socket_option(client_conn->mgmt_rsp_fd, server_conn->busy_poll_us) != 0) {
+        print_last_socket_error("Failed to enable busy polling on the data sockets");
     }
 }
 
 void handle_client(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
-    fd_set read_fds;
-    fd_set write_fds;
-    fd_set except_fds;
-    enum { NUM_FDS = 6 };
-    SOCKET all_fds[NUM_FDS];
-    all_fds[0] = server_conn->server_fd;
-    all_fds[1] = client_conn->ctrl_fd;
-    all_fds[2] = client_conn->mgmt_fd;
-    all_fds[3] = client_conn->mgmt_rsp_fd;
-    all_fds[4] = client_conn->h2t_data_fd;
-    all_fds[5] = client_conn->t2h_data_fd;
-    const char *all_fd_names[NUM_FDS];
-    all_fd_names[0] = SERVER_SOCK_NAME;
-    all_fd_names[1] = CONTROL_SOCK_NAME;
-    all_fd_names[2] = MANAGEMENT_SOCK_NAME;
-    all_fd_names[3] = MANAGEMENT_RSP_SOCK_NAME;
-    all_fd_names[4] = H2T_SOCK_NAME;
-    all_fd_names[5] = T2H_SOCK_NAME;
-
-    SOCKET max_fd = max_of(all_fds, NUM_FDS) + 1;
+    enum { IDLE_WAIT_MS = 1000, SHM_EVENT_LOOP_INTERVAL = 64 };
+    SOCKET all_fds[NUM_SOCK_TAGS];
+    const char *all_fd_names[NUM_SOCK_TAGS];
+    get_client_sockets(server_conn, client_conn, all_fds, all_fd_names);
+
+    // H2T, MGMT, CTRL and server listening socket are read-only.
+    // T2H & MGMT_RSP are write-only and never block; writable interest is only armed while
+    // their output queue holds data the socket did not accept yet.
+    unsigned int all_interests[NUM_SOCK_TAGS];
+    all_interests[SERVER_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[CONTROL_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[MANAGEMENT_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[MANAGEMENT_RSP_SOCK_TAG] = 0;
+    all_interests[H2T_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[T2H_SOCK_TAG] = 0;
+
+    // H2T is read in large chunks, whatever the socket has ready, without ever blocking
+    input_queue_reset(&(server_conn->h2t_rx_queue));
+    output_queue_reset(&(server_conn->t2h_queue));
+    output_queue_reset(&(server_conn->mgmt_rsp_queue));
+    input_queue_reset(&(server_conn->mux_rx_queue));
+    input_queue_reset(&(server_conn->ctrl_rx_queue));
+    input_queue_reset(&(server_conn->mgmt_rx_queue));
+    output_queue_reset(&(server_conn->mux_tx_queue));
+    server_conn->mux_rx_remaining = 0;
+    if (client_conn->is_mux ? (set_non_blocking_socket(client_conn->ctrl_fd, 1) != 0) :
+        (set_non_blocking_socket(client_conn->h2t_data_fd, 1) != 0 ||
+         set_non_blocking_socket(client_conn->t2h_data_fd, 1) != 0 || set_non_blocking_socket(client_conn->mgmt_rsp_fd, 1) != 0)) {
+        print_last_socket_error("Failed to make data sockets non-blocking");
+        return;
+    }
+    set_busy_poll_sockets(server_conn, client_conn);
+    int h2t_low_water_mark = client_conn->is_mux ? 0 : h2t_recv_low_water_mark(server_conn);
+    if (h2t_low_water_mark > 0 && set_recv_low_water_mark(client_conn->h2t_data_fd, h2t_low_water_mark) != 0) {
+        print_last_socket_error("Failed to set the H2T receive low-water mark");
+        h2t_low_water_mark = 0; // Left alone from here on
+    }
+
+    EVENT_LOOP loop;
+    if (event_loop_init(&loop, server_conn->event_loop_backend) != OK) {
+        print_last_socket_error("Failed to create event loop");
+        return;
+    }
+    for (int i = 0; i < NUM_SOCK_TAGS; ++i) {
+        if (all_fds[i] != INVALID_SOCKET && event_loop_add(&loop, all_fds[i], all_interests[i], i) != OK) {
+            print_last_socket_error("Failed to register socket with event loop");
+            event_loop_close(&loop);
+            return;
+        }
+    }
+    if (server_conn->acceptor == NULL && server_conn->local_fd != INVALID_SOCKET &&
+        event_loop_add(&loop, server_conn->local_fd, EVENT_LOOP_READ, LOCAL_SERVER_SOCK_TAG) != OK) {
+        print_last_socket_error("Failed to register local server socket with event loop");
+        event_loop_close(&loop);
+        return;
+    }
+    // The clients before this one are still owed their frames and their close, see DRAINING_CONN
+    watch_draining_conns(server_conn, &loop, DRAINING_SOCK_TAG);
+
+    // When the driver is interrupt driven the hardware is only serviced after it raised a wakeup,
+    // and for as long as the previous pass over it still found outbound data.
+    const char has_t2h = server_conn->hw_callbacks.acquire_t2h_data != NULL;
+    const char has_mgmt_rsp = server_conn->hw_callbacks.acquire_mgmt_rsp_data != NULL;
+    int wakeup_fd = (server_conn->hw_callbacks.get_wakeup_fd != NULL) ? server_conn->hw_callbacks.get_wakeup_fd(server_conn->hw_callbacks.context) : -1;
+    if (wakeup_fd >= 0) {
+        if (event_loop_add(&loop, wakeup_fd, EVENT_LOOP_READ, HW_WAKEUP_TAG) != OK) {
+            print_last_socket_error("Failed to register hardware wakeup with event loop, polling the hardware instead");
+            wakeup_fd = -1;
+        }
+    }
+    char hw_pending = 1; // Anything raised before the wakeup was registered is picked up by the first pass
+    const char busy_poll = server_conn->busy_poll_us > 0;
+    char shm_registered = 0;
+    unsigned int shm_busy_passes = 0;
 
     while (1) {
-        FD_ZERO(&read_fds);
-        FD_ZERO(&write_fds);
-        FD_ZERO(&except_fds);
-        
-        // H2T, MGMT, and server listening socket are read-only
-        FD_SET(client_conn->h2t_data_fd, &read_fds);
-        FD_SET(client_conn->mgmt_fd, &read_fds);
-        FD_SET(server_conn->server_fd, &read_fds);
-        
-        // T2H & MGMT_RSP are write-only
-        FD_SET(client_conn->t2h_data_fd, &write_fds);
-        FD_SET(client_conn->mgmt_rsp_fd, &write_fds);
-        
-        // Ctrl is R/W
-        FD_SET(client_conn->ctrl_fd, &read_fds);
-        FD_SET(client_conn->ctrl_fd, &write_fds);
-        
-        // Any socket can have an exception
-        FD_SET(client_conn->ctrl_fd, &except_fds);
-        FD_SET(client_conn->mgmt_fd, &except_fds);
-        FD_SET(client_conn->mgmt_rsp_fd, &except_fds);
-        FD_SET(client_conn->h2t_data_fd, &except_fds);
-        FD_SET(client_conn->t2h_data_fd, &except_fds);
-        
-        struct timeval to;
-        to.tv_sec = 1;
-        to.tv_usec = 0;
-        if (select((int)max_fd, &read_fds, &write_fds, &except_fds, &to) < 0) {
-            print_last_socket_error("Select failure");
+        EVENT_LOOP_EVENT events[NUM_EVENT_TAGS];
+        unsigned int ready[NUM_EVENT_TAGS] = { 0 };
+
+        // Busy polling services the hardware on every pass, a wakeup (if any) only gets acknowledged
+        if (busy_poll) {
+            hw_pending = 1;
+        }
+
+        // Without a hardware wakeup outbound data has no event source of its own, so the hardware is polled
+        // on every iteration and the wait must not block for long while that is the case.  There is no point in
+        // polling while every output queue is full though, the wait ends once a socket is writable again.
+        const char t2h_open = has_t2h && !output_queue_is_full(&(server_conn->t2h_queue));
+        const char mgmt_rsp_open = has_mgmt_rsp && !output_queue_is_full(&(server_conn->mgmt_rsp_queue));
+        // Once nothing happened for a while, the polling backs off, see IDLE_POLL.
+        const char hw_polling = (server_conn->loopback_mode == 0) && (t2h_open || mgmt_rsp_open) && ((wakeup_fd < 0) || hw_pending);
+        int timeout_ms = IDLE_WAIT_MS;
+        if (busy_poll) {
+            timeout_ms = 0;
+        } else if (hw_polling) {
+            timeout_ms = (wakeup_fd < 0) ? idle_poll_timeout(&(server_conn->idle_poll)) : 0;
+        } else {
+            idle_poll_pause(&(server_conn->idle_poll));
+        }
+        timeout_ms = draining_wait_ms(server_conn, timeout_ms);
+
+        // The shared memory has no event source of its own either.  Before sleeping the client is asked to
+        // ring, and the rings are looked at once more for anything it published before it could see that.
+        const char shm_attached = (server_conn->shm.layout != NULL);
+        char shm_armed = 0;
+        char shm_rung = 0;
+        if (shm_attached) {
+            if (has_shm_work(server_conn, wakeup_fd)) {
+                timeout_ms = 0;
+            } else if (timeout_ms != 0) {
+                shm_transport_arm(&(server_conn->shm), SHM_TRANSPORT_WAIT_DATA |
+                                  (output_queue_is_empty(&(server_conn->t2h_queue)) ? 0 : SHM_TRANSPORT_WAIT_ROOM));
+                shm_armed = 1;
+                if (has_shm_work(server_conn, wakeup_fd)) {
+                    timeout_ms = 0;
+                }
+            }
+        }
+
+        // Frames already received may hold work for the streams that did not fit their queues before
+        if (client_conn->is_mux) {
+            unsigned int mux_ready[NUM_SOCK_TAGS] = { 0 };
+            if (demux_frames(server_conn) != OK) {
+                break;
+            }
+            if (get_mux_ready(server_conn, all_interests, mux_ready)) {
+                timeout_ms = 0;
+            }
+        }
+        const size_t pkt_cnt = server_conn->pkt_stats.h2t_cnt + server_conn->pkt_stats.t2h_cnt +
+                               server_conn->pkt_stats.mgmt_cnt + server_conn->pkt_stats.mgmt_rsp_cnt;
+
+        // While the shared memory keeps the loop busy the sockets are only looked at every so often, so that
+        // a pass over the rings costs no system call at all
+        int num_events = 0;
+        if (!shm_attached || timeout_ms != 0 || ++shm_busy_passes % SHM_EVENT_LOOP_INTERVAL == 0) {
+            num_events = event_loop_wait(&loop, events, NUM_EVENT_TAGS, timeout_ms);
+        }
+        if (shm_armed) {
+            shm_rung = shm_transport_disarm(&(server_conn->shm));
+        }
+        if (num_events < 0) {
+            print_last_socket_error("Event loop wait failure");
             break;
         }
-        
-        // First handle exceptional conditions
+        for (int i = 0; i < num_events; ++i) {
+            ready[events[i].tag] |= events[i].ready;
+        }
+        if ((ready[SHM_WAKEUP_TAG] & EVENT_LOOP_READ) && !shm_rung) {
+            shm_transport_ack(&(server_conn->shm));
+        }
+
+        // Consume the wakeup before touching the hardware, anything raised from here on wakes us up again
+        if (ready[HW_WAKEUP_TAG] & EVENT_LOOP_READ) {
+            if (server_conn->hw_callbacks.ack_wakeup != NULL) {
+                server_conn->hw_callbacks.ack_wakeup(server_conn->hw_callbacks.context);
+            }
+            hw_pending = 1;
+        }
+
+        // First handle exceptional conditions.  A socket without read interest
+        // is only ever reported readable once the client has hung up.
         char disconnect_client = 0;
-        for (int i = 0; i < NUM_FDS; ++i) {
-            if (FD_ISSET(all_fds[i], &except_fds)) {
+        for (int i = 0; i < NUM_SOCK_TAGS; ++i) {
+            if ((ready[i] & EVENT_LOOP_EXCEPT) || ((ready[i] & EVENT_LOOP_READ) && !(all_interests[i] & EVENT_LOOP_READ))) {
                 fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Exception found on socket: %s\n", all_fd_names[i]);
                 disconnect_client = 1;
                 break;
@@ -801,15 +2142,69 @@ void handle_client(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
         if (disconnect_client) {
             break;
         }
-        
+        service_draining_conns(server_conn, &loop, ready + DRAINING_SOCK_TAG);
+
+        // A multiplexed client only has the CTRL socket, its streams are ready once their frames have been
+        // received, or once the CTRL socket takes frames again
+        if (client_conn->is_mux) {
+            if (ready[CONTROL_SOCK_TAG] & EVENT_LOOP_WRITE) {
+                ssize_t bytes_sent;
+                if (output_queue_flush(&(server_conn->mux_tx_queue), client_conn->ctrl_fd, 0, &bytes_sent) == FAILURE) {
+                    print_last_socket_error_b("An error occurred sending multiplexed data", bytes_sent);
+                    break;
+                }
+            }
+            if (ready[CONTROL_SOCK_TAG] & EVENT_LOOP_READ) {
+                ssize_t bytes_recvd;
+                if (input_queue_fill(&(server_conn->mux_rx_queue), client_conn->ctrl_fd, SIZE_MAX, 0, &bytes_recvd) == FAILURE) {
+                    print_last_socket_error_b("Failed to recv multiplexed data", bytes_recvd);
+                    break;
+                }
+            }
+            ready[CONTROL_SOCK_TAG] = 0;
+            if (demux_frames(server_conn) != OK) {
+                break;
+            }
+            get_mux_ready(server_conn, all_interests, ready);
+        }
+
+        // The H2T / T2H sockets of a client on shared memory only ever report hang-ups, the rings are ready instead
+        if (shm_attached) {
+            if (!is_h2t_blocked(server_conn, wakeup_fd) && shm_ring_readable(&(server_conn->shm.h2t), 1) > 0) {
+                ready[H2T_SOCK_TAG] |= EVENT_LOOP_READ;
+            }
+            if (!output_queue_is_empty(&(server_conn->t2h_queue)) && shm_ring_room(&(server_conn->shm.t2h), 1) > 0) {
+                ready[T2H_SOCK_TAG] |= EVENT_LOOP_WRITE;
+            }
+        }
+
+        // Resume partially sent outbound data
+        if (ready[T2H_SOCK_TAG] & EVENT_LOOP_WRITE) {
+            ssize_t bytes_sent;
+            if (flush_t2h_queue(client_conn, server_conn, &bytes_sent) == FAILURE) {
+                print_last_socket_error_b("An error occurred sending T2H data", bytes_sent);
+                break;
+            }
+        }
+        if (ready[MANAGEMENT_RSP_SOCK_TAG] & EVENT_LOOP_WRITE) {
+            ssize_t bytes_sent;
+            if (flush_mgmt_rsp_queue(client_conn, server_conn, &bytes_sent) == FAILURE) {
+                print_last_socket_error_b("An error occurred sending MGMT RSP data", bytes_sent);
+                break;
+            }
+        }
+
         // Check for additional clients attempting to connect,
         // if so, politely tell them to get lost.
-        if (FD_ISSET(server_conn->server_fd, &read_fds)) {
-            reject_client(server_conn);
+        if (ready[SERVER_SOCK_TAG] & EVENT_LOOP_READ) {
+            reject_client(server_conn, server_conn->server_fd);
+        }
+        if (ready[LOCAL_SERVER_SOCK_TAG] & EVENT_LOOP_READ) {
+            reject_client(server_conn, server_conn->local_fd);
         }
 
         // See if any incoming control messages are present
-        if (FD_ISSET(client_conn->ctrl_fd, &read_fds)) {
+        if (ready[CONTROL_SOCK_TAG] & EVENT_LOOP_READ) {
             if (process_control_message(client_conn, server_conn, &disconnect_client) == FAILURE) {
                 break;
             }
@@ -817,43 +2212,276 @@ void handle_client(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
             if (disconnect_client) {
                 break;
             }
+
+            if (server_conn->shm.layout != NULL && !shm_registered) {
+                if (event_loop_add(&loop, server_conn->shm.own_bell_fd, EVENT_LOOP_READ, SHM_WAKEUP_TAG) != OK) {
+                    print_last_socket_error("Failed to register shared memory doorbell with event loop");
+                    break;
+                }
+                shm_registered = 1;
+            }
         }
-        
-        // See if any incoming management commands are present
-        if (FD_ISSET(client_conn->mgmt_fd, &read_fds)) {
+
+        // See if any incoming management commands are present.  Like H2T below, a command waiting
+        // on buffer space is retried once the hardware signals freed slots, or after an idle wait
+        // in case that wakeup went missing.
+        if ((ready[MANAGEMENT_SOCK_TAG] & EVENT_LOOP_READ) ||
+            (server_conn->mgmt_waiting && !(all_interests[MANAGEMENT_SOCK_TAG] & EVENT_LOOP_READ) && (hw_pending || num_events == 0))) {
             if (process_mgmt_data(client_conn, server_conn) == FAILURE) {
                 break;
             }
         }
 
-        // Lastly handle incoming H2T data
-        if (FD_ISSET(client_conn->h2t_data_fd, &read_fds)) {
+        // Lastly handle incoming H2T data.  Packets already received are retried on their own, without
+        // the socket being readable: once buffer space may have been freed (as for MGMT above, and on
+        // every pass when polling the hardware), or once the loopback echo fits the T2H queue again.
+        const char h2t_retry = server_conn->h2t_waiting ? ((wakeup_fd < 0) || hw_pending || num_events == 0) :
+                               (server_conn->loopback_mode == 1 && !output_queue_is_full(&(server_conn->t2h_queue)) && update_curr_h2t_header(server_conn));
+        if ((ready[H2T_SOCK_TAG] & EVENT_LOOP_READ) || h2t_retry) {
             if (process_h2t_data(client_conn, server_conn) == FAILURE) {
                 break;
             }
+            const int low_water_mark = h2t_recv_low_water_mark(server_conn);
+            if (h2t_low_water_mark > 0 && !shm_attached && low_water_mark != h2t_low_water_mark) {
+                if (set_recv_low_water_mark(client_conn->h2t_data_fd, low_water_mark) != 0) {
+                    print_last_socket_error("Failed to set the H2T receive low-water mark");
+                    break;
+                }
+                h2t_low_water_mark = low_water_mark;
+            }
         }
 
-        // See if any outbound management data is present, if so send it out
-        if (server_conn->loopback_mode == 0) {
-            if (FD_ISSET(client_conn->mgmt_rsp_fd, &write_fds)) {
-                if (server_conn->hw_callbacks.acquire_mgmt_rsp_data != NULL) {
-                    if (process_mgmt_rsp_data(client_conn, server_conn) == FAILURE) {
-                        break;
-                    }
+        if (server_conn->loopback_mode == 0 && ((wakeup_fd < 0) || hw_pending)) {
+            size_t outbound_cnt = server_conn->pkt_stats.t2h_cnt + server_conn->pkt_stats.mgmt_rsp_cnt;
+
+            // See if any outbound management data is present, if so send it out
+            if (has_mgmt_rsp) {
+                if (process_mgmt_rsp_data(client_conn, server_conn) == FAILURE) {
+                    break;
                 }
             }
 
             // See if any outbound t2h data is present, if so send it out
-            if (FD_ISSET(client_conn->t2h_data_fd, &write_fds)) {
-                if (server_conn->hw_callbacks.acquire_t2h_data != NULL) {
-                    if (process_t2h_data(client_conn, server_conn) == FAILURE) {
-                        break;
-                    }
+            if (has_t2h) {
+                if (process_t2h_data(client_conn, server_conn) == FAILURE) {
+                    break;
                 }
             }
+
+            // Completions held back by the driver never outlive the pass that produced them, so the
+            // hardware gets its memory back before the next wait whatever the batch size
+            if (server_conn->hw_callbacks.flush_data_complete != NULL) {
+                server_conn->pkt_stats.hw_writes_saved += server_conn->hw_callbacks.flush_data_complete(server_conn->hw_callbacks.context);
+            }
+
+            // Keep draining until a pass comes up empty.  Data left in the IP behind a full
+            // output queue is picked up once the client has caught up.
+            hw_pending = (server_conn->pkt_stats.t2h_cnt + server_conn->pkt_stats.mgmt_rsp_cnt) != outbound_cnt ||
+                         (has_t2h && output_queue_is_full(&(server_conn->t2h_queue))) ||
+                         (has_mgmt_rsp && output_queue_is_full(&(server_conn->mgmt_rsp_queue)));
+        }
+
+        // Packets held up on buffer space are activity too, the hardware is about to take them
+        if (num_events > 0 || server_conn->h2t_waiting || server_conn->mgmt_waiting ||
+            pkt_cnt != server_conn->pkt_stats.h2t_cnt + server_conn->pkt_stats.t2h_cnt + server_conn->pkt_stats.mgmt_cnt + server_conn->pkt_stats.mgmt_rsp_cnt) {
+            idle_poll_activity(&(server_conn->idle_poll));
+        }
+
+        // Update what the next wait listens to.  Inbound sockets are left alone while their data
+        // cannot be taken in: in loopback until the echo fits the output queue again, and while
+        // waiting on the hardware when the wakeup will tell us about freed buffer space (the
+        // pending bytes would otherwise keep the socket readable and spin this loop).  H2T is also left
+        // alone while its receive queue is full, which only happens behind a packet that is held up.
+        // Neither H2T nor T2H is ever waited on once the data goes through shared memory.
+        const char h2t_blocked = is_h2t_blocked(server_conn, wakeup_fd) || server_conn->shm.layout != NULL;
+        const char mgmt_blocked = (server_conn->loopback_mode == 1 && output_queue_is_full(&(server_conn->mgmt_rsp_queue))) ||
+                                  (wakeup_fd >= 0 && server_conn->mgmt_waiting);
+        if (update_interest(&loop, all_fds[H2T_SOCK_TAG], &(all_interests[H2T_SOCK_TAG]), h2t_blocked ? 0 : EVENT_LOOP_READ, H2T_SOCK_NAME) != OK ||
+            update_interest(&loop, all_fds[MANAGEMENT_SOCK_TAG], &(all_interests[MANAGEMENT_SOCK_TAG]), mgmt_blocked ? 0 : EVENT_LOOP_READ, MANAGEMENT_SOCK_NAME) != OK ||
+            update_interest(&loop, all_fds[T2H_SOCK_TAG], &(all_interests[T2H_SOCK_TAG]), (output_queue_is_empty(&(server_conn->t2h_queue)) || server_conn->shm.layout != NULL) ? 0 : EVENT_LOOP_WRITE, T2H_SOCK_NAME) != OK ||
+            update_interest(&loop, all_fds[MANAGEMENT_RSP_SOCK_TAG], &(all_interests[MANAGEMENT_RSP_SOCK_TAG]), output_queue_is_empty(&(server_conn->mgmt_rsp_queue)) ? 0 : EVENT_LOOP_WRITE, MANAGEMENT_RSP_SOCK_NAME) != OK) {
+            break;
+        }
+        // The CTRL socket of a multiplexed client carries every stream.  It is read for as long as the frames
+        // received have room, and written while frames are left that it did not accept yet.
+        if (client_conn->is_mux &&
+            update_interest(&loop, all_fds[CONTROL_SOCK_TAG], &(all_interests[CONTROL_SOCK_TAG]),
+                            (input_queue_is_full(&(server_conn->mux_rx_queue)) ? 0 : EVENT_LOOP_READ) |
+                            (output_queue_is_empty(&(server_conn->mux_tx_queue)) ? 0 : EVENT_LOOP_WRITE), CONTROL_SOCK_NAME) != OK) {
+            break;
+        }
+    }
+
+    event_loop_close(&loop);
+    shm_transport_close(&(server_conn->shm));
+}
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+// Threaded mode, see SERVER_CONN.threaded.  This thread only moves bytes between the sockets and the rings of
+// the MMIO engine, which owns the hardware.  Control messages are handled here with the engine parked.
+static void handle_client_threaded(SERVER_CONN *server_conn, CLIENT_CONN *client_conn) {
+    enum { IDLE_WAIT_MS = 1000 };
+    SOCKET all_fds[NUM_SOCK_TAGS];
+    const char *all_fd_names[NUM_SOCK_TAGS];
+    get_client_sockets(server_conn, client_conn, all_fds, all_fd_names);
+
+    // Inbound sockets are only read while their ring has room, outbound ones only written
+    // while the engine left data in their ring that the socket did not accept yet
+    unsigned int all_interests[NUM_SOCK_TAGS];
+    all_interests[SERVER_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[CONTROL_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[MANAGEMENT_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[MANAGEMENT_RSP_SOCK_TAG] = 0;
+    all_interests[H2T_SOCK_TAG] = EVENT_LOOP_READ;
+    all_interests[T2H_SOCK_TAG] = 0;
+
+    // The statistics of the queues are kept up to date, the queues themselves are not used
+    input_queue_reset(&(server_conn->h2t_rx_queue));
+    output_queue_reset(&(server_conn->t2h_queue));
+    output_queue_reset(&(server_conn->mgmt_rsp_queue));
+    if (set_non_blocking_socket(client_conn->h2t_data_fd, 1) != 0 || set_non_blocking_socket(client_conn->mgmt_fd, 1) != 0 ||
+        set_non_blocking_socket(client_conn->t2h_data_fd, 1) != 0 || set_non_blocking_socket(client_conn->mgmt_rsp_fd, 1) != 0) {
+        print_last_socket_error("Failed to make data sockets non-blocking");
+        return;
+    }
+    set_busy_poll_sockets(server_conn, client_conn);
+
+    MMIO_ENGINE engine;
+    if (mmio_engine_start(&engine, server_conn) != OK) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Failed to start the MMIO engine\n");
+        return;
+    }
+
+    EVENT_LOOP loop;
+    char failed = (event_loop_init(&loop, server_conn->event_loop_backend) != OK);
+    for (int i = 0; !failed && i < NUM_SOCK_TAGS; ++i) {
+        failed = (all_fds[i] != INVALID_SOCKET && event_loop_add(&loop, all_fds[i], all_interests[i], i) != OK);
+    }
+    if (!failed && server_conn->acceptor == NULL && server_conn->local_fd != INVALID_SOCKET) {
+        failed = (event_loop_add(&loop, server_conn->local_fd, EVENT_LOOP_READ, LOCAL_SERVER_SOCK_TAG) != OK);
+    }
+    if (failed || event_loop_add(&loop, engine.network_bell.fd, EVENT_LOOP_READ, ENGINE_WAKEUP_TAG) != OK) {
+        print_last_socket_error("Failed to register socket with event loop");
+        event_loop_close(&loop);
+        mmio_engine_stop(&engine);
+        return;
+    }
+    watch_draining_conns(server_conn, &loop, DRAINING_SOCK_TAG);
+
+    const char busy_poll = server_conn->busy_poll_us > 0;
+    while (1) {
+        EVENT_LOOP_EVENT events[NUM_EVENT_TAGS];
+        unsigned int ready[NUM_EVENT_TAGS] = { 0 };
+
+        // Sleep unless the engine published something since the previous pass, or freed up room
+        // that a socket left alone below could use.  Busy polling never sleeps, nor has the engine ring the bell.
+        if (!busy_poll) {
+            spsc_doorbell_arm(&(engine.network_bell));
+        }
+        const char has_work = busy_poll || mmio_engine_has_exited(&engine) ||
+                              (all_interests[T2H_SOCK_TAG] == 0 && spsc_ring_readable(&(engine.t2h_ring), 1) > 0) ||
+                              (all_interests[MANAGEMENT_RSP_SOCK_TAG] == 0 && spsc_ring_readable(&(engine.mgmt_rsp_ring), 1) > 0) ||
+                              (all_interests[H2T_SOCK_TAG] == 0 && spsc_ring_room(&(engine.h2t_ring), 1) > 0) ||
+                              (all_interests[MANAGEMENT_SOCK_TAG] == 0 && spsc_ring_room(&(engine.mgmt_ring), 1) > 0);
+        int num_events = event_loop_wait(&loop, events, NUM_EVENT_TAGS, has_work ? 0 : draining_wait_ms(server_conn, IDLE_WAIT_MS));
+        if (!busy_poll) {
+            spsc_doorbell_disarm(&(engine.network_bell));
+        }
+        if (num_events < 0) {
+            print_last_socket_error("Event loop wait failure");
+            break;
+        }
+        for (int i = 0; i < num_events; ++i) {
+            ready[events[i].tag] |= events[i].ready;
+        }
+
+        // First handle exceptional conditions, as in single-threaded mode
+        char disconnect_client = 0;
+        for (int i = 0; i < NUM_SOCK_TAGS; ++i) {
+            if ((ready[i] & EVENT_LOOP_EXCEPT) || ((ready[i] & EVENT_LOOP_READ) && !(all_interests[i] & EVENT_LOOP_READ))) {
+                fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Exception found on socket: %s\n", all_fd_names[i]);
+                disconnect_client = 1;
+                break;
+            }
+        }
+        if (disconnect_client || mmio_engine_has_exited(&engine)) {
+            break;
+        }
+        service_draining_conns(server_conn, &loop, ready + DRAINING_SOCK_TAG);
+
+        if (ready[SERVER_SOCK_TAG] & EVENT_LOOP_READ) {
+            reject_client(server_conn, server_conn->server_fd);
+        }
+        if (ready[LOCAL_SERVER_SOCK_TAG] & EVENT_LOOP_READ) {
+            reject_client(server_conn, server_conn->local_fd);
+        }
+
+        // Parameters may change what the engine works with, it is held for the duration
+        if (ready[CONTROL_SOCK_TAG] & EVENT_LOOP_READ) {
+            mmio_engine_park(&engine);
+            RETURN_CODE result = process_control_message(client_conn, server_conn, &disconnect_client);
+            if (result == OK) {
+                result = mmio_engine_fit_rings(&engine);
+            }
+            mmio_engine_unpark(&engine);
+            if (result == FAILURE || disconnect_client) {
+                break;
+            }
+        }
+
+        // Inbound data goes to the engine as it arrives, packets are only parsed over there
+        ssize_t bytes_transferred = 0;
+        if (ready[H2T_SOCK_TAG] & EVENT_LOOP_READ) {
+            if (spsc_ring_fill(&(engine.h2t_ring), client_conn->h2t_data_fd, 0, &bytes_transferred, &(server_conn->h2t_rx_queue.recv_calls)) != OK) {
+                print_last_socket_error_b("Failed to recv H2T data", bytes_transferred);
+                break;
+            }
+            if (bytes_transferred > 0) {
+                spsc_doorbell_ring(&(engine.engine_bell));
+            }
+        }
+        if (ready[MANAGEMENT_SOCK_TAG] & EVENT_LOOP_READ) {
+            if (spsc_ring_fill(&(engine.mgmt_ring), client_conn->mgmt_fd, 0, &bytes_transferred, NULL) != OK) {
+                print_last_socket_error_b("Failed to recv MGMT data", bytes_transferred);
+                break;
+            }
+            if (bytes_transferred > 0) {
+                spsc_doorbell_ring(&(engine.engine_bell));
+            }
+        }
+
+        // Outbound packets are sent as laid out by the engine, the room freed up lets it drain the hardware further
+        if ((all_interests[T2H_SOCK_TAG] == 0 || (ready[T2H_SOCK_TAG] & EVENT_LOOP_WRITE)) && spsc_ring_readable(&(engine.t2h_ring), 1) > 0) {
+            if (spsc_ring_flush(&(engine.t2h_ring), client_conn->t2h_data_fd, 0, &bytes_transferred, &(server_conn->t2h_queue.send_calls)) != OK) {
+                print_last_socket_error_b("An error occurred sending T2H data", bytes_transferred);
+                break;
+            }
+            if (bytes_transferred > 0) {
+                spsc_doorbell_ring(&(engine.engine_bell));
+            }
+        }
+        if ((all_interests[MANAGEMENT_RSP_SOCK_TAG] == 0 || (ready[MANAGEMENT_RSP_SOCK_TAG] & EVENT_LOOP_WRITE)) && spsc_ring_readable(&(engine.mgmt_rsp_ring), 1) > 0) {
+            if (spsc_ring_flush(&(engine.mgmt_rsp_ring), client_conn->mgmt_rsp_fd, 0, &bytes_transferred, &(server_conn->mgmt_rsp_queue.send_calls)) != OK) {
+                print_last_socket_error_b("An error occurred sending MGMT RSP data", bytes_transferred);
+                break;
+            }
+            if (bytes_transferred > 0) {
+                spsc_doorbell_ring(&(engine.engine_bell));
+            }
+        }
+
+        if (update_interest(&loop, all_fds[H2T_SOCK_TAG], &(all_interests[H2T_SOCK_TAG]), (spsc_ring_room(&(engine.h2t_ring), 1) > 0) ? EVENT_LOOP_READ : 0, H2T_SOCK_NAME) != OK ||
+            update_interest(&loop, all_fds[MANAGEMENT_SOCK_TAG], &(all_interests[MANAGEMENT_SOCK_TAG]), (spsc_ring_room(&(engine.mgmt_ring), 1) > 0) ? EVENT_LOOP_READ : 0, MANAGEMENT_SOCK_NAME) != OK ||
+            update_interest(&loop, all_fds[T2H_SOCK_TAG], &(all_interests[T2H_SOCK_TAG]), (spsc_ring_readable(&(engine.t2h_ring), 1) > 0) ? EVENT_LOOP_WRITE : 0, T2H_SOCK_NAME) != OK ||
+            update_interest(&loop, all_fds[MANAGEMENT_RSP_SOCK_TAG], &(all_interests[MANAGEMENT_RSP_SOCK_TAG]), (spsc_ring_readable(&(engine.mgmt_rsp_ring), 1) > 0) ? EVENT_LOOP_WRITE : 0, MANAGEMENT_RSP_SOCK_NAME) != OK) {
+            break;
         }
     }
+
+    event_loop_close(&loop);
+    mmio_engine_stop(&engine);
 }
+#endif
 
 RETURN_CODE initialize_server(unsigned short port, SERVER_CONN *server_conn, const char *port_filename) {
     if (initialize_sockets_library() == FAILURE) {
@@ -867,7 +2495,6 @@ RETURN_CODE initialize_server(unsigned short port, SERVER_CONN *server_conn, con
     server_conn->server_addr.sin_family = AF_INET;
     server_conn->server_addr.sin_addr.s_addr = INADDR_ANY;
     server_conn->server_addr.sin_port = htons(port);
-    sizeof_addr = sizeof(server_conn->server_addr);
 
     if (bind_server_socket(server_conn) != OK) {
         fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Failed to bind server socket!\n");
@@ -876,6 +2503,7 @@ RETURN_CODE initialize_server(unsigned short port, SERVER_CONN *server_conn, con
 
     // If a request to bind to any available port, take note of which port was assigned by the kernel
     if (port == 0) {
+        SOCKADDR_LEN sizeof_addr = sizeof(server_conn->server_addr);
         if (getsockname(server_conn->server_fd, (struct sockaddr *)(&(server_conn->server_addr)), &sizeof_addr) < 0) {
             print_last_socket_error("getsockname failed");
         }
@@ -884,6 +2512,17 @@ RETURN_CODE initialize_server(unsigned short port, SERVER_CONN *server_conn, con
     unsigned short port_used = ntohs(server_conn->server_addr.sin_port);
     fpga_msg_printf(FPGA_MSG_PRINTF_INFO, "Server socket is listening on port: %d\n", port_used);
 
+    // Local clients connect to a listener of their own, TCP clients are served as before
+    if (server_conn->local_path != NULL) {
+        if (bind_local_server_socket(server_conn) != OK) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Failed to bind local server socket!\n");
+            close_socket_fd(server_conn->server_fd);
+            server_conn->server_fd = INVALID_SOCKET;
+            return FAILURE;
+        }
+        fpga_msg_printf(FPGA_MSG_PRINTF_INFO, "Local server socket is listening on: %s\n", server_conn->local_path);
+    }
+
     // Write out the port used.  This is especially useful when an ephermal port is used.
 #if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS || STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
     if (port_filename != NULL) {
@@ -901,36 +2540,116 @@ RETURN_CODE initialize_server(unsigned short port, SERVER_CONN *server_conn, con
     return OK;
 }
 
-static SERVER_CONN *s_server_conn_ptr = NULL; // used to access the server_fd and close it in case of SIGINIT
-void server_terminate()
+// Closes the listening socket of 'server_conn', e.g. in case of SIGINT
+void server_terminate(SERVER_CONN *server_conn)
 {
-    // free TCP/IP recv/send buffer
-    free_tcpip_recv_send_buffer();
-    // Close the listening socket
-    if (s_server_conn_ptr->server_fd != INVALID_SOCKET)
+    server_conn->stopping = 1;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    // The acceptor thread is done with the listening sockets before they are closed
+    acceptor_join(server_conn);
+#endif
+    if (server_conn->server_fd != INVALID_SOCKET)
     {
-        set_linger_socket_option(s_server_conn_ptr->server_fd, 1, 0);
-        if (close_socket_fd(s_server_conn_ptr->server_fd))
+        set_linger_socket_option(server_conn->server_fd, 1, 0);
+        if (close_socket_fd(server_conn->server_fd))
         {
             fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Error closing server socket.");
         }
         else
         {
-            s_server_conn_ptr->server_fd = INVALID_SOCKET;
+            server_conn->server_fd = INVALID_SOCKET;
         }
     }
+    close_local_server_socket(server_conn);
 
-    s_server_conn_ptr = NULL;
     fpga_msg_printf(FPGA_MSG_PRINTF_INFO, "Server Terminated");
 }
 
-int server_main(intel_remote_debug_server_context *context, SERVER_LIFESPAN lifespan, SERVER_CONN *server_conn)
+// Pins the calling thread to 'cpu' and, unless 'sched_fifo_priority' is 0, has it run SCHED_FIFO.  Failures are
+// reported but not fatal, a thread left where it was still works, e.g. without the privileges for SCHED_FIFO.
+RETURN_CODE pin_current_thread(int cpu, int sched_fifo_priority, const char *thread_name) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    RETURN_CODE rc = OK;
+    cpu_set_t cpus;
+    int err;
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "CPU %d of the %s thread is out of range\n", cpu, thread_name);
+        return FAILURE;
+    }
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) != 0) {
+        fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Failed to pin the %s thread to CPU %d: %s\n", thread_name, cpu, strerror(err));
+        rc = FAILURE;
+    }
+    if (sched_fifo_priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = sched_fifo_priority;
+        if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Failed to run the %s thread SCHED_FIFO at priority %d: %s\n", thread_name, sched_fifo_priority, strerror(err));
+            rc = FAILURE;
+        }
+    }
+    return rc;
+#else
+    (void)cpu;
+    (void)sched_fifo_priority;
+    fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Pinning the %s thread is not supported on this platform\n", thread_name);
+    return FAILURE;
+#endif
+}
+
+static void free_queues(SERVER_CONN *server_conn)
+{
+    input_queue_free(&(server_conn->h2t_rx_queue));
+    output_queue_free(&(server_conn->t2h_queue));
+    output_queue_free(&(server_conn->mgmt_rsp_queue));
+    input_queue_free(&(server_conn->mux_rx_queue));
+    input_queue_free(&(server_conn->ctrl_rx_queue));
+    input_queue_free(&(server_conn->mgmt_rx_queue));
+    output_queue_free(&(server_conn->mux_tx_queue));
+}
+
+int server_main(SERVER_LIFESPAN lifespan, SERVER_CONN *server_conn)
 {
     int rc = 0;
-    s_server_conn_ptr = server_conn;
-    rc = alloc_tcpip_recv_send_buffer(context->h2t_t2h_mem_size);
+    if (server_conn->cpu >= 0)
+    {
+        pin_current_thread(server_conn->cpu, server_conn->sched_fifo_priority, "server");
+    }
+    // Any packet has to fit past the high-water mark, DATA_LEN_BYTES is 16 bits wide
+    rc = output_queue_alloc(&(server_conn->t2h_queue), SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + USHRT_MAX);
+    if (rc == OK)
+    {
+        // Room for a maximum sized packet on top of a partially received one
+        rc = input_queue_alloc(&(server_conn->h2t_rx_queue), 2 * (SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + USHRT_MAX));
+    }
+    if (rc == OK)
+    {
+        rc = output_queue_alloc(&(server_conn->mgmt_rsp_queue), SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER + USHRT_MAX);
+    }
+    // Multiplexed clients, a frame is taken in whatever its size.  CTRL messages and MGMT packets are only parsed
+    // once complete, so their queues have room for a whole one on top of a partially received one.
+    if (rc == OK)
+    {
+        rc = input_queue_alloc(&(server_conn->mux_rx_queue), SIZEOF_MUX_FRAME_HEADER + MUX_FRAME_MAX_PAYLOAD_BYTES);
+    }
+    if (rc == OK)
+    {
+        rc = input_queue_alloc(&(server_conn->ctrl_rx_queue), 2 * server_conn->buff->ctrl_rx_buff_sz);
+    }
+    if (rc == OK)
+    {
+        rc = input_queue_alloc(&(server_conn->mgmt_rx_queue), 2 * (SIZEOF_PACKET_GUARDBAND + SIZEOF_MGMT_PACKET_HEADER + USHRT_MAX));
+    }
+    if (rc == OK)
+    {
+        rc = output_queue_alloc(&(server_conn->mux_tx_queue), SIZEOF_MUX_FRAME_HEADER + MUX_FRAME_MAX_PAYLOAD_BYTES);
+    }
     if (rc == FAILURE)
     {
+        free_queues(server_conn);
         return rc;
     }
     else
@@ -940,33 +2659,109 @@ int server_main(intel_remote_debug_server_context *context, SERVER_LIFESPAN life
         {
             reset_buffers(server_conn);
             CLIENT_CONN client_conn = CLIENT_CONN_default;
-            rc = connect_client(&(context->driver_cxt), server_conn, &client_conn);
+            rc = connect_client(server_conn, &client_conn);
             if (rc == OK)
             {
-                handle_client(server_conn, &client_conn);
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+                ACCEPTOR acceptor;
+                const char has_acceptor = server_conn->background_reject && (acceptor_start(&acceptor, server_conn) == OK);
+                if (server_conn->background_reject && !has_acceptor)
+                {
+                    print_last_socket_error("Failed to start the acceptor thread, additional clients are rejected inline");
+                }
+                if (server_conn->threaded)
+                {
+                    handle_client_threaded(server_conn, &client_conn);
+                }
+                else
+#endif
+                {
+                    handle_client(server_conn, &client_conn);
+                }
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+                if (has_acceptor)
+                {
+                    acceptor_stop(&acceptor);
+                }
+#endif
             }
             else
             {
                 fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Rejected remote client.\n");
             }
 
-            close_client_conn(&client_conn, server_conn);
+            if (client_conn.draining)
+            {
+                start_draining(server_conn, &client_conn);
+            }
+            else
+            {
+                close_client_conn(&client_conn, server_conn);
+            }
             if (rc == INIT_ERR)
             {
                 break;
             }
-        } while (lifespan == MULTIPLE_CLIENTS);
+        } while (lifespan == MULTIPLE_CLIENTS && !server_conn->stopping);
     }
 
-    // Close the listening socket
-    set_linger_socket_option(server_conn->server_fd, 1, 0);
-    if (close_socket_fd(server_conn->server_fd))
-        fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Error closing server socket.\n");
-    else
-        server_conn->server_fd = INVALID_SOCKET;
+    free_queues(server_conn);
+
+    // Connections still waiting for a session
+    for (int i = 0; i < MAX_PENDING_CONNS; ++i)
+    {
+        PENDING_CONN *conn = &(server_conn->pending_conns[i]);
+        if (conn->state != PENDING_CONN_FREE)
+        {
+            set_linger_socket_option(conn->fd, 1, 0);
+            close_socket_fd(conn->fd);
+            conn->fd = INVALID_SOCKET;
+            conn->state = PENDING_CONN_FREE;
+        }
+    }
 
-    // capture the server connection status, especially the server_fd, in case of SIGINT, grace termination will close the server_fd
-    s_server_conn_ptr = server_conn;
+    // Clients that sent DISCONNECT_CMD still get their time to close first, no other client is served any more
+    EVENT_LOOP drain_loop = EVENT_LOOP_default;
+    if (event_loop_init(&drain_loop, server_conn->event_loop_backend) == OK)
+    {
+        watch_draining_conns(server_conn, &drain_loop, 0);
+        for (int timeout_ms = draining_wait_ms(server_conn, -1); timeout_ms >= 0; timeout_ms = draining_wait_ms(server_conn, -1))
+        {
+            EVENT_LOOP_EVENT events[MAX_DRAINING_CONNS];
+            unsigned int ready[MAX_DRAINING_CONNS] = { 0 };
+            const int num_events = event_loop_wait(&drain_loop, events, MAX_DRAINING_CONNS, timeout_ms);
+            for (int e = 0; e < num_events; ++e)
+            {
+                ready[events[e].tag] |= events[e].ready;
+            }
+            service_draining_conns(server_conn, &drain_loop, ready);
+            if (num_events < 0)
+            {
+                break;
+            }
+        }
+        event_loop_close(&drain_loop);
+    }
+    for (int i = 0; i < MAX_DRAINING_CONNS; ++i)
+    {
+        DRAINING_CONN *draining = &(server_conn->draining_conns[i]);
+        if (draining->conn.draining)
+        {
+            finish_draining(server_conn, NULL, draining);
+        }
+        output_queue_free(&(draining->tx_queue));
+    }
+
+    // Close the listening socket, unless server_terminate() did already
+    if (server_conn->server_fd != INVALID_SOCKET)
+    {
+        set_linger_socket_option(server_conn->server_fd, 1, 0);
+        if (close_socket_fd(server_conn->server_fd))
+            fpga_msg_printf(FPGA_MSG_PRINTF_ERROR, "Error closing server socket.\n");
+        else
+            server_conn->server_fd = INVALID_SOCKET;
+    }
+    close_local_server_socket(server_conn);
 
     return rc;
 }
@@ -0,0 +1,426 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memfd_create()
+#endif
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "intel_st_debug_if_shm_transport.h"
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#endif
+
+const SHM_TRANSPORT SHM_TRANSPORT_default = {
+    .layout = NULL,
+    .map_sz = 0,
+    .mem_fd = -1,
+    .h2t = { NULL, NULL, 0, 0, 0 },
+    .t2h = { NULL, NULL, 0, 0, 0 },
+    .own_sleeping = NULL,
+    .peer_sleeping = NULL,
+    .own_bell_fd = -1,
+    .peer_bell_fd = -1,
+    .spin_us = SHM_TRANSPORT_DEFAULT_SPIN_US
+};
+
+static size_t round_up_to_power_of_2(size_t sz) {
+    size_t result = SPSC_RING_CACHE_LINE_SZ;
+    while (result < sz) {
+        result <<= 1;
+    }
+    return result;
+}
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+// Points both rings into the mapping, the caller checked that it is large enough
+static void shm_transport_init_rings(SHM_TRANSPORT *shm) {
+    char *rings = (char *)shm->layout + sizeof(SHM_TRANSPORT_LAYOUT);
+    shm->h2t.indices = &(shm->layout->h2t);
+    shm->h2t.buff = rings;
+    shm->h2t.buff_sz = shm->layout->ring_sz;
+    shm->h2t.cached_head = shm->h2t.cached_tail = 0;
+    shm->t2h.indices = &(shm->layout->t2h);
+    shm->t2h.buff = rings + shm->layout->ring_sz;
+    shm->t2h.buff_sz = shm->layout->ring_sz;
+    shm->t2h.cached_head = shm->t2h.cached_tail = 0;
+}
+#endif
+
+RETURN_CODE shm_transport_create(SHM_TRANSPORT *shm, size_t ring_sz, int *fds) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    *shm = SHM_TRANSPORT_default;
+    if (ring_sz == 0 || ring_sz > SHM_TRANSPORT_MAX_RING_SZ) {
+        return FAILURE;
+    }
+    ring_sz = round_up_to_power_of_2(ring_sz);
+    shm->map_sz = sizeof(SHM_TRANSPORT_LAYOUT) + 2 * ring_sz;
+
+    // Anonymous memory, it goes away once both sides have closed the descriptor and unmapped it
+    shm->mem_fd = memfd_create("etherlink-shm", MFD_CLOEXEC);
+    if (shm->mem_fd < 0) {
+        return FAILURE;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(shm->mem_fd, (off_t)shm->map_sz) == 0) {
+        map = mmap(NULL, shm->map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, shm->mem_fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        shm_transport_close(shm);
+        return FAILURE;
+    }
+    shm->layout = (SHM_TRANSPORT_LAYOUT *)map;
+    memset(shm->layout, 0, sizeof(SHM_TRANSPORT_LAYOUT));
+    shm->layout->magic = SHM_TRANSPORT_MAGIC;
+    shm->layout->version = SHM_TRANSPORT_VERSION;
+    shm->layout->ring_sz = (uint32_t)ring_sz;
+    shm_transport_init_rings(shm);
+
+    shm->own_sleeping = &(shm->layout->server_sleeping);
+    shm->peer_sleeping = &(shm->layout->client_sleeping);
+    shm->own_bell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    shm->peer_bell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shm->own_bell_fd < 0 || shm->peer_bell_fd < 0) {
+        shm_transport_close(shm);
+        return FAILURE;
+    }
+
+    fds[SHM_TRANSPORT_MEM_FD] = shm->mem_fd;
+    fds[SHM_TRANSPORT_SERVER_BELL_FD] = shm->own_bell_fd;
+    fds[SHM_TRANSPORT_CLIENT_BELL_FD] = shm->peer_bell_fd;
+    return OK;
+#else
+    (void)ring_sz;
+    (void)fds;
+    *shm = SHM_TRANSPORT_default;
+    return FAILURE;
+#endif
+}
+
+RETURN_CODE shm_transport_attach(SHM_TRANSPORT *shm, const int *fds) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    struct stat mem_stat;
+    *shm = SHM_TRANSPORT_default;
+    shm->own_bell_fd = fds[SHM_TRANSPORT_CLIENT_BELL_FD];
+    shm->peer_bell_fd = fds[SHM_TRANSPORT_SERVER_BELL_FD];
+
+    // Never trust the sizes found in the memory before they are checked against the descriptor
+    void *map = MAP_FAILED;
+    if (fstat(fds[SHM_TRANSPORT_MEM_FD], &mem_stat) == 0 && (size_t)mem_stat.st_size >= sizeof(SHM_TRANSPORT_LAYOUT)) {
+        map = mmap(NULL, (size_t)mem_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[SHM_TRANSPORT_MEM_FD], 0);
+    }
+    close(fds[SHM_TRANSPORT_MEM_FD]);
+    if (map == MAP_FAILED) {
+        shm_transport_close(shm);
+        return FAILURE;
+    }
+    shm->layout = (SHM_TRANSPORT_LAYOUT *)map;
+    shm->map_sz = (size_t)mem_stat.st_size;
+    const size_t ring_sz = shm->layout->ring_sz;
+    if (shm->layout->magic != SHM_TRANSPORT_MAGIC || shm->layout->version != SHM_TRANSPORT_VERSION ||
+        ring_sz == 0 || (ring_sz & (ring_sz - 1)) != 0 || sizeof(SHM_TRANSPORT_LAYOUT) + 2 * ring_sz > shm->map_sz) {
+        shm_transport_close(shm);
+        return FAILURE;
+    }
+    shm_transport_init_rings(shm);
+    shm->own_sleeping = &(shm->layout->client_sleeping);
+    shm->peer_sleeping = &(shm->layout->server_sleeping);
+    return OK;
+#else
+    (void)fds;
+    *shm = SHM_TRANSPORT_default;
+    return FAILURE;
+#endif
+}
+
+void shm_transport_close(SHM_TRANSPORT *shm) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (shm->layout != NULL) {
+        munmap(shm->layout, shm->map_sz);
+    }
+    if (shm->mem_fd >= 0) {
+        close(shm->mem_fd);
+    }
+    if (shm->own_bell_fd >= 0) {
+        close(shm->own_bell_fd);
+    }
+    if (shm->peer_bell_fd >= 0) {
+        close(shm->peer_bell_fd);
+    }
+#endif
+    *shm = SHM_TRANSPORT_default;
+}
+
+size_t shm_ring_room(SHM_RING *ring, size_t wanted) {
+    const uint32_t tail = ring->indices->tail;
+    size_t room = ring->buff_sz - (uint32_t)(tail - ring->cached_head);
+    if (room < wanted) {
+        ring->cached_head = __atomic_load_n(&(ring->indices->head), __ATOMIC_ACQUIRE);
+        room = ring->buff_sz - (uint32_t)(tail - ring->cached_head);
+    }
+    return room;
+}
+
+size_t shm_ring_write(SHM_RING *ring, const void *src, size_t len) {
+    len = MIN_MACRO(len, shm_ring_room(ring, len));
+    const uint32_t tail = ring->indices->tail;
+    const size_t offset = tail & (ring->buff_sz - 1);
+    const size_t first_len = MIN_MACRO(len, ring->buff_sz - offset);
+    memcpy(ring->buff + offset, src, first_len);
+    memcpy(ring->buff, (const char *)src + first_len, len - first_len);
+    __atomic_store_n(&(ring->indices->tail), tail + (uint32_t)len, __ATOMIC_RELEASE);
+    return len;
+}
+
+size_t shm_ring_readable(SHM_RING *ring, size_t wanted) {
+    const uint32_t head = ring->indices->head;
+    size_t readable = (uint32_t)(ring->cached_tail - head);
+    if (readable < wanted) {
+        ring->cached_tail = __atomic_load_n(&(ring->indices->tail), __ATOMIC_ACQUIRE);
+        readable = (uint32_t)(ring->cached_tail - head);
+    }
+    return readable;
+}
+
+size_t shm_ring_read(SHM_RING *ring, void *dst, size_t max_len) {
+    const size_t len = MIN_MACRO(max_len, shm_ring_readable(ring, max_len));
+    const uint32_t head = ring->indices->head;
+    const size_t start = head & (ring->buff_sz - 1);
+    const size_t first_len = MIN_MACRO(len, ring->buff_sz - start);
+    memcpy(dst, ring->buff + start, first_len);
+    memcpy((char *)dst + first_len, ring->buff, len - first_len);
+    __atomic_store_n(&(ring->indices->head), head + (uint32_t)len, __ATOMIC_RELEASE);
+    return len;
+}
+
+void shm_transport_ack(SHM_TRANSPORT *shm) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    uint64_t count;
+    ssize_t rc = read(shm->own_bell_fd, &count, sizeof(count));
+    (void)rc;
+#else
+    (void)shm;
+#endif
+}
+
+void shm_transport_ring_peer(SHM_TRANSPORT *shm, int event) {
+    // Orders whatever was published before against the look at the flag, pairs with shm_transport_arm()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((__atomic_load_n(shm->peer_sleeping, __ATOMIC_RELAXED) & event) && __atomic_exchange_n(shm->peer_sleeping, 0, __ATOMIC_RELAXED)) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+        uint64_t one = 1;
+        ssize_t rc = write(shm->peer_bell_fd, &one, sizeof(one));
+        (void)rc; // Only fails once the counter saturates, in which case the other side is woken up anyway
+#endif
+    }
+}
+
+void shm_transport_arm(SHM_TRANSPORT *shm, int wait_for) {
+    __atomic_store_n(shm->own_sleeping, wait_for, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+char shm_transport_disarm(SHM_TRANSPORT *shm) {
+    // Still set unless the other side rang, the descriptor is only drained then
+    if (!__atomic_exchange_n(shm->own_sleeping, 0, __ATOMIC_RELAXED)) {
+        shm_transport_ack(shm);
+        return 1;
+    }
+    return 0;
+}
+
+RETURN_CODE shm_transport_send_fds(SOCKET sock_fd, const char *msg, size_t msg_len, const int *fds, int num_fds) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    union {
+        char buff[CMSG_SPACE(SHM_TRANSPORT_NUM_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { (void *)msg, msg_len };
+    struct msghdr hdr;
+    if (num_fds < 1 || num_fds > SHM_TRANSPORT_NUM_FDS) {
+        return FAILURE;
+    }
+    memset(&control, 0, sizeof(control));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.buff;
+    hdr.msg_controllen = CMSG_SPACE(num_fds * sizeof(int));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, num_fds * sizeof(int));
+
+    // The descriptors travel with the first byte, whatever is left goes out as usual
+    ssize_t bytes_sent = sendmsg(sock_fd, &hdr, MSG_NOSIGNAL);
+    if (bytes_sent <= 0) {
+        return FAILURE;
+    }
+    return ((size_t)bytes_sent < msg_len) ? socket_send_all(sock_fd, msg + bytes_sent, msg_len - bytes_sent, MSG_NOSIGNAL, NULL) : OK;
+#else
+    (void)sock_fd;
+    (void)msg;
+    (void)msg_len;
+    (void)fds;
+    (void)num_fds;
+    return FAILURE;
+#endif
+}
+
+RETURN_CODE shm_transport_recv_fds(SOCKET sock_fd, char *buff, size_t buff_sz, int *fds, int num_fds) {
+    for (int i = 0; i < num_fds; ++i) {
+        fds[i] = -1;
+    }
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    union {
+        char buff[CMSG_SPACE(SHM_TRANSPORT_NUM_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { buff, buff_sz - 1 };
+    struct msghdr hdr;
+    if (buff_sz < 2 || num_fds < 1 || num_fds > SHM_TRANSPORT_NUM_FDS) {
+        return FAILURE;
+    }
+    memset(buff, 0, buff_sz);
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.buff;
+    hdr.msg_controllen = sizeof(control.buff);
+    ssize_t bytes_recvd = recvmsg(sock_fd, &hdr, MSG_CMSG_CLOEXEC);
+    if (bytes_recvd <= 0) {
+        return FAILURE;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            const int received = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            int *received_fds = (int *)CMSG_DATA(cmsg);
+            for (int i = 0; i < received; ++i) {
+                if (i < num_fds) {
+                    fds[i] = received_fds[i];
+                } else {
+                    close(received_fds[i]);
+                }
+            }
+        }
+    }
+    if (memchr(buff, '\0', (size_t)bytes_recvd) == NULL) {
+        return socket_recv_until_null_reached(sock_fd, buff + bytes_recvd, buff_sz - 1 - bytes_recvd, 0, NULL);
+    }
+    return OK;
+#else
+    (void)sock_fd;
+    (void)buff;
+    (void)buff_sz;
+    return FAILURE;
+#endif
+}
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+static unsigned long long shm_now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000ULL + (unsigned long long)now.tv_nsec / 1000;
+}
+
+// Spins, then sleeps until 'ring' has data (or room, for the producer).  FAILURE once 'hangup_fd' is readable.
+static RETURN_CODE shm_transport_wait(SHM_TRANSPORT *shm, SHM_RING *ring, char for_room, SOCKET hangup_fd) {
+    const unsigned long long spin_until = shm_now_us() + shm->spin_us;
+    do {
+        if ((for_room ? shm_ring_room(ring, 1) : shm_ring_readable(ring, 1)) > 0) {
+            return OK;
+        }
+    } while (shm_now_us() < spin_until);
+
+    shm_transport_arm(shm, for_room ? SHM_TRANSPORT_WAIT_ROOM : SHM_TRANSPORT_WAIT_DATA);
+    if ((for_room ? shm_ring_room(ring, 1) : shm_ring_readable(ring, 1)) == 0) {
+        struct pollfd fds[2] = { { shm->own_bell_fd, POLLIN, 0 }, { hangup_fd, POLLIN, 0 } };
+        if (poll(fds, (hangup_fd != INVALID_SOCKET) ? 2 : 1, -1) < 0 || fds[1].revents != 0) {
+            shm_transport_disarm(shm);
+            return FAILURE;
+        }
+        if (!shm_transport_disarm(shm) && fds[0].revents != 0) {
+            shm_transport_ack(shm);
+        }
+        return OK;
+    }
+    shm_transport_disarm(shm);
+    return OK;
+}
+#endif
+
+RETURN_CODE shm_transport_send_all(SHM_TRANSPORT *shm, const void *src, size_t len, SOCKET hangup_fd) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    while (len > 0) {
+        const size_t written = shm_ring_write(&(shm->h2t), src, len);
+        if (written > 0) {
+            shm_transport_ring_peer(shm, SHM_TRANSPORT_WAIT_DATA);
+            src = (const char *)src + written;
+            len -= written;
+        } else if (shm_transport_wait(shm, &(shm->h2t), 1, hangup_fd) != OK) {
+            return FAILURE;
+        }
+    }
+    return OK;
+#else
+    (void)shm;
+    (void)src;
+    (void)len;
+    (void)hangup_fd;
+    return FAILURE;
+#endif
+}
+
+RETURN_CODE shm_transport_recv_all(SHM_TRANSPORT *shm, void *dst, size_t len, SOCKET hangup_fd) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    while (len > 0) {
+        const size_t read = shm_ring_read(&(shm->t2h), dst, len);
+        if (read > 0) {
+            shm_transport_ring_peer(shm, SHM_TRANSPORT_WAIT_ROOM);
+            dst = (char *)dst + read;
+            len -= read;
+        } else if (shm_transport_wait(shm, &(shm->t2h), 0, hangup_fd) != OK) {
+            return FAILURE;
+        }
+    }
+    return OK;
+#else
+    (void)shm;
+    (void)dst;
+    (void)len;
+    (void)hangup_fd;
+    return FAILURE;
+#endif
+}
@@ -30,46 +30,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 
-#include "intel_st_debug_if_st_dbg_ip_driver.h"
 #include "intel_st_debug_if_common.h"
 #include "intel_st_debug_if_constants.h"
 
-#define PACKET_HEADER_SIZE 64
-
 const struct timeval ZERO_TIMEOUT = { 0, 0 };
 
-static char *g_socket_recv_buff = NULL;
-static char *g_socket_send_buff = NULL;
-
-RETURN_CODE alloc_tcpip_recv_send_buffer(size_t sz)
-{
-    g_socket_recv_buff = (char*)malloc((sz + PACKET_HEADER_SIZE) * sizeof(char));
-    g_socket_send_buff = (char*)malloc((sz + PACKET_HEADER_SIZE) * sizeof(char));
-
-    if(g_socket_recv_buff == NULL || g_socket_send_buff == NULL)
-    {
-        free_tcpip_recv_send_buffer();
-        return FAILURE;
-    }
-    return OK;
-}
-
-void free_tcpip_recv_send_buffer()
-{
-    if(g_socket_recv_buff != NULL)
-    {
-        free(g_socket_recv_buff);
-        g_socket_recv_buff = NULL;
-    }
-
-    if(g_socket_send_buff != NULL)
-    {
-        free(g_socket_send_buff);
-        g_socket_send_buff = NULL;
-    }
-}
-
 SOCKET max_of(SOCKET *array, int size) {
     SOCKET result = 0;
     for (int i = 0; i < size; ++i) {
@@ -99,15 +66,6 @@ RETURN_CODE socket_send_all(SOCKET fd, const char *buff, const size_t len, int f
 }
 
 
-RETURN_CODE socket_send_all_t2h_data(SOCKET fd, uint64_t buff, const size_t len, int flags, ssize_t *bytes_sent) {
-    // First copy the mmio ptr into local memory domain
-    memcpy64_fpga2host(buff, (uint64_t *)g_socket_send_buff, len);
-    
-    RETURN_CODE ret = socket_send_all(fd, g_socket_send_buff, len, flags, bytes_sent);
-
-    return ret;
-}
-
 RETURN_CODE socket_recv_until_null_reached(SOCKET sock_fd, char *buff, const size_t max_len, int flags, ssize_t *bytes_recvd) {
     ssize_t curr_bytes_recvd;
     size_t bytes_remaining = max_len;
@@ -161,17 +119,6 @@ RETURN_CODE socket_recv_accumulate(SOCKET sock_fd, char *buff, const size_t len,
 }
 
 
-RETURN_CODE socket_recv_accumulate_h2t_data(SOCKET sock_fd, uint64_t buff, const size_t len, int flags, ssize_t *bytes_recvd) {
-    RETURN_CODE rc = socket_recv_accumulate(sock_fd, g_socket_recv_buff, len, flags, bytes_recvd);
-    
-    if (rc != FAILURE) {
-        // Copy the local memory ptr into the mmio domain
-        memcpy64_host2fpga((uint64_t *)g_socket_recv_buff, buff, len);
-    }
-    
-    return OK;
-}
-
 RETURN_CODE initialize_sockets_library() {
 #if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
     WORD wVersionRequested;
@@ -225,6 +172,64 @@ int set_linger_socket_option(SOCKET socket_fd, int l_onoff, int l_linger) {
 #endif // end if STI_NOSYS_PROT_PLATFORM != STI_PLATFORM_NIOS_UC_TCPIP
 }
 
+int set_non_blocking_socket(SOCKET socket_fd, int non_blocking) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
+    u_long mode = non_blocking ? 1 : 0;
+    return ioctlsocket(socket_fd, FIONBIO, &mode);
+#else
+    int flags = fcntl(socket_fd, F_GETFL, 0);
+    if (flags < 0) {
+        return flags;
+    }
+    return fcntl(socket_fd, F_SETFL, non_blocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+#endif
+}
+
+int set_recv_low_water_mark(SOCKET socket_fd, int bytes) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
+    // Not supported by Winsock, sockets become readable with the first byte
+    (void)socket_fd;
+    (void)bytes;
+    return 0;
+#else
+    return setsockopt(socket_fd, SOL_SOCKET, SO_RCVLOWAT, &bytes, sizeof(bytes));
+#endif
+}
+
+// Has blocking reads and polls of the socket spin on the device queue for up to 'usecs' microseconds before
+// sleeping, preferring that over interrupt driven processing where the kernel supports it.  Linux only, raising the
+// value above net.core.busy_read requires CAP_NET_ADMIN.
+int set_busy_poll_socket_option(SOCKET socket_fd, int usecs) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX && defined(SO_BUSY_POLL)
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) != 0) {
+        return -1;
+    }
+#ifdef SO_PREFER_BUSY_POLL
+    return set_boolean_socket_option(socket_fd, SO_PREFER_BUSY_POLL, 1);
+#else
+    return 0;
+#endif
+#else
+    (void)socket_fd;
+    (void)usecs;
+    return -1;
+#endif
+}
+
+// Bytes a recv() on the socket returns without waiting, -1 if the platform cannot tell
+int get_socket_bytes_readable(SOCKET socket_fd) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
+    u_long bytes;
+    return (ioctlsocket(socket_fd, FIONREAD, &bytes) == 0) ? (int)MIN_MACRO(bytes, (u_long)INT_MAX) : -1;
+#elif STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    int bytes;
+    return (ioctl(socket_fd, FIONREAD, &bytes) == 0) ? bytes : -1;
+#else
+    (void)socket_fd;
+    return -1;
+#endif
+}
+
 char is_last_socket_error_would_block() {
 #if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
     return (get_last_socket_error() == WSAEWOULDBLOCK) ? 1 : 0;
@@ -233,6 +238,16 @@ char is_last_socket_error_would_block() {
 #endif
 }
 
+// True when the last error says the peer is gone, i.e. reset the connection or closed it ahead of a send
+char is_last_socket_error_peer_gone() {
+    const int err = get_last_socket_error();
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
+    return (err == WSAECONNRESET || err == WSAECONNABORTED) ? 1 : 0;
+#else
+    return (err == ECONNRESET || err == EPIPE) ? 1 : 0;
+#endif
+}
+
 int close_socket_fd(SOCKET socket_fd) {
 #if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_WINDOWS
     return closesocket(socket_fd);
@@ -0,0 +1,260 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_st_debug_if_spsc_ring.h"
+
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+static size_t round_up_to_power_of_2(size_t sz) {
+    size_t result = SPSC_RING_CACHE_LINE_SZ;
+    while (result < sz) {
+        result <<= 1;
+    }
+    return result;
+}
+
+RETURN_CODE spsc_ring_alloc(SPSC_RING *ring, size_t min_sz) {
+    ring->buff_sz = round_up_to_power_of_2(min_sz);
+    ring->buff = (char *)malloc(ring->buff_sz + SPSC_RING_SLACK);
+    spsc_ring_reset(ring);
+    return (ring->buff != NULL) ? OK : FAILURE;
+}
+
+void spsc_ring_free(SPSC_RING *ring) {
+    if (ring->buff != NULL) {
+        free(ring->buff);
+        ring->buff = NULL;
+    }
+    ring->buff_sz = 0;
+    spsc_ring_reset(ring);
+}
+
+void spsc_ring_reset(SPSC_RING *ring) {
+    ring->head = ring->cached_head = 0;
+    ring->tail = ring->cached_tail = ring->pending_tail = 0;
+}
+
+RETURN_CODE spsc_ring_resize(SPSC_RING *ring, size_t min_sz) {
+    const size_t buff_sz = round_up_to_power_of_2(min_sz);
+    if (buff_sz <= ring->buff_sz) {
+        return OK;
+    }
+    char *buff = (char *)malloc(buff_sz + SPSC_RING_SLACK);
+    if (buff == NULL) {
+        return FAILURE;
+    }
+
+    // Whatever is queued, all of it published, moves to the start of the new buffer
+    const size_t queued = ring->pending_tail - ring->head;
+    spsc_ring_peek(ring, 0, buff, queued);
+    free(ring->buff);
+    ring->buff = buff;
+    ring->buff_sz = buff_sz;
+    ring->head = ring->cached_head = 0;
+    ring->tail = ring->cached_tail = ring->pending_tail = queued;
+    return OK;
+}
+
+size_t spsc_ring_room(SPSC_RING *ring, size_t wanted) {
+    size_t room = ring->buff_sz - (ring->pending_tail - ring->cached_head);
+    if (room < wanted) {
+        ring->cached_head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+        room = ring->buff_sz - (ring->pending_tail - ring->cached_head);
+    }
+    return room;
+}
+
+char spsc_ring_is_full(SPSC_RING *ring, size_t high_water_mark) {
+    if (ring->pending_tail - ring->cached_head < high_water_mark) {
+        return 0;
+    }
+    ring->cached_head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+    return (ring->pending_tail - ring->cached_head) >= high_water_mark;
+}
+
+char *spsc_ring_write_ptr(SPSC_RING *ring, size_t *contiguous) {
+    const size_t offset = ring->pending_tail & (ring->buff_sz - 1);
+    *contiguous = MIN_MACRO(spsc_ring_room(ring, 1), ring->buff_sz - offset);
+    return ring->buff + offset;
+}
+
+void spsc_ring_advance(SPSC_RING *ring, size_t len) {
+    ring->pending_tail += len;
+}
+
+void spsc_ring_write(SPSC_RING *ring, const void *data, size_t len) {
+    const size_t offset = ring->pending_tail & (ring->buff_sz - 1);
+    const size_t first_len = MIN_MACRO(len, ring->buff_sz - offset);
+    memcpy(ring->buff + offset, data, first_len);
+    memcpy(ring->buff, (const char *)data + first_len, len - first_len);
+    ring->pending_tail += len;
+}
+
+void spsc_ring_publish(SPSC_RING *ring) {
+    __atomic_store_n(&(ring->tail), ring->pending_tail, __ATOMIC_RELEASE);
+}
+
+size_t spsc_ring_readable(SPSC_RING *ring, size_t wanted) {
+    size_t readable = ring->cached_tail - ring->head;
+    if (readable < wanted) {
+        ring->cached_tail = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+        readable = ring->cached_tail - ring->head;
+    }
+    return readable;
+}
+
+const char *spsc_ring_read_ptr(SPSC_RING *ring, size_t offset, size_t *contiguous) {
+    const size_t start = (ring->head + offset) & (ring->buff_sz - 1);
+    *contiguous = MIN_MACRO(ring->cached_tail - ring->head - offset, ring->buff_sz - start);
+    return ring->buff + start;
+}
+
+void spsc_ring_peek(SPSC_RING *ring, size_t offset, void *dst, size_t len) {
+    const size_t start = (ring->head + offset) & (ring->buff_sz - 1);
+    const size_t first_len = MIN_MACRO(len, ring->buff_sz - start);
+    memcpy(dst, ring->buff + start, first_len);
+    memcpy((char *)dst + first_len, ring->buff, len - first_len);
+}
+
+void spsc_ring_consume(SPSC_RING *ring, size_t len) {
+    __atomic_store_n(&(ring->head), ring->head + len, __ATOMIC_RELEASE);
+}
+
+RETURN_CODE spsc_ring_fill(SPSC_RING *ring, SOCKET fd, int flags, ssize_t *bytes_recvd, size_t *recv_calls) {
+    ssize_t total_bytes_recvd = 0;
+    size_t contiguous;
+    char *dst;
+
+    // A second recv() only when the first one stopped at the end of the buffer
+    while ((dst = spsc_ring_write_ptr(ring, &contiguous)), contiguous > 0) {
+        ssize_t curr_bytes_recvd = recv(fd, dst, contiguous, flags);
+        if (recv_calls != NULL) {
+            ++(*recv_calls);
+        }
+        if (curr_bytes_recvd <= 0) {
+            if (curr_bytes_recvd < 0 && is_last_socket_error_would_block()) {
+                break;
+            }
+            if (bytes_recvd != NULL) {
+                *bytes_recvd = curr_bytes_recvd; // Return the error
+            }
+            spsc_ring_publish(ring);
+            return FAILURE;
+        }
+        spsc_ring_advance(ring, curr_bytes_recvd);
+        total_bytes_recvd += curr_bytes_recvd;
+        if ((size_t)curr_bytes_recvd < contiguous) {
+            break; // Drained
+        }
+    }
+    spsc_ring_publish(ring);
+    if (bytes_recvd != NULL) {
+        *bytes_recvd = total_bytes_recvd;
+    }
+    return OK;
+}
+
+RETURN_CODE spsc_ring_flush(SPSC_RING *ring, SOCKET fd, int flags, ssize_t *bytes_sent, size_t *send_calls) {
+    ssize_t total_bytes_sent = 0;
+    while (spsc_ring_readable(ring, 1) > 0) {
+        size_t contiguous;
+        const char *src = spsc_ring_read_ptr(ring, 0, &contiguous);
+        ssize_t curr_bytes_sent = send(fd, src, contiguous, flags);
+        if (send_calls != NULL) {
+            ++(*send_calls);
+        }
+        if (curr_bytes_sent <= 0) {
+            if (curr_bytes_sent < 0 && is_last_socket_error_would_block()) {
+                break; // Resumed once the socket is writable again
+            }
+            if (bytes_sent != NULL) {
+                *bytes_sent = curr_bytes_sent;
+            }
+            return FAILURE;
+        }
+        spsc_ring_consume(ring, curr_bytes_sent);
+        total_bytes_sent += curr_bytes_sent;
+    }
+    if (bytes_sent != NULL) {
+        *bytes_sent = total_bytes_sent;
+    }
+    return OK;
+}
+
+RETURN_CODE spsc_doorbell_init(SPSC_DOORBELL *bell) {
+    bell->sleeping = 0;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    bell->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return (bell->fd >= 0) ? OK : FAILURE;
+#else
+    bell->fd = -1;
+    return FAILURE;
+#endif
+}
+
+void spsc_doorbell_close(SPSC_DOORBELL *bell) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (bell->fd >= 0) {
+        close(bell->fd);
+    }
+#endif
+    bell->fd = -1;
+}
+
+void spsc_doorbell_ring(SPSC_DOORBELL *bell) {
+    // Orders whatever was published before against the look at 'sleeping', pairs with spsc_doorbell_arm()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(bell->sleeping), __ATOMIC_RELAXED) && __atomic_exchange_n(&(bell->sleeping), 0, __ATOMIC_RELAXED)) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+        uint64_t one = 1;
+        ssize_t rc = write(bell->fd, &one, sizeof(one));
+        (void)rc; // Only fails once the counter saturates, in which case the owner is woken up anyway
+#endif
+    }
+}
+
+void spsc_doorbell_arm(SPSC_DOORBELL *bell) {
+    __atomic_store_n(&(bell->sleeping), 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void spsc_doorbell_disarm(SPSC_DOORBELL *bell) {
+    // Still set unless the other side rang, the descriptor is only drained then
+    if (!__atomic_exchange_n(&(bell->sleeping), 0, __ATOMIC_RELAXED)) {
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+        uint64_t count;
+        ssize_t rc = read(bell->fd, &count, sizeof(count));
+        (void)rc;
+#endif
+    }
+}
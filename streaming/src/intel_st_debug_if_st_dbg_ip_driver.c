@@ -24,6 +24,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include "intel_fpga_platform.h"
@@ -33,27 +34,87 @@
 #include "intel_st_debug_if_st_dbg_ip_driver.h"
 #include "intel_st_debug_if_st_dbg_ip_allocator.h"
 
-ST_DBG_IP_DESIGN_INFO g_std_dbg_ip_info;
-static char g_dbg_info_set = 0;
-static FPGA_MMIO_INTERFACE_HANDLE g_mmio_handle = FPGA_MMIO_INTERFACE_INVALID_HANDLE;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+// CSR accesses, in bus transactions
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+#define MMIO_ACCESSES_PER_64 1
+#else
+#define MMIO_ACCESSES_PER_64 2
+#endif
+
+static int enable_irq_wakeup(intel_stream_debug_if_driver_context *context, FPGA_INTERRUPT_HANDLE interrupt_handle);
+static void init_credits(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESCRIPTOR_CREDITS *credits, uint32_t available_slots_csr, unsigned short depth, uint32_t raw_buff, size_t raw_buff_sz);
+static void refresh_credits(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESCRIPTOR_CREDITS *credits);
+
+static inline uint32_t csr_read_32(intel_stream_debug_if_driver_context *context, uint32_t offset)
+{
+    ++context->mmio_stats.reads;
+    return fpga_mmio_read_32(&context->mmio, offset);
+}
+
+static inline uint64_t csr_read_64(intel_stream_debug_if_driver_context *context, uint32_t offset)
+{
+    context->mmio_stats.reads += MMIO_ACCESSES_PER_64;
+    return fpga_mmio_read_64(&context->mmio, offset);
+}
+
+static inline void csr_write_32(intel_stream_debug_if_driver_context *context, uint32_t offset, uint32_t value)
+{
+    ++context->mmio_stats.writes;
+    fpga_mmio_write_32(&context->mmio, offset, value);
+}
+
+static inline void csr_write_64(intel_stream_debug_if_driver_context *context, uint32_t offset, uint64_t value)
+{
+    context->mmio_stats.writes += MMIO_ACCESSES_PER_64;
+    fpga_mmio_write_64(&context->mmio, offset, value);
+}
 
-// Descriptor tracking
-static unsigned short g_h2t_descriptor_slots_available = 0;
-static unsigned short g_mgmt_descriptor_slots_available = 0;
-static unsigned short g_h2t_descriptor_chain[MAX_H2T_DESCRIPTOR_DEPTH] = { 0 };
-static unsigned short g_mgmt_descriptor_chain[MAX_MGMT_DESCRIPTOR_DEPTH] = { 0 };
-static unsigned short g_h2t_descriptor_write_idx = 0;
-static unsigned short g_h2t_descriptor_read_idx = 0;
-static unsigned short g_mgmt_descriptor_write_idx = 0;
-static unsigned short g_mgmt_descriptor_read_idx = 0;
+// Reads the HOW_LONG / WHERE pair of a descriptor, returning HOW_LONG.  WHERE is only meaningful for a
+// non-empty descriptor, so when 64-bit MMIO is emulated an idle poll skips that second bus read.
+static inline uint32_t fetch_how_long_where(intel_stream_debug_if_driver_context *context, uint32_t offset, uint32_t *where)
+{
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    uint64_t howlong_where = csr_read_64(context, offset);
+    *where = (uint32_t)(howlong_where >> 32);
+    return (uint32_t)howlong_where;
+#else
+    uint32_t last_howlong = csr_read_32(context, offset);
+    if ((last_howlong & ST_DBG_IP_HOW_LONG_MASK) != 0) {
+        *where = csr_read_32(context, offset + 4);
+    }
+    return last_howlong;
+#endif
+}
 
-// SOP tracking
-static unsigned char g_t2h_sop = 1;
-static unsigned char g_mgmt_rsp_sop = 1;
+// Upper half of the 64-bit CSR at 'offset', skipping the read of the lower half when 64-bit MMIO is emulated
+static inline uint32_t fetch_upper_32(intel_stream_debug_if_driver_context *context, uint32_t offset)
+{
+#ifndef FPGA_PLATFORM_FORCE_64BIT_MMIO_EMULATION_WITH_32BIT
+    return (uint32_t)(csr_read_64(context, offset) >> 32);
+#else
+    return csr_read_32(context, offset + 4);
+#endif
+}
 
-// Memory tracking
-static CIRCLE_BUFF g_h2t_rx_cbuff;
-static CIRCLE_BUFF g_mgmt_rx_cbuff;
+// Puts a context in its start up state, before the instance is handed its design info and handles
+void init_driver_context(intel_stream_debug_if_driver_context *context)
+{
+    memset(context, 0, sizeof(*context));
+    context->mmio_handle = FPGA_MMIO_INTERFACE_INVALID_HANDLE;
+    context->interrupt_handle = FPGA_INTERRUPT_INVALID_HANDLE;
+    context->done_batch = 1;
+    context->t2h_sop = 1;
+    context->mgmt_rsp_sop = 1;
+    context->h2t_sop = 1;
+    context->mgmt_sop = 1;
+    context->irq_enabled_handle = FPGA_INTERRUPT_INVALID_HANDLE;
+    context->irq_wakeup_fd = -1;
+}
 
 int init_driver(intel_stream_debug_if_driver_context *context, FPGA_MMIO_INTERFACE_HANDLE mmio_handle)
 {
@@ -63,7 +124,9 @@ int init_driver(intel_stream_debug_if_driver_context *context, FPGA_MMIO_INTERFA
 #endif
 
     int ret = 0;
-    g_mmio_handle = context->mmio_handle = mmio_handle;
+    context->in_sync = 0;
+    context->mmio_handle = mmio_handle;
+    context->mmio = fpga_mmio_resolve(mmio_handle);
 
 #ifdef MMIO_LOG
     g_mmio_log_f = fopen("mmlink_mmio_log.csv", "w");
@@ -73,165 +136,209 @@ int init_driver(intel_stream_debug_if_driver_context *context, FPGA_MMIO_INTERFA
                             "H2T base_addr:64'h%llx\n"
                             "T2H base_addr:64'h%llx\n"
                             "line_no,function,type,base_addr,offset,value\n",
-                            g_std_dbg_ip_info.ST_DBG_IP_CSR_BASE_ADDR, g_std_dbg_ip_info.H2T_MEM_BASE_ADDR, g_std_dbg_ip_info.T2H_MEM_BASE_ADDR);
+                            context->design_info.ST_DBG_IP_CSR_BASE_ADDR, context->design_info.H2T_MEM_BASE_ADDR, context->design_info.T2H_MEM_BASE_ADDR);
 #endif
     
-    if (!g_dbg_info_set) {
+    if (!context->design_info_set) {
         return INIT_ERROR_CODE_MISSING_INFO;
     }
-    if (check_version_and_type() != 0) {
+    if (check_version_and_type(context) != 0) {
         return INIT_ERROR_CODE_INCOMPATIBLE_IP;
     }
     
-    assert_h2t_t2h_reset();
-    g_h2t_descriptor_write_idx = 0;
-    g_h2t_descriptor_read_idx = 0;
-    g_mgmt_descriptor_write_idx = 0;
-    g_mgmt_descriptor_read_idx = 0;
-    g_h2t_descriptor_slots_available = (unsigned short)fpga_read_32(g_mmio_handle, ST_DBG_IP_H2T_AVAILABLE_SLOTS);
-    g_mgmt_descriptor_slots_available = (unsigned short)fpga_read_32(g_mmio_handle, ST_DBG_IP_MGMT_AVAILABLE_SLOTS);
-    g_t2h_sop = 1;
-    g_mgmt_rsp_sop = 1;
-    cbuff_init(&g_h2t_rx_cbuff, g_std_dbg_ip_info.H2T_MEM_BASE_ADDR, g_std_dbg_ip_info.H2T_MEM_SZ);
-    cbuff_init(&g_mgmt_rx_cbuff, g_std_dbg_ip_info.MGMT_MEM_BASE_ADDR, g_std_dbg_ip_info.MGMT_MEM_SZ);
+    assert_h2t_t2h_reset(context);
+    init_credits(context, &context->h2t_credits, ST_DBG_IP_H2T_AVAILABLE_SLOTS, MAX_H2T_DESCRIPTOR_DEPTH, context->design_info.H2T_MEM_BASE_ADDR, context->design_info.H2T_MEM_SZ);
+    init_credits(context, &context->mgmt_credits, ST_DBG_IP_MGMT_AVAILABLE_SLOTS, MAX_MGMT_DESCRIPTOR_DEPTH, context->design_info.MGMT_MEM_BASE_ADDR, context->design_info.MGMT_MEM_SZ);
+    context->t2h_sop = 1;
+    context->mgmt_rsp_sop = 1;
+    context->h2t_sop = 1;
+    context->mgmt_sop = 1;
+    context->t2h_done_pending = 0;
+    context->mgmt_rsp_done_pending = 0;
+
+    // The reset above also cleared the interrupt enable, so it is re-armed for every client
+    if (context->interrupt_handle != FPGA_INTERRUPT_INVALID_HANDLE) {
+        if (enable_irq_wakeup(context, context->interrupt_handle) != 0) {
+            fpga_msg_printf(FPGA_MSG_PRINTF_WARNING, "Failed to enable ST Debug IP interrupts, falling back to polling the hardware.\n");
+        }
+    }
 
+    context->in_sync = 1;
     return ret;
 }
 
+// Takes the IP over as the previous client left it: no probe, no reset, the descriptor bookkeeping and the
+// interrupt set up by init_driver() carry on.  Only done while the context is in sync with the IP, between two
+// packets in every direction, with every H2T and MGMT descriptor handed back, every consumed T2H and MGMT RSP
+// descriptor acknowledged, and no T2H or MGMT RSP data the IP produced for the previous client.
+int resume_driver(intel_stream_debug_if_driver_context *context)
+{
+    uint32_t where = 0;
+    if (!context->in_sync || !context->t2h_sop || !context->mgmt_rsp_sop || !context->h2t_sop || !context->mgmt_sop) {
+        return -1;
+    }
+    if (context->t2h_done_pending != 0 || context->mgmt_rsp_done_pending != 0) {
+        return -1;
+    }
+    refresh_credits(context, &context->h2t_credits);
+    if (context->h2t_credits.slots_available != context->h2t_credits.slots_total) {
+        return -1;
+    }
+    if (context->design_info.MGMT_MEM_SZ != 0) {
+        refresh_credits(context, &context->mgmt_credits);
+        if (context->mgmt_credits.slots_available != context->mgmt_credits.slots_total) {
+            return -1;
+        }
+    }
+    if ((fetch_how_long_where(context, ST_DBG_IP_T2H_HOW_LONG, &where) & ST_DBG_IP_HOW_LONG_MASK) != 0) {
+        return -1;
+    }
+    if (context->design_info.MGMT_RSP_MEM_SZ != 0 && (fetch_how_long_where(context, ST_DBG_IP_MGMT_RSP_HOW_LONG, &where) & ST_DBG_IP_HOW_LONG_MASK) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
 // This should be called one time prior to any driver function calls
-void set_design_info(ST_DBG_IP_DESIGN_INFO info)
+void set_design_info(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESIGN_INFO info)
 {
-    g_std_dbg_ip_info = info;
-    g_dbg_info_set = 1;
+    context->design_info = info;
+    context->design_info_set = 1;
 }
 
-// Returns a non-NULL buffer if there is both space in the H2T memory & H2T descriptor memory.
-// Checks to see if any descriptors have been processed by the ST Debug IP, and if so frees
-// the associated memory.
-uint32_t get_h2t_buffer(size_t sz) {
-    // First update available descriptor slots, and free space in the buffer
-    uint32_t freed_descriptor_slots = fpga_read_32(g_mmio_handle,   ST_DBG_IP_H2T_AVAILABLE_SLOTS) - g_h2t_descriptor_slots_available;
-    if (freed_descriptor_slots > 0) {
-        g_h2t_descriptor_slots_available += freed_descriptor_slots;
-        size_t bytes_freed = 0;
-        for (char i = 0; i < freed_descriptor_slots; ++i) {
-            bytes_freed += g_h2t_descriptor_chain[(g_h2t_descriptor_read_idx + i) % MAX_H2T_DESCRIPTOR_DEPTH];
-        }
-        g_h2t_descriptor_read_idx = (g_h2t_descriptor_read_idx + freed_descriptor_slots) % MAX_H2T_DESCRIPTOR_DEPTH;
+static void init_credits(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESCRIPTOR_CREDITS *credits, uint32_t available_slots_csr, unsigned short depth, uint32_t raw_buff, size_t raw_buff_sz)
+{
+    credits->available_slots_csr = available_slots_csr;
+    credits->depth = depth;
+    credits->slots_total = credits->slots_available = (unsigned short)csr_read_32(context, available_slots_csr);
+    credits->write_idx = 0;
+    credits->read_idx = 0;
+    credits->bytes_allocated = 0;
+    credits->bytes_freed = 0;
+    cbuff_init(&credits->cbuff, raw_buff, raw_buff_sz);
+}
 
-        // Update the cbuff, freeing up space
-        cbuff_free(&g_h2t_rx_cbuff, bytes_freed);
+// Frees the memory of every descriptor the IP has processed since the last refresh
+static void refresh_credits(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESCRIPTOR_CREDITS *credits)
+{
+    unsigned short freed_descriptor_slots = (unsigned short)(csr_read_32(context, credits->available_slots_csr) - credits->slots_available);
+    if (freed_descriptor_slots > 0) {
+        credits->slots_available += freed_descriptor_slots;
+        credits->read_idx = (credits->read_idx + freed_descriptor_slots) % credits->depth;
+        const size_t chain_end = credits->chain_end[(credits->read_idx + credits->depth - 1) % credits->depth];
+        cbuff_free(&credits->cbuff, chain_end - credits->bytes_freed);
+        credits->bytes_freed = chain_end;
     }
+}
 
-    // Make sure we have space in descriptor mem
-    if (g_h2t_descriptor_slots_available > 0) {
-        // Make sure we have space in cbuff
-        const size_t aligned_sz = GET_ALIGNED_SZ(sz);
-        if (g_h2t_rx_cbuff.space_available >= aligned_sz) {
-            g_h2t_descriptor_chain[g_h2t_descriptor_write_idx++ % MAX_H2T_DESCRIPTOR_DEPTH] = aligned_sz;
-            return cbuff_alloc(&g_h2t_rx_cbuff, aligned_sz);
+// Returns a non-NULL buffer if there is both space in the memory & descriptor memory of the channel
+static uint32_t alloc_credits(intel_stream_debug_if_driver_context *context, ST_DBG_IP_DESCRIPTOR_CREDITS *credits, size_t sz)
+{
+    const size_t aligned_sz = GET_ALIGNED_SZ(sz);
+    if (credits->slots_available == 0 || credits->cbuff.space_available < aligned_sz) {
+        refresh_credits(context, credits);
+        if (credits->slots_available == 0 || credits->cbuff.space_available < aligned_sz) {
+            return 0;
         }
     }
+    credits->bytes_allocated += aligned_sz;
+    credits->chain_end[credits->write_idx] = credits->bytes_allocated;
+    credits->write_idx = (credits->write_idx + 1) % credits->depth;
+    return cbuff_alloc(&credits->cbuff, aligned_sz);
+}
 
-    return 0;
+// Returns a non-NULL buffer if there is both space in the H2T memory & H2T descriptor memory.
+// Only checks whether the ST Debug IP has processed any descriptors, freeing the associated
+// memory, when the space known to be available is not enough.
+uint32_t get_h2t_buffer(intel_stream_debug_if_driver_context *context, size_t sz) {
+    return alloc_credits(context, &context->h2t_credits, sz);
 }
 
 // Assumes there is space in both the buffer and descriptor memory
-int push_h2t_data(H2T_PACKET_HEADER *header, uint32_t payload) {
-    --g_h2t_descriptor_slots_available;
+int push_h2t_data(intel_stream_debug_if_driver_context *context, H2T_PACKET_HEADER *header, uint32_t payload) {
+    // The payload may still sit in the write-combining buffers, it must land before the descriptor
+    fpga_mmio_wc_flush(&context->mmio);
+    --context->h2t_credits.slots_available;
     unsigned long last_howlong = (header->DATA_LEN_BYTES & ST_DBG_IP_HOW_LONG_MASK);
     if (header->SOP_EOP & H2T_PACKET_HEADER_MASK_EOP) {
         last_howlong |= ST_DBG_IP_LAST_DESCRIPTOR_MASK;
     }
     uint64_t howlong_where = last_howlong | ((uint64_t)((uint64_t)payload) << 32);
-    fpga_write_64(g_mmio_handle, ST_DBG_IP_H2T_HOW_LONG, howlong_where);
+    csr_write_64(context, ST_DBG_IP_H2T_HOW_LONG, howlong_where);
     uint64_t connid_channelpush = header->CONN_ID | ((uint64_t)header->CHANNEL << 32);
-    fpga_write_64(g_mmio_handle, ST_DBG_IP_H2T_CONNECTION_ID, connid_channelpush);
+    csr_write_64(context, ST_DBG_IP_H2T_CONNECTION_ID, connid_channelpush);
+    context->h2t_sop = (header->SOP_EOP & H2T_PACKET_HEADER_MASK_EOP) != 0;
 
     return 0;
 }
 
-// Returns a non-NULL buffer if there is both space in the MGMT memory & MGMT descriptor memory.
-// Checks to see if any descriptors have been processed by the ST Debug IP, and if so frees
-// the associated memory.
-uint32_t get_mgmt_buffer(size_t sz) {
-    // First update available descriptor slots, and free space in the buffer
-    uint32_t freed_descriptor_slots = fpga_read_32(g_mmio_handle,  ST_DBG_IP_MGMT_AVAILABLE_SLOTS) - g_mgmt_descriptor_slots_available;
-    if (freed_descriptor_slots > 0) {
-        g_mgmt_descriptor_slots_available += freed_descriptor_slots;
-        size_t bytes_freed = 0;
-        for (char i = 0; i < freed_descriptor_slots; ++i) {
-            bytes_freed += g_mgmt_descriptor_chain[(g_mgmt_descriptor_read_idx + i) % MAX_MGMT_DESCRIPTOR_DEPTH];
-        }
-        g_mgmt_descriptor_read_idx = (g_mgmt_descriptor_read_idx + freed_descriptor_slots) % MAX_MGMT_DESCRIPTOR_DEPTH;
-
-        // Update the cbuff, freeing up space
-        cbuff_free(&g_mgmt_rx_cbuff, bytes_freed);
-    }
-
-    // Make sure we have space in descriptor mem
-    if (g_mgmt_descriptor_slots_available > 0) {
-        // Make sure we have space in cbuff
-        const size_t aligned_sz = GET_ALIGNED_SZ(sz);
-        if (g_mgmt_rx_cbuff.space_available >= aligned_sz) {
-            g_mgmt_descriptor_chain[g_mgmt_descriptor_write_idx++ % MAX_MGMT_DESCRIPTOR_DEPTH] = aligned_sz;
-            return cbuff_alloc(&g_mgmt_rx_cbuff, aligned_sz);
-        }
-    }
-
-    return 0;
+// Same as get_h2t_buffer() for the MGMT memory & MGMT descriptor memory.
+uint32_t get_mgmt_buffer(intel_stream_debug_if_driver_context *context, size_t sz) {
+    return alloc_credits(context, &context->mgmt_credits, sz);
 }
 
 // Assumes there is space in both the buffer and descriptor memory
-int push_mgmt_data(MGMT_PACKET_HEADER *header, uint32_t payload) {
-    --g_mgmt_descriptor_slots_available;
+int push_mgmt_data(intel_stream_debug_if_driver_context *context, MGMT_PACKET_HEADER *header, uint32_t payload) {
+    fpga_mmio_wc_flush(&context->mmio);
+    --context->mgmt_credits.slots_available;
     unsigned long last_howlong = (header->DATA_LEN_BYTES & ST_DBG_IP_HOW_LONG_MASK);
     if (header->SOP_EOP & MGMT_PACKET_HEADER_MASK_EOP) {
         last_howlong |= ST_DBG_IP_LAST_DESCRIPTOR_MASK;
     }
     uint64_t howlong_where = last_howlong | ((uint64_t)((uint64_t)payload) << 32);
-    fpga_write_64(g_mmio_handle, ST_DBG_IP_MGMT_HOW_LONG, howlong_where);
+    csr_write_64(context, ST_DBG_IP_MGMT_HOW_LONG, howlong_where);
     uint64_t channel_id_push = (uint64_t)header->CHANNEL << 32;
-    fpga_write_64(g_mmio_handle, ST_DBG_IP_MGMT_CHANNEL_ID_PUSH - 0x4, channel_id_push);
+    csr_write_64(context, ST_DBG_IP_MGMT_CHANNEL_ID_PUSH - 0x4, channel_id_push);
+    context->mgmt_sop = (header->SOP_EOP & MGMT_PACKET_HEADER_MASK_EOP) != 0;
     return 0;
 }
 
 // Reads out the next T2H data if non-empty
-int get_t2h_data(H2T_PACKET_HEADER *header, uint32_t *payload) {
-    uint64_t howlong_where = fpga_read_64(g_mmio_handle, ST_DBG_IP_T2H_HOW_LONG);
-    uint32_t last_howlong = (uint32_t)howlong_where;
-    uint32_t where = (uint32_t)(howlong_where >> 32);
+int get_t2h_data(intel_stream_debug_if_driver_context *context, H2T_PACKET_HEADER *header, uint32_t *payload) {
+    uint32_t where = 0;
+    uint32_t last_howlong = fetch_how_long_where(context, ST_DBG_IP_T2H_HOW_LONG, &where);
     // Early return no need to do more work if there is no data
     if ((header->DATA_LEN_BYTES = (unsigned short)(last_howlong & ST_DBG_IP_HOW_LONG_MASK)) == 0) {
         return 0;
     }
-    *payload = where + g_std_dbg_ip_info.T2H_MEM_BASE_ADDR;
+    *payload = where + context->design_info.T2H_MEM_BASE_ADDR;
     header->SOP_EOP = 0; // Be sure to clear this!
-    if (g_t2h_sop) {
+    if (context->t2h_sop) {
         header->SOP_EOP |= H2T_PACKET_HEADER_MASK_SOP;
     }
     if (last_howlong & ST_DBG_IP_LAST_DESCRIPTOR_MASK) {
         header->SOP_EOP |= H2T_PACKET_HEADER_MASK_EOP;
-        g_t2h_sop = 1;
+        context->t2h_sop = 1;
     } else {
-        g_t2h_sop = 0;
+        context->t2h_sop = 0;
     }
-    uint64_t connid_channelid = fpga_read_64(g_mmio_handle, ST_DBG_IP_T2H_CONNECTION_ID);
+    uint64_t connid_channelid = csr_read_64(context, ST_DBG_IP_T2H_CONNECTION_ID);
     header->CONN_ID = (unsigned char)(connid_channelid);
     header->CHANNEL = (uint16_t)(connid_channelid >> 32);
     return 0;
 }
 
-inline void t2h_data_complete()
+// Hands 'pending' consumed descriptors back to the IP at once
+static void write_descriptors_done(intel_stream_debug_if_driver_context *context, uint32_t offset, unsigned int *pending)
 {
-    fpga_write_32(g_mmio_handle, ST_DBG_IP_T2H_DESCRIPTORS_DONE, 1);
+    if (*pending > 0) {
+        csr_write_32(context, offset, *pending);
+        context->mmio_stats.writes_saved += *pending - 1;
+        *pending = 0;
+    }
+}
+
+inline void t2h_data_complete(intel_stream_debug_if_driver_context *context)
+{
+    if (++context->t2h_done_pending >= context->done_batch) {
+        write_descriptors_done(context, ST_DBG_IP_T2H_DESCRIPTORS_DONE, &context->t2h_done_pending);
+    }
 }
 
 // Reads out the next MGMT RSP data if non-empty
-int get_mgmt_rsp_data(MGMT_PACKET_HEADER *header, uint32_t *payload) {
-    uint64_t howlong_where = fpga_read_64(g_mmio_handle, ST_DBG_IP_MGMT_RSP_HOW_LONG);
-    uint32_t last_howlong = (uint32_t)howlong_where;
-    uint32_t where = (uint32_t)(howlong_where >> 32);
+int get_mgmt_rsp_data(intel_stream_debug_if_driver_context *context, MGMT_PACKET_HEADER *header, uint32_t *payload) {
+    uint32_t where = 0;
+    uint32_t last_howlong = fetch_how_long_where(context, ST_DBG_IP_MGMT_RSP_HOW_LONG, &where);
 
     // Early return no need to do more work if there is no data
     header->DATA_LEN_BYTES = last_howlong & ST_DBG_IP_HOW_LONG_MASK;
@@ -239,38 +346,49 @@ int get_mgmt_rsp_data(MGMT_PACKET_HEADER *header, uint32_t *payload) {
     {
         return 0;
     }
-    *payload = where + g_std_dbg_ip_info.MGMT_RSP_MEM_BASE_ADDR;
+    *payload = where + context->design_info.MGMT_RSP_MEM_BASE_ADDR;
     header->SOP_EOP = 0; // Be sure to clear this!
-    if (g_mgmt_rsp_sop) {
+    if (context->mgmt_rsp_sop) {
         header->SOP_EOP |= H2T_PACKET_HEADER_MASK_SOP;
     }
     if (last_howlong & ST_DBG_IP_LAST_DESCRIPTOR_MASK) {
         header->SOP_EOP |= H2T_PACKET_HEADER_MASK_EOP;
-        g_mgmt_rsp_sop = 1;
+        context->mgmt_rsp_sop = 1;
     } else {
-        g_mgmt_rsp_sop = 0;
+        context->mgmt_rsp_sop = 0;
     }
 
-    header->CHANNEL = (uint32_t)(fpga_read_64(g_mmio_handle, ST_DBG_IP_MGMT_RSP_CHANNEL_ID_ADVANCE - 0x4) >> 32);
+    header->CHANNEL = fetch_upper_32(context, ST_DBG_IP_MGMT_RSP_CHANNEL_ID_ADVANCE - 0x4);
     return 0;
 }
 
-void mgmt_rsp_data_complete()
+void mgmt_rsp_data_complete(intel_stream_debug_if_driver_context *context)
 {
-    fpga_write_32(g_mmio_handle, ST_DBG_IP_MGMT_RSP_DESCRIPTORS_DONE, 1);
+    if (++context->mgmt_rsp_done_pending >= context->done_batch) {
+        write_descriptors_done(context, ST_DBG_IP_MGMT_RSP_DESCRIPTORS_DONE, &context->mgmt_rsp_done_pending);
+    }
+}
+
+size_t flush_data_complete(intel_stream_debug_if_driver_context *context)
+{
+    size_t writes_saved = context->mmio_stats.writes_saved;
+    write_descriptors_done(context, ST_DBG_IP_T2H_DESCRIPTORS_DONE, &context->t2h_done_pending);
+    write_descriptors_done(context, ST_DBG_IP_MGMT_RSP_DESCRIPTORS_DONE, &context->mgmt_rsp_done_pending);
+    return context->mmio_stats.writes_saved - writes_saved;
 }
 
-void set_loopback_mode(int val) {
-    uint32_t rd = fpga_read_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK);
+void set_loopback_mode(intel_stream_debug_if_driver_context *context, int val) {
+    context->in_sync = 0; // The reset below is not accounted for, the next client gets a full init_driver()
+    uint32_t rd = csr_read_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK);
     if (val == 1) {
-        fpga_write_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, rd | ST_DBG_IP_CONFIG_LOOPBACK_FIELD | ST_DBG_IP_CONFIG_H2T_T2H_RESET_FIELD);
+        csr_write_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, rd | ST_DBG_IP_CONFIG_LOOPBACK_FIELD | ST_DBG_IP_CONFIG_H2T_T2H_RESET_FIELD);
     } else {
-        fpga_write_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, (rd & ~ST_DBG_IP_CONFIG_LOOPBACK_FIELD) | ST_DBG_IP_CONFIG_H2T_T2H_RESET_FIELD);
+        csr_write_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, (rd & ~ST_DBG_IP_CONFIG_LOOPBACK_FIELD) | ST_DBG_IP_CONFIG_H2T_T2H_RESET_FIELD);
     }
 }
 
-int get_loopback_mode() {
-    uint32_t rd = fpga_read_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK);
+int get_loopback_mode(intel_stream_debug_if_driver_context *context) {
+    uint32_t rd = csr_read_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK);
     if ((rd & ST_DBG_IP_CONFIG_LOOPBACK_FIELD) > 0) {
         return 1;
     } else {
@@ -278,17 +396,17 @@ int get_loopback_mode() {
     }
 }
 
-void enable_interrupts(int val) {
-    uint32_t rd = fpga_read_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK);
+void enable_interrupts(intel_stream_debug_if_driver_context *context, int val) {
+    uint32_t rd = csr_read_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK);
     if (val == 1) {
-        fpga_write_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, rd | ST_DBG_IP_CONFIG_ENABLE_INT_FIELD);
+        csr_write_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, rd | ST_DBG_IP_CONFIG_ENABLE_INT_FIELD);
     } else {
-        fpga_write_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, rd & ~ST_DBG_IP_CONFIG_ENABLE_INT_FIELD);
+        csr_write_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, rd & ~ST_DBG_IP_CONFIG_ENABLE_INT_FIELD);
     }
 }
 
-int get_mgmt_support() {
-    uint32_t rd = fpga_read_32(g_mmio_handle, ST_DBG_IP_CONFIG_MGMT_MGMT_RSP_DESC_DEPTH);
+int get_mgmt_support(intel_stream_debug_if_driver_context *context) {
+    uint32_t rd = csr_read_32(context, ST_DBG_IP_CONFIG_MGMT_MGMT_RSP_DESC_DEPTH);
     if (rd > 0) {
         return 1;
     } else {
@@ -296,8 +414,8 @@ int get_mgmt_support() {
     }
 }
 
-int check_version_and_type() {
-    uint64_t type_version = fpga_read_64(g_mmio_handle, ST_DBG_IP_CONFIG_TYPE);
+int check_version_and_type(intel_stream_debug_if_driver_context *context) {
+    uint64_t type_version = csr_read_64(context, ST_DBG_IP_CONFIG_TYPE);
     uint32_t type = (uint32_t)type_version;
     uint32_t version = (uint32_t)(type_version >> 32);
     if ((type != SUPPORTED_TYPE) || (version != SUPPORTED_VERSION)) {
@@ -314,57 +432,157 @@ int check_version_and_type() {
     }
 }
 
-void assert_h2t_t2h_reset()
+void assert_h2t_t2h_reset(intel_stream_debug_if_driver_context *context)
 {
-    fpga_write_32(g_mmio_handle, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, ST_DBG_IP_CONFIG_H2T_T2H_RESET_FIELD);
+    csr_write_32(context, ST_DBG_IP_CONFIG_RESET_AND_LOOPBACK, ST_DBG_IP_CONFIG_H2T_T2H_RESET_FIELD);
 }
 
-void memcpy64_fpga2host(int32_t fpga_buff, uint64_t *host_buff, size_t len)
+// Invoked from the platform's interrupt thread, merely wakes up whoever waits on the eventfd
+static void st_dbg_ip_isr(void *isr_context)
 {
-    size_t transfers = (len + 7) / 8;
-    for (size_t i = 0; i < transfers; ++i)
-    {
-        *host_buff++ = fpga_read_64(g_mmio_handle, fpga_buff);
-        fpga_buff += 8;
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    intel_stream_debug_if_driver_context *context = (intel_stream_debug_if_driver_context *)isr_context;
+    uint64_t one = 1;
+    // This can only fail once the counter saturates, in which case a wakeup is pending anyway
+    ssize_t rc = write(context->irq_wakeup_fd, &one, sizeof(one));
+    (void)rc;
+#else
+    (void)isr_context;
+#endif
+}
+
+// Routes the IP interrupt to an eventfd, so the server can wait on it alongside its sockets.
+// A return value other than 0 leaves the driver in polling mode.
+static int enable_irq_wakeup(intel_stream_debug_if_driver_context *context, FPGA_INTERRUPT_HANDLE interrupt_handle)
+{
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (context->irq_wakeup_fd < 0) {
+        context->irq_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (context->irq_wakeup_fd < 0) {
+            return -1;
+        }
+    }
+    context->irq_enabled_handle = FPGA_INTERRUPT_INVALID_HANDLE;
+    ack_irq_wakeup(context); // Drop whatever was raised while no client was being served
+    if (fpga_register_isr(interrupt_handle, st_dbg_ip_isr, context) < 0) {
+        return -1;
+    }
+
+    // A set mask bit lets that channel raise the interrupt: T2H when data is ready to be read out,
+    // H2T (and MGMT) when descriptor slots have been freed up.
+    uint32_t mask = ST_DBG_IP_CONFIG_MASK_H2T_FIELD | ST_DBG_IP_CONFIG_MASK_T2H_FIELD;
+    if (get_mgmt_support(context) == 1) {
+        mask |= ST_DBG_IP_CONFIG_MASK_MGMT_FIELD | ST_DBG_IP_CONFIG_MASK_MGMT_RSP_FIELD;
     }
+    csr_write_32(context, ST_DBG_IP_CONFIG_INTERRUPTS, mask);
+    enable_interrupts(context, 1);
+    if (fpga_enable_interrupt(interrupt_handle) < 0) {
+        enable_interrupts(context, 0);
+        return -1;
+    }
+    context->irq_enabled_handle = interrupt_handle;
+    return 0;
+#else
+    (void)context;
+    (void)interrupt_handle;
+    return -1;
+#endif
 }
 
-void memcpy64_host2fpga(uint64_t *host_buff, int32_t fpga_buff, size_t len)
+int get_irq_wakeup_fd(intel_stream_debug_if_driver_context *context)
 {
-    size_t transfers = (len + 7) / 8;
-    for (size_t i = 0; i < transfers; ++i)
-    {
-        fpga_write_64(g_mmio_handle, fpga_buff, *host_buff++);
-        fpga_buff += 8;
+    if (context->irq_enabled_handle == FPGA_INTERRUPT_INVALID_HANDLE) {
+        return -1;
     }
+    return context->irq_wakeup_fd;
+}
+
+// Consumes all pending wakeups; must be called before the hardware is serviced so no interrupt is lost
+void ack_irq_wakeup(intel_stream_debug_if_driver_context *context)
+{
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    uint64_t count;
+    ssize_t rc = read(context->irq_wakeup_fd, &count, sizeof(count));
+    (void)rc;
+#else
+    (void)context;
+#endif
 }
 
-int set_driver_param(const char *param, const char *val)
+// No MMIO access here, the mapping may already be gone at shutdown.  The next init_driver() resets the IP anyway.
+void disable_irq_wakeup(intel_stream_debug_if_driver_context *context)
+{
+    context->in_sync = 0;
+    if (context->irq_enabled_handle != FPGA_INTERRUPT_INVALID_HANDLE) {
+        fpga_disable_interrupt(context->irq_enabled_handle);
+        context->irq_enabled_handle = FPGA_INTERRUPT_INVALID_HANDLE;
+    }
+#if STI_NOSYS_PROT_PLATFORM==STI_PLATFORM_LINUX
+    if (context->irq_wakeup_fd >= 0) {
+        close(context->irq_wakeup_fd);
+        context->irq_wakeup_fd = -1;
+    }
+#endif
+}
+
+// Always writes whole 64-bit words, i.e. up to 7 bytes past 'len'.  'host_buff' need not be aligned.
+void memcpy64_fpga2host(intel_stream_debug_if_driver_context *context, int32_t fpga_buff, uint64_t *host_buff, size_t len)
+{
+    fpga_mmio_read_burst(&context->mmio, fpga_buff, host_buff, len);
+}
+
+// Always reads whole 64-bit words, i.e. up to 7 bytes past 'len'.  'host_buff' need not be aligned.
+// Goes through the write-combining window when the platform mapped one, see push_h2t_data().
+void memcpy64_host2fpga(intel_stream_debug_if_driver_context *context, uint64_t *host_buff, int32_t fpga_buff, size_t len)
+{
+    fpga_mmio_write_burst_wc(&context->mmio, fpga_buff, host_buff, len);
+}
+
+void get_mmio_stats(intel_stream_debug_if_driver_context *context, ST_DBG_IP_MMIO_STATS *stats)
+{
+    *stats = context->mmio_stats;
+}
+
+int set_driver_param(intel_stream_debug_if_driver_context *context, const char *param, const char *val)
 {
     if (strncmp(param, HW_LOOPBACK_PARAM, HW_LOOPBACK_PARAM_LEN) == 0) {
         if (strncmp(val, "1", 1) == 0) {
-            set_loopback_mode(1);
+            set_loopback_mode(context, 1);
         } else {
-            set_loopback_mode(0);
+            set_loopback_mode(context, 0);
+        }
+    } else if (strncmp(param, DONE_BATCH_PARAM, DONE_BATCH_PARAM_LEN) == 0) {
+        unsigned long done_batch = strtoul(val, NULL, 10);
+        // More completions than descriptors in the T2H or MGMT RSP queue can never be pending
+        if (done_batch == 0 || done_batch > context->design_info.T2H_DESC_DEPTH) {
+            return -1;
+        }
+        if (context->design_info.MGMT_RSP_MEM_SZ != 0 && done_batch > context->design_info.MGMT_RSP_DESC_DEPTH) {
+            return -1;
         }
+        // Descriptors held back under the previous setting go out with the next flush
+        context->done_batch = (unsigned int)done_batch;
     }
 
     return 0;
 }
 
-char *get_driver_param(const char *param) {
+char *get_driver_param(intel_stream_debug_if_driver_context *context, const char *param) {
     if (strncmp(param, HW_LOOPBACK_PARAM, HW_LOOPBACK_PARAM_LEN) == 0) {
-        if (get_loopback_mode() == 0) {
+        if (get_loopback_mode(context) == 0) {
             return "0";
         } else {
             return "1";
         }
     } else if (strncmp(param, MGMT_SUPPORT_PARAM, MGMT_SUPPORT_PARAM_LEN) == 0) {
-        if (get_mgmt_support() == 1) {
+        if (get_mgmt_support(context) == 1) {
             return "1";
         } else {
             return "0";
         }
+    } else if (strncmp(param, DONE_BATCH_PARAM, DONE_BATCH_PARAM_LEN) == 0) {
+        snprintf(context->param_buff, sizeof(context->param_buff), "%u", context->done_batch);
+        return context->param_buff;
     }
 
     return NULL;
@@ -24,6 +24,8 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <stdio.h>
+
 #include "intel_st_debug_if_stream_dbg.h"
 #include "intel_st_debug_if_server.h"
 #include "intel_st_debug_if_st_dbg_ip_driver.h"
@@ -34,14 +36,16 @@
 
 enum {
   CTRL_RX_BUFF_SZ = 512,
-  CTRL_TX_BUFF_SZ = 512
+  CTRL_TX_BUFF_SZ = 512,
+  PORT_FILE_NAME_SZ = 64,
+  LOCAL_PATH_SZ = 128
 };
-static char g_ctrl_rx_buff[CTRL_RX_BUFF_SZ] = {0};
-static char g_ctrl_tx_buff[CTRL_TX_BUFF_SZ] = {0};
 
-static SERVER_HW_CALLBACKS get_hw_callbacks() {
+static SERVER_HW_CALLBACKS get_hw_callbacks(intel_remote_debug_server_context *context) {
   SERVER_HW_CALLBACKS result = SERVER_HW_CALLBACKS_default;
+  result.context = &(context->driver_cxt);
   result.init_driver = init_driver;
+  result.resume_driver = resume_driver;
   result.has_mgmt_support = get_mgmt_support;
   result.set_param = set_driver_param;
   result.get_param = get_driver_param;
@@ -49,6 +53,9 @@ static SERVER_HW_CALLBACKS get_hw_callbacks() {
   result.h2t_data_received = push_h2t_data;
   result.acquire_t2h_data = get_t2h_data;
   result.t2h_data_complete = t2h_data_complete;
+  result.flush_data_complete = flush_data_complete;
+  result.get_wakeup_fd = get_irq_wakeup_fd;
+  result.ack_wakeup = ack_irq_wakeup;
 #if ENABLE_MGMT != 0
   result.get_mgmt_buffer = get_mgmt_buffer;
   result.mgmt_data_received = push_mgmt_data;
@@ -78,38 +85,56 @@ static ST_DBG_IP_DESIGN_INFO get_design_info(intel_remote_debug_server_context *
     result.T2H_MEM_BASE_ADDR = T2H_MEM_BASE_4K;
     result.T2H_MEM_SZ = context->h2t_t2h_mem_size;
   }
+  result.T2H_DESC_DEPTH = T2H_DESC_DEPTH_DEFAULT;
 #if ENABLE_MGMT != 0
   result.MGMT_MEM_BASE_ADDR = MGMT_MEM_BASE;
   result.MGMT_MEM_SZ = MGMT_MEM_SPAN;
   result.MGMT_RSP_MEM_BASE_ADDR = MGMT_RSP_MEM_BASE;
   result.MGMT_RSP_MEM_SZ = MGMT_RSP_MEM_SPAN;
+  result.MGMT_RSP_DESC_DEPTH = MGMT_RSP_DESC_DEPTH_DEFAULT;
 #else
   result.MGMT_MEM_BASE_ADDR = 0;
   result.MGMT_MEM_SZ = 0;
   result.MGMT_RSP_MEM_BASE_ADDR = 0;
   result.MGMT_RSP_MEM_SZ = 0;
+  result.MGMT_RSP_DESC_DEPTH = 0;
 #endif
   return result;
 }
 
 void init_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *context, FPGA_MMIO_INTERFACE_HANDLE mmio_handle, size_t size, int port)
 {
+  init_driver_context(&(context->driver_cxt));
   context->port = port;
   context->h2t_t2h_mem_size = size;
+  context->instance = 0;
+  context->event_loop_backend = EVENT_LOOP_BACKEND_DEFAULT;
+  context->threaded = 0;
+  context->busy_poll_us = 0;
+  context->cpu = -1;
+  context->engine_cpu = -1;
+  context->sched_fifo_priority = 0;
+  context->local_path = NULL;
+  context->handshake_timeout_ms = DEFAULT_HANDSHAKE_TIMEOUT_MS;
+  context->warm_reconnect = 1;
+  context->server_conn = NULL;
   context->driver_cxt.mmio_handle = mmio_handle; // TODO: this should be filled by the driver init(). driver_init() should be called here as well.
+  context->driver_cxt.interrupt_handle = FPGA_INTERRUPT_INVALID_HANDLE; // Polling unless the caller opens the interrupt
 }
 
 int start_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *context)
 {
   int ret = 0;
+  char ctrl_rx_buff[CTRL_RX_BUFF_SZ] = {0};
+  char ctrl_tx_buff[CTRL_TX_BUFF_SZ] = {0};
   ST_DBG_IP_DESIGN_INFO design_info = get_design_info(context);
-  set_design_info(design_info);
+  set_design_info(&(context->driver_cxt), design_info);
 
   SERVER_BUFFERS buffers = SERVER_BUFFERS_default;
   buffers.use_wrapping_data_buffers = 1;
-  buffers.ctrl_rx_buff = g_ctrl_rx_buff;
+  buffers.ctrl_rx_buff = ctrl_rx_buff;
   buffers.ctrl_rx_buff_sz = CTRL_RX_BUFF_SZ;
-  buffers.ctrl_tx_buff = g_ctrl_tx_buff;
+  buffers.ctrl_tx_buff = ctrl_tx_buff;
   buffers.ctrl_tx_buff_sz = CTRL_TX_BUFF_SZ;
   buffers.h2t_rx_buff = design_info.H2T_MEM_BASE_ADDR;
   buffers.h2t_rx_buff_sz = design_info.H2T_MEM_SZ;
@@ -122,11 +147,39 @@ int start_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *
 
   SERVER_CONN server_conn = SERVER_CONN_default;
   server_conn.buff = &buffers;
-  server_conn.hw_callbacks = get_hw_callbacks();
+  server_conn.hw_callbacks = get_hw_callbacks(context);
+  server_conn.event_loop_backend = context->event_loop_backend;
+  server_conn.threaded = context->threaded;
+  server_conn.busy_poll_us = context->busy_poll_us;
+  server_conn.cpu = context->cpu;
+  server_conn.engine_cpu = context->engine_cpu;
+  server_conn.sched_fifo_priority = context->sched_fifo_priority;
+  server_conn.handshake_timeout_ms = context->handshake_timeout_ms;
+  server_conn.warm_reconnect = context->warm_reconnect;
+
+  // The first instance keeps the historical port file name
+  char port_filename[PORT_FILE_NAME_SZ];
+  if (context->instance == 0) {
+    snprintf(port_filename, sizeof(port_filename), "%s", SERVER_PORT_FILE);
+  } else {
+    snprintf(port_filename, sizeof(port_filename), "%s.%u", SERVER_PORT_FILE, context->instance);
+  }
+
+  // Same for the local socket, if any
+  char local_path[LOCAL_PATH_SZ];
+  if (context->local_path != NULL) {
+    if (context->instance == 0) {
+      snprintf(local_path, sizeof(local_path), "%s", context->local_path);
+    } else {
+      snprintf(local_path, sizeof(local_path), "%s.%u", context->local_path, context->instance);
+    }
+    server_conn.local_path = local_path;
+  }
 
-    if (initialize_server((unsigned short)context->port, &server_conn, SERVER_PORT_FILE) == OK)
+  context->server_conn = &server_conn;
+    if (initialize_server((unsigned short)context->port, &server_conn, port_filename) == OK)
     {
-      ret = server_main(context, MULTIPLE_CLIENTS, &server_conn);
+      ret = server_main(MULTIPLE_CLIENTS, &server_conn);
     }
     else
     {
@@ -134,12 +187,16 @@ int start_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *
                       "Server failed to initialize, no further attempts will be made!\n");
       ret = -1;
     }
+  context->server_conn = NULL;
 
   return ret;
 }
 
-void terminate_st_dbg_transport_server_over_tcpip()
+void terminate_st_dbg_transport_server_over_tcpip(intel_remote_debug_server_context *context)
 {
-  server_terminate();
+  if (context->server_conn != NULL)
+  {
+    server_terminate(context->server_conn);
+  }
 }
 
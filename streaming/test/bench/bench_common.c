@@ -0,0 +1,600 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "intel_fpga_api.h"
+#include "intel_fpga_platform_api.h"
+
+#include "intel_st_debug_if_constants.h"
+#include "intel_st_debug_if_mmio_engine.h"
+#include "bench_common.h"
+
+#define BENCH_H2T_SLOTS 64
+
+static FPGA_MMIO_INTERFACE_HANDLE s_handle = FPGA_MMIO_INTERFACE_INVALID_HANDLE;
+static char s_threaded = 0;
+static int s_busy_poll_us = 0;
+static int s_cpu = -1;
+static int s_engine_cpu = -1;
+static const char *s_local_path = NULL;
+static unsigned long s_handshake_timeout_ms = DEFAULT_HANDSHAKE_TIMEOUT_MS;
+static char s_warm_reconnect = 1;
+static char s_background_reject = 1;
+static SERVER_LIFESPAN s_lifespan = SINGLE_CLIENT;
+
+static size_t sw_model_span(size_t h2t_t2h_mem_size) {
+    // CSRs extend up to the MGMT RSP block, the H2T / T2H memories start after the CSRs or after 2K
+    return MAX_MACRO(4 * h2t_t2h_mem_size, (size_t)0x4000);
+}
+
+int bench_sw_model_init(size_t h2t_t2h_mem_size) {
+    char span_arg[64];
+    const size_t span = sw_model_span(h2t_t2h_mem_size);
+    snprintf(span_arg, sizeof(span_arg), "--address-span=%zu", span);
+    const char *argv[] = { "streaming_bench", "--single-component-mode", "--uio-driver-path=/dev/uio0", span_arg };
+
+    optind = 0;
+    if (!fpga_platform_init(4, argv)) {
+        fprintf(stderr, "Failed to initialize the UIO software model\n");
+        return -1;
+    }
+    if ((s_handle = fpga_open(0)) == FPGA_MMIO_INTERFACE_INVALID_HANDLE) {
+        fprintf(stderr, "Failed to open the UIO software model\n");
+        return -1;
+    }
+
+    // Present an idle, compatible ST Debug IP: no T2H data and a fixed number of free H2T slots,
+    // which makes every pushed H2T descriptor look consumed by the time the driver checks again.
+    memset(fpga_uio_get_base_address(s_handle), 0, span);
+    fpga_write_32(s_handle, ST_DBG_IP_CONFIG_TYPE, SUPPORTED_TYPE);
+    fpga_write_32(s_handle, ST_DBG_IP_CONFIG_VERSION, SUPPORTED_VERSION);
+    fpga_write_32(s_handle, ST_DBG_IP_H2T_AVAILABLE_SLOTS, BENCH_H2T_SLOTS);
+    return 0;
+}
+
+void bench_sw_model_cleanup() {
+    if (s_handle != FPGA_MMIO_INTERFACE_INVALID_HANDLE) {
+        fpga_close(s_handle);
+        s_handle = FPGA_MMIO_INTERFACE_INVALID_HANDLE;
+    }
+    fpga_platform_cleanup();
+}
+
+FPGA_MMIO_INTERFACE_HANDLE bench_sw_model_handle() {
+    return s_handle;
+}
+
+static void *bench_server_thread(void *arg) {
+    BENCH_SERVER *server = (BENCH_SERVER *)arg;
+    server->rc = server_main(server->lifespan, &(server->server_conn));
+    return NULL;
+}
+
+void bench_server_set_threaded(char threaded) {
+    s_threaded = threaded;
+}
+
+void bench_server_set_busy_poll(int busy_poll_us) {
+    s_busy_poll_us = busy_poll_us;
+}
+
+void bench_server_set_cpus(int cpu, int engine_cpu) {
+    s_cpu = cpu;
+    s_engine_cpu = engine_cpu;
+}
+
+void bench_server_set_local_path(const char *local_path) {
+    s_local_path = local_path;
+}
+
+void bench_server_set_handshake_timeout(unsigned long handshake_timeout_ms) {
+    s_handshake_timeout_ms = handshake_timeout_ms;
+}
+
+void bench_server_set_warm_reconnect(char warm_reconnect) {
+    s_warm_reconnect = warm_reconnect;
+}
+
+void bench_server_set_background_reject(char background_reject) {
+    s_background_reject = background_reject;
+}
+
+void bench_server_set_lifespan(SERVER_LIFESPAN lifespan) {
+    s_lifespan = lifespan;
+}
+
+void bench_server_stop(BENCH_SERVER *server) {
+    server->server_conn.stopping = 1;
+}
+
+void bench_server_terminate(BENCH_SERVER *server) {
+    server_terminate(&(server->server_conn));
+}
+
+int bench_server_start(BENCH_SERVER *server, size_t h2t_t2h_mem_size, EVENT_LOOP_BACKEND backend) {
+    init_st_dbg_transport_server_over_tcpip(&(server->context), s_handle, h2t_t2h_mem_size, 0);
+    server->context.event_loop_backend = backend;
+
+    // Same memory map as the one etherlink derives from --h2t-t2h-mem-size
+    ST_DBG_IP_DESIGN_INFO info;
+    memset(&info, 0, sizeof(info));
+    info.ST_DBG_IP_CSR_BASE_ADDR = ST_DBG_IF_BASE;
+    info.H2T_MEM_BASE_ADDR = (h2t_t2h_mem_size > JOP_MEM_SIZE_2K) ? h2t_t2h_mem_size : H2T_MEM_BASE_2K;
+    info.H2T_MEM_SZ = h2t_t2h_mem_size;
+    info.T2H_MEM_BASE_ADDR = (h2t_t2h_mem_size > JOP_MEM_SIZE_2K) ? 2 * h2t_t2h_mem_size : T2H_MEM_BASE_4K;
+    info.T2H_MEM_SZ = h2t_t2h_mem_size;
+    info.T2H_DESC_DEPTH = T2H_DESC_DEPTH_DEFAULT;
+    set_design_info(&(server->context.driver_cxt), info);
+
+    server->buffers = SERVER_BUFFERS_default;
+    server->buffers.use_wrapping_data_buffers = 1;
+    server->buffers.ctrl_rx_buff = server->ctrl_rx_buff;
+    server->buffers.ctrl_rx_buff_sz = BENCH_CTRL_BUFF_SZ;
+    server->buffers.ctrl_tx_buff = server->ctrl_tx_buff;
+    server->buffers.ctrl_tx_buff_sz = BENCH_CTRL_BUFF_SZ;
+    server->buffers.h2t_rx_buff = info.H2T_MEM_BASE_ADDR;
+    server->buffers.h2t_rx_buff_sz = info.H2T_MEM_SZ;
+    server->buffers.t2h_tx_buff = info.T2H_MEM_BASE_ADDR;
+    server->buffers.t2h_tx_buff_sz = info.T2H_MEM_SZ;
+
+    server->server_conn = SERVER_CONN_default;
+    server->server_conn.buff = &(server->buffers);
+    server->server_conn.event_loop_backend = backend;
+    server->server_conn.threaded = s_threaded;
+    server->server_conn.busy_poll_us = s_busy_poll_us;
+    server->server_conn.cpu = s_cpu;
+    server->server_conn.engine_cpu = s_engine_cpu;
+    server->server_conn.local_path = s_local_path;
+    server->server_conn.handshake_timeout_ms = s_handshake_timeout_ms;
+    server->server_conn.warm_reconnect = s_warm_reconnect;
+    server->server_conn.background_reject = s_background_reject;
+    server->server_conn.hw_callbacks.context = &(server->context.driver_cxt);
+    server->server_conn.hw_callbacks.init_driver = init_driver;
+    server->server_conn.hw_callbacks.resume_driver = resume_driver;
+    server->server_conn.hw_callbacks.has_mgmt_support = get_mgmt_support;
+    server->server_conn.hw_callbacks.set_param = set_driver_param;
+    server->server_conn.hw_callbacks.get_param = get_driver_param;
+    server->server_conn.hw_callbacks.get_h2t_buffer = get_h2t_buffer;
+    server->server_conn.hw_callbacks.h2t_data_received = push_h2t_data;
+    server->server_conn.hw_callbacks.acquire_t2h_data = get_t2h_data;
+    server->server_conn.hw_callbacks.t2h_data_complete = t2h_data_complete;
+    server->server_conn.hw_callbacks.flush_data_complete = flush_data_complete;
+    server->server_conn.hw_callbacks.get_wakeup_fd = get_irq_wakeup_fd;
+    server->server_conn.hw_callbacks.ack_wakeup = ack_irq_wakeup;
+
+    if (initialize_server(0, &(server->server_conn), NULL) != OK) {
+        return -1;
+    }
+    server->port = ntohs(server->server_conn.server_addr.sin_port);
+    server->lifespan = s_lifespan;
+    return pthread_create(&(server->thread), NULL, bench_server_thread, server);
+}
+
+int bench_server_join(BENCH_SERVER *server) {
+    pthread_join(server->thread, NULL);
+    return server->rc;
+}
+
+// Connects to 'local_path' (same format as SERVER_CONN.local_path) unless NULL, to 'port' on the loopback otherwise
+static SOCKET bench_connect_socket(unsigned short port, const char *local_path) {
+    struct sockaddr_in addr;
+    SOCKET fd = socket((local_path != NULL) ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+    if (fd == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    if (local_path != NULL) {
+        struct sockaddr_un local_addr;
+        const size_t path_len = strlen(local_path);
+        socklen_t addr_len = sizeof(local_addr);
+        memset(&local_addr, 0, sizeof(local_addr));
+        local_addr.sun_family = AF_UNIX;
+        if (path_len >= sizeof(local_addr.sun_path)) {
+            close_socket_fd(fd);
+            return INVALID_SOCKET;
+        }
+        memcpy(local_addr.sun_path, local_path, path_len);
+        if (local_path[0] == '@') {
+            local_addr.sun_path[0] = '\0';
+            addr_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + path_len);
+        }
+        if (connect(fd, (const struct sockaddr *)&local_addr, addr_len) < 0) {
+            close_socket_fd(fd);
+            return INVALID_SOCKET;
+        }
+        return fd;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close_socket_fd(fd);
+        return INVALID_SOCKET;
+    }
+    set_tcp_no_delay(fd, 1);
+    return fd;
+}
+
+static int bench_recv_string(SOCKET fd, char *buff, size_t buff_sz) {
+    ssize_t bytes_recvd;
+    zero_mem(buff, buff_sz);
+    return (socket_recv_until_null_reached(fd, buff, buff_sz - 1, 0, &bytes_recvd) == OK) ? 0 : -1;
+}
+
+// Reads no further than 'expected', another message may follow right away (the two READYs of the CONTROL socket)
+static int bench_expect_string(SOCKET fd, const char *expected) {
+    char buff[128];
+    const size_t len = strlen(expected) + 1;
+    if (len > sizeof(buff) || socket_recv_accumulate(fd, buff, len, 0, NULL) != OK || memcmp(buff, expected, len) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int bench_connect_channel(SOCKET *fd, unsigned short port, const char *local_path, const char *sock_name, int handle) {
+    char msg[128];
+    if ((*fd = bench_connect_socket(port, local_path)) == INVALID_SOCKET) {
+        return -1;
+    }
+    generate_expected_handle_message(msg, sizeof(msg), sock_name, handle);
+    if (socket_send_all(*fd, msg, strlen(msg) + 1, 0, NULL) != OK) {
+        return -1;
+    }
+    return bench_expect_string(*fd, READY_MSG);
+}
+
+static int bench_client_connect_to(BENCH_CLIENT *client, unsigned short port, const char *local_path) {
+    char welcome[512];
+    client->ctrl_fd = client->mgmt_fd = client->mgmt_rsp_fd = client->h2t_data_fd = client->t2h_data_fd = INVALID_SOCKET;
+    client->shm = SHM_TRANSPORT_default;
+    client->mux = 0;
+    client->mux_rx_remaining = 0;
+
+    if ((client->ctrl_fd = bench_connect_socket(port, local_path)) == INVALID_SOCKET ||
+        bench_recv_string(client->ctrl_fd, welcome, sizeof(welcome)) != 0 ||
+        (client->handle = parse_handle_id(welcome)) <= 0) {
+        return -1;
+    }
+
+    char msg[128];
+    generate_expected_handle_message(msg, sizeof(msg), CONTROL_SOCK_NAME, client->handle);
+    if (socket_send_all(client->ctrl_fd, msg, strlen(msg) + 1, 0, NULL) != OK ||
+        bench_expect_string(client->ctrl_fd, READY_MSG) != 0 ||
+        bench_connect_channel(&(client->mgmt_fd), port, local_path, MANAGEMENT_SOCK_NAME, client->handle) != 0 ||
+        bench_connect_channel(&(client->mgmt_rsp_fd), port, local_path, MANAGEMENT_RSP_SOCK_NAME, client->handle) != 0 ||
+        bench_connect_channel(&(client->h2t_data_fd), port, local_path, H2T_SOCK_NAME, client->handle) != 0 ||
+        bench_connect_channel(&(client->t2h_data_fd), port, local_path, T2H_SOCK_NAME, client->handle) != 0) {
+        return -1;
+    }
+    return bench_expect_string(client->ctrl_fd, READY_MSG);
+}
+
+int bench_client_connect(BENCH_CLIENT *client, unsigned short port) {
+    return bench_client_connect_to(client, port, NULL);
+}
+
+int bench_client_connect_local(BENCH_CLIENT *client, const char *local_path) {
+    return bench_client_connect_to(client, 0, local_path);
+}
+
+int bench_client_connect_reversed(BENCH_CLIENT *client, unsigned short port) {
+    const char *sock_names[] = { T2H_SOCK_NAME, H2T_SOCK_NAME, MANAGEMENT_RSP_SOCK_NAME, MANAGEMENT_SOCK_NAME };
+    SOCKET *fds[] = { &(client->t2h_data_fd), &(client->h2t_data_fd), &(client->mgmt_rsp_fd), &(client->mgmt_fd) };
+    char welcome[512];
+    char msg[128];
+    client->ctrl_fd = client->mgmt_fd = client->mgmt_rsp_fd = client->h2t_data_fd = client->t2h_data_fd = INVALID_SOCKET;
+    client->shm = SHM_TRANSPORT_default;
+    client->mux = 0;
+    client->mux_rx_remaining = 0;
+
+    if ((client->ctrl_fd = bench_connect_socket(port, NULL)) == INVALID_SOCKET ||
+        bench_recv_string(client->ctrl_fd, welcome, sizeof(welcome)) != 0 ||
+        (client->handle = parse_handle_id(welcome)) <= 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+        generate_expected_handle_message(msg, sizeof(msg), sock_names[i], client->handle);
+        if ((*(fds[i]) = bench_connect_socket(port, NULL)) == INVALID_SOCKET ||
+            socket_send_all(*(fds[i]), msg, strlen(msg) + 1, 0, NULL) != OK) {
+            return -1;
+        }
+    }
+    generate_expected_handle_message(msg, sizeof(msg), CONTROL_SOCK_NAME, client->handle);
+    if (socket_send_all(client->ctrl_fd, msg, strlen(msg) + 1, 0, NULL) != OK ||
+        bench_expect_string(client->ctrl_fd, READY_MSG) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+        if (bench_expect_string(*(fds[i]), READY_MSG) != 0) {
+            return -1;
+        }
+    }
+    return bench_expect_string(client->ctrl_fd, READY_MSG);
+}
+
+SOCKET bench_connect_silent(unsigned short port) {
+    return bench_connect_socket(port, NULL);
+}
+
+int bench_client_connect_mux(BENCH_CLIENT *client, unsigned short port) {
+    char welcome[512];
+    char msg[128];
+    client->ctrl_fd = client->mgmt_fd = client->mgmt_rsp_fd = client->h2t_data_fd = client->t2h_data_fd = INVALID_SOCKET;
+    client->shm = SHM_TRANSPORT_default;
+    client->mux = 1;
+    client->mux_rx_remaining = 0;
+
+    snprintf(msg, sizeof(msg), "%s=1", MUX_SUPPORT_PARAM);
+    if ((client->ctrl_fd = bench_connect_socket(port, NULL)) == INVALID_SOCKET ||
+        bench_recv_string(client->ctrl_fd, welcome, sizeof(welcome)) != 0 ||
+        (client->handle = parse_handle_id(welcome)) <= 0) {
+        return -1;
+    }
+    if (strstr(welcome, msg) == NULL) {
+        return 1;
+    }
+    generate_expected_handle_message(msg, sizeof(msg), MUX_SOCK_NAME, client->handle);
+    if (socket_send_all(client->ctrl_fd, msg, strlen(msg) + 1, 0, NULL) != OK) {
+        return -1;
+    }
+    return bench_expect_string(client->ctrl_fd, READY_MSG);
+}
+
+// Sends 'len' bytes as frames of 'stream', each with its header in a single system call
+static int bench_mux_send(BENCH_CLIENT *client, unsigned char stream, const char *buff, size_t len) {
+    while (len > 0) {
+        unsigned char header[SIZEOF_MUX_FRAME_HEADER];
+        const size_t chunk = MIN_MACRO(len, (size_t)MUX_FRAME_MAX_PAYLOAD_BYTES);
+        struct iovec iov[2];
+        struct msghdr msg;
+        populate_mux_frame_header_bytes(header, stream, (unsigned short)chunk);
+        iov[0].iov_base = header;
+        iov[0].iov_len = sizeof(header);
+        iov[1].iov_base = (void *)buff;
+        iov[1].iov_len = chunk;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        ssize_t sent = sendmsg(client->ctrl_fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return -1;
+        }
+        // Whatever the socket did not take at once
+        if ((size_t)sent < sizeof(header)) {
+            if (socket_send_all(client->ctrl_fd, (const char *)header + sent, sizeof(header) - sent, 0, NULL) != OK) {
+                return -1;
+            }
+            sent = sizeof(header);
+        }
+        const size_t payload_sent = (size_t)sent - sizeof(header);
+        if (payload_sent < chunk && socket_send_all(client->ctrl_fd, buff + payload_sent, chunk - payload_sent, 0, NULL) != OK) {
+            return -1;
+        }
+        buff += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+// Receives 'len' bytes of 'stream', dropping whatever the other streams carry in between
+static int bench_mux_recv(BENCH_CLIENT *client, unsigned char stream, char *buff, size_t len) {
+    char discard[256];
+    while (len > 0) {
+        if (client->mux_rx_remaining == 0) {
+            unsigned char header_bytes[SIZEOF_MUX_FRAME_HEADER];
+            MUX_FRAME_HEADER header;
+            if (socket_recv_accumulate(client->ctrl_fd, (char *)header_bytes, sizeof(header_bytes), 0, NULL) != OK) {
+                return -1;
+            }
+            parse_mux_frame_header_bytes(header_bytes, &header);
+            client->mux_rx_stream = header.STREAM;
+            client->mux_rx_remaining = header.DATA_LEN_BYTES;
+            continue;
+        }
+        const char wanted = (client->mux_rx_stream == stream);
+        const size_t chunk = MIN_MACRO(client->mux_rx_remaining, wanted ? len : sizeof(discard));
+        if (socket_recv_accumulate(client->ctrl_fd, wanted ? buff : discard, chunk, 0, NULL) != OK) {
+            return -1;
+        }
+        client->mux_rx_remaining -= chunk;
+        if (wanted) {
+            buff += chunk;
+            len -= chunk;
+        }
+    }
+    return 0;
+}
+
+// A CTRL message comes in a single frame, the first byte gets there and the rest of the frame follows at once
+static int bench_mux_recv_string(BENCH_CLIENT *client, char *buff, size_t buff_sz) {
+    size_t len = 0;
+    zero_mem(buff, buff_sz);
+    do {
+        const size_t chunk = (len == 0 || client->mux_rx_remaining == 0) ? 1 : MIN_MACRO(client->mux_rx_remaining, buff_sz - 1 - len);
+        if (chunk == 0 || len + chunk >= buff_sz || bench_mux_recv(client, MUX_STREAM_CONTROL, buff + len, chunk) != 0) {
+            return -1;
+        }
+        len += chunk;
+    } while (buff[len - 1] != '\0');
+    return 0;
+}
+
+int bench_client_command(BENCH_CLIENT *client, const char *cmd, char *rsp, size_t rsp_sz) {
+    if (client->mux) {
+        if (bench_mux_send(client, MUX_STREAM_CONTROL, cmd, strlen(cmd) + 1) != 0) {
+            return -1;
+        }
+        return bench_mux_recv_string(client, rsp, rsp_sz);
+    }
+    if (socket_send_all(client->ctrl_fd, cmd, strlen(cmd) + 1, 0, NULL) != OK) {
+        return -1;
+    }
+    return bench_recv_string(client->ctrl_fd, rsp, rsp_sz);
+}
+
+int bench_client_disconnect(BENCH_CLIENT *client) {
+    char rsp[64];
+    int rc = bench_client_command(client, DISCONNECT_CMD, rsp, sizeof(rsp));
+    bench_client_close(client);
+    return (rc == 0 && strcmp(rsp, DISCONNECT_CMD_RSP) == 0) ? 0 : -1;
+}
+
+void bench_client_close(BENCH_CLIENT *client) {
+    shm_transport_close(&(client->shm));
+    SOCKET *fds[] = { &(client->mgmt_fd), &(client->mgmt_rsp_fd), &(client->h2t_data_fd), &(client->t2h_data_fd), &(client->ctrl_fd) };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+        if (*(fds[i]) != INVALID_SOCKET) {
+            close_socket_fd(*(fds[i]));
+            *(fds[i]) = INVALID_SOCKET;
+        }
+    }
+}
+
+int bench_client_h2t_echo(BENCH_CLIENT *client, size_t payload_sz, size_t num_packets) {
+    const size_t packet_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + payload_sz;
+    unsigned char *tx = (unsigned char *)malloc(packet_sz);
+    unsigned char *rx = (unsigned char *)malloc(packet_sz);
+    int rc = 0;
+
+    if (tx == NULL || rx == NULL) {
+        rc = -1;
+    }
+    for (size_t i = 0; (rc == 0) && (i < num_packets); ++i) {
+        populate_h2t_packet_bytes(tx, 1, 1, 0, 0, (unsigned short)payload_sz);
+        for (size_t j = 0; j < payload_sz; ++j) {
+            tx[SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + j] = (unsigned char)(i + j);
+        }
+        if (bench_client_h2t_send(client, tx, packet_sz) != 0 || bench_client_t2h_recv(client, rx, packet_sz) != 0 ||
+            memcmp(tx + SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER, rx + SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER, payload_sz) != 0) {
+            rc = -1;
+        }
+    }
+    free(tx);
+    free(rx);
+    return rc;
+}
+
+int bench_client_attach_shm(BENCH_CLIENT *client, size_t ring_sz) {
+    char cmd[64];
+    char rsp[64];
+    int fds[SHM_TRANSPORT_NUM_FDS];
+    snprintf(cmd, sizeof(cmd), "%s %zu", SHM_ATTACH_CMD, ring_sz);
+    if (socket_send_all(client->ctrl_fd, cmd, strlen(cmd) + 1, 0, NULL) != OK ||
+        shm_transport_recv_fds(client->ctrl_fd, rsp, sizeof(rsp), fds, SHM_TRANSPORT_NUM_FDS) != OK) {
+        return -1;
+    }
+    char complete = strcmp(rsp, SHM_ATTACH_CMD_RSP) == 0;
+    for (int i = 0; i < SHM_TRANSPORT_NUM_FDS; ++i) {
+        complete = complete && fds[i] >= 0;
+    }
+    if (!complete) {
+        for (int i = 0; i < SHM_TRANSPORT_NUM_FDS; ++i) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+        return -1;
+    }
+    if (shm_transport_attach(&(client->shm), fds) != OK) {
+        return -1;
+    }
+    // Spinning only keeps the server off the CPU when there is a single one
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        client->shm.spin_us = 0;
+    }
+    return 0;
+}
+
+int bench_client_h2t_send(BENCH_CLIENT *client, const void *buff, size_t len) {
+    if (client->mux) {
+        return bench_mux_send(client, MUX_STREAM_H2T, (const char *)buff, len);
+    }
+    if (client->shm.layout != NULL) {
+        return (shm_transport_send_all(&(client->shm), buff, len, client->t2h_data_fd) == OK) ? 0 : -1;
+    }
+    return (socket_send_all(client->h2t_data_fd, (const char *)buff, len, 0, NULL) == OK) ? 0 : -1;
+}
+
+int bench_client_t2h_recv(BENCH_CLIENT *client, void *buff, size_t len) {
+    if (client->mux) {
+        return bench_mux_recv(client, MUX_STREAM_T2H, (char *)buff, len);
+    }
+    if (client->shm.layout != NULL) {
+        return (shm_transport_recv_all(&(client->shm), buff, len, client->t2h_data_fd) == OK) ? 0 : -1;
+    }
+    return (socket_recv_accumulate(client->t2h_data_fd, (char *)buff, len, 0, NULL) == OK) ? 0 : -1;
+}
+
+size_t bench_size_arg(int argc, char **argv, const char *name, size_t default_value) {
+    const size_t name_len = strlen(name);
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, name_len) == 0 && argv[i][2 + name_len] == '=') {
+            return (size_t)strtoul(argv[i] + 3 + name_len, NULL, 0);
+        }
+    }
+    return default_value;
+}
+
+double bench_now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+double bench_thread_cpu_seconds(pthread_t thread) {
+    clockid_t cid;
+    struct timespec ts;
+    if (pthread_getcpuclockid(thread, &cid) != 0 || clock_gettime(cid, &ts) != 0) {
+        return 0.0;
+    }
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+double bench_server_cpu_seconds(BENCH_SERVER *server) {
+    double cpu = bench_thread_cpu_seconds(server->thread);
+    MMIO_ENGINE *engine = server->server_conn.engine;
+    if (engine != NULL) {
+        cpu += bench_thread_cpu_seconds(engine->thread);
+    }
+    return cpu;
+}
+
+size_t bench_server_t2h_queued(BENCH_SERVER *server) {
+    MMIO_ENGINE *engine = server->server_conn.engine;
+    if (engine != NULL) {
+        return __atomic_load_n(&(engine->t2h_ring.tail), __ATOMIC_ACQUIRE) - __atomic_load_n(&(engine->t2h_ring.head), __ATOMIC_ACQUIRE);
+    }
+    return output_queue_len(&(server->server_conn.t2h_queue));
+}
@@ -0,0 +1,137 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "intel_st_debug_if_server.h"
+#include "intel_st_debug_if_stream_dbg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Structure Definitions
+enum { BENCH_CTRL_BUFF_SZ = 512 };
+
+typedef struct {
+    intel_remote_debug_server_context context;
+    char ctrl_rx_buff[BENCH_CTRL_BUFF_SZ];
+    char ctrl_tx_buff[BENCH_CTRL_BUFF_SZ];
+    SERVER_BUFFERS buffers;
+    SERVER_CONN server_conn;
+    unsigned short port;
+    SERVER_LIFESPAN lifespan;
+    pthread_t thread;
+    int rc;
+} BENCH_SERVER;
+
+typedef struct {
+    SOCKET ctrl_fd;
+    SOCKET mgmt_fd;
+    SOCKET mgmt_rsp_fd;
+    SOCKET h2t_data_fd;
+    SOCKET t2h_data_fd;
+    int handle;
+    SHM_TRANSPORT shm;  // H2T / T2H data goes through shared memory once attached, see bench_client_attach_shm()
+    char mux;           // Every stream goes through the CTRL socket, see bench_client_connect_mux()
+    unsigned char mux_rx_stream;
+    size_t mux_rx_remaining;  // Payload bytes left in the frame being received
+} BENCH_CLIENT;
+
+typedef struct {
+    const char *name;
+    const char *description;
+    int (*run)(int argc, char **argv);
+} BENCH_SCENARIO;
+
+// UIO software model, preset so that the ST Debug IP driver accepts it.
+int bench_sw_model_init(size_t h2t_t2h_mem_size);
+void bench_sw_model_cleanup();
+FPGA_MMIO_INTERFACE_HANDLE bench_sw_model_handle();
+
+// Runs server_main() for a single client on an ephemeral port in a dedicated thread, in threaded mode
+// (see SERVER_CONN.threaded) once bench_server_set_threaded() has been called.
+void bench_server_set_threaded(char threaded);
+// Busy poll mode (see SERVER_CONN.busy_poll_us, 0 is off) and CPUs of the server and MMIO engine threads (-1 for none)
+void bench_server_set_busy_poll(int busy_poll_us);
+void bench_server_set_cpus(int cpu, int engine_cpu);
+// Local listener next to the TCP one (see SERVER_CONN.local_path), NULL for none
+void bench_server_set_local_path(const char *local_path);
+// See SERVER_CONN.handshake_timeout_ms
+void bench_server_set_handshake_timeout(unsigned long handshake_timeout_ms);
+// See SERVER_CONN.warm_reconnect
+void bench_server_set_warm_reconnect(char warm_reconnect);
+// See SERVER_CONN.background_reject
+void bench_server_set_background_reject(char background_reject);
+// Servers serve a single client unless MULTIPLE_CLIENTS is set here, bench_server_stop() then has the server
+// exit once its current client is gone
+void bench_server_set_lifespan(SERVER_LIFESPAN lifespan);
+void bench_server_stop(BENCH_SERVER *server);
+// Closes the listening sockets while a client is served, as SIGINT does (server_terminate())
+void bench_server_terminate(BENCH_SERVER *server);
+int bench_server_start(BENCH_SERVER *server, size_t h2t_t2h_mem_size, EVENT_LOOP_BACKEND backend);
+int bench_server_join(BENCH_SERVER *server);
+
+// Minimal reference client performing the same handshake as the debug host.
+int bench_client_connect(BENCH_CLIENT *client, unsigned short port);
+int bench_client_connect_local(BENCH_CLIENT *client, const char *local_path);
+// Same over a single multiplexed connection (see MUX_SOCK_NAME), returns 1 if the welcome message did not offer it
+int bench_client_connect_mux(BENCH_CLIENT *client, unsigned short port);
+// Same as bench_client_connect() with the other four sockets connected in reverse order, and their acks sent
+// ahead of the one of the CONTROL socket
+int bench_client_connect_reversed(BENCH_CLIENT *client, unsigned short port);
+// A connection that never sends anything, as a half-open client would
+SOCKET bench_connect_silent(unsigned short port);
+int bench_client_command(BENCH_CLIENT *client, const char *cmd, char *rsp, size_t rsp_sz);
+int bench_client_disconnect(BENCH_CLIENT *client);
+// Closes the sockets of the client without telling the server, e.g. once it was told with DISCONNECT_CMD already
+void bench_client_close(BENCH_CLIENT *client);
+int bench_client_h2t_echo(BENCH_CLIENT *client, size_t payload_sz, size_t num_packets);
+
+// Moves the H2T / T2H data of a client connected with bench_client_connect_local() to shared memory (see
+// SHM_ATTACH_CMD), rings of 'ring_sz' bytes each.  The send / recv helpers use whichever transport is in use,
+// multiplexed connections included.
+int bench_client_attach_shm(BENCH_CLIENT *client, size_t ring_sz);
+int bench_client_h2t_send(BENCH_CLIENT *client, const void *buff, size_t len);
+int bench_client_t2h_recv(BENCH_CLIENT *client, void *buff, size_t len);
+
+// Returns the value of a "--name=<value>" argument, or 'default_value' if absent
+size_t bench_size_arg(int argc, char **argv, const char *name, size_t default_value);
+
+// Timing helpers
+double bench_now_seconds();
+double bench_thread_cpu_seconds(pthread_t thread);
+double bench_server_cpu_seconds(BENCH_SERVER *server); // Including the MMIO engine while it runs
+
+// T2H bytes laid out by the server but not sent yet, from its output queue or its T2H ring in threaded mode
+size_t bench_server_t2h_queued(BENCH_SERVER *server);
+
+#ifdef __cplusplus
+}
+#endif
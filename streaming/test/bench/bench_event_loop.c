@@ -0,0 +1,107 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+
+// Compares the server CPU cost per H2T -> T2H round trip, and while idle, between the event loop backends.
+// The server runs in SERVER_LOOPBACK mode so the hardware only contributes the software model copies.
+
+typedef struct {
+    double wall_us_per_pkt;
+    double cpu_us_per_pkt;
+    double idle_cpu_pct;
+    double idle_hw_poll_cpu_pct;
+} EVENT_LOOP_BENCH_RESULT;
+
+static double measure_idle_cpu_pct(BENCH_SERVER *server, double seconds) {
+    double cpu_start = bench_server_cpu_seconds(server);
+    double wall_start = bench_now_seconds();
+    usleep((useconds_t)(seconds * 1e6));
+    return 100.0 * (bench_server_cpu_seconds(server) - cpu_start) / (bench_now_seconds() - wall_start);
+}
+
+static int run_backend(EVENT_LOOP_BACKEND backend, size_t mem_size, size_t payload_sz, size_t num_packets, EVENT_LOOP_BENCH_RESULT *result) {
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    char rsp[64];
+    int rc = -1;
+
+    if (bench_server_start(&server, mem_size, backend) != 0) {
+        return -1;
+    }
+    if (bench_client_connect(&client, server.port) == 0 &&
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 1", rsp, sizeof(rsp)) == 0) {
+        // Warm up, then measure
+        bench_client_h2t_echo(&client, payload_sz, 100);
+        double cpu_start = bench_server_cpu_seconds(&server);
+        double wall_start = bench_now_seconds();
+        rc = bench_client_h2t_echo(&client, payload_sz, num_packets);
+        result->wall_us_per_pkt = 1e6 * (bench_now_seconds() - wall_start) / num_packets;
+        result->cpu_us_per_pkt = 1e6 * (bench_server_cpu_seconds(&server) - cpu_start) / num_packets;
+        result->idle_cpu_pct = measure_idle_cpu_pct(&server, 0.5);
+
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 0", rsp, sizeof(rsp));
+        result->idle_hw_poll_cpu_pct = measure_idle_cpu_pct(&server, 0.5);
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    return rc;
+}
+
+static int bench_event_loop_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t payload_sz = bench_size_arg(argc, argv, "payload", 64);
+    const size_t num_packets = bench_size_arg(argc, argv, "packets", 20000);
+    const EVENT_LOOP_BACKEND backends[] = { EVENT_LOOP_BACKEND_SELECT, EVENT_LOOP_BACKEND_EPOLL };
+
+    if (bench_sw_model_init(mem_size) != 0) {
+        return 1;
+    }
+    printf("%zu round trips of %zu byte payloads\n", num_packets, payload_sz);
+    printf("%-8s %14s %14s %16s %16s\n", "backend", "wall us/pkt", "cpu us/pkt", "idle cpu %", "idle hw-poll %");
+    int rc = 0;
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        EVENT_LOOP_BENCH_RESULT result;
+        if (run_backend(backends[i], mem_size, payload_sz, num_packets, &result) != 0) {
+            printf("%-8s failed\n", event_loop_backend_name(backends[i]));
+            rc = 1;
+            continue;
+        }
+        printf("%-8s %14.2f %14.2f %16.1f %16.1f\n", event_loop_backend_name(backends[i]),
+            result.wall_us_per_pkt, result.cpu_us_per_pkt, result.idle_cpu_pct, result.idle_hw_poll_cpu_pct);
+    }
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_EVENT_LOOP_SCENARIO = {
+    "event-loop",
+    "server CPU per packet and while idle, select vs epoll [--packets=N] [--payload=N] [--mem-size=N]",
+    bench_event_loop_run
+};
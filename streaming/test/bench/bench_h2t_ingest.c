@@ -0,0 +1,194 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_st_debug_if_st_dbg_ip_driver.h"
+
+#include "bench_common.h"
+
+// H2T packets sent back to back, in chunks that do not line up with the packets.  In loopback
+// mode the echoed payloads are checked, covering packets split across socket reads.  Reported
+// per packet are the recv() calls and CSR reads the server made to take the stream in and its CPU time.
+
+typedef struct {
+    SOCKET fd;
+    const char *stream;
+    size_t stream_sz;
+    size_t chunk_sz;
+    int rc;
+} H2T_SENDER;
+
+static void *h2t_sender_thread(void *arg) {
+    H2T_SENDER *sender = (H2T_SENDER *)arg;
+    sender->rc = 0;
+    for (size_t offset = 0; (sender->rc == 0) && (offset < sender->stream_sz); offset += sender->chunk_sz) {
+        if (socket_send_all(sender->fd, sender->stream + offset, MIN_MACRO(sender->chunk_sz, sender->stream_sz - offset), 0, NULL) != OK) {
+            sender->rc = -1;
+        }
+    }
+    return NULL;
+}
+
+// Payload sizes cycle through 1 .. 'max_payload_sz' unless 'fixed' is set
+static size_t packet_payload_sz(size_t i, size_t max_payload_sz, char fixed) {
+    return fixed ? max_payload_sz : 1 + (i * 7) % max_payload_sz;
+}
+
+static char *build_h2t_stream(size_t num_packets, size_t max_payload_sz, char fixed, size_t *stream_sz) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    *stream_sz = 0;
+    for (size_t i = 0; i < num_packets; ++i) {
+        *stream_sz += header_sz + packet_payload_sz(i, max_payload_sz, fixed);
+    }
+    char *stream = (char *)malloc(*stream_sz);
+    if (stream == NULL) {
+        return NULL;
+    }
+    char *dst = stream;
+    for (size_t i = 0; i < num_packets; ++i) {
+        const size_t payload_sz = packet_payload_sz(i, max_payload_sz, fixed);
+        populate_h2t_packet_bytes((unsigned char *)dst, 1, 1, 0, 0, (unsigned short)payload_sz);
+        for (size_t j = 0; j < payload_sz; ++j) {
+            dst[header_sz + j] = (char)(i + j);
+        }
+        dst += header_sz + payload_sz;
+    }
+    return stream;
+}
+
+static int check_echo(BENCH_CLIENT *client, size_t num_packets, size_t max_payload_sz) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    char *rx = (char *)malloc(header_sz + max_payload_sz);
+    int rc = (rx != NULL) ? 0 : -1;
+    for (size_t i = 0; (rc == 0) && (i < num_packets); ++i) {
+        const size_t payload_sz = packet_payload_sz(i, max_payload_sz, 0);
+        if (socket_recv_accumulate(client->t2h_data_fd, rx, header_sz + payload_sz, 0, NULL) != OK ||
+            ((H2T_PACKET_HEADER *)(rx + SIZEOF_PACKET_GUARDBAND))->DATA_LEN_BYTES != payload_sz) {
+            rc = -1;
+            break;
+        }
+        for (size_t j = 0; j < payload_sz; ++j) {
+            if (rx[header_sz + j] != (char)(i + j)) {
+                printf("Loopback: packet %zu corrupted at byte %zu\n", i, j);
+                rc = -1;
+                break;
+            }
+        }
+    }
+    free(rx);
+    return rc;
+}
+
+static int run_h2t_stream(BENCH_SERVER *server, BENCH_CLIENT *client, char loopback, size_t num_packets, size_t payload_sz, size_t chunk_sz) {
+    SERVER_CONN *server_conn = &(server->server_conn);
+    H2T_SENDER sender = { client->h2t_data_fd, NULL, 0, chunk_sz, -1 };
+    pthread_t thread;
+    int rc = -1;
+
+    if ((sender.stream = build_h2t_stream(num_packets, payload_sz, !loopback, &(sender.stream_sz))) == NULL) {
+        return -1;
+    }
+    const size_t h2t_start = server_conn->pkt_stats.h2t_cnt;
+    const size_t recv_start = server_conn->h2t_rx_queue.recv_calls;
+    ST_DBG_IP_MMIO_STATS mmio_start;
+    ST_DBG_IP_MMIO_STATS mmio_end;
+    get_mmio_stats(&(server->context.driver_cxt), &mmio_start);
+    const double cpu_start = bench_server_cpu_seconds(server);
+    const double start = bench_now_seconds();
+    if (pthread_create(&thread, NULL, h2t_sender_thread, &sender) == 0) {
+        if (loopback) {
+            rc = check_echo(client, num_packets, payload_sz);
+        } else {
+            // Wait for the server to have pushed all of them to the hardware
+            rc = 0;
+            while (server_conn->pkt_stats.h2t_cnt - h2t_start < num_packets) {
+                if (bench_now_seconds() - start > 5) {
+                    rc = -1;
+                    break;
+                }
+            }
+        }
+        pthread_join(thread, NULL);
+        rc = (rc == 0) ? sender.rc : rc;
+    }
+    const double elapsed = bench_now_seconds() - start;
+    const double cpu = bench_server_cpu_seconds(server) - cpu_start;
+    get_mmio_stats(&(server->context.driver_cxt), &mmio_end);
+    const char *mode = loopback ? "loopback" : "hardware";
+    if (rc == 0) {
+        printf("%-10s %10zu %10zu %12.0f %14.3f %14.3f %14.3f\n", mode, payload_sz, chunk_sz, num_packets / elapsed,
+            (double)(server_conn->h2t_rx_queue.recv_calls - recv_start) / num_packets,
+            (double)(mmio_end.reads - mmio_start.reads) / num_packets, 1e6 * cpu / num_packets);
+    } else {
+        printf("%-10s %10zu %10zu failed\n", mode, payload_sz, chunk_sz);
+    }
+    free((char *)sender.stream);
+    return rc;
+}
+
+static int bench_h2t_ingest_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 8192);
+    const size_t payload_sizes[] = { bench_size_arg(argc, argv, "payload", 64), bench_size_arg(argc, argv, "large-payload", 4096) };
+    const size_t max_payload_sz = bench_size_arg(argc, argv, "max-payload", 4096);
+    const size_t chunk_sz = bench_size_arg(argc, argv, "chunk", 1000);
+    const size_t num_packets = bench_size_arg(argc, argv, "packets", 100000);
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    char rsp[64];
+    int rc = 1;
+
+    if (bench_sw_model_init(mem_size) != 0 || bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+        return 1;
+    }
+    if (bench_client_connect(&client, server.port) == 0) {
+        printf("%-10s %10s %10s %12s %14s %14s %14s\n", "mode", "payload", "chunk", "packets/s", "recvs/packet", "reads/packet", "cpu us/packet");
+        rc = 0;
+        for (size_t i = 0; (rc == 0) && (i < sizeof(payload_sizes) / sizeof(payload_sizes[0])); ++i) {
+            if (run_h2t_stream(&server, &client, 0, num_packets, payload_sizes[i], chunk_sz) != 0) {
+                rc = 1;
+            }
+        }
+        if (rc == 0 && (bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 1", rsp, sizeof(rsp)) != 0 ||
+                        run_h2t_stream(&server, &client, 1, num_packets, max_payload_sz, chunk_sz) != 0)) {
+            rc = 1;
+        }
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 0", rsp, sizeof(rsp));
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_H2T_INGEST_SCENARIO = {
+    "h2t-ingest",
+    "H2T rate, recv() calls and CPU per packet for a back to back stream\n"
+    "                  [--packets=N] [--payload=N] [--large-payload=N] [--max-payload=N] [--chunk=N]",
+    bench_h2t_ingest_run
+};
@@ -0,0 +1,141 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "intel_fpga_api.h"
+#include "intel_st_debug_if_constants.h"
+#include "intel_st_debug_if_st_dbg_ip_driver.h"
+
+#include "bench_common.h"
+
+// Cost of polling a hardware without wakeup while nothing happens, and how long T2H data showing up after
+// a quiet period takes to reach the client, with the polling backoff (IDLE_POLL) disabled and enabled.
+// Reported are the server CPU while idle, the time it spent in each IDLE_POLL state (POLL_STATE_TIME_US)
+// and the median / worst T2H pickup latency.
+
+static int compare_seconds(const void *a, const void *b) {
+    const double lhs = *(const double *)a;
+    const double rhs = *(const double *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int set_server_param(BENCH_CLIENT *client, const char *param, unsigned long value) {
+    char cmd[64];
+    char rsp[64];
+    snprintf(cmd, sizeof(cmd), "%s %s %lu", SET_PARAM_CMD, param, value);
+    if (bench_client_command(client, cmd, rsp, sizeof(rsp)) != 0 || strcmp(rsp, SET_PARAM_CMD_RSP) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Time from the IP reporting a T2H descriptor to the first byte of it at the client.  The software model
+// keeps reporting it until it is withdrawn, so whatever was sent on top is drained afterwards.
+static int measure_t2h_pickup(BENCH_CLIENT *client, size_t payload_sz, double *seconds) {
+    char rx[4096];
+    const double start = bench_now_seconds();
+    fpga_write_64(bench_sw_model_handle(), ST_DBG_IP_T2H_HOW_LONG, payload_sz | ST_DBG_IP_LAST_DESCRIPTOR_MASK);
+    if (recv(client->t2h_data_fd, rx, 1, 0) != 1) {
+        return -1;
+    }
+    *seconds = bench_now_seconds() - start;
+    fpga_write_64(bench_sw_model_handle(), ST_DBG_IP_T2H_HOW_LONG, 0);
+    usleep(20000);
+    while (recv(client->t2h_data_fd, rx, sizeof(rx), MSG_DONTWAIT) > 0) {
+    }
+    return 0;
+}
+
+static int run_idle_poll(const char *mode, char backoff, size_t mem_size, size_t payload_sz, size_t num_samples, double gap_s) {
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    char rsp[64];
+    double *pickups = (double *)malloc(num_samples * sizeof(double));
+    int rc = -1;
+
+    if (pickups == NULL || bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+        free(pickups);
+        return -1;
+    }
+    if (bench_client_connect(&client, server.port) == 0 && (backoff || set_server_param(&client, POLL_SPIN_US_PARAM, (unsigned long)-1) == 0)) {
+        const double cpu_start = bench_server_cpu_seconds(&server);
+        const double wall_start = bench_now_seconds();
+        rc = 0;
+        for (size_t i = 0; (rc == 0) && (i < num_samples); ++i) {
+            usleep((useconds_t)(gap_s * 1e6));
+            rc = measure_t2h_pickup(&client, payload_sz, &pickups[i]);
+        }
+        const double cpu_pct = 100.0 * (bench_server_cpu_seconds(&server) - cpu_start) / (bench_now_seconds() - wall_start);
+        unsigned long long spin_us = 0, sleep_us = 0, wait_us = 0;
+        char cmd[64];
+        snprintf(cmd, sizeof(cmd), "%s %s", GET_PARAM_CMD, POLL_STATE_TIME_US_PARAM);
+        if (rc == 0 && (bench_client_command(&client, cmd, rsp, sizeof(rsp)) != 0 || sscanf(rsp, "%llu %llu %llu", &spin_us, &sleep_us, &wait_us) != 3)) {
+            rc = -1;
+        }
+        if (rc == 0) {
+            qsort(pickups, num_samples, sizeof(double), compare_seconds);
+            printf("%-10s %12.1f %12.1f %12.1f %12.1f %14.1f %14.1f\n", mode, cpu_pct, spin_us / 1e3, sleep_us / 1e3, wait_us / 1e3,
+                1e6 * pickups[num_samples / 2], 1e6 * pickups[num_samples - 1]);
+        } else {
+            printf("%-10s failed\n", mode);
+        }
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    free(pickups);
+    return rc;
+}
+
+static int bench_idle_poll_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t payload_sz = bench_size_arg(argc, argv, "payload", 64);
+    const size_t num_samples = bench_size_arg(argc, argv, "samples", 10);
+    const double gap_s = bench_size_arg(argc, argv, "gap-ms", 200) / 1000.0;
+    int rc = 0;
+
+    if (num_samples == 0 || bench_sw_model_init(mem_size) != 0) {
+        return 1;
+    }
+    printf("%zu T2H packets, each after %.0f ms without activity\n", num_samples, gap_s * 1e3);
+    printf("%-10s %12s %12s %12s %12s %14s %14s\n", "polling", "cpu %", "spin ms", "sleep ms", "wait ms", "pickup us p50", "pickup us max");
+    if (run_idle_poll("spin", 0, mem_size, payload_sz, num_samples, gap_s) != 0 ||
+        run_idle_poll("adaptive", 1, mem_size, payload_sz, num_samples, gap_s) != 0) {
+        rc = 1;
+    }
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_IDLE_POLL_SCENARIO = {
+    "idle-poll",
+    "server CPU while idle and T2H pickup latency, hardware polling with and without backoff\n"
+    "                  [--samples=N] [--gap-ms=N] [--payload=N]",
+    bench_idle_poll_run
+};
@@ -0,0 +1,237 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "intel_st_debug_if_constants.h"
+
+#include "bench_common.h"
+
+// Round trip latency of an H2T packet echoed back on T2H by the server loopback, one packet in flight
+// at a time.  The server either sleeps in its event loop between packets (default) or busy polls
+// (--busy-poll, SERVER_CONN.busy_poll_us), optionally pinned with --cpu / --engine-cpu.  The default
+// event loop is measured over TCP, over a single multiplexed TCP connection (MUX_SOCK_NAME), over a local
+// socket (SERVER_CONN.local_path) and over shared memory (SERVER_CONN.shm) as well.  Reported are
+// percentiles of the round trips and the server CPU time per round trip: busy polling keeps its core
+// busy whether packets flow or not.
+//
+// The "flooded" rows measure the default event loop while another client keeps connecting, as a port scanner or
+// a misconfigured tool would.  The server refuses those connections on a thread of its own or, for "flood-inl",
+// inline (SERVER_CONN.background_reject), the CPU time reported is that of the thread serving the client.  The
+// server is then terminated while still flooded, the client has to be served on.
+
+// Connects to the server and resets the connection again, for as long as 'stop' is 0
+typedef struct {
+    unsigned short port;
+    volatile int stop;
+    size_t connects;
+} FLOODER;
+
+static void *flooder_thread(void *arg) {
+    FLOODER *flooder = (FLOODER *)arg;
+    struct sockaddr_in addr;
+    struct timeval timeout = { 0, 1000 }; // Gives up on a full listen backlog rather than wait for SYN retries
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(flooder->port);
+    while (!flooder->stop) {
+        SOCKET fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == INVALID_SOCKET) {
+            break;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            ++(flooder->connects);
+        }
+        set_linger_socket_option(fd, 1, 0);
+        close_socket_fd(fd);
+    }
+    return NULL;
+}
+
+static int compare_seconds(const void *a, const void *b) {
+    const double lhs = *(const double *)a;
+    const double rhs = *(const double *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static double percentile_us(const double *sorted, size_t num, double fraction) {
+    return 1e6 * sorted[(size_t)(fraction * (double)(num - 1))];
+}
+
+static int ping_pong(BENCH_CLIENT *client, const unsigned char *tx, unsigned char *rx, size_t packet_sz) {
+    if (bench_client_h2t_send(client, tx, packet_sz) != 0 || bench_client_t2h_recv(client, rx, packet_sz) != 0 ||
+        memcmp(tx + SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER, rx + SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER,
+               packet_sz - SIZEOF_PACKET_GUARDBAND - SIZEOF_H2T_PACKET_HEADER) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// The Nagle parameters are accepted over any transport, whether Nagle's algorithm applies to it or not
+static int set_nagle_params(BENCH_CLIENT *client, const char *mode) {
+    const char *params[] = { T2H_NAGLE_PARAM, MGMT_RSP_NAGLE_PARAM };
+    char cmd[64];
+    char rsp[64];
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); ++i) {
+        snprintf(cmd, sizeof(cmd), "%s %s 0", SET_PARAM_CMD, params[i]);
+        if (bench_client_command(client, cmd, rsp, sizeof(rsp)) != 0 || strcmp(rsp, SET_PARAM_CMD_RSP) != 0) {
+            printf("%-10s %s refused\n", mode, params[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int run_latency(const char *mode, int busy_poll_us, const char *local_path, char shm, char mux, char flood, size_t mem_size, size_t payload_sz, size_t num_packets, size_t warmup) {
+    const size_t packet_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + payload_sz;
+    unsigned char *tx = (unsigned char *)malloc(packet_sz);
+    unsigned char *rx = (unsigned char *)malloc(packet_sz);
+    double *round_trips = (double *)malloc(num_packets * sizeof(double));
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    FLOODER flooder = { 0, 0, 0 };
+    pthread_t flooder_tid;
+    char flooding = 0;
+    char rsp[64];
+    int rc = -1;
+
+    bench_server_set_busy_poll(busy_poll_us);
+    bench_server_set_local_path(local_path);
+    if (tx == NULL || rx == NULL || round_trips == NULL || bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+        free(tx);
+        free(rx);
+        free(round_trips);
+        return -1;
+    }
+    const int connected = (local_path != NULL) ? bench_client_connect_local(&client, local_path) :
+                          mux ? bench_client_connect_mux(&client, server.port) : bench_client_connect(&client, server.port);
+    if (connected == 1) {
+        printf("%-10s not offered by the server\n", mode);
+        rc = 0;
+    }
+    if (connected == 0 && set_nagle_params(&client, mode) == 0 &&
+        (!shm || bench_client_attach_shm(&client, SHM_TRANSPORT_DEFAULT_RING_SZ) == 0) &&
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 1", rsp, sizeof(rsp)) == 0 && strcmp(rsp, SET_PARAM_CMD_RSP) == 0) {
+        populate_h2t_packet_bytes(tx, 1, 1, 0, 0, (unsigned short)payload_sz);
+        for (size_t j = 0; j < payload_sz; ++j) {
+            tx[SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + j] = (unsigned char)j;
+        }
+        rc = 0;
+        for (size_t i = 0; (rc == 0) && (i < warmup); ++i) {
+            rc = ping_pong(&client, tx, rx, packet_sz);
+        }
+        flooder.port = server.port;
+        flooding = flood && (pthread_create(&flooder_tid, NULL, flooder_thread, &flooder) == 0);
+        const double cpu_start = bench_server_cpu_seconds(&server);
+        for (size_t i = 0; (rc == 0) && (i < num_packets); ++i) {
+            const double start = bench_now_seconds();
+            rc = ping_pong(&client, tx, rx, packet_sz);
+            round_trips[i] = bench_now_seconds() - start;
+        }
+        const double cpu = bench_server_cpu_seconds(&server) - cpu_start;
+        if (flooding) {
+            bench_server_terminate(&server);
+            flooder.stop = 1;
+            pthread_join(flooder_tid, NULL);
+            if (rc == 0 && ping_pong(&client, tx, rx, packet_sz) != 0) {
+                printf("%-10s not served once terminated\n", mode);
+                rc = -1;
+            }
+        }
+        if (rc == 0) {
+            qsort(round_trips, num_packets, sizeof(double), compare_seconds);
+            printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %14.3f\n", mode, percentile_us(round_trips, num_packets, 0.5),
+                percentile_us(round_trips, num_packets, 0.9), percentile_us(round_trips, num_packets, 0.99),
+                percentile_us(round_trips, num_packets, 0.999), 1e6 * round_trips[num_packets - 1], 1e6 * cpu / num_packets);
+        } else {
+            printf("%-10s failed\n", mode);
+        }
+        snprintf(rsp, sizeof(rsp), "%s %s", GET_PARAM_CMD, REJECTS_RATE_LIMITED_PARAM);
+        if (flooding && rc == 0 && bench_client_command(&client, rsp, rsp, sizeof(rsp)) == 0) {
+            printf("%-10s %zu connections meanwhile, %s of them reset without a rejection message\n", "", flooder.connects, rsp);
+        }
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 0", rsp, sizeof(rsp));
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    free(tx);
+    free(rx);
+    free(round_trips);
+    return rc;
+}
+
+static int bench_latency_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t payload_sz = bench_size_arg(argc, argv, "payload", 64);
+    const size_t num_packets = bench_size_arg(argc, argv, "packets", 20000);
+    const size_t warmup = bench_size_arg(argc, argv, "warmup", 1000);
+    const int busy_poll_us = (int)bench_size_arg(argc, argv, "busy-poll", 50);
+    char local_path[64];
+    int rc = 0;
+
+    snprintf(local_path, sizeof(local_path), "@streaming_bench.%d", (int)getpid());
+    if (num_packets == 0 || busy_poll_us <= 0 || bench_sw_model_init(mem_size) != 0) {
+        return 1;
+    }
+    bench_server_set_cpus((int)bench_size_arg(argc, argv, "cpu", (size_t)-1), (int)bench_size_arg(argc, argv, "engine-cpu", (size_t)-1));
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("Note: a single CPU is online, busy polling competes with the client for it\n");
+    }
+    printf("%-10s %10s %10s %10s %10s %10s %14s\n", "mode", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "cpu us/packet");
+    if (run_latency("default", 0, NULL, 0, 0, 0, mem_size, payload_sz, num_packets, warmup) != 0 ||
+        run_latency("mux", 0, NULL, 0, 1, 0, mem_size, payload_sz, num_packets, warmup) != 0 ||
+        run_latency("unix", 0, local_path, 0, 0, 0, mem_size, payload_sz, num_packets, warmup) != 0 ||
+        run_latency("shm", 0, local_path, 1, 0, 0, mem_size, payload_sz, num_packets, warmup) != 0 ||
+        run_latency("busy-poll", busy_poll_us, NULL, 0, 0, 0, mem_size, payload_sz, num_packets, warmup) != 0 ||
+        run_latency("flooded", 0, NULL, 0, 0, 1, mem_size, payload_sz, num_packets, warmup) != 0) {
+        rc = 1;
+    }
+    bench_server_set_background_reject(0);
+    if (rc == 0 && run_latency("flood-inl", 0, NULL, 0, 0, 1, mem_size, payload_sz, num_packets, warmup) != 0) {
+        rc = 1;
+    }
+    bench_server_set_background_reject(1);
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_LATENCY_SCENARIO = {
+    "latency",
+    "H2T to T2H round trip percentiles in loopback, default event loop over TCP, multiplexed TCP, Unix sockets and shared memory vs busy polling,\n"
+    "                  and while another client keeps connecting\n"
+    "                  [--packets=N] [--payload=N] [--warmup=N] [--busy-poll=usecs] [--cpu=N] [--engine-cpu=N]",
+    bench_latency_run
+};
@@ -0,0 +1,143 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_fpga_api.h"
+#include "intel_st_debug_if_constants.h"
+
+#include "bench_common.h"
+
+// MMIO accessors through a handle, which reload the base address from the interface vector on every
+// access, against the same accesses through an FPGA_MMIO_INTERFACE resolved once up front.  The copies
+// are what memcpy64_fpga2host()/memcpy64_host2fpga() do for every H2T/T2H payload.
+
+typedef struct {
+    FPGA_MMIO_INTERFACE_HANDLE handle;
+    FPGA_MMIO_INTERFACE mmio;
+    uint32_t h2t_mem;
+    uint8_t *host_buff;
+    size_t len;
+    uint64_t sink;
+} MMIO_ACCESS_CTX;
+
+typedef void (*MMIO_ACCESS_FN)(MMIO_ACCESS_CTX *ctx);
+
+static void poll_csr_handle(MMIO_ACCESS_CTX *ctx) {
+    ctx->sink += fpga_read_32(ctx->handle, ST_DBG_IP_H2T_AVAILABLE_SLOTS);
+}
+
+static void poll_csr_resolved(MMIO_ACCESS_CTX *ctx) {
+    ctx->sink += fpga_mmio_read_32(&ctx->mmio, ST_DBG_IP_H2T_AVAILABLE_SLOTS);
+}
+
+static void read_words_handle(MMIO_ACCESS_CTX *ctx) {
+    for (size_t i = 0; i < ctx->len; i += 8) {
+        ctx->sink += fpga_read_64(ctx->handle, ctx->h2t_mem + (uint32_t)i);
+    }
+}
+
+static void read_words_resolved(MMIO_ACCESS_CTX *ctx) {
+    for (size_t i = 0; i < ctx->len; i += 8) {
+        ctx->sink += fpga_mmio_read_64(&ctx->mmio, ctx->h2t_mem + (uint32_t)i);
+    }
+}
+
+static void fpga2host_handle(MMIO_ACCESS_CTX *ctx) {
+    fpga_read_burst(ctx->handle, ctx->h2t_mem, ctx->host_buff, ctx->len);
+}
+
+static void fpga2host_resolved(MMIO_ACCESS_CTX *ctx) {
+    fpga_mmio_read_burst(&ctx->mmio, ctx->h2t_mem, ctx->host_buff, ctx->len);
+}
+
+static void host2fpga_handle(MMIO_ACCESS_CTX *ctx) {
+    fpga_write_burst(ctx->handle, ctx->h2t_mem, ctx->host_buff, ctx->len);
+}
+
+static void host2fpga_resolved(MMIO_ACCESS_CTX *ctx) {
+    fpga_mmio_write_burst(&ctx->mmio, ctx->h2t_mem, ctx->host_buff, ctx->len);
+}
+
+static double ns_per_call(MMIO_ACCESS_FN fn, MMIO_ACCESS_CTX *ctx, size_t iterations) {
+    for (size_t i = 0; i < iterations / 16; ++i) {
+        fn(ctx);
+    }
+    const double start = bench_now_seconds();
+    for (size_t i = 0; i < iterations; ++i) {
+        fn(ctx);
+    }
+    return 1e9 * (bench_now_seconds() - start) / iterations;
+}
+
+static void report(const char *name, size_t len, MMIO_ACCESS_FN by_handle, MMIO_ACCESS_FN resolved, MMIO_ACCESS_CTX *ctx, size_t iterations) {
+    ctx->len = len;
+    const double handle_ns = ns_per_call(by_handle, ctx, iterations);
+    const double resolved_ns = ns_per_call(resolved, ctx, iterations);
+    printf("%-12s %8zu %14.2f %14.2f %10.2f\n", name, len, handle_ns, resolved_ns, handle_ns / resolved_ns);
+}
+
+static int bench_mmio_access_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t iterations = bench_size_arg(argc, argv, "iterations", 1000000);
+    static const size_t s_copy_sizes[] = { 64, 512, 4096 };
+    MMIO_ACCESS_CTX ctx;
+
+    if (bench_sw_model_init(mem_size) != 0) {
+        return 1;
+    }
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.handle = bench_sw_model_handle();
+    ctx.mmio = fpga_mmio_resolve(ctx.handle);
+    ctx.h2t_mem = (mem_size > JOP_MEM_SIZE_2K) ? (uint32_t)mem_size : H2T_MEM_BASE_2K;
+    ctx.host_buff = (uint8_t *)malloc(mem_size + 8);
+    if (ctx.host_buff == NULL) {
+        bench_sw_model_cleanup();
+        return 1;
+    }
+    memset(ctx.host_buff, 0x5A, mem_size + 8);
+
+    printf("%-12s %8s %14s %14s %10s\n", "access", "bytes", "handle ns", "resolved ns", "speedup");
+    report("csr-poll", 4, poll_csr_handle, poll_csr_resolved, &ctx, iterations);
+    for (size_t i = 0; i < sizeof(s_copy_sizes) / sizeof(s_copy_sizes[0]); ++i) {
+        const size_t len = (s_copy_sizes[i] < mem_size) ? s_copy_sizes[i] : mem_size;
+        const size_t copy_iterations = iterations * 64 / (len + 64);
+        report("read-words", len, read_words_handle, read_words_resolved, &ctx, copy_iterations);
+        report("fpga2host", len, fpga2host_handle, fpga2host_resolved, &ctx, copy_iterations);
+        report("host2fpga", len, host2fpga_handle, host2fpga_resolved, &ctx, copy_iterations);
+    }
+
+    free(ctx.host_buff);
+    bench_sw_model_cleanup();
+    return (ctx.sink == 0) ? 1 : 0;
+}
+
+const BENCH_SCENARIO BENCH_MMIO_ACCESS_SCENARIO = {
+    "mmio-access",
+    "MMIO accesses and payload copies through a handle vs. a resolved interface [--mem-size=N] [--iterations=N]",
+    bench_mmio_access_run
+};
@@ -0,0 +1,244 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_st_debug_if_constants.h"
+
+#include "bench_common.h"
+
+// Time from the first connect() of a client to the answer to its first command, with the five sockets of the
+// default handshake vs a single multiplexed connection (MUX_SOCK_NAME).  A fresh server is started for every
+// session, which is left out of the measurement.  Reported are percentiles of the setup time, the mean of the
+// server's own SESSION_SETUP_US and the mean time to disconnect.
+//
+// Two more rows check the handshake itself: "reversed" connects the other four sockets in reverse order, acked
+// ahead of the CONTROL socket, and "stalled" has a silent connection come in first, which holds the client up
+// for the handshake timeout (--stall-ms) before it is given up.  Few sessions are run stalled.
+//
+// The last rows reconnect to a single server, which sets up the hardware right after the previous client
+// disconnected, i.e. while the next one connects: "cold" resets the IP every time, "warm" takes it over
+// (SERVER_CONN.warm_reconnect).  The "warm" column counts the sessions that started warm.  As the hardware is
+// set up before the next client comes in, what taking it over saves does not show in the setup time of either
+// row; the MMIO accesses and the mean time of init_driver() and resume_driver() themselves follow the "warm" row.
+// On a single CPU every row has a mode about 1 ms up, the server spinning for DEFAULT_POLL_SPIN_US after the
+// handshake holds the client up.  "lingering" reconnects warm as well, but closes the sockets of each session
+// only once the next one is set up, as a tool that starts its next run right away might: the server must not
+// wait for them to close (DRAINING_CONN).
+
+typedef enum {
+    SETUP_SOCKETS,
+    SETUP_REVERSED,
+    SETUP_MUX,
+    SETUP_STALLED,
+    SETUP_COLD_RECONNECT,
+    SETUP_WARM_RECONNECT,
+    SETUP_LINGERING_RECONNECT
+} SETUP_MODE;
+
+enum { MAX_STALLED_SESSIONS = 20, HW_SETUP_ROUNDS = 10000 };
+
+static int compare_seconds(const void *a, const void *b) {
+    const double lhs = *(const double *)a;
+    const double rhs = *(const double *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static double percentile_us(const double *sorted, size_t num, double fraction) {
+    return 1e6 * sorted[(size_t)(fraction * (double)(num - 1))];
+}
+
+// MMIO accesses and mean time of a full set up of the hardware vs taking it over, on the context a server left behind
+static void print_hw_setup_accesses(BENCH_SERVER *server) {
+    intel_stream_debug_if_driver_context *context = &(server->context.driver_cxt);
+    ST_DBG_IP_MMIO_STATS before;
+    ST_DBG_IP_MMIO_STATS after_resume;
+    ST_DBG_IP_MMIO_STATS after_init;
+    get_mmio_stats(context, &before);
+    int resumed = resume_driver(context);
+    get_mmio_stats(context, &after_resume);
+    int initialized = init_driver(context, context->mmio_handle);
+    get_mmio_stats(context, &after_init);
+
+    double resume_time = 0.0;
+    double init_time = 0.0;
+    for (size_t i = 0; (resumed == 0) && (initialized == 0) && (i < HW_SETUP_ROUNDS); ++i) {
+        const double start = bench_now_seconds();
+        resumed = resume_driver(context);
+        const double resume_end = bench_now_seconds();
+        initialized = init_driver(context, context->mmio_handle);
+        init_time += bench_now_seconds() - resume_end;
+        resume_time += resume_end - start;
+    }
+    if (resumed == 0 && initialized == 0) {
+        printf("%-10s MMIO reads / writes: init_driver %zu / %zu in %.3f us, resume_driver %zu / %zu in %.3f us\n", "",
+            after_init.reads - after_resume.reads, after_init.writes - after_resume.writes, 1e6 * init_time / HW_SETUP_ROUNDS,
+            after_resume.reads - before.reads, after_resume.writes - before.writes, 1e6 * resume_time / HW_SETUP_ROUNDS);
+    }
+}
+
+static int run_session_setup(const char *mode, SETUP_MODE setup_mode, size_t mem_size, size_t num_sessions) {
+    double *setups = (double *)malloc(num_sessions * sizeof(double));
+    double teardown = 0.0;
+    double server_setup_us = 0.0;
+    size_t warm_starts = 0;
+    int rc = (setups != NULL) ? 0 : -1;
+
+    // Reconnects all go to the same server
+    const char lingering = (setup_mode == SETUP_LINGERING_RECONNECT);
+    const char reconnect = (setup_mode == SETUP_COLD_RECONNECT || setup_mode == SETUP_WARM_RECONNECT || lingering);
+    BENCH_SERVER server;
+    BENCH_CLIENT previous;
+    char has_previous = 0;
+    if (reconnect && rc == 0) {
+        bench_server_set_lifespan(MULTIPLE_CLIENTS);
+        bench_server_set_warm_reconnect(setup_mode != SETUP_COLD_RECONNECT);
+        rc = bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT);
+        bench_server_set_lifespan(SINGLE_CLIENT);
+        bench_server_set_warm_reconnect(1);
+    }
+
+    for (size_t i = 0; (rc == 0) && (i < num_sessions); ++i) {
+        BENCH_CLIENT client;
+        char rsp[64];
+        if (!reconnect && bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+            rc = -1;
+            break;
+        }
+        const double start = bench_now_seconds();
+        const SOCKET silent_fd = (setup_mode == SETUP_STALLED) ? bench_connect_silent(server.port) : INVALID_SOCKET;
+        const int connected = (setup_mode == SETUP_MUX) ? bench_client_connect_mux(&client, server.port) :
+                              (setup_mode == SETUP_REVERSED) ? bench_client_connect_reversed(&client, server.port) :
+                              bench_client_connect(&client, server.port);
+        if (connected == 1) {
+            printf("%-10s not offered by the server\n", mode);
+            bench_client_disconnect(&client);
+            bench_server_join(&server);
+            free(setups);
+            return 0;
+        }
+        if (connected != 0 || bench_client_command(&client, PING_CMD, rsp, sizeof(rsp)) != 0 || strcmp(rsp, PING_CMD_RSP) != 0) {
+            rc = -1;
+        }
+        const double connect_end = bench_now_seconds();
+        setups[i] = connect_end - start;
+        if (has_previous) {
+            bench_client_close(&previous);
+            has_previous = 0;
+        }
+        snprintf(rsp, sizeof(rsp), "%s %s", GET_PARAM_CMD, SESSION_SETUP_US_PARAM);
+        if (rc == 0 && bench_client_command(&client, rsp, rsp, sizeof(rsp)) == 0) {
+            server_setup_us += strtod(rsp, NULL);
+        } else {
+            rc = -1;
+        }
+        snprintf(rsp, sizeof(rsp), "%s %s", GET_PARAM_CMD, WARM_START_PARAM);
+        if (rc == 0 && bench_client_command(&client, rsp, rsp, sizeof(rsp)) == 0) {
+            warm_starts += (strcmp(rsp, "1") == 0);
+        } else {
+            rc = -1;
+        }
+        if (silent_fd != INVALID_SOCKET) {
+            close_socket_fd(silent_fd);
+        }
+        if (reconnect && (rc != 0 || i == num_sessions - 1)) {
+            bench_server_stop(&server);
+        }
+        const double disconnect_start = bench_now_seconds();
+        if (lingering && rc == 0 && i < num_sessions - 1) {
+            if (bench_client_command(&client, DISCONNECT_CMD, rsp, sizeof(rsp)) != 0 || strcmp(rsp, DISCONNECT_CMD_RSP) != 0) {
+                rc = -1;
+            }
+            previous = client;
+            has_previous = 1;
+        } else if (bench_client_disconnect(&client) != 0) {
+            rc = -1;
+        }
+        teardown += bench_now_seconds() - disconnect_start;
+        if (!reconnect) {
+            bench_server_join(&server);
+        }
+    }
+    if (has_previous) {
+        bench_server_stop(&server);
+        bench_client_close(&previous);
+    }
+    if (reconnect && setups != NULL) {
+        bench_server_join(&server);
+    }
+    if (rc == 0) {
+        qsort(setups, num_sessions, sizeof(double), compare_seconds);
+        printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %14.1f %6zu\n", mode, percentile_us(setups, num_sessions, 0.5),
+            percentile_us(setups, num_sessions, 0.9), percentile_us(setups, num_sessions, 0.99),
+            1e6 * setups[num_sessions - 1], server_setup_us / num_sessions, 1e6 * teardown / num_sessions, warm_starts);
+        if (setup_mode == SETUP_WARM_RECONNECT) {
+            print_hw_setup_accesses(&server);
+        }
+    } else {
+        printf("%-10s failed\n", mode);
+    }
+    free(setups);
+    return rc;
+}
+
+static int bench_session_setup_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t num_sessions = bench_size_arg(argc, argv, "sessions", 200);
+    const size_t stall_ms = bench_size_arg(argc, argv, "stall-ms", 100);
+    int rc = 0;
+
+    if (num_sessions == 0 || bench_sw_model_init(mem_size) != 0) {
+        return 1;
+    }
+    printf("%-10s %10s %10s %10s %10s %10s %14s %6s\n", "mode", "p50 us", "p90 us", "p99 us", "max us", "server us", "disconnect us", "warm");
+    if (run_session_setup("sockets", SETUP_SOCKETS, mem_size, num_sessions) != 0 ||
+        run_session_setup("reversed", SETUP_REVERSED, mem_size, num_sessions) != 0 ||
+        run_session_setup("mux", SETUP_MUX, mem_size, num_sessions) != 0) {
+        rc = 1;
+    }
+    bench_server_set_handshake_timeout((unsigned long)stall_ms);
+    if (rc == 0 && stall_ms > 0 && run_session_setup("stalled", SETUP_STALLED, mem_size, MIN_MACRO(num_sessions, MAX_STALLED_SESSIONS)) != 0) {
+        rc = 1;
+    }
+    bench_server_set_handshake_timeout(DEFAULT_HANDSHAKE_TIMEOUT_MS);
+    if (rc == 0 && (run_session_setup("cold", SETUP_COLD_RECONNECT, mem_size, num_sessions) != 0 ||
+                    run_session_setup("warm", SETUP_WARM_RECONNECT, mem_size, num_sessions) != 0 ||
+                    run_session_setup("lingering", SETUP_LINGERING_RECONNECT, mem_size, num_sessions) != 0)) {
+        rc = 1;
+    }
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_SESSION_SETUP_SCENARIO = {
+    "session-setup",
+    "Connect to first command answer, five sockets vs a single multiplexed connection, cold vs warm reconnects,\n"
+    "                  reconnects ahead of closing the previous session\n"
+    "                  [--sessions=N] [--stall-ms=N]",
+    bench_session_setup_run
+};
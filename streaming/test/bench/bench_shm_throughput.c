@@ -0,0 +1,138 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "intel_st_debug_if_constants.h"
+
+#include "bench_common.h"
+
+// H2T packets echoed back on T2H by the server loopback, with up to --window packets in flight, over TCP,
+// over a local socket (SERVER_CONN.local_path) and over shared memory (SERVER_CONN.shm).  The client is a
+// single thread that keeps the window full and checks every echoed payload.  Reported are the payload
+// throughput and the server CPU time per packet: over shared memory a busy server makes no system call.
+
+static void fill_payload(unsigned char *payload, size_t payload_sz, size_t seq) {
+    for (size_t j = 0; j < payload_sz; ++j) {
+        payload[j] = (unsigned char)(seq + j);
+    }
+}
+
+static int check_payload(const unsigned char *payload, size_t payload_sz, size_t seq) {
+    for (size_t j = 0; j < payload_sz; ++j) {
+        if (payload[j] != (unsigned char)(seq + j)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int run_throughput(const char *mode, const char *local_path, size_t ring_sz, size_t mem_size, size_t payload_sz, size_t num_packets, size_t window) {
+    const size_t header_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER;
+    const size_t packet_sz = header_sz + payload_sz;
+    unsigned char *tx = (unsigned char *)malloc(packet_sz);
+    unsigned char *rx = (unsigned char *)malloc(packet_sz);
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    char rsp[64];
+    int rc = -1;
+
+    bench_server_set_local_path(local_path);
+    if (tx == NULL || rx == NULL || bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+        free(tx);
+        free(rx);
+        return -1;
+    }
+    const int connected = (local_path != NULL) ? bench_client_connect_local(&client, local_path) : bench_client_connect(&client, server.port);
+    if (connected == 0 && (ring_sz == 0 || bench_client_attach_shm(&client, ring_sz) == 0) &&
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 1", rsp, sizeof(rsp)) == 0 && strcmp(rsp, SET_PARAM_CMD_RSP) == 0) {
+        populate_h2t_packet_bytes(tx, 1, 1, 0, 0, (unsigned short)payload_sz);
+        const double start = bench_now_seconds();
+        const double cpu_start = bench_server_cpu_seconds(&server);
+        size_t sent = 0;
+        size_t received = 0;
+        rc = 0;
+        while ((rc == 0) && (received < num_packets)) {
+            while ((rc == 0) && (sent < num_packets) && (sent - received < window)) {
+                fill_payload(tx + header_sz, payload_sz, sent++);
+                rc = bench_client_h2t_send(&client, tx, packet_sz);
+            }
+            if (rc == 0 && (rc = bench_client_t2h_recv(&client, rx, packet_sz)) == 0) {
+                rc = check_payload(rx + header_sz, payload_sz, received++);
+            }
+        }
+        const double elapsed = bench_now_seconds() - start;
+        const double cpu = bench_server_cpu_seconds(&server) - cpu_start;
+        if (rc == 0) {
+            printf("%-8s %12.1f %12.1f %14.3f\n", mode, (double)(num_packets * payload_sz) / elapsed / 1e6,
+                (double)num_packets / elapsed / 1e3, 1e6 * cpu / num_packets);
+        } else {
+            printf("%-8s failed\n", mode);
+        }
+        bench_client_command(&client, "SET_PARAM SERVER_LOOPBACK 0", rsp, sizeof(rsp));
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    free(tx);
+    free(rx);
+    return rc;
+}
+
+static int bench_shm_throughput_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t payload_sz = bench_size_arg(argc, argv, "payload", 1024);
+    const size_t num_packets = bench_size_arg(argc, argv, "packets", 100000);
+    const size_t window = bench_size_arg(argc, argv, "window", 16);
+    const size_t ring_sz = bench_size_arg(argc, argv, "ring-size", SHM_TRANSPORT_DEFAULT_RING_SZ);
+    char local_path[64];
+    int rc = 0;
+
+    // The whole window has to fit what the server queues on T2H in loopback, or neither side would make progress
+    snprintf(local_path, sizeof(local_path), "@streaming_bench.%d", (int)getpid());
+    if (num_packets == 0 || payload_sz == 0 || payload_sz > mem_size || window == 0 || ring_sz == 0 ||
+        window * (SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + payload_sz) > OUTPUT_QUEUE_DEFAULT_HIGH_WATER_MARK ||
+        bench_sw_model_init(mem_size) != 0) {
+        return 1;
+    }
+    printf("%-8s %12s %12s %14s\n", "mode", "MB/s", "kpackets/s", "cpu us/packet");
+    if (run_throughput("tcp", NULL, 0, mem_size, payload_sz, num_packets, window) != 0 ||
+        run_throughput("unix", local_path, 0, mem_size, payload_sz, num_packets, window) != 0 ||
+        run_throughput("shm", local_path, ring_sz, mem_size, payload_sz, num_packets, window) != 0) {
+        rc = 1;
+    }
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_SHM_THROUGHPUT_SCENARIO = {
+    "shm-throughput",
+    "H2T to T2H loopback throughput over TCP, Unix sockets and shared memory\n"
+    "                  [--packets=N] [--payload=N] [--window=N] [--ring-size=N]",
+    bench_shm_throughput_run
+};
@@ -0,0 +1,138 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "intel_fpga_api.h"
+#include "intel_st_debug_if_constants.h"
+
+#include "bench_common.h"
+
+// A client that stops reading T2H must not hold up the rest of the session.  The software model
+// keeps reporting the same T2H descriptor, so the server produces T2H data for as long as it is
+// allowed to, while the client measures PING round trips and pushes H2T packets.
+
+enum { SLOW_CONSUMER_TIMEOUT_S = 2 };
+
+static void set_socket_timeouts(SOCKET fd, long seconds) {
+    struct timeval tv = { seconds, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int measure_ping(BENCH_CLIENT *client, size_t num_pings, double *avg_us, double *max_us) {
+    char rsp[64];
+    double total = 0.0;
+    *max_us = 0.0;
+    for (size_t i = 0; i < num_pings; ++i) {
+        double start = bench_now_seconds();
+        if (bench_client_command(client, PING_CMD, rsp, sizeof(rsp)) != 0) {
+            return -1;
+        }
+        double elapsed_us = 1e6 * (bench_now_seconds() - start);
+        total += elapsed_us;
+        *max_us = MAX_MACRO(*max_us, elapsed_us);
+    }
+    *avg_us = total / num_pings;
+    return 0;
+}
+
+static int measure_h2t(BENCH_SERVER *server, BENCH_CLIENT *client, size_t payload_sz, size_t num_packets, double *pkts_per_s) {
+    const size_t packet_sz = SIZEOF_PACKET_GUARDBAND + SIZEOF_H2T_PACKET_HEADER + payload_sz;
+    unsigned char *tx = (unsigned char *)calloc(1, packet_sz);
+    int rc = (tx != NULL) ? 0 : -1;
+
+    const size_t h2t_start = server->server_conn.pkt_stats.h2t_cnt;
+    double start = bench_now_seconds();
+    for (size_t i = 0; (rc == 0) && (i < num_packets); ++i) {
+        populate_h2t_packet_bytes(tx, 1, 1, 0, 0, (unsigned short)payload_sz);
+        if (socket_send_all(client->h2t_data_fd, (const char *)tx, packet_sz, 0, NULL) != OK) {
+            rc = -1;
+        }
+    }
+    // Wait for the server to have pushed all of them to the hardware
+    while (rc == 0 && server->server_conn.pkt_stats.h2t_cnt - h2t_start < num_packets) {
+        if (bench_now_seconds() - start > SLOW_CONSUMER_TIMEOUT_S) {
+            rc = -1;
+        }
+        usleep(100);
+    }
+    *pkts_per_s = num_packets / (bench_now_seconds() - start);
+    free(tx);
+    return rc;
+}
+
+static int bench_slow_consumer_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t t2h_payload_sz = bench_size_arg(argc, argv, "t2h-payload", 1024);
+    const size_t h2t_payload_sz = bench_size_arg(argc, argv, "payload", 64);
+    const size_t num_packets = bench_size_arg(argc, argv, "packets", 10000);
+    const size_t num_pings = bench_size_arg(argc, argv, "pings", 200);
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    int rc = 1;
+
+    if (bench_sw_model_init(mem_size) != 0 || bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+        return 1;
+    }
+    if (bench_client_connect(&client, server.port) == 0) {
+        set_socket_timeouts(client.ctrl_fd, SLOW_CONSUMER_TIMEOUT_S);
+        set_socket_timeouts(client.h2t_data_fd, SLOW_CONSUMER_TIMEOUT_S);
+
+        // Endless T2H data which the client never reads; give it time to back up
+        fpga_write_64(bench_sw_model_handle(), ST_DBG_IP_T2H_HOW_LONG, t2h_payload_sz | ST_DBG_IP_LAST_DESCRIPTOR_MASK);
+        usleep(300000);
+
+        double ping_avg_us, ping_max_us, h2t_pkts_per_s;
+        printf("T2H stalled after %zu packets, %zu bytes queued in the server\n",
+            server.server_conn.pkt_stats.t2h_cnt, bench_server_t2h_queued(&server));
+        if (measure_ping(&client, num_pings, &ping_avg_us, &ping_max_us) != 0) {
+            printf("PING: no response within %d s\n", SLOW_CONSUMER_TIMEOUT_S);
+        } else {
+            printf("PING: %zu round trips, avg %.1f us, max %.1f us\n", num_pings, ping_avg_us, ping_max_us);
+            if (measure_h2t(&server, &client, h2t_payload_sz, num_packets, &h2t_pkts_per_s) != 0) {
+                printf("H2T: stalled, %zu packets not taken in within %d s\n", num_packets, SLOW_CONSUMER_TIMEOUT_S);
+            } else {
+                printf("H2T: %zu packets of %zu bytes, %.0f packets/s\n", num_packets, h2t_payload_sz, h2t_pkts_per_s);
+                rc = 0;
+            }
+        }
+        fpga_write_64(bench_sw_model_handle(), ST_DBG_IP_T2H_HOW_LONG, 0);
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    bench_sw_model_cleanup();
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_SLOW_CONSUMER_SCENARIO = {
+    "slow-consumer",
+    "PING latency and H2T rate while the client does not read T2H [--packets=N] [--payload=N] [--t2h-payload=N] [--pings=N]",
+    bench_slow_consumer_run
+};
@@ -0,0 +1,156 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_fpga_api.h"
+#include "intel_st_debug_if_constants.h"
+#include "intel_st_debug_if_st_dbg_ip_driver.h"
+
+#include "bench_common.h"
+
+// T2H throughput for a range of T2H_BATCH_SIZE values.  The software model keeps reporting the same
+// T2H descriptor, so the server always has a full batch available while the client drains the socket.
+// DESCRIPTORS_DONE acknowledgements are batched up to --done-batch descriptors per CSR write.
+
+static const size_t s_batch_sizes[] = { 1, 4, 16, 64 };
+
+static int set_batch_size(BENCH_CLIENT *client, size_t batch_size) {
+    char cmd[64];
+    char rsp[64];
+    snprintf(cmd, sizeof(cmd), "%s %s %zu", SET_PARAM_CMD, T2H_BATCH_SIZE_PARAM, batch_size);
+    if (bench_client_command(client, cmd, rsp, sizeof(rsp)) != 0 || strcmp(rsp, SET_PARAM_CMD_RSP) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int set_done_batch(BENCH_CLIENT *client, size_t done_batch) {
+    char cmd[64];
+    char rsp[64];
+    snprintf(cmd, sizeof(cmd), "%s %s %zu", SET_DRIVER_PARAM_CMD, DONE_BATCH_PARAM, done_batch);
+    if (bench_client_command(client, cmd, rsp, sizeof(rsp)) != 0 || strcmp(rsp, SET_PARAM_CMD_RSP) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int drain_t2h(BENCH_CLIENT *client, char *rx, size_t rx_sz, double duration_s) {
+    const double end = bench_now_seconds() + duration_s;
+    while (bench_now_seconds() < end) {
+        if (recv(client->t2h_data_fd, rx, rx_sz, 0) <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int bench_t2h_batch_run(int argc, char **argv) {
+    const size_t mem_size = bench_size_arg(argc, argv, "mem-size", 4096);
+    const size_t payload_sz = bench_size_arg(argc, argv, "payload", 64);
+    const double duration_s = bench_size_arg(argc, argv, "duration-ms", 500) / 1000.0;
+    const size_t done_batch = bench_size_arg(argc, argv, "done-batch", 1);
+    const size_t rx_sz = 0x10000;
+    char *rx = (char *)malloc(rx_sz);
+    BENCH_SERVER server;
+    BENCH_CLIENT client;
+    int rc = 1;
+
+    if (rx == NULL || bench_sw_model_init(mem_size) != 0 || bench_server_start(&server, mem_size, EVENT_LOOP_BACKEND_DEFAULT) != 0) {
+        free(rx);
+        return 1;
+    }
+    if (bench_client_connect(&client, server.port) == 0) {
+        SERVER_CONN *server_conn = &(server.server_conn);
+        rc = 0;
+        if (set_done_batch(&client, done_batch) != 0) {
+            printf("%s %zu rejected\n", DONE_BATCH_PARAM, done_batch);
+            rc = 1;
+        }
+        fpga_write_64(bench_sw_model_handle(), ST_DBG_IP_T2H_HOW_LONG, payload_sz | ST_DBG_IP_LAST_DESCRIPTOR_MASK);
+
+        printf("%-10s %12s %12s %14s %14s %14s %14s\n", "batch", "packets/s", "MB/s", "sends/packet", "reads/packet", "writes/packet", "cpu us/packet");
+        for (size_t i = 0; (rc == 0) && (i < sizeof(s_batch_sizes) / sizeof(s_batch_sizes[0])); ++i) {
+            if (set_batch_size(&client, s_batch_sizes[i]) != 0) {
+                printf("%s %zu rejected\n", T2H_BATCH_SIZE_PARAM, s_batch_sizes[i]);
+                rc = 1;
+                break;
+            }
+            // Settle on the new batch size before sampling
+            if (drain_t2h(&client, rx, rx_sz, duration_s / 10) != 0) {
+                rc = 1;
+                break;
+            }
+            const size_t t2h_start = server_conn->pkt_stats.t2h_cnt;
+            const size_t sends_start = server_conn->t2h_queue.send_calls;
+            ST_DBG_IP_MMIO_STATS mmio_start;
+            get_mmio_stats(&(server.context.driver_cxt), &mmio_start);
+            const double cpu_start = bench_server_cpu_seconds(&server);
+            const double start = bench_now_seconds();
+            if (drain_t2h(&client, rx, rx_sz, duration_s) != 0) {
+                rc = 1;
+                break;
+            }
+            const double elapsed = bench_now_seconds() - start;
+            const double cpu = bench_server_cpu_seconds(&server) - cpu_start;
+            const size_t num_packets = server_conn->pkt_stats.t2h_cnt - t2h_start;
+            const size_t num_sends = server_conn->t2h_queue.send_calls - sends_start;
+            ST_DBG_IP_MMIO_STATS mmio_end;
+            get_mmio_stats(&(server.context.driver_cxt), &mmio_end);
+            if (num_packets == 0) {
+                printf("%-10zu no T2H data\n", s_batch_sizes[i]);
+                rc = 1;
+                break;
+            }
+            printf("%-10zu %12.0f %12.1f %14.3f %14.3f %14.3f %14.3f\n", s_batch_sizes[i], num_packets / elapsed,
+                num_packets * (SIZEOF_H2T_PACKET_HEADER + payload_sz) / elapsed / 1e6,
+                (double)num_sends / num_packets, (double)(mmio_end.reads - mmio_start.reads) / num_packets,
+                (double)(mmio_end.writes - mmio_start.writes) / num_packets, 1e6 * cpu / num_packets);
+        }
+        fpga_write_64(bench_sw_model_handle(), ST_DBG_IP_T2H_HOW_LONG, 0);
+        if (rc == 0) {
+            char cmd[64];
+            char rsp[64];
+            snprintf(cmd, sizeof(cmd), "%s %s", GET_PARAM_CMD, HW_WRITES_SAVED_PER_SEC_PARAM);
+            if (bench_client_command(&client, cmd, rsp, sizeof(rsp)) == 0) {
+                printf("%s %s\n", HW_WRITES_SAVED_PER_SEC_PARAM, rsp);
+            }
+        }
+    }
+    bench_client_disconnect(&client);
+    bench_server_join(&server);
+    bench_sw_model_cleanup();
+    free(rx);
+    return rc;
+}
+
+const BENCH_SCENARIO BENCH_T2H_BATCH_SCENARIO = {
+    "t2h-batch",
+    "T2H throughput, send() calls and CSR accesses per packet for several T2H_BATCH_SIZE values [--payload=N] [--duration-ms=N] [--done-batch=N]",
+    bench_t2h_batch_run
+};
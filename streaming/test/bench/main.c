@@ -0,0 +1,108 @@
+// Copyright(c) 2021, Intel Corporation
+//
+// Redistribution  and  use  in source  and  binary  forms,  with  or  without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of  source code  must retain the  above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name  of Intel Corporation  nor the names of its contributors
+//   may be used to  endorse or promote  products derived  from this  software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,  BUT NOT LIMITED TO,  THE
+// IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT  SHALL THE COPYRIGHT OWNER  OR CONTRIBUTORS BE
+// LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR
+// CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT LIMITED  TO,  PROCUREMENT  OF
+// SUBSTITUTE GOODS OR SERVICES;  LOSS OF USE,  DATA, OR PROFITS;  OR BUSINESS
+// INTERRUPTION)  HOWEVER CAUSED  AND ON ANY THEORY  OF LIABILITY,  WHETHER IN
+// CONTRACT,  STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE  OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "intel_fpga_api.h"
+
+#include "bench_common.h"
+
+/*
+ * Streaming debug server benchmarks, run against the UIO software model:
+ *   streaming_bench <scenario> [--option=value ...] [--mmio-burst=<kernel>] [--threaded]
+ */
+
+extern const BENCH_SCENARIO BENCH_EVENT_LOOP_SCENARIO;
+extern const BENCH_SCENARIO BENCH_SLOW_CONSUMER_SCENARIO;
+extern const BENCH_SCENARIO BENCH_T2H_BATCH_SCENARIO;
+extern const BENCH_SCENARIO BENCH_H2T_INGEST_SCENARIO;
+extern const BENCH_SCENARIO BENCH_MMIO_ACCESS_SCENARIO;
+extern const BENCH_SCENARIO BENCH_LATENCY_SCENARIO;
+extern const BENCH_SCENARIO BENCH_IDLE_POLL_SCENARIO;
+extern const BENCH_SCENARIO BENCH_SHM_THROUGHPUT_SCENARIO;
+extern const BENCH_SCENARIO BENCH_SESSION_SETUP_SCENARIO;
+
+static const BENCH_SCENARIO *s_scenarios[] = {
+    &BENCH_EVENT_LOOP_SCENARIO,
+    &BENCH_SLOW_CONSUMER_SCENARIO,
+    &BENCH_T2H_BATCH_SCENARIO,
+    &BENCH_H2T_INGEST_SCENARIO,
+    &BENCH_MMIO_ACCESS_SCENARIO,
+    &BENCH_LATENCY_SCENARIO,
+    &BENCH_IDLE_POLL_SCENARIO,
+    &BENCH_SHM_THROUGHPUT_SCENARIO,
+    &BENCH_SESSION_SETUP_SCENARIO
+};
+static const size_t s_num_scenarios = sizeof(s_scenarios) / sizeof(s_scenarios[0]);
+
+// Keep the server chatter out of the benchmark report, errors excepted
+static int bench_printf(FPGA_MSG_PRINTF_TYPE type, const char *format, va_list args)
+{
+    if (type == FPGA_MSG_PRINTF_ERROR) {
+        fputs("ERROR: ", stderr);
+        return vfprintf(stderr, format, args);
+    }
+    return 0;
+}
+
+static void show_help(const char *program)
+{
+    printf("Usage:\n %s <scenario> [--option=value ...] [--mmio-burst=<auto|64|sse2|avx2|neon>] [--threaded]\n\nScenarios:\n", program);
+    for (size_t i = 0; i < s_num_scenarios; ++i) {
+        printf(" %-16s %s\n", s_scenarios[i]->name, s_scenarios[i]->description);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        show_help(argv[0]);
+        return 1;
+    }
+
+    fpga_platform_register_printf(bench_printf);
+    const char *MMIO_BURST_ARG = "--mmio-burst=";
+    for (int i = 2; i < argc; ++i) {
+        FPGA_MMIO_BURST_KERNEL kernel;
+        if (strncmp(argv[i], MMIO_BURST_ARG, strlen(MMIO_BURST_ARG)) == 0 &&
+            (!fpga_mmio_burst_parse(argv[i] + strlen(MMIO_BURST_ARG), &kernel) || !fpga_mmio_burst_select(kernel))) {
+            fprintf(stderr, "Unsupported MMIO burst kernel: %s\n", argv[i] + strlen(MMIO_BURST_ARG));
+            return 1;
+        }
+        if (strcmp(argv[i], "--threaded") == 0) {
+            bench_server_set_threaded(1);
+        }
+    }
+    for (size_t i = 0; i < s_num_scenarios; ++i) {
+        if (strcmp(argv[1], s_scenarios[i]->name) == 0) {
+            return s_scenarios[i]->run(argc - 1, argv + 1);
+        }
+    }
+
+    show_help(argv[0]);
+    return 1;
+}